@@ -287,15 +287,15 @@ void D3D11Rtx::internalPrepareDraw(
   
   // Calculate given XXHashes for current geometry
   // geoData.futureGeometryHashes = computeHash(geoData, (maxIndex - minIndex));
-  // geoData.futureGeometryHashes = std::shared_future<GeometryHashes>();
+  // geoData.futureGeometryHashes = Future<GeometryHashes>();
   
   // Process and compute hashes for skinning data
-  // std::shared_future<SkinningData> futureSkinningData = processSkinning(geoData);
+  // Future<SkinningData> futureSkinningData = processSkinning(geoData);
 
   // if (RtxOptions::Get()->calculateMeshBoundingBox()) {
   //   geoData.futureBoundingBox = computeAxisAlignedBoundingBox(geoData);
   // }
-  // geoData.futureBoundingBox = std::shared_future<AxisAlignBoundingBox>();
+  // geoData.futureBoundingBox = Future<AxisAlignBoundingBox>();
 
   // Send it
   m_dctx->EmitCs([geoData](DxvkContext* ctx) {
@@ -6,6 +6,7 @@
 
 #include "../dxso/dxso_isgn.h"
 
+#include "../util/util_bit.h"
 #include "../util/util_math.h"
 #include "../util/util_vector.h"
 
@@ -49,6 +50,37 @@ namespace dxvk {
     Rc<DxvkBuffer>            buffer;
     DxsoShaderMetaInfo        meta  = {};
     bool                      dirty = true;
+
+    // NV-DXVK start: Track registers changed since the last upload
+    // Hardware vertex processing only, software vertex processing always re-uploads
+    bit::bitset<caps::MaxFloatConstantsVS> changedF;
+    bit::bitset<caps::MaxOtherConstants>   changedI;
+    // Number of registers the bound slice holds current values for
+    uint32_t                  uploadedCountF = 0;
+    uint32_t                  uploadedCountI = 0;
+
+    bool NeedsUpload(uint32_t floatCount, uint32_t intCount) {
+      if (floatCount > uploadedCountF || intCount > uploadedCountI)
+        return true;
+
+      for (uint32_t i = 0; i < floatCount / 32; i++) {
+        if (changedF.dword(i) != 0)
+          return true;
+      }
+
+      if (floatCount % 32 != 0 && (changedF.dword(floatCount / 32) & ((1u << (floatCount % 32)) - 1)) != 0)
+        return true;
+
+      return (changedI.dword(0) & ((1u << intCount) - 1)) != 0;
+    }
+
+    void MarkUploaded(uint32_t floatCount, uint32_t intCount) {
+      changedF.clearAll();
+      changedI.clearAll();
+      uploadedCountF = floatCount;
+      uploadedCountI = intCount;
+    }
+    // NV-DXVK end
   };
 
 }
\ No newline at end of file
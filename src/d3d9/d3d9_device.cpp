@@ -41,6 +41,7 @@
 
 #include "../util/util_bit.h"
 #include "../util/util_math.h"
+#include "../util/log/metrics.h"
 
 #include "../dxvk/rtx_render/rtx_context.h"
 #include "../dxvk/rtx_render/rtx_options.h"
@@ -2955,18 +2956,9 @@ namespace dxvk {
     auto* oldShader = GetCommonShader(m_state.vertexShader);
     auto* newShader = GetCommonShader(shader);
 
-    bool oldCopies = oldShader && oldShader->GetMeta().needsConstantCopies;
-    bool newCopies = newShader && newShader->GetMeta().needsConstantCopies;
-
-    m_consts[DxsoProgramTypes::VertexShader].dirty |= oldCopies || newCopies || !oldShader;
-    m_consts[DxsoProgramTypes::VertexShader].meta  = newShader ? newShader->GetMeta() : DxsoShaderMetaInfo();
-
-    if (newShader && oldShader) {
-      m_consts[DxsoProgramTypes::VertexShader].dirty
-        |= newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF
-        || newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI
-        || newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB;
-    }
+    // NV-DXVK start: shader constant change tracking
+    MarkShaderConstantsDirty<DxsoProgramTypes::VertexShader>(oldShader, newShader);
+    // NV-DXVK end
 
     m_state.vertexShader = shader;
 
@@ -3284,18 +3276,9 @@ namespace dxvk {
     auto* oldShader = GetCommonShader(m_state.pixelShader);
     auto* newShader = GetCommonShader(shader);
 
-    bool oldCopies = oldShader && oldShader->GetMeta().needsConstantCopies;
-    bool newCopies = newShader && newShader->GetMeta().needsConstantCopies;
-
-    m_consts[DxsoProgramTypes::PixelShader].dirty |= oldCopies || newCopies || !oldShader;
-    m_consts[DxsoProgramTypes::PixelShader].meta  = newShader ? newShader->GetMeta() : DxsoShaderMetaInfo();
-
-    if (newShader && oldShader) {
-      m_consts[DxsoProgramTypes::PixelShader].dirty
-        |= newShader->GetMeta().maxConstIndexF > oldShader->GetMeta().maxConstIndexF
-        || newShader->GetMeta().maxConstIndexI > oldShader->GetMeta().maxConstIndexI
-        || newShader->GetMeta().maxConstIndexB > oldShader->GetMeta().maxConstIndexB;
-    }
+    // NV-DXVK start: shader constant change tracking
+    MarkShaderConstantsDirty<DxsoProgramTypes::PixelShader>(oldShader, newShader);
+    // NV-DXVK end
 
     m_state.pixelShader = shader;
 
@@ -4868,6 +4851,9 @@ namespace dxvk {
 
 
   void D3D9DeviceEx::EmitCsChunk(DxvkCsChunkRef&& chunk) {
+    // NV-DXVK start: commands in this chunk may wait on batched geometry hashes
+    m_rtx.FlushGeometryHashes();
+    // NV-DXVK end
     m_csThread.dispatchChunk(std::move(chunk));
     m_csIsBusy = true;
   }
@@ -5120,6 +5106,11 @@ namespace dxvk {
     if (likely(constSet.meta.maxConstIndexB != 0 || boolBuffer == nullptr)) {
       CopySoftwareConstants(DxsoConstantBuffers::VSBoolConstantBuffer, boolBuffer, Src.bConsts, boolDataSize, false);
     }
+
+    // NV-DXVK start: shader constant upload counters
+    m_constantUploadStats.numUploads++;
+    m_constantUploadStats.bytesWritten += floatDataSize + intDataSize + boolDataSize;
+    // NV-DXVK end
   }
 
 
@@ -5215,6 +5206,14 @@ namespace dxvk {
           data[constant.uboIdx] = *reinterpret_cast<const Vector4*>(constant.float32);
       }
     }
+
+    // NV-DXVK start: shader constant change tracking
+    constSet.MarkUploaded(floatCount, constSet.meta.maxConstIndexI);
+
+    m_constantUploadStats.numUploads++;
+    m_constantUploadStats.bytesWritten += (constSet.meta.maxConstIndexI != 0 ? intDataSize : 0)
+                                        + (constSet.meta.maxConstIndexF != 0 ? floatDataSize : 0);
+    // NV-DXVK end
   }
 
 
@@ -6669,7 +6668,14 @@ namespace dxvk {
         ? m_consts[ProgramType].meta.maxConstIndexF
         : m_consts[ProgramType].meta.maxConstIndexI;
 
-      m_consts[ProgramType].dirty |= StartRegister < maxCount;
+      // NV-DXVK start: shader constant change tracking
+      // Games often set the same values for every draw, only registers that change need an upload
+      const uint32_t firstChanged = TracksConstantChanges<ProgramType>()
+        ? MarkChangedConstants<ProgramType, ConstantType>(StartRegister, pConstantData, Count)
+        : StartRegister;
+
+      m_consts[ProgramType].dirty |= firstChanged < maxCount;
+      // NV-DXVK end
     } else if constexpr (ProgramType == DxsoProgramType::VertexShader) {
       if (unlikely(CanSWVP())) {
         m_consts[DxsoProgramType::VertexShader].dirty |= StartRegister < m_consts[ProgramType].meta.maxConstIndexB;
@@ -6687,6 +6693,104 @@ namespace dxvk {
   }
 
 
+  // NV-DXVK start: shader constant change tracking
+  template <DxsoProgramType ProgramType, D3D9ConstantType ConstantType, typename T>
+  uint32_t D3D9DeviceEx::MarkChangedConstants(
+          UINT  StartRegister,
+    const T*    pConstantData,
+          UINT  Count) {
+    D3D9ConstantSets& constSet = m_consts[ProgramType];
+    const bool floatEmu = m_d3d9Options.d3d9FloatEmulation == D3D9FloatEmulation::Enabled;
+
+    uint32_t firstChanged = std::numeric_limits<uint32_t>::max();
+    uint32_t numRedundant = 0;
+
+    auto MarkHelper = [&] (const auto& set) {
+      for (uint32_t i = 0; i < Count; i++) {
+        const uint32_t reg = StartRegister + i;
+
+        if constexpr (ConstantType == D3D9ConstantType::Float) {
+          // Compare against the value UpdateStateConstants is about to store
+          const Vector4 value = floatEmu
+            ? replaceNaN(pConstantData + (i * 4))
+            : Vector4(pConstantData + (i * 4));
+
+          if (std::memcmp(&set.fConsts[reg], &value, sizeof(Vector4)) == 0) {
+            numRedundant++;
+            continue;
+          }
+
+          constSet.changedF.set(reg, true);
+        } else {
+          if (std::memcmp(&set.iConsts[reg], pConstantData + (i * 4), sizeof(Vector4i)) == 0) {
+            numRedundant++;
+            continue;
+          }
+
+          constSet.changedI.set(reg, true);
+        }
+
+        firstChanged = std::min(firstChanged, reg);
+      }
+    };
+
+    if constexpr (ProgramType == DxsoProgramTypes::VertexShader)
+      MarkHelper(m_state.vsConsts);
+    else
+      MarkHelper(m_state.psConsts);
+
+    m_constantUploadStats.numRedundantRegisters += numRedundant;
+
+    return firstChanged;
+  }
+
+
+  template <DxsoProgramType ProgramType>
+  void D3D9DeviceEx::MarkShaderConstantsDirty(const D3D9CommonShader* pOldShader, const D3D9CommonShader* pNewShader) {
+    D3D9ConstantSets& constSet = m_consts[ProgramType];
+
+    bool oldCopies = pOldShader && pOldShader->GetMeta().needsConstantCopies;
+    bool newCopies = pNewShader && pNewShader->GetMeta().needsConstantCopies;
+
+    constSet.dirty |= oldCopies || newCopies || !pOldShader;
+    constSet.meta   = pNewShader ? pNewShader->GetMeta() : DxsoShaderMetaInfo();
+
+    if (pNewShader && pOldShader) {
+      const DxsoShaderMetaInfo& oldMeta = pOldShader->GetMeta();
+      const DxsoShaderMetaInfo& newMeta = pNewShader->GetMeta();
+
+      if (TracksConstantChanges<ProgramType>()) {
+        // Keep the bound constants unless the new shader reads registers they lack, or that changed since
+        const uint32_t floatConstsCount = ProgramType == DxsoProgramTypes::VertexShader
+          ? m_vsFloatConstsCount
+          : m_psFloatConstsCount;
+
+        constSet.dirty
+          |= constSet.NeedsUpload(std::min(newMeta.maxConstIndexF, floatConstsCount), newMeta.maxConstIndexI)
+          || newMeta.maxConstIndexB > oldMeta.maxConstIndexB;
+      } else {
+        constSet.dirty
+          |= newMeta.maxConstIndexF > oldMeta.maxConstIndexF
+          || newMeta.maxConstIndexI > oldMeta.maxConstIndexI
+          || newMeta.maxConstIndexB > oldMeta.maxConstIndexB;
+      }
+    }
+  }
+
+
+  void D3D9DeviceEx::ReportConstantUploadStats() {
+    static const MetricId s_uploads = Metrics::registerCounter("d3d9_constant_uploads");
+    static const MetricId s_bytesWritten = Metrics::registerCounter("d3d9_constant_bytes_written");
+    static const MetricId s_redundantRegisters = Metrics::registerCounter("d3d9_constant_redundant_registers");
+    Metrics::add(s_uploads, m_constantUploadStats.numUploads);
+    Metrics::add(s_bytesWritten, static_cast<double>(m_constantUploadStats.bytesWritten));
+    Metrics::add(s_redundantRegisters, m_constantUploadStats.numRedundantRegisters);
+
+    m_constantUploadStats = {};
+  }
+  // NV-DXVK end
+
+
   void D3D9DeviceEx::UpdateFixedFunctionVS() {
     ScopedCpuProfileZone();
     // Shader...
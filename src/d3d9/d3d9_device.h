@@ -823,6 +823,20 @@ namespace dxvk {
     
     template <DxsoProgramType ShaderStage>
     void UploadConstants();
+
+    // NV-DXVK start: shader constant change tracking
+    template <DxsoProgramType ProgramType>
+    bool TracksConstantChanges() {
+      // Software vertex processing uploads from its own buffers, always re-upload those
+      return m_d3d9Options.trackConstantChanges && (ProgramType == DxsoProgramType::PixelShader || !CanSWVP());
+    }
+
+    template <DxsoProgramType ProgramType, D3D9ConstantType ConstantType, typename T>
+    uint32_t MarkChangedConstants(UINT StartRegister, const T* pConstantData, UINT Count);
+
+    template <DxsoProgramType ProgramType>
+    void MarkShaderConstantsDirty(const D3D9CommonShader* pOldShader, const D3D9CommonShader* pNewShader);
+    // NV-DXVK end
     
     void UpdateClipPlanes();
     
@@ -1042,6 +1056,10 @@ namespace dxvk {
         const T*    pConstantData,
               UINT  Count);
 
+    // NV-DXVK start: shader constant upload counters
+    void ReportConstantUploadStats();
+    // NV-DXVK end
+
     template <
       DxsoProgramType  ProgramType,
       D3D9ConstantType ConstantType,
@@ -1240,6 +1258,14 @@ namespace dxvk {
     D3D9ConstantLayout              m_psLayout;
     D3D9ConstantSets                m_consts[DxsoProgramTypes::Count];
 
+    // NV-DXVK start: shader constant upload counters, reported once per frame
+    struct {
+      uint32_t                      numUploads            = 0;
+      uint64_t                      bytesWritten          = 0;
+      uint32_t                      numRedundantRegisters = 0;
+    }                               m_constantUploadStats;
+    // NV-DXVK end
+
     D3D9ViewportInfo                m_viewportInfo;
 
     DxvkCsChunkPool                 m_csChunkPool;
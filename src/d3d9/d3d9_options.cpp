@@ -99,6 +99,10 @@ namespace dxvk {
     // NV-DXVK start: force app geometry data into host memory
     this->hostMemoryForGeometry = config.getOption<bool>("d3d9.hostMemoryForGeometry", true);
     // NV-DXVK end
+
+    // NV-DXVK start: shader constant change tracking
+    this->trackConstantChanges = config.getOption<bool>("d3d9.trackConstantChanges", true);
+    // NV-DXVK end
  
     // If we are not Nvidia, enable general hazards.
     this->generalHazards = adapter != nullptr
@@ -190,6 +190,13 @@ namespace dxvk {
     /// Use host memory for all geometry data (vertex/index).
     bool hostMemoryForGeometry;
     // NV-DXVK end
+
+    // NV-DXVK start: shader constant change tracking
+    /// Only upload shader constants when a register read by the bound shader
+    /// changes value, and keep the bound constants across shader changes when
+    /// they still hold everything the new shader reads.
+    bool trackConstantChanges;
+    // NV-DXVK end
   };
 
 }
\ No newline at end of file
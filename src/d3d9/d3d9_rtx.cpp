@@ -23,6 +23,10 @@ namespace dxvk {
     , m_gpeWorkers(popcnt_uint8(D3D9Rtx::kAllThreads), "geometry-processing") { }
 
   void D3D9Rtx::Initialize() {
+    if (GeometryHashCache::enable()) {
+      m_hashCache.initialize();
+    }
+
     m_vsVertexCaptureData = m_parent->CreateConstantBuffer(false,
                                         sizeof(D3D9RtxVertexCaptureData),
                                         DxsoProgramType::VertexShader,
@@ -492,13 +496,11 @@ namespace dxvk {
 
     // Copy all the vertices into a staging buffer.  Assign fields of the geoData structure.
     processVertices(vertexContext, vertexIndexOffset, idealTexcoordIndex, geoData);
-    geoData.futureGeometryHashes = computeHash(geoData, (maxIndex - minIndex));
-    std::shared_future<SkinningData> futureSkinningData = processSkinning(geoData);
-    if (RtxOptions::Get()->calculateMeshBoundingBox()) {
-      geoData.futureBoundingBox = computeAxisAlignedBoundingBox(geoData);
-    } else {
-      geoData.futureBoundingBox = std::shared_future<AxisAlignBoundingBox>();
-    }
+    // Bounding boxes are computed by the hashing tasks, while the positions are in cache
+    geoData.futureBoundingBox = Future<AxisAlignBoundingBox>();
+    Future<AxisAlignBoundingBox>* pFutureBoundingBox = RtxOptions::Get()->calculateMeshBoundingBox() ? &geoData.futureBoundingBox : nullptr;
+    geoData.futureGeometryHashes = computeHash(geoData, (maxIndex - minIndex), pFutureBoundingBox);
+    Future<SkinningData> futureSkinningData = processSkinning(geoData);
 
     // For shader based drawcalls we also want to capture the vertex shader output
     if (m_parent->UseProgrammableVS() && useVertexCapture()) {
@@ -521,7 +523,7 @@ namespace dxvk {
     return true;
   }
 
-  std::shared_future<SkinningData> D3D9Rtx::processSkinning(const RasterGeometry& geoData) {
+  Future<SkinningData> D3D9Rtx::processSkinning(const RasterGeometry& geoData) {
     ScopedCpuProfileZone();
     if (d3d9State().renderStates[D3DRS_VERTEXBLEND] != D3DVBF_DISABLE) {
       bool hasBlendIndices = d3d9State().vertexDecl != nullptr ? d3d9State().vertexDecl->TestFlag(D3D9VertexDeclFlag::HasBlendIndices) : false;
@@ -585,7 +587,7 @@ namespace dxvk {
       });
     }
 
-    return std::shared_future<SkinningData>(); // empty future
+    return Future<SkinningData>(); // empty future
   }
 
   template<bool FixedFunction>
@@ -3,6 +3,7 @@
 #include "d3d9_state.h"
 #include "../dxvk/dxvk_buffer.h"
 #include "../util/util_threadpool.h"
+#include "../dxvk/rtx_render/rtx_geometry_hash_cache.h"
 #include <vector>
 
 namespace dxvk {
@@ -26,6 +27,7 @@ namespace dxvk {
 
     RTX_OPTION("rtx", bool, useVertexCapture, true, "When enabled, injects code into the original vertex shader to capture final shaded vertex positions.  Is useful for games using simple vertex shaders, that still also set the fixed function transform matrices.");
     RTX_OPTION("rtx", bool, useVertexCapturedNormals, true, "When enabled, vertex normals are read from the input assembler and used in raytracing.  This doesn't always work as normals can be in any coordinate space, but can help sometimes.");
+    RTX_OPTION("rtx", uint32_t, geometryHashBatchSize, 32, "The number of draw calls whose geometry hashing is gathered into a single worker task.  Larger batches reduce scheduling overhead in scenes with many draw calls, a value of 1 hashes every draw call as its own task.");
 
     // Copy of the parameters issued to D3D9 on DrawXXX
     struct Draw {
@@ -115,6 +117,13 @@ namespace dxvk {
       */
     void EndFrame();
 
+    /**
+      * \brief: Dispatch all geometry hashing work gathered so far to the worker threads.
+      *         Must be called before any command referencing the pending hashes is
+      *         submitted to the CS thread.
+      */
+    void FlushGeometryHashes();
+
   private: 
     // Give threads specific tasks, to reduce the chance of 
     //  critical work being pre-empted.
@@ -128,8 +137,33 @@ namespace dxvk {
       kHashingThreads = (kHashingThread0 | kHashingThread1 | kHashingThread2),
       kAllThreads = (kHashingThreads | kSkinningThread)
     };
+    // Geometry hashing work for a single draw call, deferred until its batch is dispatched
+    struct GeometryHashJob {
+      HashQuery vertexRegions[2]; // Position, Texcoord
+      Rc<DxvkBuffer> indexBufferRef;
+      const void* pIndexData;
+      size_t indexStride;
+      uint32_t indexCount;
+      uint32_t maxIndexValue;
+      XXH64_hash_t vertexDataSeed;
+      XXH64_hash_t geometryDescriptorHash;
+      XXH64_hash_t vertexLayoutHash;
+      XXH64_hash_t cacheFingerprint;
+      GeometryHashCache::LookupResult cacheResult;
+      Promise<GeometryHashes> promise;
+      fast::PositionFormat positionFormat;
+      bool computeBoundingBox;
+      Promise<AxisAlignBoundingBox> boundingBoxPromise;
+    };
+    // Must outlive the workers, which may still be filling it
+    GeometryHashCache m_hashCache;
+    // Job storage handed back by the workers once a batch is hashed, so batches don't reallocate
+    AtomicMpmcQueue<std::vector<GeometryHashJob>, 16> m_spareHashBatches;
+
     WorkerThreadPool<4 * 1024> m_gpeWorkers;
 
+    std::vector<GeometryHashJob> m_pendingHashJobs;
+
     DxvkStagingDataAlloc m_rtStagingData;
     D3D9DeviceEx* m_parent;
 
@@ -185,10 +219,12 @@ namespace dxvk {
 
     bool isRenderingUI();
 
-    std::shared_future<SkinningData> processSkinning(const RasterGeometry& geoData);
+    Future<SkinningData> processSkinning(const RasterGeometry& geoData);
+
+    Future<AxisAlignBoundingBox> computeAxisAlignedBoundingBox(const RasterGeometry& geoData);
 
-    std::shared_future<AxisAlignBoundingBox> computeAxisAlignedBoundingBox(const RasterGeometry& geoData);
+    Future<GeometryHashes> computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue, Future<AxisAlignBoundingBox>* pBoundingBoxOut);
 
-    std::shared_future<GeometryHashes> computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue);
+    void processGeometryHashBatch(std::vector<GeometryHashJob>& jobs);
   };
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include "d3d9_device.h"
 #include "d3d9_rtx.h"
@@ -5,7 +6,9 @@
 #include "d3d9_state.h"
 #include "../dxvk/dxvk_buffer.h"
 #include "../dxvk/rtx_render/rtx_hashing.h"
+#include "../dxvk/rtx_render/rtx_geometry_hash_cache.h"
 #include "../util/util_fastops.h"
+#include "../util/log/metrics.h"
 
 namespace dxvk {
   // Geometry indices should never be signed.  Using this to handle the non-indexed case for templates.
@@ -39,6 +42,57 @@ namespace dxvk {
     return true;
   }
 
+  fast::PositionFormat getPositionFormat(const VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R32G32B32_SFLOAT:
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+      return fast::PositionFormat::Float32x3;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return fast::PositionFormat::Float16x4;
+    case VK_FORMAT_R16G16B16A16_SSCALED:
+      return fast::PositionFormat::Sint16x4;
+    case VK_FORMAT_R16G16B16A16_SNORM:
+      return fast::PositionFormat::Snorm16x4;
+    case VK_FORMAT_R8G8B8A8_USCALED:
+      return fast::PositionFormat::Uint8x4;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      return fast::PositionFormat::Unorm8x4;
+    case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+      return fast::PositionFormat::Snorm10x3;
+    default:
+      ONCE(Logger::info(str::format("[RTX-Compatibility-Info] Bounding boxes are not supported for vertex position format [", format, "]. Ignoring.")));
+      return fast::PositionFormat::Unsupported;
+    }
+  }
+
+  AxisAlignBoundingBox toBoundingBox(const HashBoundsQuery& bounds) {
+    return AxisAlignBoundingBox {
+      { bounds.minPos[0], bounds.minPos[1], bounds.minPos[2] },
+      { bounds.maxPos[0], bounds.maxPos[1], bounds.maxPos[2] }
+    };
+  }
+
+  static_assert(VertexRegions::Count == sizeof(D3D9Rtx::GeometryHashJob::vertexRegions) / sizeof(HashQuery), "Hash job must hold every vertex region");
+
+  // Scratch memory reused across all the hash jobs executed on a worker thread
+  struct GeometryHashScratch {
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    std::vector<NoIndices> noIndices;
+    std::vector<uint8_t> packedElements;
+
+    template<typename T>
+    std::vector<T>& uniqueIndices() {
+      if constexpr (std::is_same<T, uint16_t>::value) {
+        return indices16;
+      } else if constexpr (std::is_same<T, uint32_t>::value) {
+        return indices32;
+      } else {
+        return noIndices;
+      }
+    }
+  };
+
   // Sorts and deduplicates a set of integers, storing the result in a vector
   template<typename T>
   void deduplicateSortIndices(const void* pIndexData, const size_t indexCount, const uint32_t maxIndexValue, std::vector<T>& uniqueIndicesOut) {
@@ -46,8 +100,8 @@ namespace dxvk {
     // We know there will be at most, this many unique indices
     const uint32_t indexRange = maxIndexValue + 1;
 
-    // Initialize all to 0
-    uniqueIndicesOut.resize(indexRange, (T)0);
+    // Initialize all to 0 (the vector may be reused scratch memory)
+    uniqueIndicesOut.assign(indexRange, (T)0);
 
     // Use memory as a bin table for index data
     for (uint32_t i = 0; i < indexCount; i++) {
@@ -68,13 +122,13 @@ namespace dxvk {
   }
 
   template<typename T>
-  void hashGeometryData(const size_t indexCount, const uint32_t maxIndexValue, const void* pIndexData, const Rc<DxvkBuffer>& indexBufferRef, const HashQuery vertexRegions[Count], GeometryHashes& hashesOut) {
+  void hashGeometryData(const size_t indexCount, const uint32_t maxIndexValue, const void* pIndexData, const Rc<DxvkBuffer>& indexBufferRef, const HashQuery vertexRegions[Count], GeometryHashScratch& scratch, HashBoundsQuery* pBounds, GeometryHashes& hashesOut) {
     ScopedCpuProfileZone();
 
     const HashRule& globalHashRule = RtxOptions::Get()->GeometryHashGenerationRule;
 
-    // TODO (REMIX-658): Improve this by reducing allocation overhead of vector
-    std::vector<T> uniqueIndices(0);
+    std::vector<T>& uniqueIndices = scratch.uniqueIndices<T>();
+    uniqueIndices.clear();
     if constexpr (!std::is_same<T, NoIndices>::value) {
       assert((indexCount > 0 && indexBufferRef.ptr()));
       deduplicateSortIndices(pIndexData, indexCount, maxIndexValue, uniqueIndices);
@@ -98,10 +152,21 @@ namespace dxvk {
 
       if (globalHashRule.test(component) && componentToRegionMap.count(component) > 0) {
         const VertexRegions region = componentToRegionMap.at(component);
-        hashesOut[component] = hashVertexRegionIndexed(vertexRegions[(uint32_t)region], uniqueIndices);
+        // Positions are bounded in the same pass, so the vertex buffer is only streamed once
+        HashBoundsQuery* pRegionBounds = region == Position ? pBounds : nullptr;
+        hashesOut[component] = hashVertexRegionIndexed(vertexRegions[(uint32_t)region], uniqueIndices, scratch.packedElements, pRegionBounds);
+        if (pRegionBounds) {
+          pBounds = nullptr;
+        }
       }
     }
 
+    // The hash rule didn't cover positions, bound them separately
+    if (pBounds && vertexRegions[Position].stride > 0) {
+      const HashQuery& positions = vertexRegions[Position];
+      fast::accumulatePositionBounds(positions.pBase, positions.stride, (uint32_t) (positions.size / positions.stride), pBounds->format, pBounds->minPos, pBounds->maxPos);
+    }
+
     // TODO (REMIX-656): Remove this once we can transition content to new hash
     if (globalHashRule.test(HashComponents::LegacyPositions0) || globalHashRule.test(HashComponents::LegacyPositions1)) {
       hashRegionLegacy(vertexRegions[Position], hashesOut[HashComponents::LegacyPositions0], hashesOut[HashComponents::LegacyPositions1]);
@@ -118,7 +183,36 @@ namespace dxvk {
     }
   }
 
-  std::shared_future<GeometryHashes> D3D9Rtx::computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue) {
+  // Releases the staging memory of a draw call which didn't need its data hashed
+  void releaseGeometryData(const Rc<DxvkBuffer>& indexBufferRef, const HashQuery vertexRegions[Count]) {
+    if (indexBufferRef.ptr())
+      indexBufferRef->release(DxvkAccess::Read);
+
+    for (uint32_t i = 0; i < Count; i++) {
+      if (vertexRegions[i].size > 0 && vertexRegions[i].ref.ptr())
+        vertexRegions[i].ref->release(DxvkAccess::Read);
+    }
+  }
+
+  // Applies the per draw call state on top of the hashes derived from the buffer contents
+  GeometryHashes finalizeGeometryHashes(const GeometryHashes& contentHashes, const XXH64_hash_t geometryDescriptorHash, const XXH64_hash_t vertexLayoutHash, const XXH64_hash_t vertexDataSeed) {
+    GeometryHashes hashes = contentHashes;
+
+    // Finalize the descriptor hash
+    hashes[HashComponents::GeometryDescriptor] = geometryDescriptorHash;
+    hashes[HashComponents::VertexLayout] = vertexLayoutHash;
+
+    // Do we need to modify the hash from an external source?
+    if (vertexDataSeed) {
+      hashes[HashComponents::VertexPosition] ^= vertexDataSeed;
+    }
+
+    assert(hashes[HashComponents::VertexPosition] != kEmptyHash);
+
+    return hashes;
+  }
+
+  Future<GeometryHashes> D3D9Rtx::computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue, Future<AxisAlignBoundingBox>* pBoundingBoxOut) {
     ScopedCpuProfileZone();
 
     const uint32_t indexCount = geoData.indexCount;
@@ -127,8 +221,12 @@ namespace dxvk {
     HashQuery vertexRegions[Count];
     memset(&vertexRegions[0], 0, sizeof(vertexRegions));
 
-    if (!getVertexRegion(geoData.positionBuffer, vertexCount, vertexRegions[Position]))
-      return std::shared_future<GeometryHashes>(); //invalid
+    if (!getVertexRegion(geoData.positionBuffer, vertexCount, vertexRegions[Position])) {
+      if (pBoundingBoxOut) {
+        *pBoundingBoxOut = computeAxisAlignedBoundingBox(geoData);
+      }
+      return Future<GeometryHashes>(); //invalid
+    }
 
     // Acquire prevents the staging allocator from re-using this memory
     vertexRegions[Position].ref->acquire(DxvkAccess::Read);
@@ -142,7 +240,6 @@ namespace dxvk {
       indexBufferRef->acquire(DxvkAccess::Read);
     const void* pIndexData = geoData.indexBuffer.defined() ? geoData.indexBuffer.mapPtr(0) : nullptr;
     const size_t indexStride = geoData.indexBuffer.stride();
-    const size_t indexDataSize = indexCount * indexStride;
 
     // Assume the GPU changed the data via shaders, include the constant buffer data in hash
     XXH64_hash_t vertexDataSeed = kEmptyHash;
@@ -168,71 +265,173 @@ namespace dxvk {
       vertexLayoutHash = hashVertexLayout(geoData);
     }
 
-    return m_gpeWorkers.Schedule([vertexRegions, indexBufferRef, pIndexData, indexStride, indexDataSize, indexCount, maxIndexValue, vertexDataSeed, geometryDescriptorHash, vertexLayoutHash]() -> GeometryHashes {
-      ScopedCpuProfileZone();
+    // Static geometry that was seen before can skip the full hash
+    Future<GeometryHashes> result;
+    XXH64_hash_t cacheFingerprint = kEmptyHash;
+    GeometryHashCache::LookupResult cacheResult = GeometryHashCache::LookupResult::Miss;
+    if (m_hashCache.isInitialized()) {
+      cacheFingerprint = GeometryHashCache::computeFingerprint(vertexRegions, Count, pIndexData, indexCount * indexStride, maxIndexValue);
+
+      GeometryHashes cachedHashes;
+      cacheResult = m_hashCache.lookup(cacheFingerprint, cachedHashes);
+
+      if (cacheResult != GeometryHashCache::LookupResult::Miss) {
+        Promise<GeometryHashes> cachedPromise;
+        cachedPromise.set_value(finalizeGeometryHashes(cachedHashes, geometryDescriptorHash, vertexLayoutHash, vertexDataSeed));
+        result = cachedPromise.get_future();
+
+        // Hits due for validation are still hashed in full below, but only to check the cache
+        if (cacheResult == GeometryHashCache::LookupResult::Hit) {
+          if (pBoundingBoxOut) {
+            *pBoundingBoxOut = computeAxisAlignedBoundingBox(geoData);
+          }
+          releaseGeometryData(indexBufferRef, vertexRegions);
+          return result;
+        }
+      }
+    }
 
-      GeometryHashes hashes;
+    GeometryHashJob& job = m_pendingHashJobs.emplace_back();
+    for (uint32_t i = 0; i < Count; i++) {
+      job.vertexRegions[i] = vertexRegions[i];
+    }
+    job.indexBufferRef = indexBufferRef;
+    job.pIndexData = pIndexData;
+    job.indexStride = indexStride;
+    job.indexCount = indexCount;
+    job.maxIndexValue = maxIndexValue;
+    job.vertexDataSeed = vertexDataSeed;
+    job.geometryDescriptorHash = geometryDescriptorHash;
+    job.vertexLayoutHash = vertexLayoutHash;
+    job.cacheFingerprint = cacheFingerprint;
+    job.cacheResult = cacheResult;
+    job.positionFormat = getPositionFormat(geoData.positionBuffer.vertexFormat());
+    // The hash only bounds positions it can decode while streaming them, leave the rest to the full buffer pass
+    job.computeBoundingBox = pBoundingBoxOut != nullptr && job.positionFormat != fast::PositionFormat::Unsupported && vertexRegions[Position].stride > 0;
+
+    if (job.computeBoundingBox) {
+      *pBoundingBoxOut = job.boundingBoxPromise.get_future();
+    } else if (pBoundingBoxOut) {
+      *pBoundingBoxOut = computeAxisAlignedBoundingBox(geoData);
+    }
 
-      // Finalize the descriptor hash
-      hashes[HashComponents::GeometryDescriptor] = geometryDescriptorHash;
-      hashes[HashComponents::VertexLayout] = vertexLayoutHash;
+    if (!result.valid()) {
+      result = job.promise.get_future();
+    }
+
+    // Dispatch once we've gathered a full batch, partial batches are flushed before the next CS chunk is emitted
+    if (m_pendingHashJobs.size() >= std::max(geometryHashBatchSize(), 1u)) {
+      FlushGeometryHashes();
+    }
+
+    return result;
+  }
+
+  void D3D9Rtx::FlushGeometryHashes() {
+    if (m_pendingHashJobs.empty()) {
+      return;
+    }
+
+    ScopedCpuProfileZone();
+
+    // Hand the batch to the task and continue with recycled storage if a worker returned some
+    std::vector<GeometryHashJob> batch = std::move(m_pendingHashJobs);
+    m_pendingHashJobs.clear();
+    if (!m_spareHashBatches.pop(m_pendingHashJobs)) {
+      m_pendingHashJobs.reserve(batch.size());
+    }
+
+    m_gpeWorkers.Schedule([this, batch = std::move(batch)]() mutable {
+      processGeometryHashBatch(batch);
+      batch.clear();
+      m_spareHashBatches.push(std::move(batch));
+    });
+  }
+
+  void D3D9Rtx::processGeometryHashBatch(std::vector<GeometryHashJob>& jobs) {
+    ScopedCpuProfileZone();
+
+    static const MetricId s_hashJobs = Metrics::registerCounter("geometry_hash_jobs");
+    static const MetricId s_hashBatchSize = Metrics::registerHistogram("geometry_hash_batch_size");
+    Metrics::add(s_hashJobs, static_cast<double>(jobs.size()));
+    Metrics::sample(s_hashBatchSize, static_cast<double>(jobs.size()));
+
+    // Staging data for consecutive draws is usually carved out of the same buffers, visiting
+    // the jobs in address order keeps the gathers below walking forwards through memory.
+    std::sort(jobs.begin(), jobs.end(), [](const GeometryHashJob& a, const GeometryHashJob& b) {
+      return a.vertexRegions[Position].pBase < b.vertexRegions[Position].pBase;
+    });
+
+    static thread_local GeometryHashScratch s_scratch;
+
+    for (GeometryHashJob& job : jobs) {
+      GeometryHashes hashes;
+      HashBoundsQuery bounds;
+      bounds.format = job.positionFormat;
+      HashBoundsQuery* pBounds = job.computeBoundingBox ? &bounds : nullptr;
 
       // Index hash
-      switch (indexStride) {
+      switch (job.indexStride) {
       case 2:
-        hashGeometryData<uint16_t>(indexCount, maxIndexValue, pIndexData, indexBufferRef, vertexRegions, hashes);
+        hashGeometryData<uint16_t>(job.indexCount, job.maxIndexValue, job.pIndexData, job.indexBufferRef, job.vertexRegions, s_scratch, pBounds, hashes);
         break;
       case 4:
-        hashGeometryData<uint32_t>(indexCount, maxIndexValue, pIndexData, indexBufferRef, vertexRegions, hashes);
+        hashGeometryData<uint32_t>(job.indexCount, job.maxIndexValue, job.pIndexData, job.indexBufferRef, job.vertexRegions, s_scratch, pBounds, hashes);
         break;
       default:
-        hashGeometryData<NoIndices>(indexCount, maxIndexValue, pIndexData, indexBufferRef, vertexRegions, hashes);
+        hashGeometryData<NoIndices>(job.indexCount, job.maxIndexValue, job.pIndexData, job.indexBufferRef, job.vertexRegions, s_scratch, pBounds, hashes);
         break;
       }
 
-      // Do we need to modify the hash from an external source?
-      if (vertexDataSeed) {
-        hashes[HashComponents::VertexPosition] ^= vertexDataSeed;
+      if (job.computeBoundingBox) {
+        job.boundingBoxPromise.set_value(toBoundingBox(bounds));
       }
 
-      assert(hashes[HashComponents::VertexPosition] != kEmptyHash);
+      switch (job.cacheResult) {
+      case GeometryHashCache::LookupResult::HitValidate:
+        // The draw call was already served from the cache
+        m_hashCache.validate(job.cacheFingerprint, hashes);
+        continue;
+      case GeometryHashCache::LookupResult::Miss:
+        if (job.cacheFingerprint != kEmptyHash) {
+          m_hashCache.insert(job.cacheFingerprint, hashes);
+        }
+        break;
+      default:
+        break;
+      }
 
-      return hashes;
-    });
+      job.promise.set_value(finalizeGeometryHashes(hashes, job.geometryDescriptorHash, job.vertexLayoutHash, job.vertexDataSeed));
+    }
   }
 
-  std::shared_future<AxisAlignBoundingBox> D3D9Rtx::computeAxisAlignedBoundingBox(const RasterGeometry& geoData) {
+  Future<AxisAlignBoundingBox> D3D9Rtx::computeAxisAlignedBoundingBox(const RasterGeometry& geoData) {
     ScopedCpuProfileZone();
 
     const void* pVertexData = geoData.positionBuffer.mapPtr((size_t)geoData.positionBuffer.offsetFromSlice());
     const uint32_t vertexCount = geoData.vertexCount;
     const size_t vertexStride = geoData.positionBuffer.stride();
+    const fast::PositionFormat positionFormat = getPositionFormat(geoData.positionBuffer.vertexFormat());
 
-    if (pVertexData == nullptr) {
-      return std::shared_future<AxisAlignBoundingBox>();
+    // Positions that can't be decoded have no bounds, consumers fall back to the object's origin
+    if (pVertexData == nullptr || positionFormat == fast::PositionFormat::Unsupported) {
+      return Future<AxisAlignBoundingBox>();
     }
 
-    return m_gpeWorkers.Schedule([pVertexData, vertexCount, vertexStride]()->AxisAlignBoundingBox {
-      ScopedCpuProfileZone();
+    // Acquire prevents the staging allocator from re-using this memory
+    Rc<DxvkBuffer> positionBufferRef = geoData.positionBuffer.buffer();
+    positionBufferRef->acquire(DxvkAccess::Read);
 
-      __m128 minPos = _mm_set_ps1(FLT_MAX);
-      __m128 maxPos = _mm_set_ps1(-FLT_MAX);
+    return m_gpeWorkers.Schedule([pVertexData, vertexCount, vertexStride, positionFormat, positionBufferRef]()->AxisAlignBoundingBox {
+      ScopedCpuProfileZone();
 
-      const uint8_t* pVertex = static_cast<const uint8_t*>(pVertexData);
-      for (uint32_t vertexIdx = 0; vertexIdx < vertexCount; ++vertexIdx) {
-        const Vector3* const pVertexPos = reinterpret_cast<const Vector3* const>(pVertex);
-        __m128 vertexPos = _mm_set_ps(0.0f, pVertexPos->z, pVertexPos->y, pVertexPos->x);
-        minPos = _mm_min_ps(minPos, vertexPos);
-        maxPos = _mm_max_ps(maxPos, vertexPos);
+      HashBoundsQuery bounds;
+      fast::accumulatePositionBounds(pVertexData, vertexStride, vertexCount, positionFormat, bounds.minPos, bounds.maxPos);
 
-        pVertex += vertexStride;
-      }
+      // Release this memory back to the staging allocator
+      positionBufferRef->release(DxvkAccess::Read);
 
-      AxisAlignBoundingBox boundingbox = {
-        { minPos.m128_f32[0], minPos.m128_f32[1], minPos.m128_f32[2] },
-        { maxPos.m128_f32[0], maxPos.m128_f32[1], maxPos.m128_f32[2] }
-      };
-      return boundingbox;
+      return toBoundingBox(bounds);
     });
   }
 }
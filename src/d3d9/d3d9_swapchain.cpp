@@ -360,6 +360,10 @@ namespace dxvk {
 
     D3D9DeviceLock lock = m_parent->LockDevice();
 
+    // NV-DXVK start: shader constant upload counters
+    m_parent->ReportConstantUploadStats();
+    // NV-DXVK end
+
     uint32_t presentInterval = m_presentParams.PresentationInterval;
 
     // This is not true directly in d3d9 to to timing differences that don't matter for us.
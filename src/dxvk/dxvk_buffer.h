@@ -313,6 +313,19 @@ namespace dxvk {
 
     VkDeviceAddress getDeviceAddress();
 
+    // NV-DXVK start: chunk defragmentation
+    /**
+     * \brief Memory of the initial backing buffer
+     *
+     * Slices allocated by renaming the
+     * buffer may live in other memory.
+     * \returns Memory slice
+     */
+    const DxvkMemory& getMemory() const {
+      return m_buffer.memory;
+    }
+    // NV-DXVK end
+
   protected:
 
     DxvkDevice*             m_device;
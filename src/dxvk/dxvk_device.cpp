@@ -23,6 +23,7 @@
 #include "dxvk_instance.h"
 #include "rtx_render/rtx_context.h"
 #include "dxvk_scoped_annotation.h"
+#include "../util/log/metrics.h"
 
 
 namespace dxvk {
@@ -94,6 +95,10 @@ namespace dxvk {
     m_objects.getRtxInitializer().release();
     // NV-DXVK end
 
+    // NV-DXVK start: stop the metrics flusher while it can still be joined
+    Metrics::shutdown();
+    // NV-DXVK end
+
 #ifdef TRACY_ENABLE
     TracyVkDestroy(m_queues.graphics.tracyCtx);
     m_vkd->vkDestroyCommandPool(m_vkd->device(), m_queues.graphics.tracyPool, nullptr);
@@ -279,6 +284,13 @@ namespace dxvk {
   }
 
 
+  // NV-DXVK start: chunk fragmentation stats
+  DxvkMemoryFragmentation DxvkDevice::getMemoryFragmentation(uint32_t heap) {
+    return m_objects.memoryManager().getMemoryFragmentation(heap);
+  }
+  // NV-DXVK end
+
+
   uint32_t DxvkDevice::getCurrentFrameId() const {
     return m_statCounters.getCtr(DxvkStatCounter::QueuePresentCount);
   }
@@ -446,6 +446,18 @@ namespace dxvk {
      */
     DxvkMemoryStats getMemoryStats(uint32_t heap);
 
+    // NV-DXVK start: chunk fragmentation stats
+    /**
+     * \brief Retrieves chunk fragmentation
+     *
+     * Walks the chunks of the heap, meant for
+     * the HUD rather than per-frame queries.
+     * \param [in] heap Memory heap index
+     * \returns Free space within the heap's chunks
+     */
+    DxvkMemoryFragmentation getMemoryFragmentation(uint32_t heap);
+    // NV-DXVK end
+
     /**
      * \brief Retreves current frame ID
      * \returns Current frame ID
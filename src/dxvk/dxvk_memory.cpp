@@ -216,21 +216,28 @@ DxvkMemory::DxvkMemory() { }
     if (m_alloc != nullptr)
       m_alloc->free(*this);
   }
+
+
+  // NV-DXVK start: chunk defragmentation
+  uint64_t DxvkMemory::chunkId() const {
+    return m_chunk != nullptr ? m_chunk->id() : 0;
+  }
+  // NV-DXVK end
   
 
   DxvkMemoryChunk::DxvkMemoryChunk(
           DxvkMemoryAllocator*  alloc,
           DxvkMemoryType*       type,
-          DxvkDeviceMemory      memory)
-  : m_alloc(alloc), m_type(type), m_memory(memory) {
-    // Mark the entire chunk as free
-    m_freeList.push_back(FreeSlice { 0, memory.memSize });
+          DxvkDeviceMemory      memory,
+          uint64_t              id)
+  : m_alloc(alloc), m_type(type), m_memory(memory), m_allocator(memory.memSize), m_id(id) {
   }
   
   
   DxvkMemoryChunk::~DxvkMemoryChunk() {
     // This call is technically not thread-safe, but it
     // doesn't need to be since we don't free chunks
+    // NV-DXVK: evacuated chunks are freed, with the memory type mutex held
     m_alloc->freeDeviceMemory(m_type, m_memory);
   }
   
@@ -248,43 +255,23 @@ DxvkMemory::DxvkMemory() { }
      || m_memory.memAllocateFlags != allocateFlags
      || m_memory.priority != priority)
       return DxvkMemory();
-    
-    // If the chunk is full, return
-    if (m_freeList.size() == 0)
+
+    // NV-DXVK start: chunk defragmentation
+    if (m_evacuating)
       return DxvkMemory();
+    // NV-DXVK end
     
-    // Select the slice to allocate from in a worst-fit
-    // manner. This may help keep fragmentation low.
-    auto bestSlice = m_freeList.begin();
-    
-    for (auto slice = m_freeList.begin(); slice != m_freeList.end(); slice++) {
-      if (slice->length == size) {
-        bestSlice = slice;
-        break;
-      } else if (slice->length > bestSlice->length) {
-        bestSlice = slice;
-      }
-    }
-    
-    // We need to align the allocation to the requested alignment
-    const VkDeviceSize sliceStart = bestSlice->offset;
-    const VkDeviceSize sliceEnd   = bestSlice->offset + bestSlice->length;
-    
-    const VkDeviceSize allocStart = dxvk::align(sliceStart,        align);
-    const VkDeviceSize allocEnd   = dxvk::align(allocStart + size, align);
-    
-    if (allocEnd > sliceEnd)
+    // NV-DXVK start: TLSF chunk sub-allocator
+    // Good fit from the segregated free lists, the unused
+    // alignment padding and tail stay free in the chunk.
+    const VkDeviceSize allocSize  = dxvk::align(size, align);
+    const VkDeviceSize allocStart = m_allocator.alloc(allocSize, align);
+
+    if (allocStart == TlsfAllocator::kInvalidOffset)
       return DxvkMemory();
-    
-    // We can use this slice, but we'll have to add
-    // the unused parts of it back to the free list.
-    m_freeList.erase(bestSlice);
-    
-    if (allocStart != sliceStart)
-      m_freeList.push_back({ sliceStart, allocStart - sliceStart });
-    
-    if (allocEnd != sliceEnd)
-      m_freeList.push_back({ allocEnd, sliceEnd - allocEnd });
+
+    const VkDeviceSize allocEnd   = allocStart + allocSize;
+    // NV-DXVK end
 
     // NV-DXVK start:
     // Calculate the pointer to the mapped data, if any
@@ -301,25 +288,11 @@ DxvkMemory::DxvkMemory() { }
   void DxvkMemoryChunk::free(
           VkDeviceSize  offset,
           VkDeviceSize  length) {
-    // Remove adjacent entries from the free list and then add
-    // a new slice that covers all those entries. Without doing
-    // so, the slice could not be reused for larger allocations.
-    auto curr = m_freeList.begin();
-    
-    while (curr != m_freeList.end()) {
-      if (curr->offset == offset + length) {
-        length += curr->length;
-        curr = m_freeList.erase(curr);
-      } else if (curr->offset + curr->length == offset) {
-        offset -= curr->length;
-        length += curr->length;
-        curr = m_freeList.erase(curr);
-      } else {
-        curr++;
-      }
-    }
-    
-    m_freeList.push_back({ offset, length });
+    // NV-DXVK start: TLSF chunk sub-allocator
+    // Merges with adjacent free blocks, so the space
+    // can be reused for larger allocations.
+    m_allocator.free(offset);
+    // NV-DXVK end
   }
   
   
@@ -374,6 +347,30 @@ DxvkMemory::DxvkMemory() { }
   }
   
   
+  // NV-DXVK start: chunk fragmentation stats
+  DxvkMemoryFragmentation DxvkMemoryAllocator::getMemoryFragmentation(uint32_t heap) {
+    DxvkMemoryFragmentation fragmentation;
+
+    for (uint32_t i = 0; i < m_memProps.memoryTypeCount; i++) {
+      if (m_memTypes[i].heapId != heap)
+        continue;
+
+      std::lock_guard<dxvk::mutex> lock(m_memTypes[i].mutex);
+
+      for (const auto& chunk : m_memTypes[i].chunks) {
+        const TlsfAllocator::Stats chunkStats = chunk->getStats();
+        fragmentation.freeBytes += chunkStats.freeBytes;
+        fragmentation.freeBlocks += chunkStats.numFreeBlocks;
+        fragmentation.largestFreeBlock = std::max(fragmentation.largestFreeBlock, chunkStats.largestFreeBlock);
+        fragmentation.chunks++;
+      }
+    }
+
+    return fragmentation;
+  }
+  // NV-DXVK end
+
+
   DxvkMemory DxvkMemoryAllocator::alloc(
     const VkMemoryRequirements*             req,
     const VkMemoryDedicatedRequirements&    dedAllocReq,
@@ -514,7 +511,7 @@ DxvkMemory::DxvkMemory() { }
           devMem = tryAllocDeviceMemory(type, propertyFlags, allocateFlags, type->chunkSize >> i, priority, nullptr, category);
 
         if (devMem.memHandle) {
-          Rc<DxvkMemoryChunk> chunk = new DxvkMemoryChunk(this, type, devMem);
+          Rc<DxvkMemoryChunk> chunk = new DxvkMemoryChunk(this, type, devMem, m_nextChunkId++);
           memory = chunk->alloc(propertyFlags, allocateFlags, size, align, priority, category);
 
           type->chunks.push_back(std::move(chunk));
@@ -615,6 +612,11 @@ DxvkMemory::DxvkMemory() { }
           VkDeviceSize          offset,
           VkDeviceSize          length) {
     chunk->free(offset, length);
+
+    // NV-DXVK start: chunk defragmentation
+    if (chunk->isEvacuating() && chunk->isEmpty())
+      this->releaseEvacuatedChunk(type, chunk);
+    // NV-DXVK end
   }
   
 
@@ -627,6 +629,53 @@ DxvkMemory::DxvkMemory() { }
   }
 
 
+  // NV-DXVK start: chunk defragmentation
+  void DxvkMemoryAllocator::getChunkInfos(std::vector<DxvkMemoryChunkInfo>& infos) {
+    infos.clear();
+
+    for (uint32_t i = 0; i < m_memProps.memoryTypeCount; i++) {
+      if (!(m_memTypes[i].memType.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        continue;
+
+      std::lock_guard<dxvk::mutex> lock(m_memTypes[i].mutex);
+
+      for (const auto& chunk : m_memTypes[i].chunks)
+        infos.push_back({ chunk->id(), i, chunk->size(), chunk->size() - chunk->getStats().freeBytes });
+    }
+  }
+
+
+  void DxvkMemoryAllocator::setChunkEvacuating(uint64_t chunkId, bool evacuating) {
+    for (uint32_t i = 0; i < m_memProps.memoryTypeCount; i++) {
+      std::lock_guard<dxvk::mutex> lock(m_memTypes[i].mutex);
+
+      for (const auto& chunk : m_memTypes[i].chunks) {
+        if (chunk->id() != chunkId)
+          continue;
+
+        chunk->setEvacuating(evacuating);
+
+        if (evacuating && chunk->isEmpty())
+          this->releaseEvacuatedChunk(&m_memTypes[i], chunk.ptr());
+        return;
+      }
+    }
+  }
+
+
+  void DxvkMemoryAllocator::releaseEvacuatedChunk(
+          DxvkMemoryType*       type,
+          DxvkMemoryChunk*      chunk) {
+    // The type mutex is held, and no slices of the chunk remain
+    auto it = std::find_if(type->chunks.begin(), type->chunks.end(),
+      [chunk] (const Rc<DxvkMemoryChunk>& c) { return c.ptr() == chunk; });
+
+    if (it != type->chunks.end())
+      type->chunks.erase(it);
+  }
+  // NV-DXVK end
+
+
   VkDeviceSize DxvkMemoryAllocator::pickChunkSize(uint32_t memTypeId) const {
     VkMemoryType type = m_memProps.memoryTypes[memTypeId];
     VkMemoryHeap heap = m_memProps.memoryHeaps[type.heapIndex];
@@ -23,11 +23,38 @@
 
 #include "dxvk_adapter.h"
 
+// NV-DXVK start: TLSF chunk sub-allocator
+#include "../util/util_tlsf.h"
+// NV-DXVK end
+
 namespace dxvk {
   
   class DxvkMemoryAllocator;
   class DxvkMemoryChunk;
   
+  // NV-DXVK start: chunk fragmentation stats
+  /**
+   * \brief Free space within sub-allocated chunks
+   *
+   * Gathered by walking the chunks of a heap, so unlike
+   * the memory stats this is not free to query. Fragmentation
+   * is the share of free chunk memory outside the largest
+   * free block, i.e. unusable by the largest request that
+   * would still fit if the space were contiguous.
+   */
+  struct DxvkMemoryFragmentation {
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFreeBlock = 0;
+    uint32_t freeBlocks = 0;
+    uint32_t chunks = 0;
+
+    float ratio() const {
+      return freeBytes != 0 ? 1.0f - float(largestFreeBlock) / float(freeBytes) : 0.0f;
+    }
+  };
+  // NV-DXVK end
+
+
   /**
    * \brief Memory stats
    * 
@@ -219,6 +246,15 @@ namespace dxvk {
     operator bool () const {
       return m_memory != VK_NULL_HANDLE;
     }
+
+    // NV-DXVK start: chunk defragmentation
+    /**
+     * \brief Chunk the slice was sub-allocated from
+     *
+     * \returns Chunk ID, or 0 for dedicated allocations
+     */
+    uint64_t chunkId() const;
+    // NV-DXVK end
     
   private:
     
@@ -249,7 +285,8 @@ namespace dxvk {
     DxvkMemoryChunk(
             DxvkMemoryAllocator*  alloc,
             DxvkMemoryType*       type,
-            DxvkDeviceMemory      memory);
+            DxvkDeviceMemory      memory,
+            uint64_t              id);
     
     ~DxvkMemoryChunk();
 
@@ -284,23 +321,80 @@ namespace dxvk {
     void free(
             VkDeviceSize  offset,
             VkDeviceSize  length);
+
+    // NV-DXVK start: TLSF chunk sub-allocator
+    /**
+     * \brief Free space and fragmentation of the chunk
+     * \returns Sub-allocator stats
+     */
+    TlsfAllocator::Stats getStats() const {
+      return m_allocator.getStats();
+    }
+    // NV-DXVK end
+
+    // NV-DXVK start: chunk defragmentation
+    uint64_t id() const {
+      return m_id;
+    }
+
+    VkDeviceSize size() const {
+      return m_memory.memSize;
+    }
+
+    bool isEmpty() const {
+      return m_allocator.getStats().numAllocations == 0;
+    }
+
+    /**
+     * \brief Marks the chunk for evacuation
+     *
+     * An evacuating chunk refuses new allocations
+     * and is released once its last slice is freed.
+     * \param [in] evacuating Whether to evacuate
+     */
+    void setEvacuating(bool evacuating) {
+      m_evacuating = evacuating;
+    }
+
+    bool isEvacuating() const {
+      return m_evacuating;
+    }
+    // NV-DXVK end
     
   private:
     
-    struct FreeSlice {
-      VkDeviceSize offset;
-      VkDeviceSize length;
-    };
-    
     DxvkMemoryAllocator*  m_alloc;
     DxvkMemoryType*       m_type;
     DxvkDeviceMemory      m_memory;
     
-    std::vector<FreeSlice> m_freeList;
+    // NV-DXVK start: TLSF chunk sub-allocator
+    TlsfAllocator         m_allocator;
+    // NV-DXVK end
+
+    // NV-DXVK start: chunk defragmentation
+    uint64_t              m_id;
+    bool                  m_evacuating = false;
+    // NV-DXVK end
     
   };
   
   
+  // NV-DXVK start: chunk defragmentation
+  /**
+   * \brief Chunk usage
+   *
+   * Describes a sub-allocated chunk
+   * for defragmentation planning.
+   */
+  struct DxvkMemoryChunkInfo {
+    uint64_t          id;
+    uint32_t          memoryType;
+    VkDeviceSize      size;
+    VkDeviceSize      usedBytes;
+  };
+  // NV-DXVK end
+
+
   /**
    * \brief Memory allocator
    * 
@@ -358,6 +452,37 @@ namespace dxvk {
       return m_memHeaps[heap].stats;
     }
 
+    // NV-DXVK start: chunk fragmentation stats
+    /**
+     * \brief Gathers chunk fragmentation of a heap
+     *
+     * Walks every chunk of the heap under the memory
+     * type locks, so it contends with allocations.
+     * \param [in] heap Heap index
+     * \returns Free space within the heap's chunks
+     */
+    DxvkMemoryFragmentation getMemoryFragmentation(uint32_t heap);
+    // NV-DXVK end
+
+    // NV-DXVK start: chunk defragmentation
+    /**
+     * \brief Queries the usage of all chunks
+     *
+     * \param [out] infos Chunks of device local memory types
+     */
+    void getChunkInfos(std::vector<DxvkMemoryChunkInfo>& infos);
+
+    /**
+     * \brief Starts or stops evacuating a chunk
+     *
+     * New allocations avoid evacuating chunks,
+     * which are released once they are empty.
+     * \param [in] chunkId Chunk ID
+     * \param [in] evacuating Whether to evacuate
+     */
+    void setChunkEvacuating(uint64_t chunkId, bool evacuating);
+    // NV-DXVK end
+
     // NV-DXVK start
     /**
      * \brief Queries memory properties
@@ -388,6 +513,10 @@ namespace dxvk {
     std::array<DxvkMemoryHeap, VK_MAX_MEMORY_HEAPS> m_memHeaps;
     std::array<DxvkMemoryType, VK_MAX_MEMORY_TYPES> m_memTypes;
 
+    // NV-DXVK start: chunk defragmentation
+    std::atomic<uint64_t>                  m_nextChunkId = { 1 };
+    // NV-DXVK end
+
     DxvkMemory tryAlloc(
       const VkMemoryRequirements* req,
       const VkMemoryDedicatedAllocateInfo* dedAllocInfo,
@@ -427,6 +556,12 @@ namespace dxvk {
     void freeDeviceMemory(
             DxvkMemoryType*       type,
             DxvkDeviceMemory      memory);
+
+    // NV-DXVK start: chunk defragmentation
+    void releaseEvacuatedChunk(
+            DxvkMemoryType*       type,
+            DxvkMemoryChunk*      chunk);
+    // NV-DXVK end
     
     VkDeviceSize pickChunkSize(
             uint32_t              memTypeId) const;
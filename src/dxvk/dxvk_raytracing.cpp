@@ -102,7 +102,7 @@ namespace dxvk {
   class DxvkDeferredOpFinalizer : public Singleton<DxvkDeferredOpFinalizer> {
     typedef WorkerThreadPool<1024, true, false> ThreadPoolType;
 
-    // Note: WorkerThreadPool is not thread-safe
+    // Guards the lazy creation and release of the thread pool
     sync::Spinlock m_mutex;
     ThreadPoolType* m_threadPool = nullptr;
   public:
@@ -118,7 +118,7 @@ namespace dxvk {
       }
     }
 
-    std::shared_future<VkResult> finalize(const Rc<vk::DeviceFn>& vkd,
+    Future<VkResult> finalize(const Rc<vk::DeviceFn>& vkd,
                                           VkDeferredOperationKHR deferredOp) {
       std::lock_guard<sync::Spinlock> lock(m_mutex);
 
@@ -127,21 +127,9 @@ namespace dxvk {
         m_threadPool = new ThreadPoolType(numCpuCores / 4, "dxvk-deferredop-finalizer");
       }
 
-      std::shared_future<VkResult> future;
-      do {
-        future = m_threadPool->Schedule([vkd, deferredOp]() -> VkResult {
-          return vkd->vkDeferredOperationJoinKHR(vkd->device(), deferredOp);
-        });
-
-        if (future.valid()) {
-          break;
-        }
-
-        ONCE(Logger::warn("Unable to schedule a deferred op finalizer. Retrying..."));
-        std::this_thread::yield();
-      } while (true);
-
-      return future;
+      return m_threadPool->Schedule([vkd, deferredOp]() -> VkResult {
+        return vkd->vkDeferredOperationJoinKHR(vkd->device(), deferredOp);
+      });
     }
   };
 
@@ -332,7 +320,7 @@ namespace dxvk {
     if (result != VK_OPERATION_NOT_DEFERRED_KHR) {
       uint32_t numLaunches = m_vkd->vkGetDeferredOperationMaxConcurrencyKHR(m_vkd->device(), deferredOp);
 
-      std::vector<std::shared_future<VkResult>> joins;
+      std::vector<Future<VkResult>> joins;
       while (numLaunches > 1) {
         joins.emplace_back(DxvkDeferredOpFinalizer::get().finalize(m_vkd, deferredOp));
         --numLaunches;
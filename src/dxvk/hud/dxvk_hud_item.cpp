@@ -547,8 +547,15 @@ namespace dxvk::hud {
 
 
   void HudMemoryStatsItem::update(dxvk::high_resolution_clock::time_point time) {
-    for (uint32_t i = 0; i < m_memory.memoryHeapCount; i++)
+    for (uint32_t i = 0; i < m_memory.memoryHeapCount; i++) {
       m_heaps[i] = m_device->getMemoryStats(i);
+
+      // NV-DXVK start: chunk fragmentation stats
+      // Only shown for device local heaps, and gathering it walks every chunk
+      if (m_memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        m_fragmentation[i] = m_device->getMemoryFragmentation(i);
+      // NV-DXVK end
+    }
   }
 
 
@@ -594,6 +601,21 @@ namespace dxvk::hud {
           position.y += 4.0f;
         }
 
+        // NV-DXVK start: chunk fragmentation stats
+        const DxvkMemoryFragmentation& fragmentation = m_fragmentation[i];
+        if (fragmentation.freeBytes != 0) {
+          std::string text = str::format("Chunk free: ", fragmentation.freeBytes >> 20, " MB in ", fragmentation.freeBlocks,
+                                         " blocks, largest ", fragmentation.largestFreeBlock >> 20, " MB (",
+                                         uint32_t(fragmentation.ratio() * 100.0f), "% fragmented)");
+          position.y += 16.0f;
+          renderer.drawText(16.0f,
+                            { position.x + 16.0f, position.y },
+                            { 1.0f, 1.0f, 1.0f, 1.0f },
+                            text);
+          position.y += 4.0f;
+        }
+        // NV-DXVK end
+
         position.y += 16.0f;
       }
     }
@@ -367,6 +367,9 @@ namespace dxvk::hud {
     Rc<DxvkDevice>                    m_device;
     VkPhysicalDeviceMemoryProperties  m_memory;
     DxvkMemoryStats                   m_heaps[VK_MAX_MEMORY_HEAPS];
+    // NV-DXVK start: chunk fragmentation stats
+    DxvkMemoryFragmentation           m_fragmentation[VK_MAX_MEMORY_HEAPS];
+    // NV-DXVK end
 
   };
 
@@ -426,6 +426,12 @@ namespace dxvk {
       ImGui::Text("");
     }
 
+#ifdef REMIX_DEVELOPMENT
+    const RtxTextureManager& textureManager = m_device->getCommon()->getTextureManager();
+    ImGui::Text("Deduplicated Textures: %u (%.f MiB saved)", textureManager.getDedupedTextureCount(),
+                (float) ((double) textureManager.getDedupedTextureBytes() / bytesPerMebibyte));
+#endif
+
     ImGui::Dummy(ImVec2 { 4, 0 });
   }
 
@@ -1247,6 +1253,7 @@ namespace dxvk {
           data.insert(pair.first);
           action = "added";
         }
+        RtxOptionImpl::markHashSetsChanged();
 
         char buffer[256];
         sprintf_s(buffer, "%s - %s %016llX\n", uniqueId, action, pair.first);
@@ -34,6 +34,7 @@
 
 #include "dxvk_scoped_annotation.h"
 #include "rtx_options.h"
+#include "../../util/log/metrics.h"
 
 #include "rtx/pass/instance_definitions.h"
 #include "rtx/concept/billboard.h"
@@ -62,18 +63,17 @@ namespace dxvk {
     // Remove instances past their lifetime or marked for GC explicitly
     const uint32_t currentFrame = m_device->getCurrentFrameId();
 
-    // Remove all pooled BLAS that haven't been used for a few frames
-    for (uint32_t i = 0; i < m_blasPool.size();) {
-      Rc<PooledBlas>& blas = m_blasPool[i];
+    // Remove all pooled BLAS that haven't been used for a few frames, then the least recently used ones over budget
+    const size_t budgetBytes = size_t(RtxOptions::Get()->getBlasPoolBudgetMB()) << 20;
+    m_blasPool.garbageCollect(currentFrame, numFramesToKeepBLAS, budgetBytes);
 
-      if (blas->frameLastTouched + numFramesToKeepBLAS < currentFrame) {
-        // Put this BLAS to the end of the vector
-        std::swap(blas, m_blasPool.back());
-        // Remove the last element
-        m_blasPool.pop_back();
-        continue;
-      }
-      ++i;
+    static const MetricId s_poolBytes = Metrics::registerGauge("blas_pool_mb");
+    static const MetricId s_poolWaste = Metrics::registerGauge("blas_pool_in_flight_waste_mb");
+
+    if (Metrics::enabled()) {
+      const SizeClassPool<Rc<PooledBlas>>::Stats stats = m_blasPool.getStats();
+      Metrics::set(s_poolBytes, stats.totalBytes / (1024.0 * 1024.0));
+      Metrics::set(s_poolWaste, (stats.inFlightBytes - stats.requestedBytes) / (1024.0 * 1024.0));
     }
   }
   
@@ -478,7 +478,8 @@ namespace dxvk {
         // Previously static BLAS is no longer considered static (i.e. because it started getting animated)
         if (blasEntry->staticBlas.ptr()) {
           // Move the BLAS used by this geometry to the common pool
-          m_blasPool.push_back(blasEntry->staticBlas);
+          const Rc<PooledBlas>& blas = blasEntry->staticBlas;
+          m_blasPool.release(blas, blas->accelStructure->info().size, blas->frameLastTouched, currentFrame);
           blasEntry->staticBlas = nullptr;
         }
       }
@@ -600,27 +601,16 @@ namespace dxvk {
       m_device->vkd()->vkGetAccelerationStructureBuildSizesKHR(m_device->handle(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
                                                                &buildInfo, bucket->primitiveCounts.data(), &sizeInfo);
 
-      // Try to find an existing BLAS that is minimally sufficient to fit this bucket of geometries
-      PooledBlas* selectedBlas = nullptr;
-      for (const auto& blas : m_blasPool) {
-        size_t bufferSize = blas->accelStructure->info().size;
-        if (bufferSize >= sizeInfo.accelerationStructureSize &&
-            (!selectedBlas || bufferSize < selectedBlas->accelStructure->info().size) &&
-            blas->frameLastTouched + 2 <= currentFrame) /* note: +2 because frameLastTouched is unsigned and init'd with UINT32_MAX, and keep the BLAS'es for one extra frame for previous TLAS access */
-        {
-          selectedBlas = blas.ptr();
-        }
-      }
+      // Try to find an existing BLAS that is minimally sufficient to fit this bucket of geometries.
+      // Note: the pool keeps the BLAS'es for one extra frame for previous TLAS access
+      Rc<PooledBlas> selectedBlas;
+      if (!m_blasPool.acquire(sizeInfo.accelerationStructureSize, currentFrame, selectedBlas)) {
+        // There is no such BLAS - create one and put it into the pool
+        selectedBlas = createPooledBlas(sizeInfo.accelerationStructureSize);
 
-      // There is no such BLAS - create one and put it into the pool
-      if (!selectedBlas) {
-        auto newBlas = createPooledBlas(sizeInfo.accelerationStructureSize);
-
-        selectedBlas = newBlas.ptr();
-
-        m_blasPool.push_back(std::move(newBlas));
+        m_blasPool.insert(selectedBlas, selectedBlas->accelStructure->info().size, sizeInfo.accelerationStructureSize, currentFrame);
       }
-      assert(selectedBlas);
+      assert(selectedBlas.ptr());
       selectedBlas->frameLastTouched = currentFrame;
 
       // Use the selected BLAS for the build
@@ -784,28 +774,73 @@ namespace dxvk {
     }
   }
 
+  // Uploads the elements of data that differ from the copy last uploaded to the buffer, and updates that copy.
+  // Changed elements less than kMaxUploadGap bytes apart are merged into one update to bound the number of copies.
+  static size_t uploadChangedRanges(Rc<DxvkContext>& ctx, const Rc<DxvkBuffer>& buffer, const unsigned char* data, size_t size,
+                                    size_t elementSize, std::vector<unsigned char>& uploaded) {
+    constexpr size_t kMaxUploadGap = 4096;
+    constexpr size_t kMaxUploadRanges = 64;
+
+    // Elements beyond the previous upload have never been written
+    const size_t comparedSize = std::min(size, uploaded.size());
+    uploaded.resize(size);
+
+    std::pair<size_t, size_t> ranges[kMaxUploadRanges];
+    size_t numRanges = 0;
+
+    for (size_t offset = 0; offset < size; offset += elementSize) {
+      if (offset + elementSize <= comparedSize && memcmp(data + offset, uploaded.data() + offset, elementSize) == 0) {
+        continue;
+      }
+
+      if (numRanges > 0 && offset - ranges[numRanges - 1].second < kMaxUploadGap) {
+        ranges[numRanges - 1].second = offset + elementSize;
+      } else if (numRanges < kMaxUploadRanges) {
+        ranges[numRanges++] = { offset, offset + elementSize };
+      } else {
+        // Too many scattered changes, extend the last range up to this element instead
+        ranges[numRanges - 1].second = offset + elementSize;
+      }
+    }
+
+    size_t uploadedBytes = 0;
+    for (size_t i = 0; i < numRanges; i++) {
+      const size_t rangeSize = ranges[i].second - ranges[i].first;
+      ctx->updateBuffer(buffer, ranges[i].first, rangeSize, data + ranges[i].first);
+      memcpy(uploaded.data() + ranges[i].first, data + ranges[i].first, rangeSize);
+      uploadedBytes += rangeSize;
+    }
+
+    return uploadedBytes;
+  }
+
   void AccelManager::uploadSurfaceData(Rc<DxvkContext> ctx) {
     ScopedCpuProfileZone();
     if (m_reorderedSurfaces.empty())
       return;
 
+    static const MetricId s_surfaceUploadBytes = Metrics::registerCounter("surface_upload_bytes");
+
     // Surface buffer
     const auto surfacesGPUSize = m_reorderedSurfaces.size() * kSurfaceGPUSize;
 
     // Allocate the instance buffer and copy its contents from host to device memory
     DxvkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-    info.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    // Transfer source so the buffers can be relocated by memory defragmentation
+    info.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+      VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
     info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
     info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
     info.size = align(surfacesGPUSize, kBufferAlignment);
     if (m_surfaceBuffer == nullptr || info.size > m_surfaceBuffer->info().size) {
       m_surfaceBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXAccelerationStructure);
+      m_uploadedSurfacesGPUData.clear();
     }
 
     // Write surface data
     std::size_t dataOffset = 0;
-    std::vector<unsigned char> surfacesGPUData(surfacesGPUSize);
+    std::vector<unsigned char>& surfacesGPUData = m_surfacesGPUData;
+    surfacesGPUData.resize(surfacesGPUSize);
 
     for (uint32_t i = 0; i < m_reorderedSurfaces.size(); ++i) {
       const auto& currentInstance = *m_reorderedSurfaces[i];
@@ -819,7 +854,8 @@ namespace dxvk {
     assert(dataOffset == surfacesGPUSize);
     assert(surfacesGPUData.size() == surfacesGPUSize);
 
-    ctx->updateBuffer(m_surfaceBuffer, 0, surfacesGPUData.size(), surfacesGPUData.data());
+    // Most surfaces are unchanged from the previous frame, only upload the ones that differ
+    size_t uploadedBytes = uploadChangedRanges(ctx, m_surfaceBuffer, surfacesGPUData.data(), surfacesGPUData.size(), kSurfaceGPUSize, m_uploadedSurfacesGPUData);
 
     // Find the size of the surface mapping buffer
     uint32_t maxPreviousSurfaceIndex = 0;
@@ -827,7 +863,7 @@ namespace dxvk {
       maxPreviousSurfaceIndex = std::max(maxPreviousSurfaceIndex, instance->getPreviousSurfaceIndex());
 
     // Allocate and initialize the surface mapping buffer
-    std::vector<uint32_t> surfaceIndexMapping;
+    std::vector<uint32_t>& surfaceIndexMapping = m_surfaceIndexMapping;
     surfaceIndexMapping.resize(maxPreviousSurfaceIndex + 1);
     std::fill(surfaceIndexMapping.begin(), surfaceIndexMapping.end(), BINDING_INDEX_INVALID);
     
@@ -855,9 +891,27 @@ namespace dxvk {
       info.size = align(surfaceIndexMapping.size() * sizeof(int), kBufferAlignment);
       if (m_surfaceMappingBuffer == nullptr || info.size > m_surfaceMappingBuffer->info().size) {
         m_surfaceMappingBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXAccelerationStructure);
+        m_uploadedSurfaceIndexMapping.clear();
       }
 
-      ctx->updateBuffer(m_surfaceMappingBuffer, 0, surfaceIndexMapping.size() * sizeof(surfaceIndexMapping[0]), surfaceIndexMapping.data());
+      uploadedBytes += uploadChangedRanges(ctx, m_surfaceMappingBuffer, reinterpret_cast<const unsigned char*>(surfaceIndexMapping.data()),
+                                           surfaceIndexMapping.size() * sizeof(surfaceIndexMapping[0]), sizeof(surfaceIndexMapping[0]), m_uploadedSurfaceIndexMapping);
+    }
+
+    Metrics::add(s_surfaceUploadBytes, static_cast<double>(uploadedBytes));
+  }
+
+  void AccelManager::relocateSurfaceBuffers(Rc<DxvkContext> ctx, uint64_t chunkId) {
+    // Treat a relocated buffer like a reallocated one and upload it in full next frame, rather than
+    // relying on the copy for the contents the host copies of the last upload describe
+    if (m_surfaceBuffer != nullptr && m_surfaceBuffer->getMemory().chunkId() == chunkId) {
+      m_surfaceBuffer = RtxGeometryUtils::relocateBuffer(ctx, m_surfaceBuffer, DxvkMemoryStats::Category::RTXAccelerationStructure);
+      m_uploadedSurfacesGPUData.clear();
+    }
+
+    if (m_surfaceMappingBuffer != nullptr && m_surfaceMappingBuffer->getMemory().chunkId() == chunkId) {
+      m_surfaceMappingBuffer = RtxGeometryUtils::relocateBuffer(ctx, m_surfaceMappingBuffer, DxvkMemoryStats::Category::RTXAccelerationStructure);
+      m_uploadedSurfaceIndexMapping.clear();
     }
   }
 
@@ -905,6 +959,21 @@ namespace dxvk {
       assert(blasToBuild.size() == blasRangesToBuild.size());
       ctx->vkCmdBuildAccelerationStructuresKHR(blasToBuild.size(), blasToBuild.data(), blasRangesToBuild.data());
     }
+
+    static const MetricId s_blasBuilds = Metrics::registerCounter("blas_builds");
+    static const MetricId s_blasBuildPrimitives = Metrics::registerHistogram("blas_build_primitives");
+
+    Metrics::add(s_blasBuilds, static_cast<double>(blasToBuild.size()));
+
+    if (Metrics::enabled()) {
+      for (size_t i = 0; i < blasToBuild.size(); i++) {
+        uint32_t primitiveCount = 0;
+        for (uint32_t g = 0; g < blasToBuild[i].geometryCount; g++) {
+          primitiveCount += blasRangesToBuild[i][g].primitiveCount;
+        }
+        Metrics::sample(s_blasBuildPrimitives, primitiveCount);
+      }
+    }
   }
 
   void AccelManager::buildTlas(Rc<DxvkContext> ctx, Rc<DxvkCommandList> cmdList) {
@@ -922,9 +991,9 @@ namespace dxvk {
       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
       VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
 
-    for (auto&& blas : m_blasPool) {
+    m_blasPool.forEach([&cmdList](const Rc<PooledBlas>& blas) {
       cmdList->trackResource<DxvkAccess::Read>(blas->accelStructure);
-    }
+    });
 
     internalBuildTlas<Tlas::Opaque>(ctx, cmdList);
     internalBuildTlas<Tlas::Unordered>(ctx, cmdList);
@@ -29,6 +29,7 @@
 #include "rtx_types.h"
 #include "../util/util_vector.h"
 #include "../util/util_matrix.h"
+#include "../util/util_size_class_pool.h"
 
 namespace dxvk 
 {
@@ -87,6 +88,9 @@ public:
   // Uploads instances' surface data to the GPU
   void uploadSurfaceData(Rc<DxvkContext> ctx);
 
+  // Copies the surface buffers living in the given memory chunk into new memory, for defragmentation
+  void relocateSurfaceBuffers(Rc<DxvkContext> ctx, uint64_t chunkId);
+
   // Merges the RtInstance's into a set of BLAS. Some of the BLAS will contain multiple geometries/instances,
   // and some other BLAS will be dedicated to instances with static geometries.
   void mergeInstancesIntoBlas(Rc<DxvkContext> ctx, Rc<DxvkCommandList> cmdList, class DxvkBarrierSet& execBarriers,
@@ -115,11 +119,16 @@ private:
   std::vector<RtInstance*> m_reorderedSurfaces;
   std::vector<uint32_t> m_reorderedSurfacesFirstIndexOffset; 
   std::vector<VkAccelerationStructureInstanceKHR> m_mergedInstances[Tlas::Count];
-  std::vector<Rc<PooledBlas>> m_blasPool;
+  SizeClassPool<Rc<PooledBlas>> m_blasPool;
 
   Rc<DxvkBuffer> m_vkInstanceBuffer; // Note: Holds Vulkan AS Instances, not RtInstances
   Rc<DxvkBuffer> m_surfaceBuffer;
   Rc<DxvkBuffer> m_surfaceMappingBuffer;
+  // Surface data of the current frame, and the copies last uploaded to the surface buffers
+  std::vector<unsigned char> m_surfacesGPUData;
+  std::vector<unsigned char> m_uploadedSurfacesGPUData;
+  std::vector<uint32_t> m_surfaceIndexMapping;
+  std::vector<unsigned char> m_uploadedSurfaceIndexMapping;
   Rc<DxvkDevice> m_device;
   Rc<DxvkBuffer> m_transformBuffer;
 
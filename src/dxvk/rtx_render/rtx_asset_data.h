@@ -23,6 +23,7 @@
 
 #include <vulkan/vulkan.h>
 #include "../../util/util_error.h"
+#include "../../util/thread.h"
 #include "../../util/rc/util_rc.h"
 #include "../../util/rc/util_rc_ptr.h"
 #include "../../util/xxHash/xxhash.h"
@@ -39,6 +40,13 @@ namespace dxvk {
   enum class AssetCompression {
     None,
     GDeflate,
+    LZ4,
+  };
+
+  // Color space an image asset is interpreted in when a texture is created from it
+  enum class ColorSpace {
+    FORCE_BC_SRGB,
+    AUTO
   };
 
   struct AssetInfo {
@@ -67,6 +75,21 @@ namespace dxvk {
       return m_hash;
     }
 
+    // Equal for assets holding the same data, falls back to the asset's own hash when the content was not hashed
+    XXH64_hash_t contentHash() const {
+      return m_contentHash != 0 ? m_contentHash : m_hash;
+    }
+
+    void setContentHash(XXH64_hash_t contentHash) {
+      m_contentHash = contentHash;
+    }
+
+    // Key of a texture created from the asset. The color space picks an sRGB or linear format, so assets
+    // holding the same data only share a texture when it's created in the same color space.
+    XXH64_hash_t textureKey(ColorSpace colorSpace) const {
+      return XXH3_64bits_withSeed(&colorSpace, sizeof(colorSpace), contentHash());
+    }
+
     virtual const void* data(int layer, int level) = 0;
     virtual void placement(
       int       layer,
@@ -75,12 +98,24 @@ namespace dxvk {
       uint64_t& offset,
       size_t&   size) const = 0;
     virtual void evictCache() = 0;
+    // Hints that the data of a level will be read soon. Asynchronous, optional.
+    virtual void prefetch(int layer, int level) const { }
+
+    // data() and evictCache() update the cached data of the asset, which deduplicated textures and views
+    // share. Hold this mutex around them when the asset may be read by another thread, e.g. an upload worker.
+    virtual dxvk::mutex& cacheMutex() {
+      return m_cacheMutex;
+    }
 
   protected:
     AssetData() = default;
 
     AssetInfo m_info;
     XXH64_hash_t m_hash;
+    XXH64_hash_t m_contentHash = 0;
+
+  private:
+    dxvk::mutex m_cacheMutex;
   };
 
   class ImageAssetDataView : public AssetData {
@@ -95,6 +130,7 @@ namespace dxvk {
       }
       m_info = sourceAsset->info();
       m_hash = sourceAsset->hash();
+      m_contentHash = sourceAsset->contentHash();
 
       setMinLevel(minLevel);
     }
@@ -107,6 +143,10 @@ namespace dxvk {
       return m_sourceAsset->evictCache();
     }
 
+    dxvk::mutex& cacheMutex() override {
+      return m_sourceAsset->cacheMutex();
+    }
+
     void placement(
       int       layer,
       int       face,
@@ -117,6 +157,10 @@ namespace dxvk {
         offset, size);
     }
 
+    void prefetch(int layer, int level) const override {
+      m_sourceAsset->prefetch(layer, level + m_minLevel);
+    }
+
     void setMinLevel(int minLevel) {
       const auto& srcInfo = m_sourceAsset->info();
 
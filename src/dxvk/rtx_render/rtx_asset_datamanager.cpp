@@ -25,7 +25,12 @@
 #include "rtx_asset_package.h"
 #include "rtx_game_capturer_paths.h"
 #include "rtx_io.h"
+#include "rtx_texture_file.h"
+#include "dxvk_format.h"
 #include "dxvk_scoped_annotation.h"
+#include "dxvk_util.h"
+#include "../../util/util_mapped_file.h"
+#include <fstream>
 #include <gli/gli.hpp>
 
 namespace dxvk {
@@ -106,207 +111,87 @@ namespace dxvk {
     std::string m_filename;
   };
 
-  class DdsFileParser {
-  public:
-    virtual ~DdsFileParser() {
-      closeHandle();
+  class TextureFileData : public AssetData {
+    AssetType type() const {
+      if (m_layout.width > 1 && m_layout.height == 1 && m_layout.depth == 1) {
+        return AssetType::Image1D;
+      }
+      if (m_layout.depth > 1) {
+        return AssetType::Image3D;
+      }
+      return AssetType::Image2D;
     }
 
-    bool parse(const std::string& filename) {
-      using namespace gli::detail;
-
-      m_filename = filename;
-
-      if (openHandle() == nullptr)
-        return false;
-
-      std::fseek(m_file, 0, SEEK_END);
-      m_fileSize = std::ftell(m_file);
-      std::fseek(m_file, 0, SEEK_SET);
-
-      dds_header header;
-      dds_header10 header10;
-
-      if (m_fileSize < sizeof(FOURCC_DDS) + sizeof(header))
-        return false;
-
-      char fourcc[sizeof(FOURCC_DDS)];
-      std::fread(fourcc, sizeof(fourcc), 1, m_file);
-      if (std::memcmp(fourcc, FOURCC_DDS, 4) != 0)
+  public:
+    // Only the header is read here, mip data is mapped in on demand by data()
+    bool load(const std::string& filename) {
+      std::ifstream file(filename, std::ios::binary | std::ios::ate);
+      if (!file) {
         return false;
-
-      std::fread(&header, sizeof(header), 1, m_file);
-
-      if ((header.Format.flags & gli::dx::DDPF_FOURCC) &&
-          (header.Format.fourCC == gli::dx::D3DFMT_DX10 || header.Format.fourCC == gli::dx::D3DFMT_GLI1)) {
-        if (m_fileSize < sizeof(FOURCC_DDS) + sizeof(header) + sizeof(header10))
-          return false;
-
-        std::fread(&header10, sizeof(header10), 1, m_file);
       }
 
-      m_dataOffset = std::ftell(m_file);
-
-      auto format = get_dds_format(header, header10);
-      m_format = static_cast<VkFormat>(format);
-
-      m_levels = (header.Flags & DDSD_MIPMAPCOUNT) ? int(header.MipMapLevels) : 1;
-
-      m_layers = int(std::max(header10.ArraySize, 1u));
-
-      m_faces = 1;
-      if (header.CubemapFlags & DDSCAPS2_CUBEMAP)
-        m_faces = int(glm::bitCount(header.CubemapFlags & DDSCAPS2_CUBEMAP_ALLFACES));
-
-      m_width = header.Width;
-      m_height = header.Height;
-      m_depth = 1;
-      if (header.CubemapFlags & DDSCAPS2_VOLUME)
-        m_depth = header.Depth;
-
-      size_t blockSize = gli::block_size(format);
-      glm::ivec3 blockExtent = gli::block_extent(format);
-      assert(m_levelSizes.size() >= m_levels && "DDS level sizes array overrun! Increase array size.");
-      for (int level = 0; level < m_levels; ++level) {
-        VkExtent3D levelExtent {
-          std::max(header.Width >> level, 1u), std::max(header.Height >> level, 1u), 1u
-        };
-        uint32_t widthBlocks = std::max(1u, (levelExtent.width + blockExtent.x - 1) / blockExtent.x);
-        uint32_t heightBlocks = std::max(1u, (levelExtent.height + blockExtent.y - 1) / blockExtent.y);
-        size_t levelSize = widthBlocks * heightBlocks * blockSize;
-        m_levelSizes[level] = levelSize;
-        m_sizeOfAllLevels += levelSize;
-      }
+      const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+      std::array<uint8_t, TextureFileLayout::kMaxHeaderSize> header;
+      const size_t headerSize = static_cast<size_t>(std::min<uint64_t>(fileSize, header.size()));
 
-      if (m_sizeOfAllLevels * (m_layers * m_faces) + m_dataOffset > m_fileSize)
+      file.seekg(0);
+      if (!file.read(reinterpret_cast<char*>(header.data()), headerSize)) {
         return false;
-
-      closeHandle();
-
-      return true;
-    }
-
-    FILE* openHandle() {
-      assert(!m_filename.empty() && "DDS filename cannot be empty");
-      if (m_file == nullptr) {
-        m_file = gli::detail::open_file(m_filename.c_str(), "rb");
       }
-      return m_file;
-    }
 
-    void closeHandle() {
-      if (m_file) {
-        std::fclose(m_file);
-        m_file = nullptr;
+      if (!m_layout.parse(header.data(), headerSize, fileSize)) {
+        return false;
       }
-    }
-
-  protected:
-    std::string m_filename;
-
-    long m_fileSize = 0;
-
-    uint32_t m_width = 0;
-    uint32_t m_height = 0;
-    uint32_t m_depth = 0;
-    VkFormat m_format = VK_FORMAT_UNDEFINED;
-    long m_dataOffset = 0;
-    int m_levels = 0;
-    int m_layers = 0;
-    int m_faces = 0;
-    std::array<size_t, 16> m_levelSizes;
-    size_t m_sizeOfAllLevels = 0;
-
-    void getDataPlacement(int layer, int face, int level, long& offset, size_t& size) const {
-      int linearFace = layer * m_faces + face;
-      offset = m_dataOffset + linearFace * m_sizeOfAllLevels;
 
-      for (int i = 0; i < level; ++i)
-        offset += m_levelSizes[i];
-
-      size = m_levelSizes[level];
-    }
-
-  private:
-    FILE* m_file = nullptr;
-  };
-
-  class DdsTextureData : public DdsFileParser, public AssetData {
-    std::unordered_map<int, std::vector<uint8_t>> m_data;
+      m_filename = filename;
 
-    AssetType type() const {
-      if (m_width > 1 && m_height == 1 && m_depth == 1) {
-        return AssetType::Image1D;
-      }
-      if (m_depth > 1) {
-        return AssetType::Image3D;
-      }
-      return AssetType::Image2D;
-    }
+      m_info.type = type();
+      m_info.compression = AssetCompression::None;
+      m_info.format = m_layout.format;
+      m_info.extent = { m_layout.width, m_layout.height, m_layout.depth };
+      m_info.mipLevels = m_layout.levels;
+      m_info.looseLevels = m_layout.levels;
+      m_info.numLayers = m_layout.layers;
+      m_info.filename = m_filename.c_str();
 
-  public:
+      m_hash = XXH64_std_hash<std::string> {}(m_filename);
 
-    ~DdsTextureData() override {
+      return true;
     }
 
     const void* data(int layer, int level) override {
-      int key = (layer * m_faces + 0) * m_levels + level;
-      const auto& it = m_data.find(key);
-      if (it != m_data.end())
-        return it->second.data();
-
-      long dataOffset;
-      size_t dataSize;
-      getDataPlacement(layer, 0, level, dataOffset, dataSize);
-
-      if (m_fileSize < dataOffset + dataSize)
+      if (!m_file.isOpen() && !m_file.open(m_filename)) {
         return nullptr;
+      }
 
-      auto file = openHandle();
-
-      std::vector<uint8_t> data;
-      std::fseek(file, dataOffset, SEEK_SET);
-      data.resize(dataSize);
-      std::fread(data.data(), dataSize, 1, file);
+      // Pages are faulted in as the level is read, the rest of the file is never touched
+      const TextureFileLayout::Subresource& subresource = m_layout.subresource(layer, 0, level);
+      if (subresource.offset + subresource.size > m_file.size()) {
+        return nullptr;
+      }
 
-      const void* rawData = data.data();
-      m_data[key] = std::move(data);
-      return rawData;
+      return m_file.data() + subresource.offset;
     }
 
     void evictCache() override {
-      m_data.clear();
-      closeHandle();
+      m_file.close();
     }
 
     void placement(
       int       layer,
       int       face,
       int       level,
-      uint64_t& offset64,
+      uint64_t& offset,
       size_t&   size) const override {
-      long offset;
-      getDataPlacement(layer, face, level, offset, size);
-      offset64 = offset;
+      const TextureFileLayout::Subresource& subresource = m_layout.subresource(layer, face, level);
+      offset = subresource.offset;
+      size = subresource.size;
     }
 
-    bool load(const std::string& filename) {
-      if (parse(filename)) {
-        m_info.type = type();
-        m_info.compression = AssetCompression::None;
-        m_info.format = m_format;
-        m_info.extent = { m_width, m_height, m_depth };
-        m_info.mipLevels = m_levels;
-        m_info.looseLevels = m_levels;
-        m_info.numLayers = m_layers;
-        m_info.filename = m_filename.c_str();
-
-        m_hash = XXH64_std_hash<std::string> {}(m_filename);
-
-        return true;
-      }
-      return false;
-    }
+  private:
+    TextureFileLayout m_layout;
+    MappedFile m_file;
+    std::string m_filename;
   };
 
   class PackagedAssetData : public AssetData {
@@ -353,12 +238,14 @@ namespace dxvk {
     }
 
     AssetCompression compression() const {
-      const auto blobDesc = m_package->getDataBlobDesc(
-        m_assetDesc->baseBlobIdx);
-
-      // We support only the GDeflate compression method atm
-      return blobDesc->compression != 0 ?
-        AssetCompression::GDeflate : AssetCompression::None;
+      switch (m_package->getDataBlobCompression(m_assetDesc->baseBlobIdx)) {
+      case AssetPackage::Compression::GDeflate:
+        return AssetCompression::GDeflate;
+      case AssetPackage::Compression::LZ4:
+        return AssetCompression::LZ4;
+      default:
+        return AssetCompression::None;
+      }
     }
 
     VkExtent3D extent(int level) const {
@@ -376,30 +263,46 @@ namespace dxvk {
     const void* data(int layer, int level) override {
       uint32_t blobIdx = getBlobIndex(layer, 0, level);
 
-      const auto& it = m_data.find(blobIdx);
-      if (it != m_data.end())
-        return it->second.data();
-
-      if (auto blobDesc = m_package->getDataBlobDesc(blobIdx)) {
-        if (blobDesc->compression != 0) {
-          throw DxvkError("Compressed data blobs are not supported for CPU readback.");
-        }
+      const AssetPackage::BlobSpan blob = m_package->getDataBlob(blobIdx);
 
-        std::vector<uint8_t> data(blobDesc->size);
-        m_package->readDataBlob(blobIdx, data.data(), data.size());
+      if (blob.empty()) {
+        return nullptr;
+      }
 
-        const void* rawData = data.data();
-        m_data[blobIdx] = std::move(data);
-        return rawData;
+      const uint8_t* blobData = nullptr;
+
+      switch (m_package->getDataBlobCompression(blobIdx)) {
+      case AssetPackage::Compression::None:
+        // The package is memory mapped, hand out the blob in place
+        blobData = blob.data;
+        break;
+      case AssetPackage::Compression::LZ4: {
+        auto it = m_data.find(blobIdx);
+        if (it == m_data.end()) {
+          std::vector<uint8_t> decoded(m_package->getDataBlobSize(blobIdx));
+          if (decoded.empty() || !m_package->decodeDataBlob(blobIdx, decoded.data(), decoded.size())) {
+            throw DxvkError(str::format("Failed to decode data blob ", blobIdx, " of ", m_package->getFilename()));
+          }
+          it = m_data.emplace(blobIdx, std::move(decoded)).first;
+        }
+        blobData = it->second.data();
+        break;
+      }
+      default:
+        throw DxvkError("GDeflate compressed data blobs are not supported for CPU readback.");
       }
 
-      return nullptr;
+      return blobData + getTailLevelOffset(level);
     }
 
     void evictCache() override {
       m_data.clear();
     }
 
+    void prefetch(int layer, int level) const override {
+      m_package->prefetchDataBlob(getBlobIndex(layer, 0, level));
+    }
+
     void placement(
       int       layer,
       int       face,
@@ -422,30 +325,37 @@ namespace dxvk {
     uint32_t getBlobIndex(int       layer,
                           int       face,
                           int       level) const {
-      if (m_assetDesc->type == AssetPackage::AssetDesc::Type::BUFFER) {
-        return m_assetDesc->baseBlobIdx;
-      }
+      return AssetPackage::getMipBlobIndex(*m_assetDesc, layer, face, level);
+    }
 
-      if (m_assetDesc->type == AssetPackage::AssetDesc::Type::IMAGE_CUBE) {
-        layer = layer * 6 + face;
+    // Levels in the mip tail are packed back to back in the tail blob
+    size_t getTailLevelOffset(int level) const {
+      if (type() == AssetType::Buffer || level <= (int) m_info.looseLevels) {
+        return 0;
       }
 
-      const uint32_t numLooseMips =
-        m_assetDesc->numMips - m_assetDesc->numTailMips;
-      const uint32_t baseBlobIdx =
-        level >= numLooseMips ? m_assetDesc->tailBlobIdx :
-        level + m_assetDesc->baseBlobIdx;
+      const DxvkFormatInfo* formatInfo = imageFormatInfo(m_info.format);
 
-      return baseBlobIdx + layer * numLooseMips;
+      size_t offset = 0;
+      for (int tailLevel = m_info.looseLevels; tailLevel < level; tailLevel++) {
+        const VkExtent3D elementCount = util::computeBlockCount(extent(tailLevel), formatInfo->blockSize);
+        offset += formatInfo->elementSize * util::flattenImageExtent(elementCount);
+      }
+
+      return offset;
     }
 
     Rc<AssetPackage> m_package;
     const AssetPackage::AssetDesc* m_assetDesc = nullptr;
     uint32_t m_assetIdx;
 
+    // Decoded LZ4 blobs handed out by data()
     std::unordered_map<uint32_t, std::vector<uint8_t>> m_data;
   };
 
+  // Written next to the mod files, keeps content hashes valid across runs
+  static const char* const kContentHashCacheFilename = "texture_hashes.bin";
+
   AssetDataManager::AssetDataManager() {
   }
 
@@ -453,6 +363,15 @@ namespace dxvk {
   }
 
   void AssetDataManager::initialize(const std::filesystem::path& path) {
+    if (RtxOptions::Get()->enableTextureDeduplication()) {
+      const std::string directory = path.lexically_normal().string();
+      if (m_contentHashCaches.count(directory) == 0) {
+        auto cache = std::make_unique<ContentHashCache>();
+        cache->load(path / kContentHashCacheFilename);
+        m_contentHashCaches.emplace(directory, std::move(cache));
+      }
+    }
+
     if (m_package != nullptr) {
       return;
     }
@@ -460,20 +379,18 @@ namespace dxvk {
     m_basePath = path;
     m_basePath.make_preferred();
 
-    if (RtxIo::enabled()) {
-      std::string packagePath;
+    std::string packagePath;
 
-      // Find the pkg (if it exists)
-      for (const auto& entry : std::filesystem::directory_iterator(path))
-        if (entry.path().extension() == ".pkg")
-          packagePath = entry.path().string();
+    // Find the pkg (if it exists)
+    for (const auto& entry : std::filesystem::directory_iterator(path))
+      if (entry.path().extension() == ".pkg")
+        packagePath = entry.path().string();
 
-      // Try to initialize the replacements packages
-      Rc<AssetPackage> package = new AssetPackage(packagePath);
+    // Try to initialize the replacements packages
+    Rc<AssetPackage> package = new AssetPackage(packagePath);
 
-      if (package->initialize()) {
-        m_package = std::move(package);
-      }
+    if (package->initialize()) {
+      m_package = std::move(package);
     }
   }
 
@@ -482,34 +399,48 @@ namespace dxvk {
 
     const char* extension = strrchr(filename.c_str(), '.');
     const bool isDDS = extension ? _stricmp(extension, ".dds") == 0 : false;
-    // Only allow DDS even though GLI supports KTX and KMG formats as well: we haven't tested those.
-    const bool isSupported = isDDS;
+    // KTX2 is only read by the native texture file loader, GLI does not support it.
+    const bool isKTX2 = extension ? _stricmp(extension, ".ktx2") == 0 : false;
+    // Only allow DDS and KTX2 even though GLI supports KTX and KMG formats as well: we haven't tested those.
+    const bool isSupported = isDDS || isKTX2;
 
     if (!isSupported) {
       Logger::err(str::format("Unsupported image file format, please convert to DDS using Remix Export: ", filename));
       return nullptr;
     }
 
-    if (RtxIo::enabled() && m_package != nullptr) {
+    if (m_package != nullptr) {
       auto relativePath = std::filesystem::relative(filename, m_basePath);
       uint32_t assetIdx = m_package->findAsset(relativePath.string());
       if (AssetPackage::kNoAssetIdx != assetIdx) {
-        return new PackagedAssetData(m_package, assetIdx);
+        Rc<PackagedAssetData> asset = new PackagedAssetData(m_package, assetIdx);
+
+        // GDeflate blobs can only be decoded by RTX IO, use the loose file otherwise
+        if (RtxIo::enabled() || asset->info().compression != AssetCompression::GDeflate) {
+          return asset;
+        }
       }
     }
 
-    if (isDDS && RtxOptions::Get()->usePartialDdsLoader()) {
-      Rc<DdsTextureData> dds = new DdsTextureData;
-      if (dds->load(filename)) {
-        return dds;
+    if (isKTX2 || RtxOptions::Get()->usePartialDdsLoader()) {
+      Rc<TextureFileData> textureFile = new TextureFileData;
+      if (textureFile->load(filename)) {
+        setContentHash(*textureFile, filename);
+        return textureFile;
       }
     }
 
+    if (isKTX2) {
+      Logger::err(str::format("Unsupported KTX2 image file, supercompressed files are not supported: ", filename));
+      return nullptr;
+    }
+
     // Fallback to GLI
     Rc<GliTextureData> gli = new GliTextureData;
     if (gli->load(filename)) {
       Logger::warn(str::format("The GLI library was used to load image file '", filename,
                                "'. Image data will reside in CPU memory!"));
+      setContentHash(*gli, filename);
       return gli;
     }
 
@@ -517,4 +448,27 @@ namespace dxvk {
     return nullptr;
   }
 
+  void AssetDataManager::setContentHash(AssetData& asset, const std::string& filename) {
+    // Packaged assets keep their path identity, only loose files are deduplicated
+    if (!RtxOptions::Get()->enableTextureDeduplication()) {
+      return;
+    }
+
+    ContentHashCache* cache = &m_fallbackContentHashCache;
+    for (auto& [directory, modCache] : m_contentHashCaches) {
+      if (modCache->covers(filename)) {
+        cache = modCache.get();
+        break;
+      }
+    }
+
+    asset.setContentHash(cache->getHash(filename));
+  }
+
+  void AssetDataManager::saveContentHashes() {
+    for (auto& [directory, cache] : m_contentHashCaches) {
+      cache->save();
+    }
+  }
+
 } // namespace dxvk
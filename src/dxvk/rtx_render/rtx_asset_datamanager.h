@@ -22,7 +22,10 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <unordered_map>
 #include "../util/util_singleton.h"
+#include "../util/util_content_hash_cache.h"
 #include "rtx_asset_data.h"
 #include "rtx_asset_package.h"
 
@@ -35,12 +38,22 @@ namespace dxvk {
   class AssetDataManager : public Singleton<AssetDataManager> {
     Rc<AssetPackage> m_package;
     std::filesystem::path m_basePath;
+    // Content hashes of loose files, one persistent cache per mod directory
+    std::unordered_map<std::string, std::unique_ptr<ContentHashCache>> m_contentHashCaches;
+    // Loose files outside of any mod directory
+    ContentHashCache m_fallbackContentHashCache;
+
+    void setContentHash(AssetData& asset, const std::string& filename);
+
   public:
     AssetDataManager();
     ~AssetDataManager();
 
     void initialize(const std::filesystem::path& path);
     Rc<AssetData> findAsset(const std::string& filename);
+
+    // Writes the content hash caches of all mod directories
+    void saveContentHashes();
   };
 
 } // namespace dxvk
@@ -22,32 +22,53 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
-#include <stdio.h>
+#include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ppl.h>
 
 #include "../../util/rc/util_rc.h"
 #include "../../util/log/log.h"
+#include "../../util/util_fastops.h"
+#include "../../util/util_lz4.h"
+#include "../../util/util_mapped_file.h"
 #include "../../util/util_string.h"
 
-#ifdef WIN32
-#define fseek64 _fseeki64
-#define ftell64 _ftelli64
-#else
-#define fseek64 fseeko64
-#define ftell64 ftello64
-#define fopen_s(pFile,filename,mode) (((*(pFile))=fopen((filename),(mode)))==NULL)
-#endif
-
 namespace dxvk {
 
-  // A trivial assets package file container
+  // A trivial assets package file container.
+  // The package file is memory mapped for the lifetime of the object, data blobs
+  // are addressed in place and may be accessed from any number of threads.
+  //
+  // Version 1: every mip level (and the mip tail) of every layer is a single blob,
+  //   either stored raw or GDeflate compressed for RTX IO.
+  //
+  // Version 2: blobs are split in fixed size chunks (kDefaultChunkSize of decoded
+  //   data, the last one may be shorter). Each chunk is compressed independently and
+  //   carries a CRC-32C of its stored bytes, so any mip range can be fetched, verified
+  //   and decompressed on its own and on as many threads as there are chunks.
+  //   The chunks of a blob are stored back to back. Layout:
+  //     Header | chunk data | DictionaryV2 | AssetDesc[] | BlobDescV2[] | ChunkDesc[] | names
   class AssetPackage : public RcObject {
   public:
     static constexpr uint32_t kMagic = 0xbaadd00d;
-    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kVersion1 = 1;
+    static constexpr uint32_t kVersion2 = 2;
+    static constexpr uint32_t kVersion = kVersion2;
     static constexpr uint32_t kNoAssetIdx = ~0;
+    static constexpr uint32_t kDefaultChunkSize = 64 * 1024;
+
+    enum class Compression : uint8_t {
+      None = 0,
+      GDeflate = 1, // Decoded on the GPU by RTX IO, one chunk per blob
+      LZ4 = 2,      // Decoded on the CPU, version 2 only
+    };
 
     struct Header {
       uint32_t magic;
@@ -89,6 +110,7 @@ namespace dxvk {
 
     static_assert(sizeof(AssetDesc) == 20, "Asset description structure size overrun!");
 
+    // Version 1 blob, also synthesized for version 2 blobs to describe their stored byte range
     struct BlobDesc {
       uint64_t offset : 40;
       uint64_t compression : 8;
@@ -100,107 +122,108 @@ namespace dxvk {
 
     static_assert(sizeof(BlobDesc) == 16, "Blob description structure size overrun!");
 
+    struct DictionaryV2 {
+      uint32_t assetCount;
+      uint32_t blobCount;
+      uint32_t chunkCount;
+      uint32_t chunkSize;
+    };
+
+    struct BlobDescV2 {
+      uint64_t size;
+      uint32_t firstChunk;
+      uint32_t numChunks;
+      uint8_t compression;
+      uint8_t flags;
+      uint16_t reserved0;
+      uint32_t reserved1;
+    };
+
+    static_assert(sizeof(BlobDescV2) == 24, "Blob description structure size overrun!");
+
+    struct ChunkDesc {
+      uint64_t offset : 40;
+      uint64_t compression : 8;
+      uint64_t reserved : 16;
+
+      uint32_t size;
+      uint32_t crc32c;
+    };
+
+    static_assert(sizeof(ChunkDesc) == 16, "Chunk description structure size overrun!");
+
+    // A view of the (possibly compressed) bytes of a data blob in the mapped package.
+    // Stays valid for as long as the package object is alive.
+    struct BlobSpan {
+      const uint8_t* data = nullptr;
+      size_t size = 0;
+      uint8_t compression = 0;
+
+      bool empty() const {
+        return data == nullptr;
+      }
+    };
+
     AssetPackage() = default;
     explicit AssetPackage(const std::string& filename)
       : m_filename { filename } { }
 
-    ~AssetPackage() {
-      closeFileHandle();
-    }
-
     bool initialize(const char* filename = nullptr) {
       if (m_filename.empty() && nullptr == filename)
         return false;
 
-      closeFileHandle();
-
       if (m_filename.empty() && nullptr != filename)
         m_filename = filename;
 
-      if (openFileHandle()) {
-        Header header { 0 };
-        if (sizeof(header) != fread(&header, 1, sizeof(header), m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (header.magic != kMagic) {
-          Logger::err(str::format("File ", m_filename, " is not an asset package."));
-          return false;
-        }
-
-        if (header.version != kVersion) {
-          Logger::err(str::format("Asset package ", m_filename, " version mismatch. "
-                                  "Got: ", header.version, ", expected: ", kVersion));
-          return false;
-        }
-
-        if (0 != fseek64(m_handle, header.dictOffset, SEEK_SET)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (1 != fread(&m_assetCount, 2, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (1 != fread(&m_blobCount, 2, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
+      reset();
 
-        const size_t dictSize =
-          m_assetCount * sizeof(AssetDesc) + m_blobCount * sizeof(BlobDesc);
+      if (!m_file.open(m_filename)) {
+        Logger::info(str::format("Unable to open package file ", m_filename));
+        return false;
+      }
 
-        m_metadata.reset(new uint8_t[dictSize]);
+      const size_t fileSize = m_file.size();
 
-        if (dictSize != fread(m_metadata.get(), 1, dictSize, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
+      Header header { 0 };
+      if (fileSize < sizeof(header)) {
+        return malformed();
+      }
 
-        size_t nameTableOffset = ftell64(m_handle);
-        fseek64(m_handle, 0, SEEK_END);
-        size_t nameTableSize = ftell64(m_handle) - nameTableOffset;
-        fseek64(m_handle, nameTableOffset, SEEK_SET);
+      memcpy(&header, m_file.data(), sizeof(header));
 
-        std::unique_ptr<char[]> names(new char[nameTableSize]);
+      if (header.magic != kMagic) {
+        Logger::err(str::format("File ", m_filename, " is not an asset package."));
+        reset();
+        return false;
+      }
 
-        if (1 != fread(names.get(), nameTableSize, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
+      if (header.version != kVersion1 && header.version != kVersion2) {
+        Logger::err(str::format("Asset package ", m_filename, " version mismatch. "
+                                "Got: ", header.version, ", expected: ", kVersion1, " or ", kVersion2));
+        reset();
+        return false;
+      }
 
-        closeFileHandle();
+      if (header.dictOffset > fileSize) {
+        return malformed();
+      }
 
-        auto namesPtr = names.get();
-        for (uint32_t n = 0; n < m_assetCount; n++) {
-          m_nameHash.emplace(namesPtr, n);
-          namesPtr += strlen(namesPtr) + 1;
-        }
+      m_version = header.version;
+      m_dataSize = header.dictOffset;
 
-        return true;
-      }
+      const bool parsed = m_version == kVersion1 ?
+        parseDictionaryV1(header.dictOffset) : parseDictionaryV2(header.dictOffset);
 
-      return false;
+      return parsed || malformed();
     }
 
-    bool openFileHandle() {
-      if (nullptr == m_handle) {
-        if (0 != fopen_s(&m_handle, m_filename.c_str(), "rb")) {
-          Logger::info(str::format("Unable to open package file ", m_filename));
-        }
-      }
-
-      return nullptr != m_handle;
+    uint32_t getVersion() const {
+      return m_version;
     }
 
-    void closeFileHandle() {
-      if (m_handle) {
-        fclose(m_handle);
-        m_handle = nullptr;
-      }
+    // Decoded size of the chunks of version 2 blobs, 0 for version 1 packages
+    uint32_t getChunkSize() const {
+      return m_chunkSize;
     }
 
     uint32_t getAssetCount() const {
@@ -226,34 +249,155 @@ namespace dxvk {
       return reinterpret_cast<const BlobDesc*>(m_metadata.get() + offs);
     }
 
-    size_t readDataBlob(uint32_t idx, void* out, size_t outSize) {
+    // Index of the blob holding a mip level of an asset. Levels in the mip tail all map to the tail blob.
+    static uint32_t getMipBlobIndex(const AssetDesc& assetDesc, int layer, int face, int level) {
+      if (assetDesc.type == AssetDesc::Type::BUFFER) {
+        return assetDesc.baseBlobIdx;
+      }
+
+      if (assetDesc.type == AssetDesc::Type::IMAGE_CUBE) {
+        layer = layer * 6 + face;
+      }
+
+      const uint32_t numLooseMips =
+        assetDesc.numMips - assetDesc.numTailMips;
+      const uint32_t baseBlobIdx =
+        level >= numLooseMips ? assetDesc.tailBlobIdx :
+        level + assetDesc.baseBlobIdx;
+
+      return baseBlobIdx + layer * numLooseMips;
+    }
+
+    Compression getDataBlobCompression(uint32_t idx) const {
       if (auto blobDesc = getDataBlobDesc(idx)) {
-        if (outSize < blobDesc->size)
-          return 0;
+        return toCompression(blobDesc->compression);
+      }
 
-        if (!openFileHandle())
-          return 0;
+      return Compression::None;
+    }
+
+    // Size of the blob once decoded, 0 if it cannot be decoded on the CPU
+    size_t getDataBlobSize(uint32_t idx) const {
+      if (idx >= m_blobCount || getDataBlobCompression(idx) == Compression::GDeflate)
+        return 0;
+
+      return m_blobs[idx].size;
+    }
+
+    uint32_t getDataBlobChunkCount(uint32_t idx) const {
+      return idx < m_blobCount ? m_blobs[idx].numChunks : 0;
+    }
+
+    // Returns the stored blob bytes in place, no data is copied. Thread-safe.
+    BlobSpan getDataBlob(uint32_t idx) const {
+      BlobSpan span;
 
-        if (0 == fseek64(m_handle, blobDesc->offset, SEEK_SET))
-          return fread(out, 1, blobDesc->size, m_handle);
+      if (auto blobDesc = getDataBlobDesc(idx)) {
+        span.data = m_file.data() + blobDesc->offset;
+        span.size = blobDesc->size;
+        span.compression = static_cast<uint8_t>(blobDesc->compression);
       }
 
-      return 0;
+      return span;
+    }
+
+    // Copies the stored blob bytes to the output buffer. Thread-safe.
+    size_t readDataBlob(uint32_t idx, void* out, size_t outSize) const {
+      const BlobSpan blob = getDataBlob(idx);
+
+      if (blob.empty() || outSize < blob.size)
+        return 0;
+
+      memcpy(out, blob.data, blob.size);
+
+      return blob.size;
     }
 
-    size_t getDataSize() {
-      if (!openFileHandle())
+    // Verifies and decodes a range of chunks of a blob, the first chunk lands at the start
+    // of the output buffer. Thread-safe, returns the number of bytes written or 0 on failure.
+    size_t decodeDataBlobChunks(uint32_t idx, uint32_t firstChunk, uint32_t numChunks, void* out, size_t outSize) const {
+      if (idx >= m_blobCount || firstChunk + numChunks > m_blobs[idx].numChunks)
         return 0;
 
-      if (m_handle && 0 == fseek64(m_handle, 0, SEEK_SET)) {
-        Header header { 0 };
-        if (0 == fread(&header, 1, sizeof(header), m_handle))
+      const BlobInfo& blob = m_blobs[idx];
+      uint8_t* dst = static_cast<uint8_t*>(out);
+      size_t written = 0;
+
+      for (uint32_t n = firstChunk; n < firstChunk + numChunks; n++) {
+        const size_t decodedSize = getChunkDecodedSize(blob, n);
+
+        if (outSize - written < decodedSize || !decodeChunk(blob.firstChunk + n, dst + written, decodedSize))
           return 0;
 
-        return header.dictOffset;
+        written += decodedSize;
       }
 
-      return 0;
+      return written;
+    }
+
+    // Verifies and decodes a whole blob, chunks are decoded in parallel. Thread-safe.
+    size_t decodeDataBlob(uint32_t idx, void* out, size_t outSize) const {
+      return decodeDataBlobs(&idx, &out, &outSize, 1);
+    }
+
+    // Verifies and decodes a set of blobs (e.g. a mip range), all of their chunks are
+    // decoded in parallel. Thread-safe, returns the total decoded size or 0 on failure.
+    size_t decodeDataBlobs(const uint32_t* indices, void* const* outs, const size_t* outSizes, size_t count) const {
+      struct ChunkJob {
+        uint32_t chunkIdx;
+        uint8_t* dst;
+        size_t size;
+      };
+
+      std::vector<ChunkJob> jobs;
+      size_t totalSize = 0;
+
+      for (size_t i = 0; i < count; i++) {
+        const size_t blobSize = getDataBlobSize(indices[i]);
+        if (blobSize == 0 || blobSize > outSizes[i])
+          return 0;
+
+        const BlobInfo& blob = m_blobs[indices[i]];
+        size_t dstOffset = 0;
+
+        for (uint32_t n = 0; n < blob.numChunks; n++) {
+          const size_t decodedSize = getChunkDecodedSize(blob, n);
+          jobs.push_back({ blob.firstChunk + n, static_cast<uint8_t*>(outs[i]) + dstOffset, decodedSize });
+          dstOffset += decodedSize;
+        }
+
+        totalSize += blobSize;
+      }
+
+      std::atomic<bool> success = true;
+
+      auto decodeJob = [&](size_t i) {
+        if (!decodeChunk(jobs[i].chunkIdx, jobs[i].dst, jobs[i].size)) {
+          success = false;
+        }
+      };
+
+      // Chunks are small, only fan out when there is enough work to go around
+      if (jobs.size() > 3) {
+        concurrency::parallel_for<size_t>(0, jobs.size(), decodeJob);
+      } else {
+        for (size_t i = 0; i < jobs.size(); i++) {
+          decodeJob(i);
+        }
+      }
+
+      return success ? totalSize : 0;
+    }
+
+    // Asks the OS to start paging in the blob, returns immediately.
+    void prefetchDataBlob(uint32_t idx) const {
+      if (auto blobDesc = getDataBlobDesc(idx)) {
+        m_file.prefetch(blobDesc->offset, blobDesc->size);
+      }
+    }
+
+    size_t getDataSize() const {
+      return m_dataSize;
     }
 
     uint32_t findAsset(const std::string& filename) const {
@@ -266,24 +410,256 @@ namespace dxvk {
       return kNoAssetIdx;
     }
 
+    // Name of an asset, in place in the mapped package
+    const char* getAssetName(uint32_t idx) const {
+      if (idx >= m_assetCount)
+        return nullptr;
+
+      return reinterpret_cast<const char*>(m_file.data()) + m_nameOffsets[idx];
+    }
+
     const std::string& getFilename() const {
       return m_filename;
     }
 
   private:
+    struct BlobInfo {
+      uint64_t size;
+      uint32_t firstChunk;
+      uint32_t numChunks;
+    };
+
+    static Compression toCompression(uint64_t compression) {
+      // Version 1 packages only ever used GDeflate, any non-zero value means compressed
+      return compression == 0 ? Compression::None :
+        compression == static_cast<uint64_t>(Compression::LZ4) ? Compression::LZ4 : Compression::GDeflate;
+    }
+
+    size_t getChunkDecodedSize(const BlobInfo& blob, uint32_t chunk) const {
+      if (m_chunkSize == 0)
+        return blob.size;
+
+      const uint64_t begin = uint64_t(chunk) * m_chunkSize;
+      return static_cast<size_t>(std::min<uint64_t>(m_chunkSize, blob.size - begin));
+    }
+
+    bool decodeChunk(uint32_t chunkIdx, uint8_t* dst, size_t decodedSize) const {
+      const ChunkDesc& chunk = m_chunks[chunkIdx];
+      const uint8_t* src = m_file.data() + chunk.offset;
+
+      // Version 1 checksums predate the chunked format and are not verified
+      if (m_version >= kVersion2 && fast::crc32c(src, chunk.size) != chunk.crc32c) {
+        Logger::err(str::format("Asset package ", m_filename, " chunk ", chunkIdx, " failed the CRC check."));
+        return false;
+      }
+
+      switch (toCompression(chunk.compression)) {
+      case Compression::None:
+        if (chunk.size != decodedSize)
+          return false;
+
+        memcpy(dst, src, decodedSize);
+        return true;
+      case Compression::LZ4:
+        return lz4::decompress(src, chunk.size, dst, decodedSize) == decodedSize;
+      default:
+        return false;
+      }
+    }
+
+    bool parseDictionaryV1(const size_t dictOffset) {
+      const uint8_t* fileData = m_file.data();
+      const size_t fileSize = m_file.size();
+
+      // Dictionary: asset and blob counts (16 bit each) followed by the descriptors
+      if (fileSize - dictOffset < 2 * sizeof(uint16_t)) {
+        return false;
+      }
+
+      const uint8_t* dictPtr = fileData + dictOffset;
+
+      uint16_t assetCount, blobCount;
+      memcpy(&assetCount, dictPtr, sizeof(assetCount));
+      memcpy(&blobCount, dictPtr + sizeof(assetCount), sizeof(blobCount));
+      dictPtr += sizeof(assetCount) + sizeof(blobCount);
+
+      const size_t dictSize =
+        assetCount * sizeof(AssetDesc) + blobCount * sizeof(BlobDesc);
+      const size_t nameTableOffset = (dictPtr - fileData) + dictSize;
+
+      if (nameTableOffset > fileSize) {
+        return false;
+      }
+
+      // The descriptors are unaligned in the file, keep an aligned copy of them
+      m_metadata.reset(new uint8_t[dictSize]);
+      memcpy(m_metadata.get(), dictPtr, dictSize);
+
+      m_assetCount = assetCount;
+      m_blobCount = blobCount;
+
+      // Each version 1 blob decodes as a single chunk
+      m_blobs.resize(m_blobCount);
+      m_chunks.resize(m_blobCount);
+
+      for (uint32_t n = 0; n < m_blobCount; n++) {
+        const BlobDesc* blobDesc = getDataBlobDesc(n);
+        if (blobDesc->offset > m_dataSize || m_dataSize - blobDesc->offset < blobDesc->size) {
+          return false;
+        }
+
+        m_blobs[n] = { blobDesc->size, n, 1 };
+
+        m_chunks[n] = {};
+        m_chunks[n].offset = blobDesc->offset;
+        m_chunks[n].compression = blobDesc->compression;
+        m_chunks[n].size = blobDesc->size;
+      }
+
+      return parseNames(nameTableOffset);
+    }
+
+    bool parseDictionaryV2(const size_t dictOffset) {
+      const uint8_t* fileData = m_file.data();
+      const size_t fileSize = m_file.size();
+
+      DictionaryV2 dict;
+      if (fileSize - dictOffset < sizeof(dict)) {
+        return false;
+      }
+
+      memcpy(&dict, fileData + dictOffset, sizeof(dict));
+
+      if (dict.chunkSize == 0 || dict.blobCount > UINT16_MAX + 1u) {
+        return false;
+      }
+
+      const size_t descOffset = dictOffset + sizeof(dict);
+      const size_t descSize = size_t(dict.assetCount) * sizeof(AssetDesc) +
+        size_t(dict.blobCount) * sizeof(BlobDescV2) + size_t(dict.chunkCount) * sizeof(ChunkDesc);
+
+      if (fileSize - descOffset < descSize) {
+        return false;
+      }
+
+      const uint8_t* assetsPtr = fileData + descOffset;
+      const uint8_t* blobsPtr = assetsPtr + size_t(dict.assetCount) * sizeof(AssetDesc);
+      const uint8_t* chunksPtr = blobsPtr + size_t(dict.blobCount) * sizeof(BlobDescV2);
+
+      m_assetCount = dict.assetCount;
+      m_blobCount = dict.blobCount;
+      m_chunkSize = dict.chunkSize;
+
+      m_chunks.resize(dict.chunkCount);
+      memcpy(m_chunks.data(), chunksPtr, size_t(dict.chunkCount) * sizeof(ChunkDesc));
+
+      for (const ChunkDesc& chunk : m_chunks) {
+        if (chunk.offset > m_dataSize || m_dataSize - chunk.offset < chunk.size) {
+          return false;
+        }
+      }
+
+      // Keep the version 1 view of the dictionary: asset descriptors followed by one
+      // blob descriptor spanning the stored bytes of each blob.
+      const size_t metadataSize = m_assetCount * sizeof(AssetDesc) + m_blobCount * sizeof(BlobDesc);
+      m_metadata.reset(new uint8_t[metadataSize]);
+      memcpy(m_metadata.get(), assetsPtr, m_assetCount * sizeof(AssetDesc));
+
+      BlobDesc* blobDescs = reinterpret_cast<BlobDesc*>(m_metadata.get() + m_assetCount * sizeof(AssetDesc));
+      m_blobs.resize(m_blobCount);
+
+      for (uint32_t n = 0; n < m_blobCount; n++) {
+        BlobDescV2 blobDesc;
+        memcpy(&blobDesc, blobsPtr + n * sizeof(BlobDescV2), sizeof(blobDesc));
+
+        const Compression compression = toCompression(blobDesc.compression);
+        const uint64_t expectedChunks = compression == Compression::GDeflate ? 1 :
+          (blobDesc.size + m_chunkSize - 1) / m_chunkSize;
+
+        if (blobDesc.numChunks != expectedChunks ||
+            blobDesc.firstChunk > m_chunks.size() ||
+            m_chunks.size() - blobDesc.firstChunk < blobDesc.numChunks) {
+          return false;
+        }
+
+        // Chunks of a blob are contiguous, which keeps placement() valid for RTX IO
+        uint64_t storedSize = 0;
+        for (uint32_t c = 0; c < blobDesc.numChunks; c++) {
+          const ChunkDesc& chunk = m_chunks[blobDesc.firstChunk + c];
+          if (chunk.offset != m_chunks[blobDesc.firstChunk].offset + storedSize) {
+            return false;
+          }
+          storedSize += chunk.size;
+        }
+
+        if (storedSize > UINT32_MAX) {
+          return false;
+        }
+
+        m_blobs[n] = { blobDesc.size, blobDesc.firstChunk, blobDesc.numChunks };
+
+        blobDescs[n] = {};
+        blobDescs[n].offset = blobDesc.numChunks ? m_chunks[blobDesc.firstChunk].offset : 0;
+        blobDescs[n].compression = blobDesc.compression;
+        blobDescs[n].flags = blobDesc.flags;
+        blobDescs[n].size = static_cast<uint32_t>(storedSize);
+      }
+
+      return parseNames(descOffset + descSize);
+    }
+
+    bool parseNames(const size_t nameTableOffset) {
+      const char* namesPtr = reinterpret_cast<const char*>(m_file.data() + nameTableOffset);
+      const char* namesEnd = reinterpret_cast<const char*>(m_file.data() + m_file.size());
+
+      for (uint32_t n = 0; n < m_assetCount; n++) {
+        const size_t nameLength = strnlen(namesPtr, namesEnd - namesPtr);
+        if (namesPtr + nameLength == namesEnd) {
+          return false;
+        }
+
+        m_nameHash.emplace(std::string(namesPtr, nameLength), n);
+        m_nameOffsets.push_back(namesPtr - reinterpret_cast<const char*>(m_file.data()));
+        namesPtr += nameLength + 1;
+      }
+
+      return true;
+    }
+
+    void reset() {
+      m_file.close();
+      m_metadata.reset();
+      m_blobs.clear();
+      m_chunks.clear();
+      m_nameHash.clear();
+      m_nameOffsets.clear();
+      m_version = 0;
+      m_assetCount = 0;
+      m_blobCount = 0;
+      m_chunkSize = 0;
+      m_dataSize = 0;
+    }
+
+    bool malformed() {
+      Logger::err(str::format("Malformed asset package ", m_filename));
+      reset();
+      return false;
+    }
+
     std::string m_filename;
-    FILE* m_handle = nullptr;
+    MappedFile m_file;
 
+    uint32_t m_version = 0;
     uint32_t m_assetCount = 0;
     uint32_t m_blobCount = 0;
+    uint32_t m_chunkSize = 0;
+    size_t m_dataSize = 0;
 
     std::unique_ptr<uint8_t[]> m_metadata;
+    std::vector<BlobInfo> m_blobs;
+    std::vector<ChunkDesc> m_chunks;
     std::unordered_map<std::string, uint32_t> m_nameHash;
+    std::vector<size_t> m_nameOffsets;
   };
 
 } // namespace dxvk
-
-#undef fseek64
-#ifndef WIN32
-#undef fopen_s
-#endif
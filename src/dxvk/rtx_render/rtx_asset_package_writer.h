@@ -0,0 +1,221 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <ppl.h>
+
+#include "rtx_asset_package.h"
+
+#ifdef WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+namespace dxvk {
+
+  // Streams a version 2 asset package to disk.
+  // Blobs are chunked and compressed as they are added (chunks of a blob in parallel),
+  // the dictionary and the name table are written by finish().
+  class AssetPackageWriter {
+  public:
+    using Compression = AssetPackage::Compression;
+
+    explicit AssetPackageWriter(uint32_t chunkSize = AssetPackage::kDefaultChunkSize)
+      : m_chunkSize { chunkSize } { }
+
+    ~AssetPackageWriter() {
+      if (m_handle) {
+        fclose(m_handle);
+      }
+    }
+
+    bool open(const std::string& filename) {
+      if (m_handle || m_chunkSize == 0) {
+        return false;
+      }
+
+      m_handle = fopen(filename.c_str(), "wb");
+      if (m_handle == nullptr) {
+        Logger::err(str::format("Unable to create package file ", filename));
+        return false;
+      }
+
+      // Patched with the dictionary offset once all blobs are written
+      const AssetPackage::Header header { AssetPackage::kMagic, AssetPackage::kVersion2, 0 };
+      return write(&header, sizeof(header));
+    }
+
+    // Splits the data in chunks and compresses every chunk that shrinks, returns the blob index.
+    uint32_t addBlob(const void* data, size_t size, Compression compression = Compression::LZ4) {
+      const uint8_t* src = static_cast<const uint8_t*>(data);
+      const uint32_t numChunks = static_cast<uint32_t>((size + m_chunkSize - 1) / m_chunkSize);
+
+      struct EncodedChunk {
+        std::vector<uint8_t> data;
+        Compression compression;
+      };
+
+      std::vector<EncodedChunk> encoded(numChunks);
+
+      auto encodeChunk = [&](uint32_t n) {
+        const size_t begin = size_t(n) * m_chunkSize;
+        const size_t chunkSize = std::min<size_t>(m_chunkSize, size - begin);
+
+        if (compression == Compression::LZ4) {
+          encoded[n].data.resize(lz4::compressBound(chunkSize));
+          const size_t compressedSize = lz4::compress(src + begin, chunkSize, encoded[n].data.data(), encoded[n].data.size());
+
+          if (compressedSize != 0 && compressedSize < chunkSize) {
+            encoded[n].data.resize(compressedSize);
+            encoded[n].compression = Compression::LZ4;
+            return;
+          }
+        }
+
+        encoded[n].data.assign(src + begin, src + begin + chunkSize);
+        encoded[n].compression = Compression::None;
+      };
+
+      if (numChunks > 3) {
+        concurrency::parallel_for<uint32_t>(0, numChunks, encodeChunk);
+      } else {
+        for (uint32_t n = 0; n < numChunks; n++) {
+          encodeChunk(n);
+        }
+      }
+
+      AssetPackage::BlobDescV2 blobDesc {};
+      blobDesc.size = size;
+      blobDesc.firstChunk = static_cast<uint32_t>(m_chunks.size());
+      blobDesc.numChunks = numChunks;
+      blobDesc.compression = static_cast<uint8_t>(compression);
+
+      for (const EncodedChunk& chunk : encoded) {
+        appendChunk(chunk.data.data(), chunk.data.size(), chunk.compression);
+      }
+
+      m_blobs.push_back(blobDesc);
+      return static_cast<uint32_t>(m_blobs.size() - 1);
+    }
+
+    // Adds a blob that was compressed for RTX IO as a single chunk, returns the blob index.
+    uint32_t addGDeflateBlob(const void* data, size_t storedSize) {
+      AssetPackage::BlobDescV2 blobDesc {};
+      blobDesc.size = storedSize;
+      blobDesc.firstChunk = static_cast<uint32_t>(m_chunks.size());
+      blobDesc.numChunks = 1;
+      blobDesc.compression = static_cast<uint8_t>(Compression::GDeflate);
+
+      appendChunk(data, storedSize, Compression::GDeflate);
+
+      m_blobs.push_back(blobDesc);
+      return static_cast<uint32_t>(m_blobs.size() - 1);
+    }
+
+    // Assets reference blobs by index, see AssetPackage::getMipBlobIndex() for the image layout.
+    uint32_t addAsset(const std::string& name, const AssetPackage::AssetDesc& assetDesc) {
+      m_assets.push_back(assetDesc);
+      m_assets.back().nameIdx = static_cast<uint16_t>(m_names.size());
+      m_names.push_back(name);
+      return static_cast<uint32_t>(m_assets.size() - 1);
+    }
+
+    uint32_t getBlobCount() const {
+      return static_cast<uint32_t>(m_blobs.size());
+    }
+
+    bool finish() {
+      if (m_handle == nullptr || m_failed || m_blobs.size() > UINT16_MAX + 1u) {
+        return false;
+      }
+
+      const uint64_t dictOffset = m_offset;
+
+      const AssetPackage::DictionaryV2 dict {
+        static_cast<uint32_t>(m_assets.size()),
+        static_cast<uint32_t>(m_blobs.size()),
+        static_cast<uint32_t>(m_chunks.size()),
+        m_chunkSize
+      };
+
+      write(&dict, sizeof(dict));
+      write(m_assets.data(), m_assets.size() * sizeof(AssetPackage::AssetDesc));
+      write(m_blobs.data(), m_blobs.size() * sizeof(AssetPackage::BlobDescV2));
+      write(m_chunks.data(), m_chunks.size() * sizeof(AssetPackage::ChunkDesc));
+
+      for (const std::string& name : m_names) {
+        write(name.c_str(), name.size() + 1);
+      }
+
+      const AssetPackage::Header header { AssetPackage::kMagic, AssetPackage::kVersion2, dictOffset };
+      if (0 != fseek64(m_handle, 0, SEEK_SET)) {
+        m_failed = true;
+      }
+      write(&header, sizeof(header));
+
+      const bool closed = fclose(m_handle) == 0;
+      m_handle = nullptr;
+
+      return closed && !m_failed;
+    }
+
+  private:
+    bool write(const void* data, size_t size) {
+      if (size != 0 && fwrite(data, 1, size, m_handle) != size) {
+        m_failed = true;
+      }
+
+      m_offset += size;
+      return !m_failed;
+    }
+
+    void appendChunk(const void* data, size_t size, Compression compression) {
+      AssetPackage::ChunkDesc chunkDesc {};
+      chunkDesc.offset = m_offset;
+      chunkDesc.compression = static_cast<uint8_t>(compression);
+      chunkDesc.size = static_cast<uint32_t>(size);
+      chunkDesc.crc32c = fast::crc32c(data, size);
+
+      m_chunks.push_back(chunkDesc);
+      write(data, size);
+    }
+
+    const uint32_t m_chunkSize;
+
+    FILE* m_handle = nullptr;
+    uint64_t m_offset = 0;
+    bool m_failed = false;
+
+    std::vector<AssetPackage::AssetDesc> m_assets;
+    std::vector<AssetPackage::BlobDescV2> m_blobs;
+    std::vector<AssetPackage::ChunkDesc> m_chunks;
+    std::vector<std::string> m_names;
+  };
+
+} // namespace dxvk
+
+#undef fseek64
@@ -157,14 +157,14 @@ namespace dxvk {
     mutable sync::Spinlock m_spinlock;
 
     // Replacements ready to be fed to the renderer
-    fast_unordered_cache<std::vector<AssetReplacement>> m_meshReplacers;
-    fast_unordered_cache<std::vector<AssetReplacement>> m_lightReplacers;
+    stable_unordered_cache<std::vector<AssetReplacement>> m_meshReplacers;
+    stable_unordered_cache<std::vector<AssetReplacement>> m_lightReplacers;
 
     // Replacement geometry storage
-    fast_unordered_cache<RasterGeometry> m_geometries;
+    stable_unordered_cache<RasterGeometry> m_geometries;
 
     // Replacement material storage
-    fast_unordered_cache<MaterialData> m_materials;
+    stable_unordered_cache<MaterialData> m_materials;
 
     // Secret replacements if any
     SecretReplacements m_secretReplacements;
@@ -597,7 +597,7 @@ endinject:
         (m_device->getCurrentFrameId() > m_terminateAppFrameNum) &&
         getSceneManager().isGameCapturerIdle()) {
       Logger::info(str::format("RTX: Terminating application"));
-      Metrics::serialize();
+      Metrics::flush();
       getCommonObjects()->metaExporter().waitForAllExportsToComplete();
 
       env::killProcess();
@@ -609,8 +609,17 @@ endinject:
 
   void RtxContext::updateMetrics(const float frameTimeSecs, const float gpuIdleTimeSecs) const {
     ScopedCpuProfileZone();
-    Metrics::log(Metric::average_frame_time, frameTimeSecs * 1000); // In milliseconds
-    Metrics::log(Metric::gpu_idle_ticks, gpuIdleTimeSecs * 1000); // In milliseconds
+
+    if (!Metrics::enabled())
+      return;
+
+    static const MetricId s_frameTime = Metrics::registerGauge("frame_time_ms");
+    static const MetricId s_gpuIdleTime = Metrics::registerGauge("gpu_idle_time_ms");
+    static const MetricId s_vidMemoryUsage = Metrics::registerGauge("vid_memory_usage_mb");
+    static const MetricId s_sysMemoryUsage = Metrics::registerGauge("sys_memory_usage_mb");
+
+    Metrics::set(s_frameTime, frameTimeSecs * 1000); // In milliseconds
+    Metrics::set(s_gpuIdleTime, gpuIdleTimeSecs * 1000); // In milliseconds
     uint64_t vidUsageMib = 0;
     uint64_t sysUsageMib = 0;
     // Calc memory usage
@@ -624,8 +633,10 @@ endinject:
         sysUsageMib += m_device->getMemoryStats(i).totalUsed() >> 20;
       }
     }
-    Metrics::log(Metric::vid_memory_usage, static_cast<float>(vidUsageMib)); // In MB
-    Metrics::log(Metric::sys_memory_usage, static_cast<float>(sysUsageMib)); // In MB
+    Metrics::set(s_vidMemoryUsage, static_cast<double>(vidUsageMib)); // In MB
+    Metrics::set(s_sysMemoryUsage, static_cast<double>(sysUsageMib)); // In MB
+
+    Metrics::endFrame(m_device->getCurrentFrameId());
   }
 
   void RtxContext::setClipPlanes(uint32_t enableMask, const Vector4 planes[MaxClipPlanes]) {
@@ -662,7 +673,7 @@ endinject:
     m_rtState.vsFixedFunctionCB = m_rc[vsFixedFunctionConstants].bufferSlice.buffer();
   }
 
-  void RtxContext::setSkinningData(std::shared_future<SkinningData> skinningData) {
+  void RtxContext::setSkinningData(Future<SkinningData> skinningData) {
     m_rtState.futureSkinningData = skinningData;
   }
 
@@ -834,7 +845,7 @@ endinject:
       }
 
       // Reset the future
-      m_rtState.futureSkinningData = std::shared_future<SkinningData>();
+      m_rtState.futureSkinningData = Future<SkinningData>();
     }
 
     if (!geoData.positionBuffer.defined()) {
@@ -917,7 +928,8 @@ endinject:
     originalMaterialData.textureAlphaOperation = m_rtState.texStage.alphaOperation;
     originalMaterialData.tFactor = m_rtState.legacyState.tFactor;
 
-    if (RtxOptions::Get()->shouldIgnoreTexture(originalMaterialData.getHash()))
+    const TextureCategoryIndex::Mask textureCategories = RtxOptions::Get()->getTextureCategories(originalMaterialData.getHash());
+    if (TextureCategoryIndex::has(textureCategories, TextureCategory::Ignore))
       return RtxGeometryStatus::Ignored;
 
     FogState& fogState = drawCallState.m_fogState;
@@ -936,7 +948,7 @@ endinject:
       }
     }
 
-    if (RtxOptions::Get()->isTerrainTexture(originalMaterialData.getHash())) {
+    if (TextureCategoryIndex::has(textureCategories, TextureCategory::Terrain)) {
       // When switching from one terrain layer to another, move the next layer up a bit.
       // One layer can be drawn in multiple draw calls, but they have the same materials. We don't want to shift terrain patches of the same layer.
       if (originalMaterialData.getHash() != m_lastTerrainMaterial && m_lastTerrainMaterial != 0)
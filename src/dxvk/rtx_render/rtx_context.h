@@ -137,7 +137,7 @@ namespace dxvk {
       *
       * \param [in] skinningData: shared future containing skinning data
       */
-    void setSkinningData(std::shared_future<SkinningData> skinningData);
+    void setSkinningData(Future<SkinningData> skinningData);
 
     /**
       * \brief Set legacy rendering state on the context
@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <float.h>
+#include <string.h>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+#include "../../util/util_matrix.h"
+#include "../../util/util_vector.h"
+#include "../../util/xxHash/xxhash.h"
+
+namespace dxvk {
+
+// The heuristics pairing a draw call with the BlasEntry and RtInstance it continues from previous
+// frames. They only depend on hashes, positions and frame indices, so the scene manager and the
+// draw call replay test run the same code.
+
+// The inputs of the matching heuristics, for a draw call or for the draw call that last touched a BlasEntry
+struct DrawCallMatchInputs {
+  XXH64_hash_t fullGeometryHash;
+  XXH64_hash_t vertexDataHash;
+  XXH64_hash_t positionHash;
+  XXH64_hash_t texcoordHash;
+  XXH64_hash_t materialHash;
+  XXH64_hash_t boneHash;
+  Vector3 worldPosition;
+  bool isSky;
+};
+
+// A BlasEntry of a DrawCallCache bucket, stored contiguously per bucket so that
+// candidates are matched without touching the BlasEntries themselves.
+struct DrawCallCandidate {
+  DrawCallMatchInputs inputs;
+  uint32_t frameLastTouched;
+  uint32_t handle;
+};
+
+inline bool isExactMatch(const DrawCallMatchInputs& drawCall, const DrawCallCandidate& candidate) {
+  if (drawCall.isSky != candidate.inputs.isSky)
+    return false;
+
+  return drawCall.materialHash == candidate.inputs.materialHash
+      && drawCall.fullGeometryHash == candidate.inputs.fullGeometryHash
+      && drawCall.boneHash == candidate.inputs.boneHash;
+}
+
+// Returns the candidate of a bucket to reuse for a draw call, or nullptr when it needs a new BlasEntry
+inline DrawCallCandidate* matchDrawCallCandidate(std::vector<DrawCallCandidate>& candidates, const DrawCallMatchInputs& drawCall, uint32_t currentFrame) {
+  // Handle buckets with 1 entry:
+  if (candidates.size() == 1) {
+    DrawCallCandidate& entry = candidates[0];
+
+    const bool updatedThisFrame = entry.frameLastTouched == currentFrame;
+    const bool vertexDataMatches = entry.inputs.vertexDataHash == drawCall.vertexDataHash;
+    const bool boneHashesMatch = entry.inputs.boneHash == drawCall.boneHash;
+    const bool materialHashesMatch = entry.inputs.materialHash == drawCall.materialHash;
+
+    if (isExactMatch(drawCall, entry) || !updatedThisFrame && (vertexDataMatches && boneHashesMatch || materialHashesMatch)) {
+      // Exact vertex match that is reusable for the current draw call,
+      // or something that hasn't been updated this frame and is similar enough.
+      // Matching the logic in the multi-element loop below.
+      return &entry;
+    }
+
+    // First frame of having two mismatching instances, and the first instance has already
+    // been paired with the existing BlasEntry.
+    return nullptr;
+  }
+
+  // Bucket has multiple BlasEntries
+
+  float bestScore = std::numeric_limits<float>::min();
+  DrawCallCandidate* best = nullptr;
+  for (DrawCallCandidate& blas : candidates) {
+    if (isExactMatch(drawCall, blas)) {
+      return &blas;
+    }
+    if (blas.frameLastTouched == currentFrame) {
+      continue;
+    }
+    // TODO these heuristics could use more refinement.
+    float score = 0;
+    if (blas.inputs.positionHash == drawCall.positionHash &&
+        blas.inputs.boneHash == drawCall.boneHash) {
+      score += 1000.f;
+    }
+    if (blas.inputs.texcoordHash == drawCall.texcoordHash) {
+      score += 1000.f;
+    }
+    if (blas.inputs.materialHash == drawCall.materialHash) {
+      score += 1000.f;
+    }
+    // TODO this is only checking the distance to the first instance that created the BlasEntry, not to
+    // each instance.  It also doesn't include the portal logic from InstanceManager.
+    score -= lengthSqr(drawCall.worldPosition - blas.inputs.worldPosition);
+    if (score > bestScore) {
+      bestScore = score;
+      best = &blas;
+    }
+  }
+  return best;
+}
+
+template<typename Instance>
+const Instance& derefInstance(const Instance& instance) { return instance; }
+template<typename Instance>
+const Instance& derefInstance(const Instance* instance) { return *instance; }
+
+// Returns the instance of a BLAS a draw call continues, or nullptr. Instances need getFrameLastUpdated(),
+// getMaterialHash(), getTransform() and getWorldPosition(), as RtInstance has. nearestDistSqr is set to
+// 0 when nothing closer can be found, so that InstanceManager only searches ray portals otherwise.
+template<typename Range>
+auto matchSimilarInstance(const Range& instances, const Matrix4& transform, XXH64_hash_t materialHash, uint32_t currentFrame, float uniqueObjectDistanceSqr, float& nearestDistSqr) -> decltype(&derefInstance(*std::begin(instances))) {
+  const Vector3 worldPosition = Vector3(transform[3][0], transform[3][1], transform[3][2]);
+
+  decltype(&derefInstance(*std::begin(instances))) similar = nullptr;
+  nearestDistSqr = FLT_MAX;
+
+  for (const auto& element : instances) {
+    const auto& instance = derefInstance(element);
+
+    if (instance.getFrameLastUpdated() == currentFrame) {
+      // If the transform is an exact match and the instance has already been touched this frame,
+      // then this is a second draw call on a single mesh.
+      const Matrix4 instanceTransform = instance.getTransform();
+      if (memcmp(&transform, &instanceTransform, sizeof(instanceTransform)) == 0) {
+        nearestDistSqr = 0.0f;
+        return &instance;
+      }
+    } else if (instance.getMaterialHash() == materialHash) {
+      // Instance hasn't been touched yet this frame.
+      const float distSqr = lengthSqr(instance.getWorldPosition() - worldPosition);
+      if (distSqr <= uniqueObjectDistanceSqr && distSqr < nearestDistSqr) {
+        nearestDistSqr = distSqr;
+        similar = &instance;
+
+        if (distSqr == 0.0f) {
+          // Not going to find anything closer.
+          break;
+        }
+      }
+    }
+  }
+
+  return similar;
+}
+
+}  // namespace dxvk
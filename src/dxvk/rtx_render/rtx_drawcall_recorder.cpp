@@ -0,0 +1,131 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "rtx_drawcall_recorder.h"
+#include "rtx_types.h"
+
+namespace dxvk {
+  namespace {
+    void copyMatrix(Vector4 (&rows)[4], const Matrix4& matrix) {
+      for (uint32_t i = 0; i < 4; i++) {
+        rows[i] = matrix[i];
+      }
+    }
+  }
+
+  bool DrawCallRecorder::isRecording() {
+    if (m_finished || numFrames() == 0) {
+      return false;
+    }
+
+    if (!m_writer.isOpen()) {
+      std::string filename = path();
+
+      if (!filename.empty() && filename.back() != '/' && filename.back() != '\\') {
+        filename += '/';
+      }
+
+      filename += "drawcalls.dcs";
+
+      if (!m_writer.open(filename)) {
+        Logger::err(str::format("DrawCallRecorder: Failed to create ", filename));
+        m_finished = true;
+        return false;
+      }
+
+      Logger::info(str::format("DrawCallRecorder: Recording ", numFrames(), " frames to ", filename));
+    }
+
+    return true;
+  }
+
+  void DrawCallRecorder::onDrawCall(const DrawCallState& drawCall) {
+    if (isRecording()) {
+      m_writer.addDraw(toRecord(drawCall));
+    }
+  }
+
+  void DrawCallRecorder::onFrameEnd(uint64_t frameId) {
+    if (!m_writer.isOpen()) {
+      return;
+    }
+
+    m_writer.endFrame(frameId);
+
+    if (m_writer.getFrameCount() >= numFrames()) {
+      const uint32_t frameCount = m_writer.getFrameCount();
+
+      if (m_writer.finish()) {
+        Logger::info(str::format("DrawCallRecorder: Recorded ", frameCount, " frames"));
+      } else {
+        Logger::err("DrawCallRecorder: Failed to write the draw call stream");
+      }
+
+      m_finished = true;
+    }
+  }
+
+  DrawCallStream::DrawRecord DrawCallRecorder::toRecord(const DrawCallState& drawCall) {
+    const RasterGeometry& geometry = drawCall.getGeometryData();
+    const LegacyMaterialData& material = drawCall.getMaterialData();
+    const DrawCallTransforms& transforms = drawCall.getTransformData();
+    const SkinningData& skinning = drawCall.getSkinningState();
+
+    DrawCallStream::DrawRecord record {};
+    record.hashes = geometry.hashes;
+    record.materialHash = material.getHash();
+    record.colorTextureHash = material.getColorTexture().getImageHash();
+    record.colorTexture2Hash = material.getColorTexture2().getImageHash();
+    record.boneHash = skinning.boneHash;
+
+    copyMatrix(record.objectToWorld, transforms.objectToWorld);
+    copyMatrix(record.objectToView, transforms.objectToView);
+    copyMatrix(record.worldToView, transforms.worldToView);
+    copyMatrix(record.viewToProjection, transforms.viewToProjection);
+    copyMatrix(record.textureTransform, transforms.textureTransform);
+    record.clipPlane = transforms.clipPlane;
+    record.boundingBoxMin = geometry.boundingBox.minPos;
+    record.boundingBoxMax = geometry.boundingBox.maxPos;
+
+    record.vertexCount = geometry.vertexCount;
+    record.indexCount = geometry.indexCount;
+    record.topology = geometry.topology;
+    record.cullMode = geometry.cullMode;
+    record.frontFace = geometry.frontFace;
+    record.indexType = geometry.indexBuffer.defined() ? geometry.indexBuffer.indexType() : VK_INDEX_TYPE_NONE_KHR;
+    record.positionFormat = geometry.positionBuffer.defined() ? geometry.positionBuffer.vertexFormat() : VK_FORMAT_UNDEFINED;
+    record.positionStride = geometry.positionBuffer.defined() ? geometry.positionBuffer.stride() : 0;
+    record.normalFormat = geometry.normalBuffer.defined() ? geometry.normalBuffer.vertexFormat() : VK_FORMAT_UNDEFINED;
+    record.texcoordFormat = geometry.texcoordBuffer.defined() ? geometry.texcoordBuffer.vertexFormat() : VK_FORMAT_UNDEFINED;
+    record.color0Format = geometry.color0Buffer.defined() ? geometry.color0Buffer.vertexFormat() : VK_FORMAT_UNDEFINED;
+    record.texgenMode = static_cast<uint32_t>(transforms.texgenMode);
+    record.numBones = skinning.numBones;
+    record.numBonesPerVertex = skinning.numBonesPerVertex;
+    record.fogMode = drawCall.getFogState().mode;
+
+    record.flags = (drawCall.getStencilEnabledState() ? DrawCallStream::StencilEnabled : 0)
+                 | (drawCall.getIsSky() ? DrawCallStream::Sky : 0)
+                 | (transforms.enableClipPlane ? DrawCallStream::ClipPlaneEnabled : 0)
+                 | (geometry.usesIndices() ? DrawCallStream::Indexed : 0);
+
+    return record;
+  }
+}
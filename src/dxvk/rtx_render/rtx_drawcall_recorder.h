@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "rtx_drawcall_stream.h"
+#include "rtx_option.h"
+
+namespace dxvk {
+  struct DrawCallState;
+
+  /**
+    * \brief Records the draw calls submitted to the scene manager.
+    *
+    *  Writes the metadata of every submitted DrawCallState for a number of frames to a
+    *  draw call stream, which the replay benchmark in tests/rtx/unit feeds back into the
+    *  CPU side of scene management with all GPU work stubbed out.
+    */
+  class DrawCallRecorder {
+  public:
+    RTX_OPTION("rtx.drawCallRecorder", uint32_t, numFrames, 0, "Number of frames of draw calls to record to a draw call stream file (drawcalls.dcs) once the runtime starts rendering, used to benchmark the CPU side of scene management offline. 0 disables recording.");
+    RTX_OPTION_ENV("rtx.drawCallRecorder", std::string, path, "", "DXVK_DRAWCALL_STREAM_PATH", "Directory to write the draw call stream to, the working directory is used when empty.");
+
+    void onDrawCall(const DrawCallState& drawCall);
+
+    void onFrameEnd(uint64_t frameId);
+
+    static DrawCallStream::DrawRecord toRecord(const DrawCallState& drawCall);
+
+  private:
+    DrawCallStreamWriter m_writer;
+    bool m_finished = false;
+
+    bool isRecording();
+  };
+}
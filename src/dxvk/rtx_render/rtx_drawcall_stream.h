@@ -0,0 +1,260 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+#include <stddef.h>
+
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "rtx_hashing.h"
+#include "../../util/log/log.h"
+#include "../../util/util_mapped_file.h"
+#include "../../util/util_string.h"
+#include "../../util/util_vector.h"
+
+namespace dxvk {
+
+  // Recorded stream of draw calls, as submitted to the scene manager, used to replay the
+  // CPU side of scene management without a GPU or a game.  Only the draw call metadata
+  // (hashes, counts, formats, transforms and material identity) is recorded, buffer
+  // contents are not.
+  //
+  // Layout: Header | (FrameHeader | DrawRecord[drawCount]) * frameCount
+  class DrawCallStream {
+  public:
+    static constexpr uint32_t kMagic = 0x54534344; // 'DCST'
+    static constexpr uint32_t kVersion = 1;
+
+    enum DrawFlags : uint32_t {
+      StencilEnabled = 1 << 0,
+      Sky = 1 << 1,
+      ClipPlaneEnabled = 1 << 2,
+      Indexed = 1 << 3,
+    };
+
+    struct Header {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t recordSize;
+      uint32_t frameCount;
+    };
+
+    struct FrameHeader {
+      uint64_t frameId;
+      uint32_t drawCount;
+      uint32_t reserved;
+    };
+
+    struct DrawRecord {
+      GeometryHashes hashes;
+      XXH64_hash_t materialHash;
+      XXH64_hash_t colorTextureHash;
+      XXH64_hash_t colorTexture2Hash;
+      XXH64_hash_t boneHash;
+
+      // Matrices are stored as rows, like Matrix4
+      Vector4 objectToWorld[4];
+      Vector4 objectToView[4];
+      Vector4 worldToView[4];
+      Vector4 viewToProjection[4];
+      Vector4 textureTransform[4];
+      Vector4 clipPlane;
+      Vector3 boundingBoxMin;
+      Vector3 boundingBoxMax;
+
+      uint32_t vertexCount;
+      uint32_t indexCount;
+      uint32_t topology;
+      uint32_t cullMode;
+      uint32_t frontFace;
+      uint32_t indexType;
+      uint32_t positionFormat;
+      uint32_t positionStride;
+      uint32_t normalFormat;
+      uint32_t texcoordFormat;
+      uint32_t color0Format;
+      uint32_t texgenMode;
+      uint32_t numBones;
+      uint32_t numBonesPerVertex;
+      uint32_t fogMode;
+      uint32_t flags;
+    };
+
+    static_assert(std::is_trivially_copyable_v<DrawRecord>, "Draw records must be serializable as is.");
+    static_assert(sizeof(DrawRecord) % 8 == 0, "Draw records must keep the stream 8 byte aligned.");
+
+    struct Frame {
+      uint64_t frameId;
+      const DrawRecord* draws;
+      uint32_t drawCount;
+    };
+  };
+
+  // Streams draw records to disk, one frame at a time
+  class DrawCallStreamWriter {
+  public:
+    ~DrawCallStreamWriter() {
+      finish();
+    }
+
+    bool open(const std::string& filename) {
+      m_file = std::ofstream(str::tows(filename.c_str()).c_str(), std::ios::binary);
+
+      if (!m_file) {
+        return false;
+      }
+
+      DrawCallStream::Header header {};
+      header.magic = DrawCallStream::kMagic;
+      header.version = DrawCallStream::kVersion;
+      header.recordSize = sizeof(DrawCallStream::DrawRecord);
+      m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      m_frameCount = 0;
+      return true;
+    }
+
+    bool isOpen() const {
+      return m_file.is_open();
+    }
+
+    void addDraw(const DrawCallStream::DrawRecord& record) {
+      m_draws.push_back(record);
+    }
+
+    void endFrame(uint64_t frameId) {
+      if (!isOpen()) {
+        return;
+      }
+
+      DrawCallStream::FrameHeader frame {};
+      frame.frameId = frameId;
+      frame.drawCount = static_cast<uint32_t>(m_draws.size());
+
+      m_file.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+      m_file.write(reinterpret_cast<const char*>(m_draws.data()), m_draws.size() * sizeof(DrawCallStream::DrawRecord));
+
+      m_draws.clear();
+      m_frameCount++;
+    }
+
+    uint32_t getFrameCount() const {
+      return m_frameCount;
+    }
+
+    // Patches the frame count into the header and closes the file, draws of an unfinished frame are discarded
+    bool finish() {
+      if (!isOpen()) {
+        return false;
+      }
+
+      m_file.seekp(offsetof(DrawCallStream::Header, frameCount));
+      m_file.write(reinterpret_cast<const char*>(&m_frameCount), sizeof(m_frameCount));
+
+      const bool result = m_file.good();
+      m_file.close();
+      m_draws.clear();
+      return result;
+    }
+
+  private:
+    std::ofstream m_file;
+    std::vector<DrawCallStream::DrawRecord> m_draws;
+    uint32_t m_frameCount = 0;
+  };
+
+  // Memory maps a recorded stream, draw records are accessed in place
+  class DrawCallStreamReader {
+  public:
+    bool open(const std::string& filename) {
+      m_frames.clear();
+
+      if (!m_file.open(filename)) {
+        Logger::err(str::format("Unable to open draw call stream ", filename));
+        return false;
+      }
+
+      const uint8_t* data = m_file.data();
+      const size_t size = m_file.size();
+
+      if (size < sizeof(DrawCallStream::Header)) {
+        return malformed(filename);
+      }
+
+      const auto* header = reinterpret_cast<const DrawCallStream::Header*>(data);
+
+      if (header->magic != DrawCallStream::kMagic) {
+        Logger::err(str::format("File ", filename, " is not a draw call stream."));
+        return false;
+      }
+
+      if (header->version != DrawCallStream::kVersion || header->recordSize != sizeof(DrawCallStream::DrawRecord)) {
+        Logger::err(str::format("Draw call stream ", filename, " version mismatch. "
+                                "Expected ", DrawCallStream::kVersion, ", got ", header->version, "."));
+        return false;
+      }
+
+      size_t offset = sizeof(DrawCallStream::Header);
+      m_frames.reserve(header->frameCount);
+
+      for (uint32_t n = 0; n < header->frameCount; n++) {
+        if (size - offset < sizeof(DrawCallStream::FrameHeader)) {
+          return malformed(filename);
+        }
+
+        const auto* frame = reinterpret_cast<const DrawCallStream::FrameHeader*>(data + offset);
+        offset += sizeof(DrawCallStream::FrameHeader);
+
+        if ((size - offset) / sizeof(DrawCallStream::DrawRecord) < frame->drawCount) {
+          return malformed(filename);
+        }
+
+        m_frames.push_back({ frame->frameId, reinterpret_cast<const DrawCallStream::DrawRecord*>(data + offset), frame->drawCount });
+        offset += frame->drawCount * sizeof(DrawCallStream::DrawRecord);
+      }
+
+      return true;
+    }
+
+    uint32_t getFrameCount() const {
+      return static_cast<uint32_t>(m_frames.size());
+    }
+
+    const DrawCallStream::Frame& getFrame(uint32_t idx) const {
+      return m_frames[idx];
+    }
+
+  private:
+    MappedFile m_file;
+    std::vector<DrawCallStream::Frame> m_frames;
+
+    bool malformed(const std::string& filename) {
+      Logger::err(str::format("Malformed draw call stream ", filename));
+      m_frames.clear();
+      m_file.close();
+      return false;
+    }
+  };
+
+}
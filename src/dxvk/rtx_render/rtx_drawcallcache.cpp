@@ -26,106 +26,106 @@ namespace dxvk
 {
 
 namespace {
-  bool exactMatch(const DrawCallState& drawCall, BlasEntry& blas) {
-    if (drawCall.getIsSky() != blas.input.getIsSky())
-      return false;
+  DrawCallMatchInputs getMatchInputs(const DrawCallState& drawCall) {
+    const RasterGeometry& geometryData = drawCall.getGeometryData();
+    const Matrix4& transform = drawCall.getTransformData().objectToWorld;
 
-    return drawCall.getMaterialData().getHash() == blas.input.getMaterialData().getHash()
-        && drawCall.getGeometryData().getHashForRule(rules::FullGeometryHash) == blas.input.getGeometryData().getHashForRule(rules::FullGeometryHash)
-        && drawCall.getSkinningState().boneHash == blas.input.getSkinningState().boneHash;
+    DrawCallMatchInputs inputs;
+    inputs.fullGeometryHash = geometryData.getHashForRule(rules::FullGeometryHash);
+    inputs.vertexDataHash = geometryData.getHashForRule(rules::VertexDataHash);
+    inputs.positionHash = geometryData.hashes[HashComponents::VertexPosition];
+    inputs.texcoordHash = geometryData.hashes[HashComponents::VertexTexcoord];
+    inputs.materialHash = drawCall.getMaterialData().getHash();
+    inputs.boneHash = drawCall.getSkinningState().boneHash;
+    inputs.worldPosition = Vector3(transform[3][0], transform[3][1], transform[3][2]);
+    inputs.isSky = drawCall.getIsSky();
+    return inputs;
   }
 }
 
 DrawCallCache::DrawCallCache(Rc<DxvkDevice> device) : m_device(device) {
-  m_entries.reserve(1024);
+  m_buckets.reserve(1024);
 }
 DrawCallCache::~DrawCallCache() {}
 
 DrawCallCache::CacheState DrawCallCache::get(const DrawCallState& drawCall, BlasEntry** out) {
+  refreshReturnedCandidate();
+
   // First, find the right bucket:
   const XXH64_hash_t hash = drawCall.getGeometryData().getHashForRule(rules::TopologicalHash);
-  auto range = m_entries.equal_range(hash);
-  if (range.first == m_entries.end()) {
+  auto bucketIter = m_buckets.find(hash);
+  if (bucketIter == m_buckets.end()) {
     // New bucket
     *out = allocateEntry(hash, drawCall);
     return CacheState::kNew;
   }
-  // Handle buckets with 1 entry:
-  auto iter = range.first;
-  iter++;
-  if (iter == range.second) {
-    // Only 1 element
-    BlasEntry& entry = range.first->second;
-
-    const bool updatedThisFrame = entry.frameLastTouched == m_device->getCurrentFrameId();
-    const bool vertexDataMatches = entry.input.getGeometryData().getHashForRule(rules::VertexDataHash) == drawCall.getGeometryData().getHashForRule(rules::VertexDataHash);
-    const bool boneHashesMatch = entry.input.getSkinningState().boneHash == drawCall.getSkinningState().boneHash;
-    const bool materialHashesMatch = entry.input.getMaterialData().getHash() == drawCall.getMaterialData().getHash();
-
-    if (exactMatch(drawCall, entry) || !updatedThisFrame && (vertexDataMatches && boneHashesMatch || materialHashesMatch)) {
-      // Exact vertex match that is reusable for the current draw call,
-      // or something that hasn't been updated this frame and is similar enough.
-      // Matching the logic in the multi-element loop below.
-      *out = &entry;
-      return CacheState::kExisted;
-    } else {
-      // First frame of having two mismatching instances, and the first instance has already 
-      // been paired with the existing BlasEntry.
-      *out = allocateEntry(hash, drawCall);
-      return CacheState::kNew;
-    }
-  }
-
-  // Bucket has multiple BlasEntries
 
-  float bestScore = std::numeric_limits<float>::min();
-  Matrix4 newTransform = drawCall.getTransformData().objectToWorld;
-  const Vector3 newWorldPosition = Vector3(newTransform[3][0], newTransform[3][1], newTransform[3][2]);
-  for (auto bucketIter = range.first; bucketIter != range.second; bucketIter++) {
-    BlasEntry& blas  = bucketIter->second;
-    if (exactMatch(drawCall, blas)) {
-      *out = &blas;
-      return CacheState::kExisted;
-    }
-    if (blas.frameLastTouched == m_device->getCurrentFrameId()) {
-      continue;
-    }
-    // TODO these heuristics could use more refinement.
-    float score = 0;
-    if (blas.modifiedGeometryData.hashes[HashComponents::VertexPosition] == drawCall.getGeometryData().hashes[HashComponents::VertexPosition] &&
-        blas.input.getSkinningState().boneHash == drawCall.getSkinningState().boneHash) {
-      score += 1000.f;
-    }
-    if (blas.modifiedGeometryData.hashes[HashComponents::VertexTexcoord] == drawCall.getGeometryData().hashes[HashComponents::VertexTexcoord]) {
-      score += 1000.f;
-    }
-    if (blas.input.getMaterialData().getHash() == drawCall.getMaterialData().getHash()) {
-      score += 1000.f;
-    }
-    // TODO this is only checking the distance to the first instance that created the BlasEntry, not to
-    // each instance.  It also doesn't include the portal logic from InstanceManager.
-    Matrix4 oldTransform = blas.input.getTransformData().objectToWorld;
-    const Vector3 worldPosition = Vector3(oldTransform[3][0], oldTransform[3][1], oldTransform[3][2]);
-    score -= lengthSqr(newWorldPosition - worldPosition);
-    if (score > bestScore) {
-      bestScore = score;
-      *out = &blas;
-    }
-  }
-  if (*out == nullptr) {
+  Candidate* candidate = matchDrawCallCandidate(bucketIter->second, getMatchInputs(drawCall), m_device->getCurrentFrameId());
+  if (candidate == nullptr) {
     // Failed to find similar blas, so allocate a new one
     *out = allocateEntry(hash, drawCall);
     return CacheState::kNew;
   }
+  *out = returnCandidate(*candidate);
   return CacheState::kExisted;
+}
+
+void DrawCallCache::clear() {
+  m_returnedCandidate = nullptr;
+  m_buckets.clear();
+  m_entryChunks.clear();
+  m_freeHandles.clear();
+}
 
+void DrawCallCache::refreshReturnedCandidate() {
+  if (m_returnedCandidate == nullptr) {
+    return;
+  }
+
+  Candidate& candidate = *m_returnedCandidate;
+  const BlasEntry& entry = getEntry(candidate.handle);
+
+  // The modified geometry is what the entry's BLAS was built from
+  candidate.inputs = getMatchInputs(entry.input);
+  candidate.inputs.positionHash = entry.modifiedGeometryData.hashes[HashComponents::VertexPosition];
+  candidate.inputs.texcoordHash = entry.modifiedGeometryData.hashes[HashComponents::VertexTexcoord];
+  candidate.frameLastTouched = entry.frameLastTouched;
+
+  m_returnedCandidate = nullptr;
+}
+
+BlasEntry* DrawCallCache::returnCandidate(Candidate& candidate) {
+  // Nothing else touches the buckets until the next access, so the pointer stays valid until then
+  m_returnedCandidate = &candidate;
+  return &getEntry(candidate.handle);
 }
 
 BlasEntry* DrawCallCache::allocateEntry(XXH64_hash_t hash, const DrawCallState& drawCall) {
-  auto& iter = m_entries.emplace(hash, drawCall);
-  BlasEntry* result = &iter->second;
+  if (m_freeHandles.empty()) {
+    const uint32_t firstHandle = static_cast<uint32_t>(m_entryChunks.size()) * kEntriesPerChunk;
+    m_entryChunks.emplace_back(std::make_unique<std::optional<BlasEntry>[]>(kEntriesPerChunk));
+
+    for (uint32_t i = kEntriesPerChunk; i > 0; i--) {
+      m_freeHandles.push_back(firstHandle + i - 1);
+    }
+  }
+
+  const uint32_t handle = m_freeHandles.back();
+  m_freeHandles.pop_back();
+
+  BlasEntry* result = &m_entryChunks[handle / kEntriesPerChunk][handle % kEntriesPerChunk].emplace(drawCall);
   result->frameCreated = m_device->getCurrentFrameId();
+
+  std::vector<Candidate>& candidates = m_buckets[hash];
+  candidates.push_back(Candidate {});
+  candidates.back().handle = handle;
+  returnCandidate(candidates.back());
   return result;
 }
 
+void DrawCallCache::freeEntry(uint32_t handle) {
+  m_entryChunks[handle / kEntriesPerChunk][handle % kEntriesPerChunk].reset();
+  m_freeHandles.push_back(handle);
+}
+
 }  // namespace nvvk
@@ -21,14 +21,18 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <limits>
-#include <unordered_map>
 
+#include "../util/util_flat_hash_map.h"
 #include "../util/util_vector.h"
 #include "dxvk_scoped_annotation.h"
 
 #include "rtx_types.h"
+#include "rtx_drawcall_matching.h"
 #include <d3d9types.h>
 
 namespace dxvk 
@@ -53,18 +57,69 @@ public:
 
   CacheState get(const DrawCallState& drawCall, BlasEntry** out);
 
-  std::unordered_multimap<XXH64_hash_t, BlasEntry>& getEntries() {return m_entries;}
+  // Calls fn(BlasEntry&) for every entry
+  template<typename Fn>
+  void forEach(const Fn& fn) {
+    refreshReturnedCandidate();
 
-  void clear() {
-    m_entries.clear();
+    for (auto& bucket : m_buckets) {
+      for (const Candidate& candidate : bucket.second) {
+        fn(getEntry(candidate.handle));
+      }
+    }
   }
 
+  // Erases every entry for which pred(topologicalHash, BlasEntry&) returns true
+  template<typename Pred>
+  void eraseIf(const Pred& pred) {
+    refreshReturnedCandidate();
+
+    for (auto bucketIter = m_buckets.begin(); bucketIter != m_buckets.end(); ) {
+      std::vector<Candidate>& candidates = bucketIter->second;
+
+      candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const Candidate& candidate) {
+        if (!pred(bucketIter->first, getEntry(candidate.handle))) {
+          return false;
+        }
+
+        freeEntry(candidate.handle);
+        return true;
+      }), candidates.end());
+
+      if (candidates.empty()) {
+        bucketIter = m_buckets.erase(bucketIter);
+      } else {
+        ++bucketIter;
+      }
+    }
+  }
+
+  void clear();
+
 private:
-  std::unordered_multimap<XXH64_hash_t, BlasEntry> m_entries;
+  using Candidate = DrawCallCandidate;
+
+  // Entries live in fixed size chunks, a handle is the index of an entry's slot
+  static constexpr uint32_t kEntriesPerChunk = 256;
+  std::vector<std::unique_ptr<std::optional<BlasEntry>[]>> m_entryChunks;
+  std::vector<uint32_t> m_freeHandles;
+
+  // Candidates of each bucket, keyed by topological hash
+  FlatHashMap<XXH64_hash_t, std::vector<Candidate>, XXH64_hash_passthrough> m_buckets;
+
+  // The caller updates the entry returned by get(), its candidate is refreshed on the next access
+  Candidate* m_returnedCandidate = nullptr;
 
   Rc<DxvkDevice> m_device;
 
+  BlasEntry& getEntry(uint32_t handle) {
+    return *m_entryChunks[handle / kEntriesPerChunk][handle % kEntriesPerChunk];
+  }
+
+  void refreshReturnedCandidate();
+  BlasEntry* returnCandidate(Candidate& candidate);
   BlasEntry* allocateEntry(XXH64_hash_t hash, const DrawCallState& drawCall);
+  void freeEntry(uint32_t handle);
 };
 
 }  // namespace nvvk
@@ -35,6 +35,7 @@
 #include "../../util/log/log.h"
 #include "../../util/config/config.h"
 #include "../../util/util_window.h"
+#include "../../util/util_fastops.h"
 
 #include "../../lssusd/usd_include_begin.h"
 #include <pxr/base/gf/matrix4f.h>
@@ -459,8 +460,6 @@ void GameCapturer::captureMeshPositions(const Rc<DxvkContext> ctx,
   AssetExporter::BufferCallback captureMeshPositionsAsync = [ctx, geomData, currentFrameNum, pMesh](Rc<DxvkBuffer> posBuf) {
     // Prep helper vars
     const size_t numVertices = geomData.vertexCount;
-    constexpr size_t positionSubElementSize = sizeof(float);
-    const size_t positionStride = geomData.positionBuffer.stride() / positionSubElementSize;
     const DxvkBufferSlice positionBuffer(posBuf, 0, posBuf->info().size);
     // Ensure no reads are out of bounds
     assert(((size_t)(numVertices - 1) * (size_t)geomData.positionBuffer.stride() + sizeof(pxr::GfVec3f)) <=
@@ -469,17 +468,13 @@ void GameCapturer::captureMeshPositions(const Rc<DxvkContext> ctx,
     const float* pVkPosBuf = (float*)positionBuffer.mapPtr((size_t)geomData.positionBuffer.offsetFromSlice());
     assert(pVkPosBuf);
     // Copy GPU buffer to local VtArray
-    pxr::VtArray<pxr::GfVec3f> positions;
-    positions.reserve(numVertices);
-    for (size_t idx = 0; idx < numVertices; ++idx) {
-      positions.push_back(pxr::GfVec3f(&pVkPosBuf[idx * positionStride]));
-    }
+    pxr::VtArray<pxr::GfVec3f> positions(numVertices);
+    fast::deinterleaveFloats(positions.data()->data(), pVkPosBuf, geomData.positionBuffer.stride(), 3, numVertices);
     assert(positions.size() > 0);
-    // Create comparison function that returns float
-    static auto positionsDifferentEnough = [](const pxr::GfVec3f& a, const pxr::GfVec3f& b) {
+    // Create comparison function that returns whether any position moved far enough
+    static auto positionsDifferentEnough = [](const pxr::VtArray<pxr::GfVec3f>& a, const pxr::VtArray<pxr::GfVec3f>& b) {
       const static float captureMeshPositionDelta = RtxOptions::Get()->getCaptureMeshPositionDelta();
-      const static float captureMeshPositionDeltaSq = captureMeshPositionDelta * captureMeshPositionDelta;
-      return (a - b).GetLengthSq() > captureMeshPositionDeltaSq;
+      return fast::anyDeltaExceeds(a.cdata()->data(), b.cdata()->data(), a.size(), 3, captureMeshPositionDelta);
     };
     // Cache buffer iff new buffer differs from previous buffer
     evalNewBufferAndCache(pMesh, pMesh->lssData.buffers.positionBufs, positions, currentFrameNum, positionsDifferentEnough);
@@ -497,8 +492,6 @@ void GameCapturer::captureMeshNormals(const Rc<DxvkContext> ctx,
     assert(geomData.normalBuffer.vertexFormat() == VK_FORMAT_R32G32B32_SFLOAT);
     // Prep helper vars
     const size_t numVertices = geomData.vertexCount;
-    constexpr size_t normalSubElementSize = sizeof(float);
-    const size_t normalStride = geomData.normalBuffer.stride() / normalSubElementSize;
     const DxvkBufferSlice normalBuffer(norBuf, 0, norBuf->info().size );
     // Ensure no reads are out of bounds
     assert(((size_t)(numVertices - 1) * (size_t)geomData.normalBuffer.stride() + sizeof(pxr::GfVec3f)) <=
@@ -507,17 +500,13 @@ void GameCapturer::captureMeshNormals(const Rc<DxvkContext> ctx,
     const float* pVkNormalBuf = (float*)normalBuffer.mapPtr((size_t)geomData.normalBuffer.offsetFromSlice());
     assert(pVkNormalBuf);
     // Copy GPU buffer to local VtArray
-    pxr::VtArray<pxr::GfVec3f> normals;
-    normals.reserve(numVertices);
-    for (size_t idx = 0; idx < numVertices; ++idx) {
-      normals.push_back(pxr::GfVec3f(&pVkNormalBuf[idx * normalStride]));
-    }
+    pxr::VtArray<pxr::GfVec3f> normals(numVertices);
+    fast::deinterleaveFloats(normals.data()->data(), pVkNormalBuf, geomData.normalBuffer.stride(), 3, numVertices);
     assert(normals.size() > 0);
-    // Create comparison function that returns float
-    static auto normalsDifferentEnough = [](const pxr::GfVec3f& a, const pxr::GfVec3f& b) {
+    // Create comparison function that returns whether any normal changed enough
+    static auto normalsDifferentEnough = [](const pxr::VtArray<pxr::GfVec3f>& a, const pxr::VtArray<pxr::GfVec3f>& b) {
       const static float captureMeshNormalDelta = RtxOptions::Get()->getCaptureMeshNormalDelta();
-      const static float captureMeshNormalDeltaSq = captureMeshNormalDelta * captureMeshNormalDelta;
-      return (a - b).GetLengthSq() > captureMeshNormalDeltaSq;
+      return fast::anyDeltaExceeds(a.cdata()->data(), b.cdata()->data(), a.size(), 3, captureMeshNormalDelta);
     };
     // Cache buffer iff new buffer differs from previous buffer
     evalNewBufferAndCache(pMesh, pMesh->lssData.buffers.normalBufs, normals, currentFrameNum, normalsDifferentEnough);
@@ -534,9 +523,8 @@ static void getIndicesFromVK(const size_t numIndices, const DxvkBufferSlice& ind
   // Get copied-to-CPU GPU buffer
   const T* pVkIndexBuf = (T*) indexBuffer.mapPtr(0);
   assert(pVkIndexBuf);
-  for (size_t idx = 0; idx < numIndices; ++idx) {
-    indices.push_back(pVkIndexBuf[idx]);
-  }
+  indices.resize(numIndices);
+  fast::widenIndices<T>(reinterpret_cast<uint32_t*>(indices.data()), pVkIndexBuf, numIndices);
 }
 
 void GameCapturer::captureMeshIndices(const Rc<DxvkContext> ctx,
@@ -549,7 +537,6 @@ void GameCapturer::captureMeshIndices(const Rc<DxvkContext> ctx,
     const DxvkBufferSlice indexBuffer(idxBuf, 0, idxBuf->info().size);
     // Copy GPU buffer to local VtArray
     pxr::VtArray<int> indices;
-    indices.reserve(numIndices);
 
     switch (geomData.indexBuffer.indexType()) {
     case VK_INDEX_TYPE_UINT16:
@@ -562,9 +549,9 @@ void GameCapturer::captureMeshIndices(const Rc<DxvkContext> ctx,
       assert(0);
     }
     assert(indices.size() > 0);
-    // Create comparison function that returns float
-    static auto differentIndices = [](const int a, const int b) {
-      return a != b;
+    // Create comparison function that returns whether any index changed
+    static auto differentIndices = [](const pxr::VtArray<int>& a, const pxr::VtArray<int>& b) {
+      return memcmp(a.cdata(), b.cdata(), a.size() * sizeof(int)) != 0;
     };
     // Cache buffer iff new buffer differs from previous buffer
     evalNewBufferAndCache(pMesh, pMesh->lssData.buffers.idxBufs, indices, currentFrameNum, differentIndices);
@@ -583,8 +570,6 @@ void GameCapturer::captureMeshTexCoords(const Rc<DxvkContext> ctx,
            geomData.texcoordBuffer.vertexFormat() == VK_FORMAT_R32G32B32_SFLOAT);
     // Prep helper vars
     const size_t numVertices = geomData.vertexCount;
-    constexpr size_t texcoordSubElementSize = sizeof(float);
-    const size_t texcoordStride = geomData.texcoordBuffer.stride() / texcoordSubElementSize;
     const DxvkBufferSlice texcoordBuffer(texBuf, 0, texBuf->info().size );
     // Ensure no reads are out of bounds
     assert(((size_t)(numVertices - 1) * (size_t)geomData.texcoordBuffer.stride() + sizeof(pxr::GfVec2f)) <=
@@ -592,19 +577,17 @@ void GameCapturer::captureMeshTexCoords(const Rc<DxvkContext> ctx,
     // Get copied-to-CPU GPU buffer
     const float* pVkTexcoordsBuf = (float*)texcoordBuffer.mapPtr((size_t)geomData.texcoordBuffer.offsetFromSlice());
     assert(pVkTexcoordsBuf);
-    // Copy GPU buffer to local VtArray
-    pxr::VtArray<pxr::GfVec2f> texcoords;
-    texcoords.reserve(numVertices);
-    for (size_t idx = 0; idx < numVertices; ++idx) {
-      texcoords.push_back(pxr::GfVec2f(       pVkTexcoordsBuf[idx * texcoordStride],
-                                       1.0f - pVkTexcoordsBuf[idx * texcoordStride + 1]));
+    // Copy GPU buffer to local VtArray, flipping V
+    pxr::VtArray<pxr::GfVec2f> texcoords(numVertices);
+    fast::deinterleaveFloats(texcoords.data()->data(), pVkTexcoordsBuf, geomData.texcoordBuffer.stride(), 2, numVertices);
+    for (pxr::GfVec2f& texcoord : texcoords) {
+      texcoord[1] = 1.0f - texcoord[1];
     }
     assert(texcoords.size() > 0);
-    // Create comparison function that returns float
-    static auto differentIndices = [](const pxr::GfVec2f& a, const pxr::GfVec2f& b) {
+    // Create comparison function that returns whether any texcoord changed enough
+    static auto differentIndices = [](const pxr::VtArray<pxr::GfVec2f>& a, const pxr::VtArray<pxr::GfVec2f>& b) {
       const static float captureMeshTexcoordDelta = RtxOptions::Get()->getCaptureMeshTexcoordDelta();
-      const static float captureMeshTexcoordDeltaSq = captureMeshTexcoordDelta * captureMeshTexcoordDelta;
-      return (a - b).GetLengthSq() > captureMeshTexcoordDeltaSq;
+      return fast::anyDeltaExceeds(a.cdata()->data(), b.cdata()->data(), a.size(), 2, captureMeshTexcoordDelta);
     };
     // Cache buffer iff new buffer differs from previous buffer
     evalNewBufferAndCache(pMesh, pMesh->lssData.buffers.texcoordBufs, texcoords, currentFrameNum, differentIndices);
@@ -632,19 +615,18 @@ void GameCapturer::captureMeshColor(const Rc<DxvkContext> ctx,
     const uint8_t* pVkColorBuf = (uint8_t*)colorBuffer.mapPtr((size_t)geomData.color0Buffer.offsetFromSlice());
     assert(pVkColorBuf);
     // Copy GPU buffer to local VtArray
-    pxr::VtArray<pxr::GfVec3f> colors;
-    colors.reserve(numVertices);
+    pxr::VtArray<pxr::GfVec3f> colors(numVertices);
+    pxr::GfVec3f* pColors = colors.data();
     for (size_t idx = 0; idx < numVertices; ++idx) {
-      colors.push_back(pxr::GfVec3f((float)pVkColorBuf[idx * colorStride + 2] / 256.f,
-                                    (float)pVkColorBuf[idx * colorStride + 1] / 256.f,
-                                    (float)pVkColorBuf[idx * colorStride + 0] / 256.f));
+      pColors[idx] = pxr::GfVec3f((float)pVkColorBuf[idx * colorStride + 2] / 256.f,
+                                  (float)pVkColorBuf[idx * colorStride + 1] / 256.f,
+                                  (float)pVkColorBuf[idx * colorStride + 0] / 256.f);
     }
     assert(colors.size() > 0);
-    // Create comparison function that returns float
-    static auto colorsDifferentEnough = [](const pxr::GfVec3f& a, const pxr::GfVec3f& b) {
+    // Create comparison function that returns whether any color changed enough
+    static auto colorsDifferentEnough = [](const pxr::VtArray<pxr::GfVec3f>& a, const pxr::VtArray<pxr::GfVec3f>& b) {
       const static float captureMeshColorDelta = RtxOptions::Get()->getCaptureMeshColorDelta();
-      const static float captureMeshColorDeltaSq = captureMeshColorDelta * captureMeshColorDelta;
-      return (a - b).GetLengthSq() > captureMeshColorDeltaSq;
+      return fast::anyDeltaExceeds(a.cdata()->data(), b.cdata()->data(), a.size(), 3, captureMeshColorDelta);
     };
     // Cache buffer iff new buffer differs from previous buffer
     evalNewBufferAndCache(pMesh, pMesh->lssData.buffers.colorBufs, colors, currentFrameNum, colorsDifferentEnough);
@@ -653,27 +635,20 @@ void GameCapturer::captureMeshColor(const Rc<DxvkContext> ctx,
   m_exporter.copyBufferFromGPU(ctx, geomData.color0Buffer, captureMeshColorAsync);
 }
 
-template <typename T, typename CompareTReturnBool>
+template <typename T, typename CompareBuffersReturnBool>
 static void GameCapturer::evalNewBufferAndCache(std::shared_ptr<Mesh> pMesh,
                                                 std::map<float,pxr::VtArray<T>>& bufferCache,
                                                 pxr::VtArray<T>& newBuffer,
                                                 const float currentFrameNum,
-                                                CompareTReturnBool compareT) {
+                                                CompareBuffersReturnBool differentEnough) {
   std::lock_guard lock(pMesh->meshSync.mutex);
   // Discover whether the new buffer is worth cacheing
   bool bSufficientlyDifferent = false;
   if(bufferCache.size() > 0) {
     const auto& prevBuf = (--bufferCache.cend())->second;
     assert(newBuffer.size() == prevBuf.size());
-    for(size_t idx = 0; idx < newBuffer.size(); ++idx) {
-      const T& newVal = newBuffer[idx];
-      const T& prevVal = prevBuf[idx];
-      bSufficientlyDifferent = compareT(newVal, prevVal);
-      if(bSufficientlyDifferent) {
-        // Early out as soon as we've found enough of a difference
-        break;
-      }
-    }
+    // Early outs as soon as it finds enough of a difference
+    bSufficientlyDifferent = differentEnough(newBuffer, prevBuf);
   } else {
     bSufficientlyDifferent = true;
   }
@@ -759,9 +734,11 @@ void GameCapturer::prepExportMetaData(const Capture& cap,
   exportPrep.meta.startTimeCode = 0.0;
   exportPrep.meta.endTimeCode = floor(static_cast<double>(cap.currentFrameNum));
   exportPrep.meta.numFramesCaptured = cap.numFramesCaptured;
+  exportPrep.meta.numExportThreads = RtxOptions::Get()->captureExportThreads();
   window::saveWindowIconToFile(exportPrep.meta.iconPath);
   exportPrep.meta.bUseLssUsdPlugins = bUseLssUsdPlugins;
   exportPrep.meta.bReduceMeshBuffers = true;
+  exportPrep.meta.bDedupTimeSamples = RtxOptions::Get()->captureDedupTimeSamples();
   exportPrep.meta.isZUp = RtxOptions::Get()->isZUp();
   exportPrep.meta.isLHS = RtxOptions::Get()->isLHS();
   exportPrep.debugId = cap.idStr;
@@ -151,12 +151,12 @@ private:
                         const RaytraceGeometry& geomData,
                         const float currentCaptureTime,
                         std::shared_ptr<Mesh> pMesh);
-  template <typename T, typename CompareTReturnBool>
+  template <typename T, typename CompareBuffersReturnBool>
   static void evalNewBufferAndCache(std::shared_ptr<Mesh> pMesh,
                                     std::map<float,pxr::VtArray<T>>& bufferCache,
                                     pxr::VtArray<T>& newBuffer,
                                     const float currentCaptureTime,
-                                    CompareTReturnBool compareT);
+                                    CompareBuffersReturnBool differentEnough);
   void exportStep();
   struct Capture;
   static lss::Export prepExport(const Capture& cap,
@@ -0,0 +1,299 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "rtx_geometry_hash_cache.h"
+#include "rtx_options.h"
+#include "dxvk_scoped_annotation.h"
+
+#include "../../util/util_env.h"
+#include "../../util/util_once.h"
+
+namespace dxvk {
+  // Number of elements sampled from each buffer when fingerprinting
+  static constexpr uint32_t kFingerprintSamples = 16;
+  // Size of each window sampled from index data when fingerprinting
+  static constexpr size_t kFingerprintIndexWindow = 64;
+  // Hits since validation of an entry due for a check on its next hit
+  static constexpr uint32_t kValidationDue = ~0u;
+
+  GeometryHashCache::~GeometryHashCache() {
+    if (!m_initialized) {
+      return;
+    }
+
+    logStatistics();
+    writeFile();
+  }
+
+  void GeometryHashCache::initialize() {
+    if (m_initialized) {
+      return;
+    }
+
+    m_initialized = true;
+
+    const std::string fileName = getFileName();
+    if (!m_file.open(fileName)) {
+      Logger::info(str::format("[RTX] Geometry hash cache not found, creating new cache: ", fileName));
+      return;
+    }
+
+    const FileHeader* pHeader = reinterpret_cast<const FileHeader*>(m_file.data());
+    if (m_file.size() < sizeof(FileHeader) ||
+        pHeader->magic != kMagic ||
+        pHeader->version != kVersion ||
+        m_file.size() != sizeof(FileHeader) + pHeader->entryCount * sizeof(FileEntry)) {
+      Logger::warn(str::format("[RTX] Geometry hash cache is invalid or out of date, discarding: ", fileName));
+      m_file.close();
+      return;
+    }
+
+    m_fileEntries = reinterpret_cast<const FileEntry*>(m_file.data() + sizeof(FileHeader));
+    m_fileEntryCount = pHeader->entryCount;
+
+    Logger::info(str::format("[RTX] Geometry hash cache loaded ", m_fileEntryCount, " entries from: ", fileName));
+  }
+
+  XXH64_hash_t GeometryHashCache::computeFingerprint(const HashQuery* regions, const uint32_t regionCount,
+                                                     const void* pIndexData, const size_t indexDataSize,
+                                                     const uint32_t maxIndexValue) {
+    ScopedCpuProfileZone();
+
+    // Anything that changes the hash output must be part of the key
+    const uint32_t hashRule = RtxOptions::Get()->GeometryHashGenerationRule.raw();
+    const float meterToWorldUnitScale = RtxOptions::Get()->getMeterToWorldUnitScale();
+
+    XXH64_hash_t h = XXH3_64bits(&kVersion, sizeof(kVersion));
+    h = XXH3_64bits_withSeed(&hashRule, sizeof(hashRule), h);
+    h = XXH3_64bits_withSeed(&meterToWorldUnitScale, sizeof(meterToWorldUnitScale), h);
+    h = XXH3_64bits_withSeed(&maxIndexValue, sizeof(maxIndexValue), h);
+    h = XXH3_64bits_withSeed(&indexDataSize, sizeof(indexDataSize), h);
+
+    for (uint32_t r = 0; r < regionCount; r++) {
+      const HashQuery& region = regions[r];
+      const size_t layout[] = { region.size, region.stride, region.elementSize };
+      h = XXH3_64bits_withSeed(&layout[0], sizeof(layout), h);
+
+      if (region.size == 0 || region.stride == 0) {
+        continue;
+      }
+
+      // Sample elements evenly across the region, always including the first and last
+      const size_t elementCount = (region.size + region.stride - 1) / region.stride;
+      const size_t sampleCount = std::min<size_t>(elementCount, kFingerprintSamples);
+      for (size_t s = 0; s < sampleCount; s++) {
+        const size_t element = sampleCount > 1 ? (elementCount - 1) * s / (sampleCount - 1) : 0;
+        h = XXH3_64bits_withSeed(region.pBase + element * region.stride, region.elementSize, h);
+      }
+    }
+
+    if (pIndexData != nullptr && indexDataSize > 0) {
+      const uint8_t* pIndexBytes = static_cast<const uint8_t*>(pIndexData);
+      if (indexDataSize <= kFingerprintSamples * kFingerprintIndexWindow) {
+        h = XXH3_64bits_withSeed(pIndexBytes, indexDataSize, h);
+      } else {
+        const size_t lastWindow = indexDataSize - kFingerprintIndexWindow;
+        for (size_t s = 0; s < kFingerprintSamples; s++) {
+          const size_t offset = lastWindow * s / (kFingerprintSamples - 1);
+          h = XXH3_64bits_withSeed(pIndexBytes + offset, kFingerprintIndexWindow, h);
+        }
+      }
+    }
+
+    return h;
+  }
+
+  GeometryHashCache::LookupResult GeometryHashCache::lookup(const XXH64_hash_t fingerprint, GeometryHashes& hashesOut) {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    auto overlayIt = m_overlay.find(fingerprint);
+    if (overlayIt == m_overlay.end()) {
+      const FileEntry* pEntry = findInFile(fingerprint);
+      if (pEntry == nullptr) {
+        ++m_misses;
+        return LookupResult::Miss;
+      }
+
+      // Served right away, the first hit checks the entry against the data of this session
+      overlayIt = m_overlay.emplace(fingerprint, OverlayEntry { pEntry->hashes, kValidationDue }).first;
+    }
+
+    OverlayEntry& entry = overlayIt->second;
+    if (entry.evicted) {
+      ++m_misses;
+      return LookupResult::Miss;
+    }
+
+    ++m_hits;
+    hashesOut = entry.hashes;
+
+    // The fingerprint only samples the data, so hits are periodically hashed in full to catch changes it missed
+    if (entry.hitsSinceValidation >= std::max(revalidationInterval(), 1u)) {
+      if (!entry.validating) {
+        entry.validating = true;
+        ++m_validations;
+        return LookupResult::HitValidate;
+      }
+    } else {
+      ++entry.hitsSinceValidation;
+    }
+
+    return LookupResult::Hit;
+  }
+
+  void GeometryHashCache::insert(const XXH64_hash_t fingerprint, const GeometryHashes& hashes) {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    auto [overlayIt, inserted] = m_overlay.try_emplace(fingerprint);
+    if (inserted) {
+      overlayIt->second.hashes = hashes;
+      return;
+    }
+
+    // Another draw with this fingerprint was hashed in the meantime
+    checkEntry(overlayIt->second, hashes);
+  }
+
+  void GeometryHashCache::validate(const XXH64_hash_t fingerprint, const GeometryHashes& hashes) {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    auto overlayIt = m_overlay.find(fingerprint);
+    if (overlayIt != m_overlay.end()) {
+      checkEntry(overlayIt->second, hashes);
+    }
+  }
+
+  void GeometryHashCache::checkEntry(OverlayEntry& entry, const GeometryHashes& hashes) {
+    // An evicted fingerprint is known to collide, keep it out of the cache
+    if (entry.evicted) {
+      return;
+    }
+
+    if (memcmp(&entry.hashes, &hashes, sizeof(GeometryHashes)) != 0) {
+      ONCE(Logger::warn("[RTX] Geometry hash cache entry did not match the full hash, the mismatching entries will be evicted."));
+      entry.evicted = true;
+      ++m_evictions;
+      return;
+    }
+
+    entry.validating = false;
+    entry.hitsSinceValidation = 0;
+  }
+
+  void GeometryHashCache::logStatistics() const {
+    const uint64_t hits = m_hits;
+    const uint64_t lookups = hits + m_misses;
+    const double hitRate = lookups > 0 ? 100.0 * hits / lookups : 0.0;
+
+    Logger::info(str::format("[RTX] Geometry hash cache: ", lookups, " lookups, ", hits, " hits (", hitRate, "%), ",
+                             m_misses.load(), " misses, ", m_validations.load(), " validations, ", m_evictions.load(), " evictions"));
+  }
+
+  const GeometryHashCache::FileEntry* GeometryHashCache::findInFile(const XXH64_hash_t fingerprint) const {
+    const FileEntry* pEnd = m_fileEntries + m_fileEntryCount;
+    const FileEntry* pEntry = std::lower_bound(m_fileEntries, pEnd, fingerprint,
+      [](const FileEntry& entry, const XXH64_hash_t key) {
+        return entry.fingerprint < key;
+      });
+
+    if (pEntry != pEnd && pEntry->fingerprint == fingerprint) {
+      return pEntry;
+    }
+
+    return nullptr;
+  }
+
+  void GeometryHashCache::writeFile() {
+    ScopedCpuProfileZone();
+
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    // Nothing was added or evicted, the file on disk is up to date
+    const bool hasNewEntries = std::any_of(m_overlay.begin(), m_overlay.end(), [this](const auto& it) {
+      return it.second.evicted || findInFile(it.first) == nullptr;
+    });
+    if (!hasNewEntries) {
+      return;
+    }
+
+    std::vector<FileEntry> entries;
+    entries.reserve(m_fileEntryCount + m_overlay.size());
+
+    for (size_t i = 0; i < m_fileEntryCount; i++) {
+      if (m_overlay.find(m_fileEntries[i].fingerprint) == m_overlay.end()) {
+        entries.push_back(m_fileEntries[i]);
+      }
+    }
+
+    for (const auto& it : m_overlay) {
+      if (!it.second.evicted) {
+        entries.push_back({ it.first, it.second.hashes });
+      }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const FileEntry& a, const FileEntry& b) {
+      return a.fingerprint < b.fingerprint;
+    });
+
+    // The old file may still be mapped, release it before replacing the file
+    m_fileEntries = nullptr;
+    m_fileEntryCount = 0;
+    m_file.close();
+
+    const std::string fileName = getFileName();
+    const std::string tempFileName = fileName + ".tmp";
+    {
+      std::ofstream file(tempFileName, std::ios_base::binary | std::ios_base::trunc);
+      if (!file) {
+        Logger::warn(str::format("[RTX] Unable to write geometry hash cache: ", tempFileName));
+        return;
+      }
+
+      const FileHeader header = { kMagic, kVersion, entries.size() };
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(FileEntry));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempFileName, fileName, ec);
+    if (ec) {
+      Logger::warn(str::format("[RTX] Unable to replace geometry hash cache ", fileName, ": ", ec.message()));
+      return;
+    }
+
+    Logger::info(str::format("[RTX] Geometry hash cache saved ", entries.size(), " entries to: ", fileName));
+  }
+
+  std::string GeometryHashCache::getFileName() const {
+    std::string fileName = path();
+
+    if (!fileName.empty() && *fileName.rbegin() != '/' && *fileName.rbegin() != '\\') {
+      fileName += '/';
+    }
+
+    return fileName + env::getExeBaseName() + ".remix-geometry-cache";
+  }
+}
@@ -0,0 +1,158 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "rtx_hashing.h"
+#include "rtx_option.h"
+#include "rtx_utils.h"
+#include "../../util/thread.h"
+#include "../../util/util_mapped_file.h"
+
+namespace dxvk {
+  /**
+    * \brief Persistent cache of geometry hashes.
+    *
+    *  Maps a cheap fingerprint of the geometry buffers (sizes, strides and a handful of
+    *  sampled elements) to the full set of content hashes, so static meshes re-uploaded
+    *  by the game don't have to be hashed in full again, even across sessions.
+    *
+    *  The cache file from the previous session is memory mapped and searched in place,
+    *  entries added this session are kept in memory and merged back into the file on
+    *  destruction.  Since the fingerprint only samples the data, the first hit on an entry
+    *  loaded from the file, and every so often a later hit, is returned as HitValidate: the
+    *  cached hashes are served right away, and the caller hashes the data in full off the
+    *  critical path and reports the result through validate(), which evicts the entry on
+    *  mismatch.  This bounds how long geometry changing between the samples (e.g. CPU
+    *  skinning) can be served stale hashes.
+    */
+  class GeometryHashCache {
+  public:
+    RTX_OPTION("rtx.geometryHashCache", bool, enable, false, "When enabled, geometry hashes are cached on disk keyed by a sampled fingerprint of the vertex and index data, reducing hashing cost for static meshes that are uploaded again, including across sessions.");
+    RTX_OPTION_ENV("rtx.geometryHashCache", std::string, path, "", "DXVK_GEOMETRY_HASH_CACHE_PATH", "Directory to store the geometry hash cache file in, the working directory is used when empty.");
+    RTX_OPTION("rtx.geometryHashCache", uint32_t, revalidationInterval, 32, "Number of hits served from a geometry hash cache entry before the data is hashed in full again to check the entry is still correct.  Lower values catch geometry that changes between the sampled elements sooner, at a higher hashing cost.");
+
+    static constexpr uint32_t kMagic = 0x48434752; // 'RGCH'
+    static constexpr uint32_t kVersion = 1;
+
+    enum class LookupResult {
+      Miss,     // Not cached, hash in full and report through insert()
+      Hit,      // Cached hashes can be used as is
+      HitValidate, // Cached hashes can be used, hash in full off the critical path and report through validate()
+    };
+
+    GeometryHashCache() = default;
+    ~GeometryHashCache();
+
+    /**
+      * \brief Maps the cache file written by the previous session, if any
+      */
+    void initialize();
+
+    bool isInitialized() const {
+      return m_initialized;
+    }
+
+    /**
+      * \brief Computes the fingerprint of a set of geometry buffers, only a few elements of each buffer are read.
+      *
+      *   regions [in]: vertex regions to be hashed
+      *   regionCount [in]: number of vertex regions
+      *   pIndexData [in]: index data, may be null for non-indexed geometry
+      *   indexDataSize [in]: size of index data in bytes
+      *   maxIndexValue [in]: largest index referenced by the index data
+      */
+    static XXH64_hash_t computeFingerprint(const HashQuery* regions, const uint32_t regionCount,
+                                           const void* pIndexData, const size_t indexDataSize,
+                                           const uint32_t maxIndexValue);
+
+    /**
+      * \brief Looks up the content hashes for a fingerprint
+      *
+      *   fingerprint [in]: key computed by computeFingerprint
+      *   hashesOut [out]: cached hashes, valid on hit
+      */
+    LookupResult lookup(const XXH64_hash_t fingerprint, GeometryHashes& hashesOut);
+
+    /**
+      * \brief Adds fully computed content hashes to the cache
+      */
+    void insert(const XXH64_hash_t fingerprint, const GeometryHashes& hashes);
+
+    /**
+      * \brief Checks an entry against the fully computed hashes after a HitValidate result, evicting the entry on mismatch
+      */
+    void validate(const XXH64_hash_t fingerprint, const GeometryHashes& hashes);
+
+    void logStatistics() const;
+
+  private:
+    struct FileHeader {
+      uint32_t magic;
+      uint32_t version;
+      uint64_t entryCount;
+    };
+
+    // Entries are stored in the file sorted by fingerprint
+    struct FileEntry {
+      XXH64_hash_t fingerprint;
+      GeometryHashes hashes;
+    };
+
+    static_assert(std::is_trivially_copyable_v<GeometryHashes>, "Geometry hashes must be serializable as is.");
+
+    struct OverlayEntry {
+      GeometryHashes hashes;
+      // Hits served since the data was last hashed in full, entries from the file start out due for a check
+      uint32_t hitsSinceValidation = 0;
+      // A full hash of a served hit is on its way back through validate()
+      bool validating = false;
+      bool evicted = false;
+    };
+
+    // Compares fully computed hashes with an entry, evicting it on mismatch
+    void checkEntry(OverlayEntry& entry, const GeometryHashes& hashes);
+
+    const FileEntry* findInFile(const XXH64_hash_t fingerprint) const;
+
+    void writeFile();
+
+    std::string getFileName() const;
+
+    bool m_initialized = false;
+
+    MappedFile m_file;
+    const FileEntry* m_fileEntries = nullptr;
+    size_t m_fileEntryCount = 0;
+
+    // Entries added, validated or evicted this session, take precedence over the file
+    dxvk::mutex m_mutex;
+    fast_unordered_cache<OverlayEntry> m_overlay;
+
+    std::atomic<uint64_t> m_hits = 0;
+    std::atomic<uint64_t> m_misses = 0;
+    std::atomic<uint64_t> m_validations = 0;
+    std::atomic<uint64_t> m_evictions = 0;
+  };
+}
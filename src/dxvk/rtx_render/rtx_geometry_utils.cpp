@@ -499,6 +499,36 @@ namespace dxvk {
     }
   }
 
+  Rc<DxvkBuffer> RtxGeometryUtils::relocateBuffer(const Rc<DxvkContext>& ctx, const Rc<DxvkBuffer>& buffer, DxvkMemoryStats::Category category) {
+    // Copy into fresh memory, the original is released once the GPU is done with it
+    Rc<DxvkBuffer> copy = ctx->getDevice()->createBuffer(buffer->info(), buffer->memFlags(), category);
+    ctx->copyBuffer(copy, 0, buffer, 0, buffer->info().size);
+    return copy;
+  }
+
+  bool RtxGeometryUtils::relocateGeometryCache(const Rc<DxvkContext>& ctx, uint64_t chunkId, RaytraceGeometry& geometry) {
+    bool relocated = false;
+
+    for (Rc<DxvkBuffer>* cacheBuffer : { &geometry.indexCacheBuffer, &geometry.historyBuffer[0], &geometry.historyBuffer[1] }) {
+      if (*cacheBuffer == nullptr || (*cacheBuffer)->getMemory().chunkId() != chunkId)
+        continue;
+
+      const Rc<DxvkBuffer> copy = relocateBuffer(ctx, *cacheBuffer, DxvkMemoryStats::Category::RTXAccelerationStructure);
+
+      // Point the buffer slices at the copy, keeping their offsets, strides and formats
+      for (RaytraceBuffer* slice : { &geometry.positionBuffer, &geometry.previousPositionBuffer, &geometry.normalBuffer,
+                                     &geometry.texcoordBuffer, &geometry.color0Buffer, &geometry.indexBuffer }) {
+        if (slice->defined() && slice->buffer() == *cacheBuffer)
+          static_cast<DxvkBufferSlice&>(*slice) = DxvkBufferSlice(copy, slice->offset(), slice->length());
+      }
+
+      *cacheBuffer = copy;
+      relocated = true;
+    }
+
+    return relocated;
+  }
+
   void RtxGeometryUtils::interleaveGeometry(
     const Rc<DxvkContext>& ctx,
     const RasterGeometry& input,
@@ -137,6 +137,9 @@ namespace dxvk {
     static void processGeometryBuffers(const RasterGeometry& input, RaytraceGeometry& output);
     static size_t computeOptimalVertexStride(const RasterGeometry& input);
     static void cacheVertexDataOnGPU(const Rc<DxvkContext>& ctx, const RasterGeometry& input, RaytraceGeometry& output);
+    // Memory defragmentation:
+    static Rc<DxvkBuffer> relocateBuffer(const Rc<DxvkContext>& ctx, const Rc<DxvkBuffer>& buffer, DxvkMemoryStats::Category category);
+    static bool relocateGeometryCache(const Rc<DxvkContext>& ctx, uint64_t chunkId, RaytraceGeometry& geometry);
 
     /**
      * \brief Execute a compute shader to generate a triangle list from arbitrary topologies
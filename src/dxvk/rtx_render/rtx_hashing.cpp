@@ -22,6 +22,7 @@
 #include <smmintrin.h>
 #include <math.h>
 #include <intrin.h>
+#include <algorithm>
 #include <vector>
 #include <string_view>
 
@@ -101,30 +102,6 @@ namespace dxvk {
     return XXH3_64bits(pData, byteSize);
   }
 
-  template<typename T>
-  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<T>& uniqueIndices) {
-    ScopedCpuProfileZone();
-
-    XXH64_hash_t result = 0;
-
-    constexpr bool hasIndices = std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value;
-
-    if (hasIndices && uniqueIndices.size() > 0) {
-      for (const T idx : uniqueIndices) {
-        const uint8_t* pData = (query.pBase + idx * query.stride);
-        result = XXH3_64bits_withSeed(pData, query.elementSize, result);
-      }
-    } else {
-      for (uint32_t i = 0; i < query.size; i += query.stride) {
-        const uint8_t* pData = (query.pBase + i);
-        result = XXH3_64bits_withSeed(pData, query.elementSize, result);
-      }
-    }
-
-    return result;
-  }
-
-
   // TODO (REMIX-656): Remove this once we can transition content to new hash
   constexpr static uint32_t MaxGeomHashSize = 512; // 512b - this is a performance optimization
 
@@ -216,9 +193,6 @@ namespace dxvk {
   }
 
   // Supported template params
-  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<uint16_t>& uniqueIndices);
-  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<uint32_t>& uniqueIndices);
-  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<int>& uniqueIndices);
 
   template XXH64_hash_t hashIndicesLegacy<uint16_t>(const void* pIndexData, const size_t indexCount);
   template XXH64_hash_t hashIndicesLegacy<uint32_t>(const void* pIndexData, const size_t indexCount);
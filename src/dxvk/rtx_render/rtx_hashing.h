@@ -21,11 +21,16 @@
 */
 #pragma once
 
+#include <assert.h>
+#include <float.h>
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
-#include "../util/xxHash/xxhash.h"
-#include "../util/rc/util_rc_ptr.h"
-#include "../util/util_flags.h"
+#include "../../util/xxHash/xxhash.h"
+#include "../../util/rc/util_rc_ptr.h"
+#include "../../util/util_flags.h"
+#include "../../util/util_fastops.h"
 
 namespace dxvk {
   enum class HashComponents : uint32_t {
@@ -63,12 +68,16 @@ namespace dxvk {
                                     | (1 << (uint32_t)HashComponents::LegacyIndices);
   }
 
-  // Structure contains data required to perform a hash operation on specific data
-  struct HashQuery {
+  // The memory a hash operation reads
+  struct HashRegion {
     uint8_t* pBase;           // base pointer of the memory region to hash
     size_t size;              // length of the memory in bytes
     size_t stride;            // byte stride elements within buffer
     size_t elementSize;       // byte stride of the specific elements to hash
+  };
+
+  // Structure contains data required to perform a hash operation on specific data
+  struct HashQuery : HashRegion {
     Rc<class DxvkBuffer> ref; // reference to the buffer (for ref counting purposes)
   };
 
@@ -82,6 +91,28 @@ namespace dxvk {
     const XXH64_hash_t& operator[](const HashComponents& field) const { return fields[(uint32_t) field]; }
           XXH64_hash_t& operator[](const HashComponents& field)       { return fields[(uint32_t) field]; }
 
+    // Combines the components selected by a rule into a single hash
+    XXH64_hash_t getHashForRule(const HashRule& rule) const {
+      XXH64_hash_t hashResult = kEmptyHash;
+
+      // TODO: Can be optimized to not iterate over all component indices
+      for (uint32_t i = 0; i < (uint32_t)HashComponents::Count; i++) {
+        const HashComponents component = (HashComponents) i;
+
+        if (rule.test(component)) {
+          if (hashResult == kEmptyHash)
+            // For the first entry, we use the hash directly
+            hashResult = fields[i];
+          else
+            // For all other entries, we combine the hash via seeding
+            hashResult = XXH64(&fields[i], sizeof(XXH64_hash_t), hashResult);
+        }
+      }
+
+      assert(hashResult != kEmptyHash);
+      return hashResult;
+    }
+
   private:
     // Array of hashes, indexed by HashComponent
     XXH64_hash_t fields[HashComponents::Count];
@@ -137,7 +168,99 @@ namespace dxvk {
     *   uniqueIndices [in]: indices (byte offsets as multiples of query.stride) to hash
     */
   template<typename T>
-  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<T>& uniqueIndices);
+  XXH64_hash_t hashVertexRegionIndexed(const HashRegion& query, const std::vector<T>& uniqueIndices) {
+    XXH64_hash_t result = 0;
+
+    constexpr bool hasIndices = std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value;
+
+    if (hasIndices && uniqueIndices.size() > 0) {
+      for (const T idx : uniqueIndices) {
+        const uint8_t* pData = (query.pBase + idx * query.stride);
+        result = XXH3_64bits_withSeed(pData, query.elementSize, result);
+      }
+    } else {
+      for (uint32_t i = 0; i < query.size; i += query.stride) {
+        const uint8_t* pData = (query.pBase + i);
+        result = XXH3_64bits_withSeed(pData, query.elementSize, result);
+      }
+    }
+
+    return result;
+  }
+
+  // Bounds of vertex positions, accumulated by the hash while the positions are in cache
+  struct HashBoundsQuery {
+    fast::PositionFormat format;
+    float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  };
+
+  /**
+    * \brief Hashes a region of sparse memory, packing the elements into a scratch arena first.
+    *        Produces the same hash as the variant above.
+    *
+    *   query [in]: structure containing information about the region
+    *   uniqueIndices [in]: sorted indices (byte offsets as multiples of query.stride) to hash
+    *   scratch [in/out]: arena reused between calls to hold the packed elements
+    *   pBounds [in/out]: optional, grown to contain the hashed elements when they are positions
+    */
+  template<typename T>
+  XXH64_hash_t hashVertexRegionIndexed(const HashRegion& query, const std::vector<T>& uniqueIndices, std::vector<uint8_t>& scratch, HashBoundsQuery* pBounds = nullptr) {
+    constexpr bool hasIndices = std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value;
+    using IndexType = std::conditional_t<hasIndices, T, uint32_t>;
+
+    const IndexType* pIndices = nullptr;
+    uint32_t elementCount;
+    if (hasIndices && uniqueIndices.size() > 0) {
+      pIndices = reinterpret_cast<const IndexType*>(uniqueIndices.data());
+      elementCount = (uint32_t) uniqueIndices.size();
+    } else if (query.stride > 0) {
+      elementCount = (uint32_t) ((query.size + query.stride - 1) / query.stride);
+    } else {
+      // Every element would be at pBase, the variant above never finishes unless the region is empty
+      return 0;
+    }
+
+    if (query.elementSize == 0) {
+      // Nothing to pack, but every element still advances the hash as in the variant above
+      XXH64_hash_t result = 0;
+      for (uint32_t i = 0; i < elementCount; i++) {
+        result = XXH3_64bits_withSeed(query.pBase, 0, result);
+      }
+      return result;
+    }
+
+    // Pack the elements a chunk at a time so the hash (and bounds) loops below stream linearly
+    // through memory, while the chunk is still in cache from the gather.
+    constexpr uint32_t kChunkElements = 1024;
+    const size_t chunkSize = std::min(elementCount, kChunkElements) * query.elementSize;
+    if (scratch.size() < chunkSize + fast::kGatherStridedPadding) {
+      scratch.resize(chunkSize + fast::kGatherStridedPadding);
+    }
+
+    XXH64_hash_t result = 0;
+    for (uint32_t first = 0; first < elementCount; first += kChunkElements) {
+      const uint32_t count = std::min(elementCount - first, kChunkElements);
+      if (pIndices) {
+        fast::gatherStrided<IndexType>(scratch.data(), query.pBase, query.elementSize, query.stride, pIndices + first, count);
+      } else {
+        fast::gatherStrided<IndexType>(scratch.data(), query.pBase + first * query.stride, query.elementSize, query.stride, nullptr, count);
+      }
+
+      if (pBounds) {
+        fast::accumulatePositionBounds(scratch.data(), query.elementSize, count, pBounds->format, pBounds->minPos, pBounds->maxPos);
+      }
+
+      // NOTE: The hash must stay bit-identical to the unpacked variant above (replacement content is keyed
+      //       on it), so chain each element through the seed rather than hashing the packed array in one go.
+      const size_t packedSize = count * query.elementSize;
+      for (size_t offset = 0; offset < packedSize; offset += query.elementSize) {
+        result = XXH3_64bits_withSeed(scratch.data() + offset, query.elementSize, result);
+      }
+    }
+
+    return result;
+  }
 
   template<typename T>
   [[deprecated("(REMIX-656): Remove this once we can transition content to new hash)")]]
@@ -26,6 +26,7 @@
 #include "rtx_context.h"
 #include "rtx_scenemanager.h"
 #include "rtx_instancemanager.h"
+#include "rtx_drawcall_matching.h"
 #include "rtx_cameramanager.h"
 #include "rtx_options.h"
 #include "rtx_materials.h"
@@ -399,7 +400,8 @@ namespace dxvk {
     // Handle Alpha Test State
 
     // Note: Even if the Alpha Test enable flag is set, we consider it disabled if the actual test type is set to always.
-    bool forceAlphaTest = RtxOptions::Get()->isCutoutTexture(drawCall.getMaterialData().getHash());
+    const TextureCategoryIndex::Mask textureCategories = RtxOptions::Get()->getTextureCategories(drawCall.getMaterialData().getHash());
+    bool forceAlphaTest = TextureCategoryIndex::has(textureCategories, TextureCategory::Cutout);
     const bool alphaTestEnabled = forceAlphaTest || (AlphaTestType)drawCall.getMaterialData().alphaTestCompareOp != AlphaTestType::kAlways;
 
     // Note: Use the Opaque Material Data's alpha test state information directly if requested,
@@ -539,11 +541,11 @@ namespace dxvk {
       // or through the manually specified alpha state.
 
       // Note: Particles are differentiated from typical objects with opacity by labeling their source material textures as being particle textures.
-      out.isParticle = RtxOptions::Get()->isParticleTexture(drawCall.getMaterialData().getHash());
+      out.isParticle = TextureCategoryIndex::has(textureCategories, TextureCategory::Particle);
       out.isDecal = 
-        RtxOptions::Get()->isDecalTexture(drawCall.getMaterialData().getHash()) ||
-        RtxOptions::Get()->isDynamicDecalTexture(drawCall.getMaterialData().getHash()) ||
-        RtxOptions::Get()->isNonOffsetDecalTexture(drawCall.getMaterialData().getHash()) ||
+        (textureCategories & (TextureCategoryIndex::bit(TextureCategory::Decal) |
+                              TextureCategoryIndex::bit(TextureCategory::DynamicDecal) |
+                              TextureCategoryIndex::bit(TextureCategory::NonOffsetDecal))) != 0 ||
         drawCall.getMaterialData().isBlendedTerrain;
       out.isBlendedTerrain = drawCall.getMaterialData().isBlendedTerrain;
     } else {
@@ -599,33 +601,15 @@ namespace dxvk {
 
     const float uniqueObjectDistanceSqr = RtxOptions::Get()->getUniqueObjectDistanceSqr();
 
-    RtInstance* pSimilar = nullptr;
-    float nearestDistSqr = FLT_MAX;
-
     // Search the BLAS for an instance matching ours
-    for (const RtInstance* instance : blas.getLinkedInstances()) {
-      
-      if ((instance->m_frameLastUpdated == currentFrameIdx)) {
-        // If the transform is an exact match and the instance has already been touched this frame,
-        // then this is a second draw call on a single mesh.
-        if (memcmp(&transform, &instance->getTransform(), sizeof(instance->getTransform())) == 0) {
-          return const_cast<RtInstance*>(instance);
-        }
-      } else if (instance->m_materialHash == material.getHash()) {
-        // Instance hasn't been touched yet this frame.
-
-        const Vector3 prevInstanceWorldPosition = instance->getWorldPosition();
-
-        const float distSqr = lengthSqr(prevInstanceWorldPosition - worldPosition);
-        if (distSqr <= uniqueObjectDistanceSqr && distSqr < nearestDistSqr) {
-          if (distSqr == 0.0f) {
-            // Not going to find anything closer.
-            return const_cast<RtInstance*>(instance);
-          }
-          nearestDistSqr = distSqr;
-          foundResult.setInstance(const_cast<RtInstance*>(instance));
-        }
+    float nearestDistSqr;
+    const RtInstance* pSimilar = matchSimilarInstance(blas.getLinkedInstances(), transform, material.getHash(), currentFrameIdx, uniqueObjectDistanceSqr, nearestDistSqr);
+    if (pSimilar != nullptr) {
+      if (nearestDistSqr == 0.0f) {
+        // Not going to find anything closer.
+        return const_cast<RtInstance*>(pSimilar);
       }
+      foundResult.setInstance(const_cast<RtInstance*>(pSimilar));
     }
 
     // For portal gun and other objects that were drawn in the ViewModel, need to check the
@@ -746,6 +730,12 @@ namespace dxvk {
     currentInstance.surface.indexStride = blas.modifiedGeometryData.indexBuffer.stride();
   }
 
+  void InstanceManager::refreshInstanceBuffers(const BlasEntry& blas) {
+    for (const RtInstance* instance : blas.getLinkedInstances()) {
+      processInstanceBuffers(blas, *m_instances[instance->m_instanceVectorId]);
+    }
+  }
+
   // Returns true if the instance was modified
   bool InstanceManager::applyDeveloperOptions(RtInstance& currentInstance, const DrawCallState& drawCall) {
     if (!RtxOptions::Get()->getDeveloperOptionsEnabled())
@@ -787,9 +777,10 @@ namespace dxvk {
     const bool isFirstUpdateThisFrame = currentInstance.setFrameLastUpdated(m_device->getCurrentFrameId());
 
     // These can change in the Runtime UI so need to check during update
-    currentInstance.m_isHidden = RtxOptions::Get()->isHideInstanceTexture(drawCall.getMaterialData().getHash());
-    currentInstance.m_isPlayerModel = RtxOptions::Get()->isPlayerModelTexture(drawCall.getMaterialData().getHash());
-    currentInstance.m_isWorldSpaceUI = RtxOptions::Get()->isWorldSpaceUiTexture(drawCall.getMaterialData().getHash());
+    const TextureCategoryIndex::Mask textureCategories = RtxOptions::Get()->getTextureCategories(drawCall.getMaterialData().getHash());
+    currentInstance.m_isHidden = TextureCategoryIndex::has(textureCategories, TextureCategory::HideInstance);
+    currentInstance.m_isPlayerModel = TextureCategoryIndex::has(textureCategories, TextureCategory::PlayerModel);
+    currentInstance.m_isWorldSpaceUI = TextureCategoryIndex::has(textureCategories, TextureCategory::WorldSpaceUi);
 
     // Hide the sky instance since it is not raytraced.
     // Sky mesh and material are only good for capture and replacement purposes.
@@ -845,7 +836,7 @@ namespace dxvk {
         currentInstance.surface.texgenMode = drawCall.getTransformData().texgenMode; // NOTE: Make it material data...
         currentInstance.surface.tFactor = drawCall.getMaterialData().tFactor;
         currentInstance.surface.alphaState = alphaState;
-        currentInstance.surface.isAnimatedWater = RtxOptions::Get()->isAnimatedWaterTexture(drawCall.getMaterialData().getHash());
+        currentInstance.surface.isAnimatedWater = TextureCategoryIndex::has(textureCategories, TextureCategory::AnimatedWater);
         currentInstance.surface.associatedGeometryHash = drawCall.getHash(RtxOptions::Get()->GeometryHashGenerationRule);
 
         // For worldspace UI, we want to show the UI (unlit) in the world.  So configure the blend mode if blending is used accordingly.
@@ -862,8 +853,8 @@ namespace dxvk {
       {
         // Heuristic for MS5 - motion vectors on translucent surfaces cannot be trusted.  This will help with IQ, but need a longer term solution [TREX-634]
         const bool isMotionUnstable = material.getType() == RtSurfaceMaterialType::Translucent 
-                                   || RtxOptions::Get()->isParticleTexture(drawCall.getMaterialData().getHash())
-                                   || RtxOptions::Get()->isWorldSpaceUiTexture(drawCall.getMaterialData().getHash());
+                                   || TextureCategoryIndex::has(textureCategories, TextureCategory::Particle)
+                                   || TextureCategoryIndex::has(textureCategories, TextureCategory::WorldSpaceUi);
 
         const bool hasPreviousPositions = blas.modifiedGeometryData.previousPositionBuffer.defined() && !isMotionUnstable;
         const bool isFirstUpdateAfterCreation = currentInstance.isCreatedThisFrame(m_device->getCurrentFrameId()) && isFirstUpdateThisFrame;
@@ -876,7 +867,7 @@ namespace dxvk {
         // We cannot reliably determine the digits material because it's a dynamic texture rendered by vgui that contains all kinds of UI things.
         // So instead of offsetting the digits or making them live in unordered TLAS (either of which would solve the problem), we offset the screen background backwards.
         const float worldSpaceUiBackgroundOffset = RtxOptions::Get()->worldSpaceUiBackgroundOffset();
-        if (worldSpaceUiBackgroundOffset != 0.f && RtxOptions::Get()->isWorldSpaceUiBackgroundTexture(drawCall.getMaterialData().getHash())) {
+        if (worldSpaceUiBackgroundOffset != 0.f && TextureCategoryIndex::has(textureCategories, TextureCategory::WorldSpaceUiBackground)) {
           objectToWorld[3] += objectToWorld[2] * worldSpaceUiBackgroundOffset;
         }
 
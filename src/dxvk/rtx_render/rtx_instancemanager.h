@@ -242,6 +242,9 @@ public:
     const CameraManager& cameraManager, const RayPortalManager& rayPortalManager,
     BlasEntry& blas, const DrawCallState& drawCall, const MaterialData& materialData, const RtSurfaceMaterial& material);
 
+  // Refreshes the buffer references of the instances of a scene object, after its buffers have moved
+  void refreshInstanceBuffers(const BlasEntry& blas);
+
   // Creates a copy of a reference instance and adds it to the instance pool
   // Temporary single frame instances generated every frame should disable valid id generation to avoid overflowing it
   RtInstance* createInstanceCopy(const RtInstance& reference, bool generateValidID = true);
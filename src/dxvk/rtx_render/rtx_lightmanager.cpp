@@ -121,6 +121,30 @@ namespace dxvk {
 
   void LightManager::dynamicLightMatching() {
     ScopedCpuProfileZone();
+    const float uniqueObjectDistance = RtxOptions::Get()->getUniqueObjectDistance();
+    // Positional lights only match within uniqueObjectDistance, so nearby grid cells hold every possible match
+    const bool useGrid = std::isfinite(uniqueObjectDistance) && uniqueObjectDistance > 0.f;
+
+    // Gather the lights new this frame, these are the candidates for the previous frame's lights to match against.
+    m_matchCandidateGrid.clear(useGrid ? uniqueObjectDistance : 1.f);
+    m_matchCandidateList.clear();
+    uint32_t order = 0;
+    for (auto&& newPair : m_lights) {
+      RtLight& newLight = newPair.second;
+      // Skip old lights, this check implicitly avoids comparing the exact same light.
+      if (newLight.getBufferIdx() != kNewLightIdx || newLight.isChildOfMesh())
+        continue;
+
+      const MatchCandidate candidate { &newLight, order++ };
+      if (!useGrid || newLight.getType() == RtLightType::Distant) {
+        m_matchCandidateList.push_back(candidate);
+      } else {
+        // Lights with a non-finite position can't be similar to anything, so they're dropped by the grid
+        m_matchCandidateGrid.insert(newLight.getPosition(), candidate);
+      }
+    }
+    m_matchCandidateGrid.build();
+
     // Try match up any stragglers now we have the full light list this frame.
     for (auto it = m_lights.begin(); it != m_lights.end(); ) {
       RtLight& light = it->second;
@@ -141,24 +165,31 @@ namespace dxvk {
       }
 
       float currentSimilarity = -1.f;
-      std::optional<XXH64_hash_t> similarLight;
-      for (auto&& newPair : m_lights) {
-        RtLight& newLight = newPair.second;
-        // Skip comparing to old lights, this check implicitly avoids comparing the exact same light.
-        if (newLight.getBufferIdx() != kNewLightIdx || newLight.isChildOfMesh())
-          continue;
-
-        float similarity = isSimilar(light, newLight, RtxOptions::Get()->getUniqueObjectDistance());
-        // Update the cached light if it's similar.
-        if (similarity > currentSimilarity) {
-          similarLight = newPair.first;
+      const MatchCandidate* similarLight = nullptr;
+      auto compareCandidate = [&](const MatchCandidate& candidate) {
+        // Skip lights already matched to an earlier old light, updateLight() gave them its buffer index.
+        if (candidate.light->getBufferIdx() != kNewLightIdx)
+          return;
+
+        float similarity = isSimilar(light, *candidate.light, uniqueObjectDistance);
+        // Update the cached light if it's similar, on a tie keep the one a linear search of the light table would find first.
+        if (similarity > currentSimilarity || (similarLight && similarity == currentSimilarity && candidate.order < similarLight->order)) {
+          similarLight = &candidate;
           currentSimilarity = similarity;
         }
+      };
+
+      if (useGrid && light.getType() != RtLightType::Distant) {
+        m_matchCandidateGrid.forEachNear(light.getPosition(), compareCandidate);
+      } else {
+        for (const MatchCandidate& candidate : m_matchCandidateList) {
+          compareCandidate(candidate);
+        }
       }
 
-      if (currentSimilarity >= 0 && similarLight.has_value()) {
+      if (currentSimilarity >= 0 && similarLight) {
         // This is a dynamic light!
-        RtLight& dynamicLight = m_lights[similarLight.value()];
+        RtLight& dynamicLight = *similarLight->light;
         dynamicLight.isDynamic = true;
 
         // This is the same light, so update our new light
@@ -25,6 +25,7 @@
 #include <vector>
 #include <unordered_map>
 #include "../util/rc/util_rc_ptr.h"
+#include "../util/util_spatial_grid.h"
 #include "rtx_types.h"
 #include "rtx/utility/shader_types.h"
 #include "rtx/concept/light/light_types.h"
@@ -109,6 +110,16 @@ private:
   std::vector<unsigned char> m_lightsGPUData{};
   std::vector<uint16_t> m_lightMappingData{};
 
+  // A light added this frame, which dynamic light matching may pair up with a light from the previous frame
+  struct MatchCandidate {
+    RtLight* light;
+    uint32_t order; // Position in the light table, so ties resolve as they would in a linear search
+  };
+  // Candidates bucketed by position, rebuilt every frame to avoid comparing every old light against every new one
+  SpatialHashGrid<MatchCandidate> m_matchCandidateGrid;
+  // Candidates without a position (distant lights), or all of them if the grid can't be used
+  std::vector<MatchCandidate> m_matchCandidateList;
+
   // Similarity check.
   //  Returns -1 if not similar
   //  Returns 0~1 if similar, higher is more similar
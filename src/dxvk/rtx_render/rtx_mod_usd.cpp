@@ -1181,6 +1181,9 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
     VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
     VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
 
+  // Keep the content hashes of the mod textures for the next launch
+  AssetDataManager::get().saveContentHashes();
+
   m_owner.setState(State::Loaded);
 }
 
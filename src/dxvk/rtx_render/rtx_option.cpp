@@ -24,6 +24,7 @@
 namespace dxvk {
   Config RtxOptionImpl::s_startupOptions;
   Config RtxOptionImpl::s_customOptions;
+  std::atomic<uint32_t> RtxOptionImpl::s_hashSetVersion = 0;
 
   void fillHashTable(const std::vector<std::string>& rawInput, std::unordered_set<XXH64_hash_t>& hashTableOutput) {
     for (auto&& hashStr : rawInput) {
@@ -136,6 +137,7 @@ namespace dxvk {
       break;
     case OptionType::HashSet:
       fillHashTable(options.getOption<std::vector<std::string>>(fullName.c_str()), *value.hashSet);
+      markHashSetsChanged();
       break;
     case OptionType::HashVector:
       fillHashVector(options.getOption<std::vector<std::string>>(fullName.c_str()), *value.hashVector);
@@ -256,6 +258,7 @@ namespace dxvk {
       break;
     case OptionType::HashSet:
       *value.hashSet = *defaultValue.hashSet;
+      markHashSetsChanged();
       break;
     case OptionType::HashVector:
       *value.hashVector = *defaultValue.hashVector;
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <unordered_set>
 #include <cassert>
 #include <limits>
@@ -116,9 +117,17 @@ namespace dxvk {
     // Returns a global container holding all serializable options
     static RtxOptionMap& getGlobalRtxOptionMap();
 
+    // Hash set options are read, reset and edited in place through their references, this counts those changes
+    // so that data derived from the sets knows when to rebuild. Call markHashSetsChanged() after editing a set.
+    static uint32_t getHashSetVersion() { return s_hashSetVersion.load(std::memory_order_acquire); }
+    static void markHashSetsChanged() { s_hashSetVersion.fetch_add(1, std::memory_order_release); }
+
     // Config object holding start up settings
     static Config s_startupOptions;
     static Config s_customOptions;
+
+  private:
+    static std::atomic<uint32_t> s_hashSetVersion;
   };
 
   template <typename T>
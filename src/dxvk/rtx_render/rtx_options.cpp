@@ -281,6 +281,50 @@ namespace dxvk {
     reflexModeRef() = ReflexMode::LowLatency;
   }
 
+  void RtxOptions::updateTextureCategoryIndex() const {
+    // Another thread is rebuilding, keep using the current index until it is done
+    std::unique_lock<dxvk::mutex> lock(m_textureCategoryMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return;
+    }
+
+    // Read first: a set changed while rebuilding bumps the version again and triggers another rebuild
+    const uint32_t version = RtxOptionImpl::getHashSetVersion();
+    if (m_textureCategoryVersion.load(std::memory_order_acquire) == version) {
+      return;
+    }
+
+    // Built off to the side, lookups keep using the published index until the new one replaces it
+    std::unique_ptr<TextureCategoryIndex> indexPtr = std::make_unique<TextureCategoryIndex>();
+    TextureCategoryIndex& index = *indexPtr;
+
+    index.add(TextureCategory::Lightmap, lightmapTextures());
+    index.add(TextureCategory::SkyBox, skyBoxTextures());
+    index.add(TextureCategory::Ignore, ignoreTextures());
+    index.add(TextureCategory::IgnoreLight, ignoreLights());
+    index.add(TextureCategory::Ui, uiTextures());
+    index.add(TextureCategory::WorldSpaceUi, worldSpaceUiTextures());
+    index.add(TextureCategory::WorldSpaceUiBackground, worldSpaceUiBackgroundTextures());
+    index.add(TextureCategory::HideInstance, hideInstanceTextures());
+    index.add(TextureCategory::PlayerModel, playerModelTextures());
+    index.add(TextureCategory::PlayerModelBody, playerModelBodyTextures());
+    index.add(TextureCategory::LightConverter, lightConverter());
+    index.add(TextureCategory::Particle, particleTextures());
+    index.add(TextureCategory::Beam, beamTextures());
+    index.add(TextureCategory::Decal, decalTextures());
+    index.add(TextureCategory::DynamicDecal, dynamicDecalTextures());
+    index.add(TextureCategory::NonOffsetDecal, nonOffsetDecalTextures());
+    index.add(TextureCategory::Terrain, terrainTextures());
+    index.add(TextureCategory::Cutout, cutoutTextures());
+    index.add(TextureCategory::OpacityMicromapIgnore, opacityMicromapIgnoreTextures());
+    index.add(TextureCategory::AnimatedWater, animatedWaterTextures());
+    index.add(TextureCategory::AntiCulling, antiCullingTextures());
+
+    m_textureCategoryIndex.store(&index, std::memory_order_release);
+    m_textureCategoryIndices.emplace_back(std::move(indexPtr));
+    m_textureCategoryVersion.store(version, std::memory_order_release);
+  }
+
   std::string RtxOptions::getCurrentDirectory() const {
     return std::filesystem::current_path().string();
   }
@@ -25,6 +25,7 @@
 #include <unordered_set>
 #include <cassert>
 #include <limits>
+#include <memory>
 
 #include "../util/config/config.h"
 #include "../util/xxHash/xxhash.h"
@@ -41,6 +42,7 @@
 #include "rtx/pass/material_args.h"
 #include "rtx_option.h"
 #include "rtx_hashing.h"
+#include "rtx_texture_category_index.h"
 
 enum _NV_GPU_ARCHITECTURE_ID;
 typedef enum _NV_GPU_ARCHITECTURE_ID NV_GPU_ARCHITECTURE_ID;
@@ -345,6 +347,11 @@ namespace dxvk {
 
     RTX_OPTION("rtx", uint32_t, numFramesToKeepInstances, 1, "");
     RTX_OPTION("rtx", uint32_t, numFramesToKeepBLAS, 4, "");
+    RTX_OPTION("rtx", uint32_t, blasPoolBudgetMB, 0, "The memory budget of the BLAS pool in megabytes, unused BLAS are released least recently used first while the pool exceeds it. 0 means no budget.");
+    RTX_OPTION("rtx", bool, enableMemoryDefrag, false, "Moves geometry buffers out of sparsely used device memory chunks over a number of frames, so the chunks can be released.  Experimental, live buffers are relocated with GPU copies.");
+    RTX_OPTION("rtx", float, memoryDefragMaxChunkOccupancy, 0.25f, "Memory chunks used up to this fraction of their size are evacuated by the memory defragmentation.");
+    RTX_OPTION("rtx", uint32_t, memoryDefragBudgetMB, 16, "The number of megabytes the memory defragmentation copies per frame at most.");
+    RTX_OPTION("rtx", uint32_t, memoryDefragMaxEvacuatingChunks, 2, "The number of memory chunks the memory defragmentation evacuates at once at most.");
     RTX_OPTION("rtx", uint32_t, numFramesToKeepLights, 100, ""); // NOTE: This was the default we've had for a while, can probably be reduced...
     RTX_OPTION("rtx", uint32_t, numFramesToKeepGeometryData, 5, "");
     RTX_OPTION("rtx", uint32_t, numFramesToKeepMaterialTextures, 30, "");
@@ -720,6 +727,11 @@ namespace dxvk {
     RTX_OPTION_ENV("rtx", bool, enableAsyncTextureUpload, true, "DXVK_ASYNC_TEXTURE_UPLOAD", "");
     RTX_OPTION_ENV("rtx", bool, alwaysWaitForAsyncTextures, false, "DXVK_WAIT_ASYNC_TEXTURES", "");
     RTX_OPTION("rtx", int,  asyncTextureUploadPreloadMips, 8, "");
+    RTX_OPTION("rtx", uint32_t, textureStreamingUploadBudgetMB, 256, "The number of megabytes of texture mips uploaded per frame at most, the most visible textures are uploaded first. 0 means no budget.");
+    RTX_OPTION("rtx", float, textureStreamingVidMemPressure, 0.9f, "The fraction of the video memory budget above which the full mip chains of the least useful textures not used this frame are evicted. 0 disables eviction under memory pressure.");
+    RTX_OPTION("rtx", uint32_t, textureUploadWorkerThreads, 4, "The number of threads reading and packing texture mips into the upload staging ring in parallel. 0 packs the mips on the texture manager thread instead.");
+    RTX_OPTION("rtx", bool, enableTextureDeduplication, true, "A flag controlling if mod textures with identical file contents share a single GPU texture, true to enable, false to disable. Content hashes are cached next to the mod files so files are only read again once they change.");
+    RTX_OPTION("rtx", uint32_t, textureUploadStagingRingMB, 256, "The size in megabytes of the persistently mapped staging ring texture mips are uploaded through. Textures larger than the ring are uploaded through temporary staging memory.");
     RTX_OPTION("rtx", bool, usePartialDdsLoader, true,
                "A flag controlling if the partial DDS loader should be used, true to enable, false to disable and use GLI instead.\n"
                "Generally this should be always enabled as it allows for simple parsing of DDS header information without loading the entire texture into memory like GLI does to retrieve similar information.\n"
@@ -737,11 +749,13 @@ namespace dxvk {
     RTX_OPTION("rtx", std::string, captureInstanceStageName, "", "");
     RTX_OPTION("rtx", uint32_t, captureMaxFrames, 1, "");
     RTX_OPTION("rtx", uint32_t, captureFramesPerSecond, 24, "");
+    RTX_OPTION("rtx", uint32_t, captureExportThreads, 0, "Number of threads writing mesh and material stages when exporting a capture, 0 to use all hardware threads.");
     //   Mesh
     RTX_OPTION("rtx", float, captureMeshPositionDelta, 0.3f, "Inter-frame position min delta warrants new time sample.");
     RTX_OPTION("rtx", float, captureMeshNormalDelta, 0.3f, "Inter-frame normal min delta warrants new time sample.");
     RTX_OPTION("rtx", float, captureMeshTexcoordDelta, 0.3f, "Inter-frame texcoord min delta warrants new time sample.");
     RTX_OPTION("rtx", float, captureMeshColorDelta, 0.3f, "Inter-frame color min delta warrants new time sample.");
+    RTX_OPTION("rtx", bool, captureDedupTimeSamples, true, "Drop mesh time samples equal to both neighbouring samples when exporting a capture, USD interpolates the same values from the remaining ones.");
 
     RTX_OPTION("rtx", bool, calculateMeshBoundingBox, false, "Calculate bounding box for every mesh.");
 
@@ -790,6 +804,18 @@ namespace dxvk {
     bool initialEnableAdaptiveResolutionReplacementTextures;
     uint initialMinReplacementTextureMipMapLevel;
 
+    // Categories of the texture hashes listed in the category options below, rebuilt when one of them changes.
+    // Every rebuild publishes a new immutable index through a plain atomic pointer, so a lookup is a single load.
+    // Superseded indices are kept until shutdown since lookups on other threads may still read them, rebuilds
+    // only happen when a category option is edited so they stay few.
+    const TextureCategoryIndex m_emptyTextureCategoryIndex;
+    mutable std::atomic<const TextureCategoryIndex*> m_textureCategoryIndex = &m_emptyTextureCategoryIndex;
+    mutable std::vector<std::unique_ptr<const TextureCategoryIndex>> m_textureCategoryIndices;
+    mutable std::atomic<uint32_t> m_textureCategoryVersion = ~0u;
+    mutable dxvk::mutex m_textureCategoryMutex;
+
+    void updateTextureCategoryIndex() const;
+
     RTX_OPTION("rtx", float, effectLightIntensity, 1.f, "");
     RTX_OPTION("rtx", float, effectLightRadius, 5.f, "");
     RTX_OPTION("rtx", bool, effectLightPlasmaBall, false, "");
@@ -1025,84 +1051,97 @@ namespace dxvk {
 
     static std::unique_ptr<RtxOptions>& Get() { return pInstance; }
 
+    // Bitmask of the categories listing a texture hash, one lookup for all of them
+    TextureCategoryIndex::Mask getTextureCategories(const XXH64_hash_t& h) const {
+      if (m_textureCategoryVersion.load(std::memory_order_acquire) != RtxOptionImpl::getHashSetVersion()) {
+        updateTextureCategoryIndex();
+      }
+
+      return m_textureCategoryIndex.load(std::memory_order_acquire)->lookup(h);
+    }
+
+    bool hasTextureCategory(const XXH64_hash_t& h, TextureCategory category) const {
+      return TextureCategoryIndex::has(getTextureCategories(h), category);
+    }
+
     bool isLightmapTexture(const XXH64_hash_t& h) const {
-      return lightmapTextures().find(h) != lightmapTextures().end();
+      return hasTextureCategory(h, TextureCategory::Lightmap);
     }
 
     bool isSkyboxTexture(const XXH64_hash_t& h) const {
-      return skyBoxTextures().find(h) != skyBoxTextures().end();
+      return hasTextureCategory(h, TextureCategory::SkyBox);
     }
 
     bool shouldIgnoreTexture(const XXH64_hash_t& h) const {
-      return ignoreTextures().find(h) != ignoreTextures().end();
+      return hasTextureCategory(h, TextureCategory::Ignore);
     }
     
     bool shouldIgnoreLight(const XXH64_hash_t& h) const {
-      return ignoreLights().find(h) != ignoreLights().end();
+      return hasTextureCategory(h, TextureCategory::IgnoreLight);
     }
 
     bool isUiTexture(const XXH64_hash_t& h) const {
-      return uiTextures().find(h) != uiTextures().end();
+      return hasTextureCategory(h, TextureCategory::Ui);
     }
     
     bool isWorldSpaceUiTexture(const XXH64_hash_t& h) const {
-      return worldSpaceUiTextures().find(h) != worldSpaceUiTextures().end();
+      return hasTextureCategory(h, TextureCategory::WorldSpaceUi);
     }
 
     bool isWorldSpaceUiBackgroundTexture(const XXH64_hash_t& h) const {
-      return worldSpaceUiBackgroundTextures().find(h) != worldSpaceUiBackgroundTextures().end();
+      return hasTextureCategory(h, TextureCategory::WorldSpaceUiBackground);
     }
 
     bool isHideInstanceTexture(const XXH64_hash_t& h) const {
-      return hideInstanceTextures().find(h) != hideInstanceTextures().end();
+      return hasTextureCategory(h, TextureCategory::HideInstance);
     }
     
     bool isPlayerModelTexture(const XXH64_hash_t& h) const {
-      return playerModelTextures().find(h) != playerModelTextures().end();
+      return hasTextureCategory(h, TextureCategory::PlayerModel);
     }
 
     bool isPlayerModelBodyTexture(const XXH64_hash_t& h) const {
-      return playerModelBodyTextures().find(h) != playerModelBodyTextures().end();
+      return hasTextureCategory(h, TextureCategory::PlayerModelBody);
     }
 
     bool isParticleTexture(const XXH64_hash_t& h) const {
-      return particleTextures().find(h) != particleTextures().end();
+      return hasTextureCategory(h, TextureCategory::Particle);
     }
 
     bool isBeamTexture(const XXH64_hash_t& h) const {
-      return beamTextures().find(h) != beamTextures().end();
+      return hasTextureCategory(h, TextureCategory::Beam);
     }
 
     bool isDecalTexture(const XXH64_hash_t& h) const {
-      return decalTextures().find(h) != decalTextures().end();
+      return hasTextureCategory(h, TextureCategory::Decal);
     }
 
     bool isCutoutTexture(const XXH64_hash_t& h) const {
-      return cutoutTextures().find(h) != cutoutTextures().end();
+      return hasTextureCategory(h, TextureCategory::Cutout);
     }
 
     bool isDynamicDecalTexture(const XXH64_hash_t& h) const {
-      return dynamicDecalTextures().find(h) != dynamicDecalTextures().end();
+      return hasTextureCategory(h, TextureCategory::DynamicDecal);
     }
 
     bool isNonOffsetDecalTexture(const XXH64_hash_t& h) const {
-      return nonOffsetDecalTextures().find(h) != nonOffsetDecalTextures().end();
+      return hasTextureCategory(h, TextureCategory::NonOffsetDecal);
     }
 
     bool isTerrainTexture(const XXH64_hash_t& h) const {
-      return terrainTextures().find(h) != terrainTextures().end();
+      return hasTextureCategory(h, TextureCategory::Terrain);
     }
 
     bool shouldOpacityMicromapIgnoreTexture(const XXH64_hash_t& h) const {
-      return opacityMicromapIgnoreTextures().find(h) != opacityMicromapIgnoreTextures().end();
+      return hasTextureCategory(h, TextureCategory::OpacityMicromapIgnore);
     }
 
     bool isAnimatedWaterTexture(const XXH64_hash_t& h) const {
-      return animatedWaterTextures().find(h) != animatedWaterTextures().end();
+      return hasTextureCategory(h, TextureCategory::AnimatedWater);
     }
 
     bool isAntiCullingTexture(const XXH64_hash_t& h) const {
-      return antiCullingTextures().find(h) != antiCullingTextures().end();
+      return hasTextureCategory(h, TextureCategory::AntiCulling);
     }
 
     bool getRayPortalTextureIndex(const XXH64_hash_t& h, std::size_t& index) const {
@@ -1118,7 +1157,7 @@ namespace dxvk {
     }
 
     bool shouldConvertToLight(const XXH64_hash_t& h) const {
-      return lightConverter().find(h) != lightConverter().end();
+      return hasTextureCategory(h, TextureCategory::LightConverter);
     }
 
     const ivec2 getDrawCallRange() const { Vector2i v = drawCallRange(); return ivec2{v.x, v.y}; }
@@ -1159,6 +1198,11 @@ namespace dxvk {
     DLSSProfile getDLSSQuality() const { return qualityDLSS(); }
     uint32_t getNumFramesToKeepInstances() const { return numFramesToKeepInstances(); }
     uint32_t getNumFramesToKeepBLAS() const { return numFramesToKeepBLAS(); }
+    uint32_t getBlasPoolBudgetMB() const { return blasPoolBudgetMB(); }
+    bool getEnableMemoryDefrag() const { return enableMemoryDefrag(); }
+    float getMemoryDefragMaxChunkOccupancy() const { return memoryDefragMaxChunkOccupancy(); }
+    uint32_t getMemoryDefragBudgetMB() const { return memoryDefragBudgetMB(); }
+    uint32_t getMemoryDefragMaxEvacuatingChunks() const { return memoryDefragMaxEvacuatingChunks(); }
     uint32_t getNumFramesToKeepLights() const { return numFramesToKeepLights(); }
     uint32_t getNumFramesToPutLightsToSleep() const { return numFramesToKeepLights() /2; }
     float getMeterToWorldUnitScale() const { return 100.f * getSceneScale(); } // T-Rex world unit is in 1cm 
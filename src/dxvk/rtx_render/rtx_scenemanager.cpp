@@ -41,6 +41,7 @@
 #include "rtx_intersection_test_helpers.h"
 
 #include "dxvk_scoped_annotation.h"
+#include "../../util/log/metrics.h"
 
 namespace dxvk {
 
@@ -144,22 +145,19 @@ namespace dxvk {
     if (!RtxOptions::Get()->enableAntiCulling())
     {
       if (m_device->getCurrentFrameId() > RtxOptions::Get()->numFramesToKeepGeometryData()) {
-        auto& entries = m_drawCallCache.getEntries();
         const size_t oldestFrame = m_device->getCurrentFrameId() - RtxOptions::Get()->numFramesToKeepGeometryData();
-        for (auto& iter = entries.begin(); iter != entries.end(); ) {
-          if (iter->second.frameLastTouched < oldestFrame) {
-            onSceneObjectDestroyed(iter->second, iter->first);
-            iter = entries.erase(iter);
-          } else {
-            ++iter;
+        m_drawCallCache.eraseIf([&](XXH64_hash_t hash, BlasEntry& blas) {
+          if (blas.frameLastTouched < oldestFrame) {
+            onSceneObjectDestroyed(blas, hash);
+            return true;
           }
-        }
+          return false;
+        });
       }
     }
     else { // Implement anti-culling object GC
-      auto& entries = m_drawCallCache.getEntries();
-      for (auto& iter = entries.begin(); iter != entries.end(); ++iter) {
-        for (const RtInstance* instance : iter->second.getLinkedInstances()) {
+      m_drawCallCache.forEach([&](BlasEntry& blas) {
+        for (const RtInstance* instance : blas.getLinkedInstances()) {
           // No need to do frustum check for instances under the keeping threshold
           const uint32_t numFramesToKeepInstances = RtxOptions::Get()->getNumFramesToKeepInstances();
           const uint32_t currentFrame = m_device->getCurrentFrameId();
@@ -170,8 +168,9 @@ namespace dxvk {
           const Matrix4 objectToView = m_cameraManager.getMainCamera().getWorldToView(false) * instance->getBlas()->input.getTransformData().objectToWorld;
 
           bool isInsideFrustum = true;
-          if (instance->getBlas()->input.getGeometryData().futureBoundingBox.valid()) {
-            const AxisAlignBoundingBox boundingBox = instance->getBlas()->input.getGeometryData().boundingBox;
+          const RasterGeometry& geometryData = instance->getBlas()->input.getGeometryData();
+          if (geometryData.futureBoundingBox.valid() && !geometryData.boundingBox.isEmpty()) {
+            const AxisAlignBoundingBox boundingBox = geometryData.boundingBox;
             isInsideFrustum = boundingBoxIntersectsFrustum(m_cameraManager.getMainCamera().getFrustum(), boundingBox.minPos, boundingBox.maxPos, objectToView);
           }
           else {
@@ -187,7 +186,7 @@ namespace dxvk {
             instance->markAsOutsideFrustum();
           }
         }
-      }
+      });
     }
 
     // Demote high res material textures
@@ -202,6 +201,9 @@ namespace dxvk {
       }
     }
 
+    demoteTexturesForMemoryPressure();
+    m_device->getCommon()->getTextureManager().updateStreamingPriorities();
+
     // Perform GC on the other managers
     m_instanceManager.garbageCollection();
     m_accelManager.garbageCollection();
@@ -212,6 +214,180 @@ namespace dxvk {
   void SceneManager::destroy() {
   }
 
+  float SceneManager::computeScreenCoverage(const DrawCallState& drawCallState) const {
+    const AxisAlignBoundingBox& boundingBox = drawCallState.getGeometryData().boundingBox;
+    if (boundingBox.isEmpty()) {
+      // Bounds are unknown, treat the object as moderately sized on screen
+      return 1.f;
+    }
+
+    const Matrix4& objectToWorld = drawCallState.getTransformData().objectToWorld;
+
+    // Bounding sphere of the object in world space, scaled by the largest axis scale
+    const Vector3 objectCenter = (boundingBox.minPos + boundingBox.maxPos) * 0.5f;
+    const float objectRadius = length(boundingBox.maxPos - boundingBox.minPos) * 0.5f;
+    const float scale = std::max({ length(objectToWorld[0].xyz()), length(objectToWorld[1].xyz()), length(objectToWorld[2].xyz()) });
+
+    const Vector3 worldCenter = (objectToWorld * Vector4(objectCenter, 1.f)).xyz();
+    const float worldRadius = objectRadius * scale;
+
+    const RtCamera& camera = m_cameraManager.getMainCamera();
+    const float distance = length(worldCenter - camera.getPosition(false));
+
+    // Close enough to fill the view
+    constexpr float kMaxScreenCoverage = 4.f;
+    if (distance <= worldRadius) {
+      return kMaxScreenCoverage;
+    }
+
+    const float tanHalfFov = std::tan(camera.getFov() * 0.5f);
+    return std::min(worldRadius / (distance * std::max(tanHalfFov, 1e-3f)), kMaxScreenCoverage);
+  }
+
+  void SceneManager::demoteTexturesForMemoryPressure() {
+    RtxTextureManager& textureManager = m_device->getCommon()->getTextureManager();
+
+    // Demoted images are only freed once the frames using them retire, wait for that before re-evaluating
+    const uint32_t currentFrame = m_device->getCurrentFrameId();
+    if (m_lastPressureDemotionFrame != kInvalidFrameIndex && currentFrame < m_lastPressureDemotionFrame + kMaxFramesInFlight) {
+      return;
+    }
+
+    const uint64_t overBudgetBytes = textureManager.getVidMemOverBudget();
+    if (overBudgetBytes == 0) {
+      return;
+    }
+
+    // Textures in use this frame keep their mips, the rest go least useful first
+    std::vector<TextureRef*> candidates;
+    for (TextureRef& texture : m_textureCache.getObjectTable()) {
+      const Rc<ManagedTexture>& managedTexture = texture.getManagedTexture();
+      if (managedTexture != nullptr && managedTexture->canDemote && managedTexture->allMipsImageView != nullptr &&
+          texture.frameLastUsed != currentFrame) {
+        candidates.push_back(&texture);
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [currentFrame](const TextureRef* a, const TextureRef* b) {
+      return RtxTextureManager::streamingPriority(*a->getManagedTexture(), currentFrame) <
+             RtxTextureManager::streamingPriority(*b->getManagedTexture(), currentFrame);
+    });
+
+    uint64_t demotedBytes = 0;
+    uint32_t demotedCount = 0;
+    for (TextureRef* texture : candidates) {
+      if (demotedBytes >= overBudgetBytes) {
+        break;
+      }
+
+      demotedBytes += texture->getManagedTexture()->allMipsImageView->image()->memSize();
+      demotedCount++;
+      texture->demote();
+    }
+
+    if (demotedCount > 0) {
+      m_lastPressureDemotionFrame = currentFrame;
+    }
+
+    static const MetricId s_pressureDemotions = Metrics::registerCounter("texture_pressure_demotions");
+    Metrics::add(s_pressureDemotions, demotedCount);
+  }
+
+  void SceneManager::defragmentMemory(Rc<DxvkContext> ctx) {
+    ScopedCpuProfileZone();
+    if (!RtxOptions::Get()->getEnableMemoryDefrag())
+      return;
+
+    // Geometry caches of scene objects and the surface buffers can move, everything else stays where it is
+    std::vector<DefragPlanner::Allocation> allocations;
+    std::vector<BlasEntry*> owners;
+
+    auto addAllocation = [&](const Rc<DxvkBuffer>& buffer, BlasEntry* owner) {
+      if (buffer == nullptr || buffer->getMemory().chunkId() == 0)
+        return;
+
+      allocations.push_back({ buffer->getMemory().chunkId(), buffer->getMemory().length() });
+      owners.push_back(owner);
+    };
+
+    m_drawCallCache.forEach([&](BlasEntry& blas) {
+      addAllocation(blas.modifiedGeometryData.indexCacheBuffer, &blas);
+      addAllocation(blas.modifiedGeometryData.historyBuffer[0], &blas);
+      addAllocation(blas.modifiedGeometryData.historyBuffer[1], &blas);
+    });
+    addAllocation(m_accelManager.getSurfaceBuffer(), nullptr);
+    addAllocation(m_accelManager.getSurfaceMappingBuffer(), nullptr);
+
+    DxvkMemoryAllocator& memoryManager = m_device->getCommon()->memoryManager();
+
+    std::vector<DxvkMemoryChunkInfo> chunkInfos;
+    memoryManager.getChunkInfos(chunkInfos);
+
+    std::vector<DefragPlanner::Chunk> chunks;
+    chunks.reserve(chunkInfos.size());
+    for (const DxvkMemoryChunkInfo& info : chunkInfos) {
+      chunks.push_back({ info.id, info.memoryType, info.size, info.usedBytes });
+    }
+
+    DefragPlanner::Settings settings;
+    settings.maxOccupancy = RtxOptions::Get()->getMemoryDefragMaxChunkOccupancy();
+    settings.budgetBytesPerFrame = uint64_t(RtxOptions::Get()->getMemoryDefragBudgetMB()) << 20;
+    settings.maxEvacuatingChunks = RtxOptions::Get()->getMemoryDefragMaxEvacuatingChunks();
+
+    const uint32_t previouslyEvacuated = m_defragPlanner.getReport().evacuatedChunks;
+
+    std::vector<uint64_t> evacuate;
+    std::vector<uint64_t> restore;
+    std::vector<uint32_t> moves;
+    m_defragPlanner.update(settings, chunks, allocations, evacuate, restore, moves);
+
+    for (uint64_t chunkId : restore) {
+      memoryManager.setChunkEvacuating(chunkId, false);
+    }
+
+    // Stop allocating from the chunks before moving anything out of them
+    for (uint64_t chunkId : evacuate) {
+      memoryManager.setChunkEvacuating(chunkId, true);
+    }
+
+    for (uint32_t move : moves) {
+      const uint64_t chunkId = allocations[move].chunkId;
+      BlasEntry* blas = owners[move];
+
+      if (blas == nullptr) {
+        m_accelManager.relocateSurfaceBuffers(ctx, chunkId);
+        continue;
+      }
+
+      // All the buffers of a scene object in the chunk move at once, later moves of the same object find nothing left
+      RaytraceGeometry relocatedGeometryData = blas->modifiedGeometryData;
+      if (!RtxGeometryUtils::relocateGeometryCache(ctx, chunkId, relocatedGeometryData))
+        continue;
+
+      // The buffer slices changed, so they need new bindless indices, and the instances need to see them
+      updateBufferCache(blas->modifiedGeometryData, relocatedGeometryData);
+      blas->modifiedGeometryData = relocatedGeometryData;
+      m_instanceManager.refreshInstanceBuffers(*blas);
+    }
+
+    const DefragPlanner::Report& report = m_defragPlanner.getReport();
+
+    if (report.evacuatedChunks != previouslyEvacuated) {
+      Logger::debug(str::format("[RTX] Memory defragmentation released ", report.evacuatedChunks - previouslyEvacuated, " chunk(s), ",
+                                report.reclaimedBytes >> 20, " MB reclaimed in total"));
+    }
+
+    static const MetricId s_movedBytes = Metrics::registerGauge("defrag_moved_mb");
+    static const MetricId s_reclaimedBytes = Metrics::registerGauge("defrag_reclaimed_mb");
+    static const MetricId s_evacuatingChunks = Metrics::registerGauge("defrag_evacuating_chunks");
+
+    if (Metrics::enabled()) {
+      Metrics::set(s_movedBytes, report.movedBytes / (1024.0 * 1024.0));
+      Metrics::set(s_reclaimedBytes, report.reclaimedBytes / (1024.0 * 1024.0));
+      Metrics::set(s_evacuatingChunks, report.evacuatingChunks);
+    }
+  }
+
   template<bool isNew>
   SceneManager::ObjectCacheState SceneManager::processGeometryInfo(Rc<DxvkContext> ctx, Rc<DxvkCommandList> cmd, const DrawCallState& drawCallState, RaytraceGeometry& inOutGeometry) {
     ScopedCpuProfileZone();
@@ -358,6 +534,7 @@ namespace dxvk {
 
     m_cameraManager.onFrameEnd();
     m_instanceManager.onFrameEnd();
+    m_drawCallRecorder.onFrameEnd(m_device->getCurrentFrameId());
     m_previousFrameSceneAvailable = true;
 
     if (RtxOptions::Get()->resetBufferCacheOnEveryFrame())
@@ -371,6 +548,8 @@ namespace dxvk {
 
   void SceneManager::submitDrawState(Rc<DxvkContext> ctx, Rc<DxvkCommandList> cmd, const DrawCallState& input) {
     ScopedCpuProfileZone();
+    m_drawCallRecorder.onDrawCall(input);
+
     const uint32_t kBufferCacheLimit = kSurfaceInvalidBufferIndex - 10; // Limit for unique buffers minus some padding
     if (m_bufferCache.getTotalCount() >= kBufferCacheLimit && m_bufferCache.getActiveCount() >= kBufferCacheLimit) {
       Logger::info("[RTX-Compatibility-Info] This application is pushing more unique buffers than is currently supported - some objects may not raytrace.");
@@ -787,7 +966,7 @@ namespace dxvk {
   }
 
   // Helper to populate the texture cache with this resource (and patch sampler if required for texture)
-  void SceneManager::trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool patchSampler, bool allowAsync) {
+  void SceneManager::trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool patchSampler, bool allowAsync, float screenCoverage) {
     // If no texcoords, no need to bind the texture
     if (!hasTexcoords) {
       ONCE(Logger::info(str::format("[RTX-Compatibility-Info] Trying to bind a texture to a mesh without UVs.  Was this intended?")));
@@ -804,6 +983,11 @@ namespace dxvk {
     // Fetch the texture object from cache
     TextureRef& cachedTexture = m_textureCache.at(textureIndex);
 
+    // Drives the upload order and eviction of streamed textures
+    if (cachedTexture.getManagedTexture() != nullptr) {
+      cachedTexture.getManagedTexture()->recordDemand(ctx->getDevice()->getCurrentFrameId(), screenCoverage);
+    }
+
     // If there is a pending promotion, schedule its upload
     if (cachedTexture.isPromotable()) {
       Rc<DxvkContext> dxvkCtx = ctx;
@@ -859,6 +1043,7 @@ namespace dxvk {
     std::optional<RtSurfaceMaterial> surfaceMaterial{};
 
     const bool hasTexcoords = drawCallState.hasTextureCoordinates();
+    const float screenCoverage = computeScreenCoverage(drawCallState);
 
     if (renderMaterialDataType == MaterialDataType::Legacy || renderMaterialDataType == MaterialDataType::Opaque) {
       uint32_t albedoOpacityTextureIndex = kSurfaceMaterialInvalidTextureIndex;
@@ -907,7 +1092,7 @@ namespace dxvk {
           roughnessConstant = 1.f;
         } else {
           if(defaults.useAlbedoTextureIfPresent())
-            trackTexture(ctx, legacyMaterialData.getColorTexture(), albedoOpacityTextureIndex, hasTexcoords, false); // NOTE: Do not patch original sampler
+            trackTexture(ctx, legacyMaterialData.getColorTexture(), albedoOpacityTextureIndex, hasTexcoords, false, true, screenCoverage); // NOTE: Do not patch original sampler
         }
 
         if (RtxOptions::Get()->getHighlightLegacyModeEnabled()) {
@@ -943,18 +1128,18 @@ namespace dxvk {
           metallicConstant = 0.f;
           roughnessConstant = 1.f;
         } else {
-          trackTexture(ctx, opaqueMaterialData.getAlbedoOpacityTexture(), albedoOpacityTextureIndex, hasTexcoords);
-          trackTexture(ctx, opaqueMaterialData.getRoughnessTexture(), roughnessTextureIndex, hasTexcoords);
-          trackTexture(ctx, opaqueMaterialData.getMetallicTexture(), metallicTextureIndex, hasTexcoords);
+          trackTexture(ctx, opaqueMaterialData.getAlbedoOpacityTexture(), albedoOpacityTextureIndex, hasTexcoords, true, true, screenCoverage);
+          trackTexture(ctx, opaqueMaterialData.getRoughnessTexture(), roughnessTextureIndex, hasTexcoords, true, true, screenCoverage);
+          trackTexture(ctx, opaqueMaterialData.getMetallicTexture(), metallicTextureIndex, hasTexcoords, true, true, screenCoverage);
 
           albedoOpacityConstant = opaqueMaterialData.getAlbedoOpacityConstant();
           metallicConstant = opaqueMaterialData.getMetallicConstant();
           roughnessConstant = opaqueMaterialData.getRoughnessConstant();
         }
 
-        trackTexture(ctx, opaqueMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords);
-        trackTexture(ctx, opaqueMaterialData.getTangentTexture(), tangentTextureIndex, hasTexcoords);
-        trackTexture(ctx, opaqueMaterialData.getEmissiveColorTexture(), emissiveColorTextureIndex, hasTexcoords);
+        trackTexture(ctx, opaqueMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords, true, true, screenCoverage);
+        trackTexture(ctx, opaqueMaterialData.getTangentTexture(), tangentTextureIndex, hasTexcoords, true, true, screenCoverage);
+        trackTexture(ctx, opaqueMaterialData.getEmissiveColorTexture(), emissiveColorTextureIndex, hasTexcoords, true, true, screenCoverage);
 
         emissiveIntensity = opaqueMaterialData.getEmissiveIntensity();
         emissiveColorConstant = opaqueMaterialData.getEmissiveColorConstant();
@@ -998,11 +1183,11 @@ namespace dxvk {
       bool enableEmissive = RtxOptions::Get()->getSharedMaterialDefaults().EnableEmissive;
       float emissiveIntensity = RtxOptions::Get()->getSharedMaterialDefaults().EmissiveIntensity;
 
-      trackTexture(ctx, translucentMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords);
+      trackTexture(ctx, translucentMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords, true, true, screenCoverage);
 
       refractiveIndex = translucentMaterialData.getRefractiveIndex();
 
-      trackTexture(ctx, translucentMaterialData.getTransmittanceTexture(), transmittanceTextureIndex, hasTexcoords);
+      trackTexture(ctx, translucentMaterialData.getTransmittanceTexture(), transmittanceTextureIndex, hasTexcoords, true, true, screenCoverage);
 
       transmittanceColor = translucentMaterialData.getTransmittanceColor();
       transmittanceMeasureDistance = translucentMaterialData.getTransmittanceMeasurementDistance();
@@ -1025,9 +1210,9 @@ namespace dxvk {
       const auto& rayPortalMaterialData = renderMaterialData.getRayPortalMaterialData();
 
       uint32_t maskTextureIndex = kSurfaceMaterialInvalidTextureIndex;
-      trackTexture(ctx, rayPortalMaterialData.getMaskTexture(), maskTextureIndex, hasTexcoords, true, false);
+      trackTexture(ctx, rayPortalMaterialData.getMaskTexture(), maskTextureIndex, hasTexcoords, true, false, screenCoverage);
       uint32_t maskTextureIndex2 = kSurfaceMaterialInvalidTextureIndex;
-      trackTexture(ctx, rayPortalMaterialData.getMaskTexture2(), maskTextureIndex2, hasTexcoords, true, false);
+      trackTexture(ctx, rayPortalMaterialData.getMaskTexture2(), maskTextureIndex2, hasTexcoords, true, false, screenCoverage);
 
       uint8_t rayPortalIndex = rayPortalMaterialData.getRayPortalIndex();
       uint8_t spriteSheetRows = rayPortalMaterialData.getSpriteSheetRows();
@@ -1097,6 +1282,8 @@ namespace dxvk {
     m_lightManager.dynamicLightMatching();
 
     garbageCollection();
+
+    defragmentMemory(ctx);
     
     m_bindlessResourceManager.prepareSceneData(cmdList, getTextureTable(), getBufferTable());
 
@@ -34,10 +34,12 @@
 #include "../dxvk_bind_mask.h"
 #include "../dxvk_cmdlist.h"
 #include "../util/util_hashtable.h"
+#include "../util/util_defrag_planner.h"
 
 #include "rtx_types.h"
 #include "rtx_cameramanager.h"
 #include "rtx_drawcallcache.h"
+#include "rtx_drawcall_recorder.h"
 #include "rtx_sparseuniquecache.h"
 #include "rtx_sparserefcountcache.h"
 #include "rtx_lightmanager.h"
@@ -173,7 +175,7 @@ public:
 
   void finalizeAllPendingTexturePromotions();
 
-  void trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool patchSampler = true, bool allowAsync = true);
+  void trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool patchSampler = true, bool allowAsync = true, float screenCoverage = 1.f);
 
 private:
   enum class ObjectCacheState
@@ -212,6 +214,15 @@ private:
 
   void createEffectLight(Rc<DxvkContext> ctx, const DrawCallState& input, const RtInstance* instance);
 
+  // Projected size of a scene object's bounds, in viewport heights
+  float computeScreenCoverage(const DrawCallState& drawCallState) const;
+
+  // Demotes the least useful material textures while video memory is over budget
+  void demoteTexturesForMemoryPressure();
+
+  // Moves geometry buffers out of sparsely used memory chunks, a budgeted amount each frame
+  void defragmentMemory(Rc<DxvkContext> ctx);
+
   Rc<GameCapturer> m_gameCapturer;
   uint32_t m_beginUsdExportFrameNum = -1;
   bool m_enqueueDelayedClear = false;
@@ -227,6 +238,9 @@ private:
   VolumeManager m_volumeManager;
 
   DrawCallCache m_drawCallCache;
+  DrawCallRecorder m_drawCallRecorder;
+
+  DefragPlanner m_defragPlanner;
 
   CameraManager m_cameraManager;
 
@@ -243,6 +257,7 @@ private:
   Rc<DxvkSampler> m_materialTextureSampler;
 
   uint32_t m_currentFrameIdx = -1;
+  uint32_t m_lastPressureDemotionFrame = kInvalidFrameIndex;
   bool m_useFixedFrameTime = false;
   std::chrono::time_point<std::chrono::system_clock> m_startTime;
 };
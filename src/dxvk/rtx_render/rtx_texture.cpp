@@ -71,23 +71,30 @@ namespace dxvk {
         }
       }
     } else {
-      uint64_t offset;
-      size_t size;
-      assetData->placement(layer, 0, assetBaseMip, offset, size);
-      // TODO: optimize
-      for (uint32_t n = 1; n < desc.mipLevels; n++) {
+      // Levels stored back to back (DDS) are read at once, other
+      // layouts (KTX2 stores the smallest level first) level by level.
+      RtxIo::FileSource src { assetFile, 0, 0, false };
+      RtxIo::ImageDest dst { image, static_cast<uint16_t>(layer), 0, 0 };
+
+      for (uint32_t n = 0; n < desc.mipLevels; n++) {
         uint64_t levelOffset;
         size_t levelSize;
         assetData->placement(layer, 0, n + assetBaseMip, levelOffset, levelSize);
-        size += levelSize;
-      }
 
-      RtxIo::FileSource src { assetFile, offset, size, false };
-      RtxIo::ImageDest dst {
-        image,
-        static_cast<uint16_t>(layer),
-        0, static_cast<uint16_t>(desc.mipLevels)
-      };
+        if (n == 0) {
+          src.offset = levelOffset;
+        } else if (levelOffset != src.offset + src.size) {
+          completionSyncpt = rtxio.enqueueRead(dst, src);
+
+          src.offset = levelOffset;
+          src.size = 0;
+          dst.startMip = static_cast<uint16_t>(n);
+          dst.count = 0;
+        }
+
+        src.size += levelSize;
+        dst.count++;
+      }
 
       completionSyncpt = rtxio.enqueueRead(dst, src);
     }
@@ -165,6 +172,41 @@ namespace dxvk {
 #endif
   }
 
+  // Size of levels [firstMip, lastMip] packed back to back, each level aligned to a cache line
+  static size_t getMipsStagingSize(const AssetInfo& assetInfo, const DxvkFormatInfo* formatInfo, int firstMip, int lastMip) {
+    size_t totalSize = 0;
+    for (int level = firstMip; level <= lastMip; ++level) {
+      const VkExtent3D levelExtent = util::computeMipLevelExtent(assetInfo.extent, level);
+      const VkExtent3D elementCount = util::computeBlockCount(levelExtent, formatInfo->blockSize);
+      const size_t levelSize = formatInfo->elementSize * util::flattenImageExtent(elementCount);
+      totalSize += align(levelSize, CACHE_LINE_SIZE);
+    }
+    return totalSize;
+  }
+
+  static void packMipsToStaging(AssetData& assetData, const DxvkFormatInfo* formatInfo, int firstMip, int lastMip, uint8_t* pDst) {
+    const AssetInfo& assetInfo = assetData.info();
+
+    uintptr_t pBaseDst = (uintptr_t) pDst;
+    for (int level = firstMip; level <= lastMip; ++level) {
+      const VkExtent3D levelExtent = util::computeMipLevelExtent(assetInfo.extent, level);
+      const VkExtent3D elementCount = util::computeBlockCount(levelExtent, formatInfo->blockSize);
+      const uint32_t rowPitch = elementCount.width * formatInfo->elementSize;
+      const uint32_t layerPitch = rowPitch * elementCount.height;
+
+      const void* pSrc = assetData.data(0, level);
+      if (pSrc == nullptr) {
+        throw DxvkError(str::format("Failed to read texture data of mip level ", level));
+      }
+
+      // Copy to the correct offset
+      util::packImageData((void*) pBaseDst, pSrc, elementCount, formatInfo->elementSize, rowPitch, layerPitch);
+
+      const size_t levelSize = formatInfo->elementSize * util::flattenImageExtent(elementCount);
+      pBaseDst += align(levelSize, CACHE_LINE_SIZE);
+    }
+  }
+
   void TextureUtils::loadTextureToVidmem(Rc<ManagedTexture> texture, const Rc<DxvkDevice>& device, const Rc<DxvkContext>& ctx) {
     auto& assetData = *texture->assetData;
     auto& assetInfo = assetData.info();
@@ -248,32 +290,12 @@ namespace dxvk {
       break;
     }
 
-    // First get total size of staging buffer
-    size_t totalSize = 0;
-    for (uint32_t level = firstMip; level <= lastMip; ++level) {
-      const VkExtent3D levelExtent = util::computeMipLevelExtent(assetInfo.extent, level);
-      const VkExtent3D elementCount = util::computeBlockCount(levelExtent, formatInfo->blockSize);
-      const size_t levelSize = formatInfo->elementSize * util::flattenImageExtent(elementCount);
-      totalSize += align(levelSize, CACHE_LINE_SIZE);
-    }
-
     // Allocate staging resource
+    const size_t totalSize = getMipsStagingSize(assetInfo, formatInfo, firstMip, lastMip);
     std::shared_ptr<uint8_t> pStagingData(new uint8_t[totalSize], std::default_delete<uint8_t[]>());
-    uintptr_t pBaseDst = (uintptr_t) pStagingData.get();
 
     // Copy the data to staging
-    for (uint32_t level = firstMip; level <= lastMip; ++level) {
-      const VkExtent3D levelExtent = util::computeMipLevelExtent(assetInfo.extent, level);
-      const VkExtent3D elementCount = util::computeBlockCount(levelExtent, formatInfo->blockSize);
-      const uint32_t rowPitch = elementCount.width * formatInfo->elementSize;
-      const uint32_t layerPitch = rowPitch * elementCount.height;
-
-      // Copy to the correct offset
-      util::packImageData((void*) pBaseDst, assetData.data(0, level), elementCount, formatInfo->elementSize, rowPitch, layerPitch);
-
-      const size_t levelSize = formatInfo->elementSize * util::flattenImageExtent(elementCount);
-      pBaseDst += align(levelSize, CACHE_LINE_SIZE);
-    }
+    packMipsToStaging(assetData, formatInfo, firstMip, lastMip, pStagingData.get());
 
     if (loadLowMips) {
       texture->linearImageDataLargeMips = pStagingData;
@@ -287,7 +309,24 @@ namespace dxvk {
     }
   }
 
-  void TextureUtils::promoteHostToVid(const Rc<DxvkDevice>& device, const Rc<DxvkContext>& ctx, const Rc<ManagedTexture>& texture, uint32_t minMipLevel) {
+  size_t TextureUtils::getLargeMipsStagingSize(const Rc<ManagedTexture>& texture) {
+    const AssetInfo& assetInfo = texture->assetData->info();
+    return getMipsStagingSize(assetInfo, imageFormatInfo(assetInfo.format), 0, texture->numLargeMips - 1);
+  }
+
+  void TextureUtils::packLargeMips(const Rc<ManagedTexture>& texture, void* pDst) {
+    ScopedCpuProfileZone();
+
+    AssetData& assetData = *texture->assetData;
+    std::lock_guard<dxvk::mutex> lock(assetData.cacheMutex());
+
+    packMipsToStaging(assetData, imageFormatInfo(assetData.info().format), 0, texture->numLargeMips - 1, static_cast<uint8_t*>(pDst));
+
+    assetData.evictCache();
+  }
+
+  void TextureUtils::promoteHostToVid(const Rc<DxvkDevice>& device, const Rc<DxvkContext>& ctx, const Rc<ManagedTexture>& texture, uint32_t minMipLevel,
+                                      const DxvkBufferSlice& largeMipsStaging) {
     ScopedGpuProfileZone(ctx, "promoteHostToVid");
 
     if (texture->state == ManagedTexture::State::kVidMem) {
@@ -322,8 +361,10 @@ namespace dxvk {
         const uint32_t rowPitch = elementCount.width * formatInfo->elementSize;
         const uint32_t layerPitch = rowPitch * elementCount.height;
 
-        uint8_t* ptr;
-        if (level < texture->numLargeMips) {
+        if (level < texture->numLargeMips && largeMipsStaging.defined()) {
+          ctx->copyBufferToImage(image, subresourceLayers, VkOffset3D { 0, 0, 0 }, image->mipLevelExtent(level),
+                                 largeMipsStaging.buffer(), largeMipsStaging.offset() + currentOffsetLow, 0, 0);
+        } else if (level < texture->numLargeMips) {
           assert(texture->linearImageDataLargeMips);
           ctx->uploadImage(image, subresourceLayers, texture->linearImageDataLargeMips.get() + currentOffsetLow, rowPitch, layerPitch);
         } else {
@@ -359,6 +400,10 @@ namespace dxvk {
     }
   }
 
+  bool TextureUtils::loadsThroughRtxIo(const Rc<ManagedTexture>& texture) {
+    return RtxIo::enabled() && texture->assetData->info().compression != AssetCompression::LZ4;
+  }
+
   Rc<ManagedTexture> TextureUtils::createTexture(const Rc<AssetData>& assetData, ColorSpace colorSpace) {
     Rc<ManagedTexture> texture = new ManagedTexture();
 
@@ -428,7 +473,10 @@ namespace dxvk {
     texture->futureImageDesc.extent = texture->assetData->info().extent;
     texture->futureImageDesc.mipLevels = texture->assetData->info().mipLevels;
 
-    if (RtxIo::enabled()) {
+    // Upload workers may be packing another texture of the same asset
+    std::lock_guard<dxvk::mutex> lock(texture->assetData->cacheMutex());
+
+    if (loadsThroughRtxIo(texture)) {
       loadTextureRtxIo(texture, device, mipsToLoad);
     } else if (mem == MemoryAperture::HOST) {
       loadTextureToHostStagingBuffer(texture, device, mipsToLoad);
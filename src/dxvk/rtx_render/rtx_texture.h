@@ -37,11 +37,6 @@ namespace dxvk {
   // Sentinel value used to indicate a key needs to be generated for this object.
   static const size_t kInvalidTextureKey = ~0ull;
 
-  enum class ColorSpace {
-    FORCE_BC_SRGB,
-    AUTO
-  };
-
   // The ManagedTexture holds streaming state for a given texture.
   //  A texture can be loaded in many states, if it's initial 
   //  memory location is host (system) memory, then there are 
@@ -97,10 +92,23 @@ namespace dxvk {
     bool canDemote = true;
     uint32_t frameQueuedForUpload = 0;
 
+    // Streaming demand: largest screen coverage (in viewport heights) of the texture in frameLastUsed
+    float demand = 0.f;
+    uint32_t frameLastUsed = 0;
+
     bool good() const {
       return state != State::kUnknown && state != State::kFailed;
     }
 
+    void recordDemand(uint32_t frameId, float screenCoverage) {
+      if (frameId != frameLastUsed) {
+        frameLastUsed = frameId;
+        demand = screenCoverage;
+      } else {
+        demand = std::max(demand, screenCoverage);
+      }
+    }
+
     void demote() {
       if (canDemote && (state == ManagedTexture::State::kVidMem || state == ManagedTexture::State::kFailed)) {
         // Evict large image
@@ -286,7 +294,19 @@ namespace dxvk {
     // TODO: to be moved
     static void loadTexture(Rc<ManagedTexture> texture, const Rc<DxvkDevice>& device, const Rc<DxvkContext>& context, const MemoryAperture mem, MipsToLoad mipsToLoad, int minimumMipLevel = -1);
 
-    static void promoteHostToVid(const Rc<DxvkDevice>& device, const Rc<DxvkContext>& ctx, const Rc<ManagedTexture>& texture, uint32_t minMipLevel = 0);
+    // Large mips are read from largeMipsStaging when defined, packed as by packLargeMips(), rather than from linearImageDataLargeMips
+    static void promoteHostToVid(const Rc<DxvkDevice>& device, const Rc<DxvkContext>& ctx, const Rc<ManagedTexture>& texture, uint32_t minMipLevel = 0,
+                                 const DxvkBufferSlice& largeMipsStaging = DxvkBufferSlice());
+
+    // Size of the large mips of a host resident texture once packed for upload
+    static size_t getLargeMipsStagingSize(const Rc<ManagedTexture>& texture);
+
+    // Packs the large mips of a host resident texture into pDst. May run on any thread, the asset's cache is locked
+    // since other textures may share it.
+    static void packLargeMips(const Rc<ManagedTexture>& texture, void* pDst);
+
+    // True when the texture data is streamed by RTX IO, LZ4 packaged assets are always decoded on the CPU
+    static bool loadsThroughRtxIo(const Rc<ManagedTexture>& texture);
 
   private:
 
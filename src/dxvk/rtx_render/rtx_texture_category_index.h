@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+
+#include "../../util/util_flat_hash_map.h"
+#include "../../util/xxHash/xxhash.h"
+
+namespace dxvk {
+  // Texture hash lists of RtxOptions a draw call's material is checked against
+  enum class TextureCategory : uint32_t {
+    Lightmap,
+    SkyBox,
+    Ignore,
+    IgnoreLight,
+    Ui,
+    WorldSpaceUi,
+    WorldSpaceUiBackground,
+    HideInstance,
+    PlayerModel,
+    PlayerModelBody,
+    LightConverter,
+    Particle,
+    Beam,
+    Decal,
+    DynamicDecal,
+    NonOffsetDecal,
+    Terrain,
+    Cutout,
+    OpacityMicromapIgnore,
+    AnimatedWater,
+    AntiCulling,
+
+    Count
+  };
+
+  /**
+    * \brief Categories of every listed texture hash, in one table.
+    *
+    *  Maps a texture hash to the bitmask of the categories listing it, so
+    *  all the categories of a texture are found with a single lookup
+    *  instead of one per category set.  Hashes in no category are not
+    *  stored and map to an empty mask.  Built from the category sets and
+    *  rebuilt from scratch when any of them changes.
+    */
+  class TextureCategoryIndex {
+  public:
+    using Mask = uint32_t;
+
+    static_assert(uint32_t(TextureCategory::Count) <= sizeof(Mask) * 8, "Too many texture categories for the mask.");
+
+    static constexpr Mask bit(TextureCategory category) {
+      return Mask(1) << uint32_t(category);
+    }
+
+    static constexpr bool has(Mask mask, TextureCategory category) {
+      return (mask & bit(category)) != 0;
+    }
+
+    void clear() {
+      m_masks.clear();
+    }
+
+    void reserve(size_t count) {
+      m_masks.reserve(count);
+    }
+
+    // Adds every hash of a category set
+    void add(TextureCategory category, const std::unordered_set<XXH64_hash_t>& hashes) {
+      for (const XXH64_hash_t hash : hashes) {
+        m_masks[hash] |= bit(category);
+      }
+    }
+
+    Mask lookup(XXH64_hash_t hash) const {
+      auto it = m_masks.find(hash);
+      return it != m_masks.end() ? it->second : 0;
+    }
+
+    // Number of distinct hashes listed in any category
+    size_t size() const {
+      return m_masks.size();
+    }
+
+  private:
+    // Texture hashes are uniformly distributed already
+    struct Passthrough {
+      size_t operator()(XXH64_hash_t hash) const {
+        return size_t(hash);
+      }
+    };
+
+    FlatHashMap<XXH64_hash_t, Mask, Passthrough> m_masks;
+  };
+}
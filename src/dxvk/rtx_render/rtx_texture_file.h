@@ -0,0 +1,367 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../util/util_bit.h"
+
+namespace dxvk {
+
+  // Layout of the image data in a DDS or KTX2 file, parsed from the file header alone.
+  // Every sub-resource (a mip level of a layer face) is addressed by its byte range in
+  // the file, so mips can be read one at a time without touching the rest of the file.
+  // Files which need conversion (paletted, packed luminance/alpha, supercompressed KTX2,
+  // ...) are rejected, callers fall back to a full loader for those.
+  struct TextureFileLayout {
+    enum class Container {
+      DDS,
+      KTX2,
+    };
+
+    struct Subresource {
+      uint64_t offset;
+      size_t size;
+    };
+
+    // Enough for the DDS header, or a KTX2 header with a full 16 level index
+    static constexpr size_t kMaxHeaderSize = 512;
+
+    Container container = Container::DDS;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;
+    uint32_t levels = 0;
+    uint32_t layers = 0;
+    uint32_t faces = 0;
+
+    // Indexed by (layer * faces + face) * levels + level
+    std::vector<Subresource> subresources;
+
+    const Subresource& subresource(uint32_t layer, uint32_t face, uint32_t level) const {
+      return subresources[(layer * faces + face) * levels + level];
+    }
+
+    /**
+      * \brief Parses the layout of a texture file
+      *
+      *   header [in]: the first bytes of the file, up to kMaxHeaderSize
+      *   headerSize [in]: number of bytes in header
+      *   fileSize [in]: size of the whole file, every sub-resource must fit in it
+      *   returns: true if the file is a supported DDS or KTX2 file
+      */
+    bool parse(const uint8_t* header, size_t headerSize, uint64_t fileSize) {
+      subresources.clear();
+
+      if (headerSize >= sizeof(kKtx2Identifier) && memcmp(header, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+        container = Container::KTX2;
+        return parseKtx2(header, headerSize, fileSize);
+      }
+
+      if (headerSize >= 4 && read<uint32_t>(header, 0) == kDdsMagic) {
+        container = Container::DDS;
+        return parseDds(header, headerSize, fileSize);
+      }
+
+      return false;
+    }
+
+  private:
+    static constexpr uint32_t kDdsMagic = 0x20534444; // "DDS "
+    static constexpr uint8_t kKtx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    static constexpr uint32_t kMaxLevels = 16;
+
+    // DDS_HEADER and DDS_HEADER_DXT10 offsets, relative to the start of the file
+    static constexpr size_t kDdsHeaderSize = 4 + 124;
+    static constexpr size_t kDdsHeader10Size = 20;
+
+    static constexpr uint32_t kDdsdMipMapCount = 0x20000;
+    static constexpr uint32_t kDdpfAlphaPixels = 0x1;
+    static constexpr uint32_t kDdpfFourCC = 0x4;
+    static constexpr uint32_t kDdpfRgb = 0x40;
+    static constexpr uint32_t kDdpfLuminance = 0x20000;
+    static constexpr uint32_t kDdsCaps2Cubemap = 0x200;
+    static constexpr uint32_t kDdsCaps2CubemapAllFaces = 0xFC00;
+    static constexpr uint32_t kDdsCaps2Volume = 0x200000;
+    static constexpr uint32_t kDx10Texture3D = 4;
+    static constexpr uint32_t kDx10MiscTextureCube = 0x4;
+
+    struct FormatDesc {
+      VkFormat format;
+      uint32_t blockBytes;
+      uint32_t blockExtent;
+    };
+
+    template<typename T>
+    static T read(const uint8_t* data, size_t offset) {
+      T value;
+      memcpy(&value, data + offset, sizeof(T));
+      return value;
+    }
+
+    static constexpr uint32_t fourCC(char a, char b, char c, char d) {
+      return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+    }
+
+    static uint32_t maxLevels(uint32_t width, uint32_t height, uint32_t depth) {
+      return 32 - bit::lzcnt(std::max({ width, height, depth }));
+    }
+
+    static bool getDxgiFormat(uint32_t dxgiFormat, FormatDesc& desc) {
+      switch (dxgiFormat) {
+      case 2:  desc = { VK_FORMAT_R32G32B32A32_SFLOAT, 16, 1 }; return true;
+      case 3:  desc = { VK_FORMAT_R32G32B32A32_UINT, 16, 1 }; return true;
+      case 4:  desc = { VK_FORMAT_R32G32B32A32_SINT, 16, 1 }; return true;
+      case 6:  desc = { VK_FORMAT_R32G32B32_SFLOAT, 12, 1 }; return true;
+      case 10: desc = { VK_FORMAT_R16G16B16A16_SFLOAT, 8, 1 }; return true;
+      case 11: desc = { VK_FORMAT_R16G16B16A16_UNORM, 8, 1 }; return true;
+      case 12: desc = { VK_FORMAT_R16G16B16A16_UINT, 8, 1 }; return true;
+      case 13: desc = { VK_FORMAT_R16G16B16A16_SNORM, 8, 1 }; return true;
+      case 14: desc = { VK_FORMAT_R16G16B16A16_SINT, 8, 1 }; return true;
+      case 16: desc = { VK_FORMAT_R32G32_SFLOAT, 8, 1 }; return true;
+      case 24: desc = { VK_FORMAT_A2B10G10R10_UNORM_PACK32, 4, 1 }; return true;
+      case 26: desc = { VK_FORMAT_B10G11R11_UFLOAT_PACK32, 4, 1 }; return true;
+      case 28: desc = { VK_FORMAT_R8G8B8A8_UNORM, 4, 1 }; return true;
+      case 29: desc = { VK_FORMAT_R8G8B8A8_SRGB, 4, 1 }; return true;
+      case 31: desc = { VK_FORMAT_R8G8B8A8_SNORM, 4, 1 }; return true;
+      case 34: desc = { VK_FORMAT_R16G16_SFLOAT, 4, 1 }; return true;
+      case 35: desc = { VK_FORMAT_R16G16_UNORM, 4, 1 }; return true;
+      case 37: desc = { VK_FORMAT_R16G16_SNORM, 4, 1 }; return true;
+      case 41: desc = { VK_FORMAT_R32_SFLOAT, 4, 1 }; return true;
+      case 49: desc = { VK_FORMAT_R8G8_UNORM, 2, 1 }; return true;
+      case 51: desc = { VK_FORMAT_R8G8_SNORM, 2, 1 }; return true;
+      case 54: desc = { VK_FORMAT_R16_SFLOAT, 2, 1 }; return true;
+      case 56: desc = { VK_FORMAT_R16_UNORM, 2, 1 }; return true;
+      case 61: desc = { VK_FORMAT_R8_UNORM, 1, 1 }; return true;
+      case 63: desc = { VK_FORMAT_R8_SNORM, 1, 1 }; return true;
+      case 71: desc = { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, 4 }; return true;
+      case 72: desc = { VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8, 4 }; return true;
+      case 74: desc = { VK_FORMAT_BC2_UNORM_BLOCK, 16, 4 }; return true;
+      case 75: desc = { VK_FORMAT_BC2_SRGB_BLOCK, 16, 4 }; return true;
+      case 77: desc = { VK_FORMAT_BC3_UNORM_BLOCK, 16, 4 }; return true;
+      case 78: desc = { VK_FORMAT_BC3_SRGB_BLOCK, 16, 4 }; return true;
+      case 80: desc = { VK_FORMAT_BC4_UNORM_BLOCK, 8, 4 }; return true;
+      case 81: desc = { VK_FORMAT_BC4_SNORM_BLOCK, 8, 4 }; return true;
+      case 83: desc = { VK_FORMAT_BC5_UNORM_BLOCK, 16, 4 }; return true;
+      case 84: desc = { VK_FORMAT_BC5_SNORM_BLOCK, 16, 4 }; return true;
+      case 85: desc = { VK_FORMAT_R5G6B5_UNORM_PACK16, 2, 1 }; return true;
+      case 87: desc = { VK_FORMAT_B8G8R8A8_UNORM, 4, 1 }; return true;
+      case 91: desc = { VK_FORMAT_B8G8R8A8_SRGB, 4, 1 }; return true;
+      case 95: desc = { VK_FORMAT_BC6H_UFLOAT_BLOCK, 16, 4 }; return true;
+      case 96: desc = { VK_FORMAT_BC6H_SFLOAT_BLOCK, 16, 4 }; return true;
+      case 98: desc = { VK_FORMAT_BC7_UNORM_BLOCK, 16, 4 }; return true;
+      case 99: desc = { VK_FORMAT_BC7_SRGB_BLOCK, 16, 4 }; return true;
+      default: return false;
+      }
+    }
+
+    static bool getFourCCFormat(uint32_t code, FormatDesc& desc) {
+      switch (code) {
+      case fourCC('D', 'X', 'T', '1'): desc = { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, 4 }; return true;
+      case fourCC('D', 'X', 'T', '2'):
+      case fourCC('D', 'X', 'T', '3'): desc = { VK_FORMAT_BC2_UNORM_BLOCK, 16, 4 }; return true;
+      case fourCC('D', 'X', 'T', '4'):
+      case fourCC('D', 'X', 'T', '5'): desc = { VK_FORMAT_BC3_UNORM_BLOCK, 16, 4 }; return true;
+      case fourCC('A', 'T', 'I', '1'):
+      case fourCC('B', 'C', '4', 'U'): desc = { VK_FORMAT_BC4_UNORM_BLOCK, 8, 4 }; return true;
+      case fourCC('B', 'C', '4', 'S'): desc = { VK_FORMAT_BC4_SNORM_BLOCK, 8, 4 }; return true;
+      case fourCC('A', 'T', 'I', '2'):
+      case fourCC('B', 'C', '5', 'U'): desc = { VK_FORMAT_BC5_UNORM_BLOCK, 16, 4 }; return true;
+      case fourCC('B', 'C', '5', 'S'): desc = { VK_FORMAT_BC5_SNORM_BLOCK, 16, 4 }; return true;
+      // D3DFORMAT values stored in place of a FourCC
+      case 36:  desc = { VK_FORMAT_R16G16B16A16_UNORM, 8, 1 }; return true;
+      case 111: desc = { VK_FORMAT_R16_SFLOAT, 2, 1 }; return true;
+      case 112: desc = { VK_FORMAT_R16G16_SFLOAT, 4, 1 }; return true;
+      case 113: desc = { VK_FORMAT_R16G16B16A16_SFLOAT, 8, 1 }; return true;
+      case 114: desc = { VK_FORMAT_R32_SFLOAT, 4, 1 }; return true;
+      case 115: desc = { VK_FORMAT_R32G32_SFLOAT, 8, 1 }; return true;
+      case 116: desc = { VK_FORMAT_R32G32B32A32_SFLOAT, 16, 1 }; return true;
+      default: return false;
+      }
+    }
+
+    static bool getMaskFormat(uint32_t flags, uint32_t bitCount, uint32_t r, uint32_t g, uint32_t b, uint32_t a, FormatDesc& desc) {
+      if (flags & kDdpfRgb) {
+        const bool hasAlpha = (flags & kDdpfAlphaPixels) != 0;
+
+        if (bitCount == 32 && hasAlpha && r == 0x00ff0000 && g == 0x0000ff00 && b == 0x000000ff && a == 0xff000000) {
+          desc = { VK_FORMAT_B8G8R8A8_UNORM, 4, 1 };
+          return true;
+        }
+        if (bitCount == 32 && hasAlpha && r == 0x000000ff && g == 0x0000ff00 && b == 0x00ff0000 && a == 0xff000000) {
+          desc = { VK_FORMAT_R8G8B8A8_UNORM, 4, 1 };
+          return true;
+        }
+        if (bitCount == 32 && !hasAlpha && r == 0x0000ffff && g == 0xffff0000 && b == 0) {
+          desc = { VK_FORMAT_R16G16_UNORM, 4, 1 };
+          return true;
+        }
+        if (bitCount == 16 && !hasAlpha && r == 0xf800 && g == 0x07e0 && b == 0x001f) {
+          desc = { VK_FORMAT_R5G6B5_UNORM_PACK16, 2, 1 };
+          return true;
+        }
+        return false;
+      }
+
+      if ((flags & kDdpfLuminance) && !(flags & kDdpfAlphaPixels)) {
+        if (bitCount == 8 && r == 0xff) {
+          desc = { VK_FORMAT_R8_UNORM, 1, 1 };
+          return true;
+        }
+        if (bitCount == 16 && r == 0xffff) {
+          desc = { VK_FORMAT_R16_UNORM, 2, 1 };
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    bool parseDds(const uint8_t* header, size_t headerSize, uint64_t fileSize) {
+      if (headerSize < kDdsHeaderSize || fileSize < kDdsHeaderSize)
+        return false;
+
+      const uint32_t flags = read<uint32_t>(header, 8);
+      const uint32_t pixelFlags = read<uint32_t>(header, 80);
+      const uint32_t code = read<uint32_t>(header, 84);
+      const uint32_t caps2 = read<uint32_t>(header, 112);
+
+      height = std::max(read<uint32_t>(header, 12), 1u);
+      width = std::max(read<uint32_t>(header, 16), 1u);
+      depth = (caps2 & kDdsCaps2Volume) ? std::max(read<uint32_t>(header, 24), 1u) : 1u;
+      levels = (flags & kDdsdMipMapCount) ? std::max(read<uint32_t>(header, 28), 1u) : 1u;
+      layers = 1;
+      faces = (caps2 & kDdsCaps2Cubemap) ? bit::popcnt(caps2 & kDdsCaps2CubemapAllFaces) : 1u;
+
+      uint64_t dataOffset = kDdsHeaderSize;
+      FormatDesc desc;
+
+      if ((pixelFlags & kDdpfFourCC) && code == fourCC('D', 'X', '1', '0')) {
+        if (headerSize < kDdsHeaderSize + kDdsHeader10Size)
+          return false;
+
+        const uint32_t dimension = read<uint32_t>(header, kDdsHeaderSize + 4);
+        const uint32_t miscFlags = read<uint32_t>(header, kDdsHeaderSize + 8);
+
+        if (!getDxgiFormat(read<uint32_t>(header, kDdsHeaderSize), desc))
+          return false;
+
+        layers = std::max(read<uint32_t>(header, kDdsHeaderSize + 12), 1u);
+        if (miscFlags & kDx10MiscTextureCube)
+          faces = 6;
+        if (dimension == kDx10Texture3D)
+          depth = std::max(read<uint32_t>(header, 24), 1u);
+
+        dataOffset += kDdsHeader10Size;
+      } else if (pixelFlags & kDdpfFourCC) {
+        if (!getFourCCFormat(code, desc))
+          return false;
+      } else if (!getMaskFormat(pixelFlags, read<uint32_t>(header, 88), read<uint32_t>(header, 92),
+                                read<uint32_t>(header, 96), read<uint32_t>(header, 100), read<uint32_t>(header, 104), desc)) {
+        return false;
+      }
+
+      if (faces == 0 || levels > std::min(kMaxLevels, maxLevels(width, height, depth)))
+        return false;
+
+      format = desc.format;
+
+      // All the levels of a layer face are stored back to back, largest first
+      std::vector<size_t> levelSizes(levels);
+      uint64_t faceSize = 0;
+      for (uint32_t level = 0; level < levels; level++) {
+        const uint64_t widthBlocks = (std::max(width >> level, 1u) + desc.blockExtent - 1) / desc.blockExtent;
+        const uint64_t heightBlocks = (std::max(height >> level, 1u) + desc.blockExtent - 1) / desc.blockExtent;
+        levelSizes[level] = size_t(widthBlocks * heightBlocks * std::max(depth >> level, 1u) * desc.blockBytes);
+        faceSize += levelSizes[level];
+      }
+
+      if (dataOffset + faceSize * layers * faces > fileSize)
+        return false;
+
+      subresources.reserve(layers * faces * levels);
+      uint64_t offset = dataOffset;
+      for (uint32_t face = 0; face < layers * faces; face++) {
+        for (uint32_t level = 0; level < levels; level++) {
+          subresources.push_back({ offset, levelSizes[level] });
+          offset += levelSizes[level];
+        }
+      }
+
+      return true;
+    }
+
+    bool parseKtx2(const uint8_t* header, size_t headerSize, uint64_t fileSize) {
+      static constexpr size_t kHeaderSize = 80;
+      static constexpr size_t kLevelDescSize = 24;
+
+      if (headerSize < kHeaderSize)
+        return false;
+
+      format = VkFormat(read<uint32_t>(header, 12));
+      width = std::max(read<uint32_t>(header, 20), 1u);
+      height = std::max(read<uint32_t>(header, 24), 1u);
+      depth = std::max(read<uint32_t>(header, 28), 1u);
+      layers = std::max(read<uint32_t>(header, 32), 1u);
+      faces = read<uint32_t>(header, 36);
+      levels = std::max(read<uint32_t>(header, 40), 1u);
+
+      // Supercompressed and Basis Universal files need transcoding
+      const uint32_t supercompression = read<uint32_t>(header, 44);
+      if (format == VK_FORMAT_UNDEFINED || supercompression != 0)
+        return false;
+
+      if ((faces != 1 && faces != 6) || levels > std::min(kMaxLevels, maxLevels(width, height, depth)))
+        return false;
+
+      if (headerSize < kHeaderSize + levels * kLevelDescSize)
+        return false;
+
+      // Each level holds the images of every layer face, levels are indexed largest first
+      subresources.resize(layers * faces * levels);
+      for (uint32_t level = 0; level < levels; level++) {
+        const uint64_t levelOffset = read<uint64_t>(header, kHeaderSize + level * kLevelDescSize);
+        const uint64_t levelSize = read<uint64_t>(header, kHeaderSize + level * kLevelDescSize + 8);
+
+        if (levelSize == 0 || levelSize % (layers * faces) != 0 || levelOffset > fileSize || levelSize > fileSize - levelOffset)
+          return false;
+
+        const uint64_t imageSize = levelSize / (layers * faces);
+        for (uint32_t face = 0; face < layers * faces; face++) {
+          subresources[face * levels + level] = { levelOffset + face * imageSize, size_t(imageSize) };
+        }
+      }
+
+      return true;
+    }
+  };
+
+} // namespace dxvk
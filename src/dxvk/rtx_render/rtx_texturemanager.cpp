@@ -22,6 +22,7 @@
 #include "rtx_texturemanager.h"
 #include "../../util/thread.h"
 #include "../../util/rc/util_rc_ptr.h"
+#include "../../util/log/metrics.h"
 #include "dxvk_context.h"
 #include "dxvk_device.h"
 #include "dxvk_scoped_annotation.h"
@@ -31,7 +32,7 @@
 #include "rtx_io.h"
 
 namespace dxvk {
-  void RtxTextureManager::work(Rc<ManagedTexture>& texture, Rc<DxvkContext>& ctx, Rc<DxvkCommandList>& cmd) {
+  void RtxTextureManager::work(Rc<ManagedTexture>& item, Rc<DxvkContext>& ctx, Rc<DxvkCommandList>& cmd) {
 #ifdef WITH_RTXIO
     if (m_kickoff || m_dropRequests) {
       if (RtxIo::enabled()) {
@@ -41,22 +42,38 @@ namespace dxvk {
     }
 #endif
 
+    // The processor item only stands for one pending upload, the upload queue picks the most wanted texture
+    uint64_t uploadBytes = 0;
+    Rc<ManagedTexture> texture = popUpload(uploadBytes);
+    if (texture == nullptr) {
+      // The texture went out with an earlier upload batch
+      return;
+    }
+
     const bool alwaysWait = RtxOptions::Get()->alwaysWaitForAsyncTextures();
 
     // Wait until the next frame since the texture's been queued for upload, to relieve some pressure from frames
     // where many new textures are created by the game. In that case, texture uploads slow down the main and CS threads,
     // thus making the frame longer.
     // Note: RTX IO will manage dispatches on its own and does not need to be cooled down.
-    if (!RtxIo::enabled()) {
+    if (!TextureUtils::loadsThroughRtxIo(texture)) {
       while (!m_dropRequests && !hasStopped() && !alwaysWait && texture->frameQueuedForUpload >= m_device->getCurrentFrameId())
         Sleep(1);
+
+      // Spread the uploads over frames once a frame's budget is spent
+      const uint64_t budgetBytes = uint64_t(RtxOptions::Get()->textureStreamingUploadBudgetMB()) << 20;
+      while (!m_dropRequests && !hasStopped() && !alwaysWait && !m_uploadBudget.tryConsume(m_device->getCurrentFrameId(), uploadBytes, budgetBytes))
+        Sleep(1);
     }
 
     if (m_dropRequests) {
       texture->state = ManagedTexture::State::kFailed;
       texture->demote();
-    } else
+    } else if (TextureUtils::loadsThroughRtxIo(texture)) {
       uploadTexture(texture, ctx);
+    } else {
+      uploadTextureBatch(std::move(texture), ctx);
+    }
   }
 
   RtxTextureManager::RtxTextureManager(const Rc<DxvkDevice>& device)
@@ -81,7 +98,7 @@ namespace dxvk {
       break;
     case ManagedTexture::State::kQueuedForUpload:
 #ifdef WITH_RTXIO
-      if (RtxIo::enabled()) {
+      if (TextureUtils::loadsThroughRtxIo(managedTexture)) {
         if (RtxIo::get().isComplete(managedTexture->completionSyncpt)) {
           managedTexture->state = ManagedTexture::State::kVidMem;
           texture.finalizePendingPromotion();
@@ -97,7 +114,7 @@ namespace dxvk {
 
     int preloadMips = allowAsync ? calcPreloadMips(managedTexture->futureImageDesc.mipLevels) : managedTexture->futureImageDesc.mipLevels;
 
-    if (RtxIo::enabled()) {
+    if (TextureUtils::loadsThroughRtxIo(managedTexture)) {
       // When we get here with a texture in VID mem, the texture is considered already preloaded with RTXIO
       preloadMips = managedTexture->state != ManagedTexture::State::kVidMem ? preloadMips : 0;
     }
@@ -125,7 +142,15 @@ namespace dxvk {
       managedTexture->state = ManagedTexture::State::kQueuedForUpload;
       managedTexture->frameQueuedForUpload = m_device->getCurrentFrameId();
 
-      RenderProcessor::add(std::move(managedTexture));
+      // Start paging in the mip tail blob of packaged assets while the texture waits in the queue
+      const AssetInfo& assetInfo = managedTexture->assetData->info();
+      if (assetInfo.mipLevels > assetInfo.looseLevels) {
+        for (uint32_t layer = 0; layer < assetInfo.numLayers; layer++) {
+          managedTexture->assetData->prefetch(layer, assetInfo.mipLevels - 1);
+        }
+      }
+
+      queueUpload(std::move(managedTexture));
     } else {
       // if we're not queueing for upload, make sure we don't hang on to low mip data
       if (managedTexture->linearImageDataLargeMips) {
@@ -155,6 +180,119 @@ namespace dxvk {
     }
   }
 
+  void RtxTextureManager::queueUpload(Rc<ManagedTexture>&& texture) {
+    bool added;
+    {
+      std::lock_guard<dxvk::mutex> lock(m_uploadQueueMutex);
+      // Keyed by texture rather than asset, one asset may back textures in both color spaces
+      added = m_uploadQueue.push(texture->uniqueKey, texture,
+                                 streamingPriority(*texture, m_device->getCurrentFrameId()), estimateLargeMipsSize(*texture));
+    }
+
+    // Requeueing a pending texture only refreshes its priority
+    if (added) {
+      RenderProcessor::add(std::move(texture));
+    }
+  }
+
+  Rc<ManagedTexture> RtxTextureManager::popBatchUpload(StagingRing::Region& region) {
+    const uint32_t currentFrame = m_device->getCurrentFrameId();
+    const uint64_t budgetBytes = uint64_t(RtxOptions::Get()->textureStreamingUploadBudgetMB()) << 20;
+
+    std::lock_guard<dxvk::mutex> lock(m_uploadQueueMutex);
+
+    if (m_uploadQueue.empty()) {
+      return nullptr;
+    }
+
+    // Only take textures the worker would upload right away, the rest wait for their own turn
+    const Rc<ManagedTexture>& texture = m_uploadQueue.top();
+    if (TextureUtils::loadsThroughRtxIo(texture) ||
+        (texture->frameQueuedForUpload >= currentFrame && !RtxOptions::Get()->alwaysWaitForAsyncTextures()) ||
+        !m_uploadBudget.canConsume(currentFrame, m_uploadQueue.topBytes(), budgetBytes)) {
+      return nullptr;
+    }
+
+    region = m_stagingRing->alloc(TextureUtils::getLargeMipsStagingSize(texture), CACHE_LINE_SIZE);
+    if (region.offset == StagingRing::kInvalidOffset) {
+      return nullptr;
+    }
+
+    uint64_t bytes;
+    Rc<ManagedTexture> result = m_uploadQueue.pop(bytes);
+    m_uploadBudget.consume(currentFrame, bytes);
+    return result;
+  }
+
+  Rc<ManagedTexture> RtxTextureManager::popUpload(uint64_t& bytes) {
+    std::lock_guard<dxvk::mutex> lock(m_uploadQueueMutex);
+
+    if (m_uploadQueue.empty()) {
+      bytes = 0;
+      return nullptr;
+    }
+
+    return m_uploadQueue.pop(bytes);
+  }
+
+  void RtxTextureManager::updateStreamingPriorities() {
+    ScopedCpuProfileZone();
+    const uint32_t currentFrame = m_device->getCurrentFrameId();
+
+    std::lock_guard<dxvk::mutex> lock(m_uploadQueueMutex);
+
+    m_uploadQueue.reprioritize([currentFrame](const Rc<ManagedTexture>& texture, float) {
+      return streamingPriority(*texture, currentFrame);
+    });
+
+    static const MetricId s_uploadQueue = Metrics::registerGauge("texture_upload_queue");
+    Metrics::set(s_uploadQueue, static_cast<double>(m_uploadQueue.size()));
+  }
+
+  uint64_t RtxTextureManager::getVidMemOverBudget() const {
+    const float pressure = RtxOptions::Get()->textureStreamingVidMemPressure();
+    if (pressure <= 0.f) {
+      return 0;
+    }
+
+    const VkPhysicalDeviceMemoryProperties& memory = m_device->adapter()->memoryProperties();
+    const DxvkAdapterMemoryInfo memHeapInfo = m_device->adapter()->getMemoryHeapInfo();
+
+    uint64_t overBudgetBytes = 0;
+    for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+      if (!(memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+        continue;
+      }
+
+      const uint64_t thresholdBytes = static_cast<uint64_t>(memHeapInfo.heaps[i].memoryBudget * pressure);
+      if (memHeapInfo.heaps[i].memoryAllocated > thresholdBytes) {
+        overBudgetBytes = std::max(overBudgetBytes, memHeapInfo.heaps[i].memoryAllocated - thresholdBytes);
+      }
+    }
+
+    return overBudgetBytes;
+  }
+
+  uint64_t RtxTextureManager::estimateLargeMipsSize(const ManagedTexture& texture) {
+    return estimateMipsSize(texture, texture.numLargeMips);
+  }
+
+  uint64_t RtxTextureManager::estimateMipsSize(const ManagedTexture& texture, int numMips) {
+    const DxvkFormatInfo* formatInfo = imageFormatInfo(texture.futureImageDesc.format);
+    if (formatInfo == nullptr) {
+      return 0;
+    }
+
+    uint64_t size = 0;
+    for (int level = 0; level < numMips; level++) {
+      const VkExtent3D levelExtent = util::computeMipLevelExtent(texture.futureImageDesc.extent, level);
+      const VkExtent3D elementCount = util::computeBlockCount(levelExtent, formatInfo->blockSize);
+      size += formatInfo->elementSize * util::flattenImageExtent(elementCount);
+    }
+
+    return size * texture.futureImageDesc.numLayers;
+  }
+
   int RtxTextureManager::calcPreloadMips(int mipLevels) {
     if (RtxOptions::Get()->enableAsyncTextureUpload()) {
       return clamp(RtxOptions::Get()->asyncTextureUploadPreloadMips(), 0, mipLevels);
@@ -170,14 +308,19 @@ namespace dxvk {
       return;
 
     try {
-      if (!RtxIo::enabled()) {
+      if (!TextureUtils::loadsThroughRtxIo(texture)) {
         assert(texture->numLargeMips > 0);
         assert(!texture->linearImageDataLargeMips);
       }
 
       TextureUtils::loadTexture(texture, m_device, ctx, TextureUtils::MemoryAperture::HOST, TextureUtils::MipsToLoad::LowMips);
 
-      if (!RtxIo::enabled()) {
+      static const MetricId s_textureUploads = Metrics::registerCounter("texture_uploads");
+      static const MetricId s_textureUploadBytes = Metrics::registerCounter("texture_upload_bytes");
+      Metrics::add(s_textureUploads);
+      Metrics::add(s_textureUploadBytes, static_cast<double>(estimateLargeMipsSize(*texture)));
+
+      if (!TextureUtils::loadsThroughRtxIo(texture)) {
         TextureUtils::promoteHostToVid(m_device, ctx, texture);
         ctx->flushCommandList();
         texture->linearImageDataLargeMips.reset();
@@ -189,13 +332,145 @@ namespace dxvk {
     }
   }
 
+  void RtxTextureManager::uploadTextureBatch(Rc<ManagedTexture>&& texture, Rc<DxvkContext>& ctx) {
+    ScopedCpuProfileZone();
+
+    if (texture->state != ManagedTexture::State::kQueuedForUpload)
+      return;
+
+    if (m_stagingRing == nullptr) {
+      createStagingRing();
+    }
+
+    m_stagingRing->retire(m_uploadFence->value());
+
+    StagingRing::Region region = m_stagingRing->alloc(TextureUtils::getLargeMipsStagingSize(texture), CACHE_LINE_SIZE);
+    while (region.offset == StagingRing::kInvalidOffset && m_stagingRing->hasPending()) {
+      // Wait for the GPU to finish reading the oldest region
+      m_uploadFence->wait(m_stagingRing->oldestFenceValue());
+      m_stagingRing->retire(m_uploadFence->value());
+      region = m_stagingRing->alloc(TextureUtils::getLargeMipsStagingSize(texture), CACHE_LINE_SIZE);
+    }
+
+    if (region.offset == StagingRing::kInvalidOffset) {
+      // Larger than the whole ring
+      uploadTexture(texture, ctx);
+      return;
+    }
+
+    struct Upload {
+      Rc<ManagedTexture> texture;
+      StagingRing::Region region;
+      Future<bool> packed;
+    };
+
+    // Hand the mips of this and the next few ready textures to the workers, they read and pack them straight into the ring
+    std::vector<Upload> batch;
+    while (texture != nullptr) {
+      uint8_t* pDst = static_cast<uint8_t*>(m_stagingRingBuffer->mapPtr(region.offset));
+
+      auto pack = [texture, pDst]() {
+        try {
+          TextureUtils::packLargeMips(texture, pDst);
+          return true;
+        } catch (const DxvkError& e) {
+          Logger::err("Failed to read texture mips for upload!");
+          Logger::err(e.message());
+          return false;
+        }
+      };
+
+      if (m_uploadWorkers != nullptr) {
+        batch.push_back({ texture, region, m_uploadWorkers->Schedule(std::move(pack)) });
+      } else {
+        Promise<bool> packed;
+        batch.push_back({ texture, region, packed.get_future() });
+        packed.set_value(pack());
+      }
+
+      if (batch.size() >= kMaxUploadBatchSize || m_dropRequests || hasStopped()) {
+        break;
+      }
+
+      texture = popBatchUpload(region);
+    }
+
+    // Record the copies in queue order as the workers finish
+    static const MetricId s_textureUploads = Metrics::registerCounter("texture_uploads");
+    static const MetricId s_textureUploadBytes = Metrics::registerCounter("texture_upload_bytes");
+
+    for (Upload& upload : batch) {
+      if (!upload.packed.get()) {
+        upload.texture->state = ManagedTexture::State::kFailed;
+        continue;
+      }
+
+      try {
+        TextureUtils::promoteHostToVid(m_device, ctx, upload.texture, 0,
+                                       DxvkBufferSlice(m_stagingRingBuffer, upload.region.offset, TextureUtils::getLargeMipsStagingSize(upload.texture)));
+
+        Metrics::add(s_textureUploads);
+        Metrics::add(s_textureUploadBytes, static_cast<double>(estimateLargeMipsSize(*upload.texture)));
+      } catch (const DxvkError& e) {
+        upload.texture->state = ManagedTexture::State::kFailed;
+        Logger::err("Failed to finish texture promotion to VidMem!");
+        Logger::err(e.message());
+      }
+    }
+
+    // The ring regions of this batch are released once the copies complete
+    ctx->signal(m_uploadFence, ++m_uploadFenceValue);
+    ctx->flushCommandList();
+
+    for (const Upload& upload : batch) {
+      m_stagingRing->submit(upload.region, m_uploadFenceValue);
+    }
+
+    static const MetricId s_uploadBatchSize = Metrics::registerGauge("texture_upload_batch_size");
+    Metrics::set(s_uploadBatchSize, static_cast<double>(batch.size()));
+  }
+
+  void RtxTextureManager::createStagingRing() {
+    const uint64_t ringSize = std::max(uint64_t(RtxOptions::Get()->textureUploadStagingRingMB()), uint64_t(1)) << 20;
+
+    DxvkBufferCreateInfo info;
+    info.size = ringSize;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    info.access = VK_ACCESS_TRANSFER_READ_BIT;
+
+    m_stagingRingBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                 DxvkMemoryStats::Category::RTXBuffer);
+    m_stagingRing = std::make_unique<StagingRing>(ringSize);
+    m_uploadFence = new sync::Fence(0);
+    m_uploadFenceValue = 0;
+
+    const uint32_t numWorkers = std::min(RtxOptions::Get()->textureUploadWorkerThreads(), kMaxUploadWorkers);
+    if (numWorkers > 0) {
+      m_uploadWorkers = std::make_unique<UploadWorkers>(uint8_t(numWorkers), "rtx-texture-upload");
+    }
+  }
+
   Rc<ManagedTexture> RtxTextureManager::preloadTexture(const Rc<AssetData>& assetData,
     ColorSpace colorSpace, const Rc<DxvkContext>& context, bool forceLoad) {
 
-    const XXH64_hash_t hash = assetData->hash();
+    const XXH64_hash_t hash = assetData->textureKey(colorSpace);
 
     auto it = m_textures.find(hash);
     if (it != m_textures.end()) {
+      // Another file with the same contents was loaded already, count each duplicate path once
+      if (it->second->assetData->hash() != assetData->hash() && m_dedupedTextures.count(assetData->hash()) == 0) {
+        const uint64_t savedBytes = estimateMipsSize(*it->second, it->second->futureImageDesc.mipLevels);
+        m_dedupedTextures.emplace(assetData->hash(), savedBytes);
+        m_dedupedTextureCount++;
+        m_dedupedTextureBytes += savedBytes;
+
+        static const MetricId s_dedupCount = Metrics::registerGauge("texture_dedup_count");
+        static const MetricId s_dedupSavedMB = Metrics::registerGauge("texture_dedup_saved_mb");
+        Metrics::set(s_dedupCount, static_cast<double>(m_dedupedTextureCount));
+        Metrics::set(s_dedupSavedMB, static_cast<double>(m_dedupedTextureBytes >> 20));
+      }
+
       return it->second;
     }
 
@@ -214,14 +489,6 @@ namespace dxvk {
     return m_textures.emplace(hash, texture).first->second;
   }
 
-  void RtxTextureManager::releaseTexture(const Rc<ManagedTexture>& texture) {
-    if (texture != nullptr) {
-      unloadTexture(texture);
-
-      m_textures.erase(texture->assetData->hash());
-    }
-  }
-
   void RtxTextureManager::demoteTexturesFromVidmem() {
     for (const auto& pair : m_textures) {
       unloadTexture(pair.second);
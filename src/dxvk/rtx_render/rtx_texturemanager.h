@@ -27,6 +27,9 @@
 #include "../../util/thread.h"
 #include "../../util/rc/util_rc_ptr.h"
 #include "../../util/sync/sync_signal.h"
+#include "../../util/util_staging_ring.h"
+#include "../../util/util_streaming_queue.h"
+#include "../../util/util_threadpool.h"
 #include "rtx_texture.h"
 
 namespace dxvk {
@@ -41,15 +44,35 @@ namespace dxvk {
     Rc<ManagedTexture> preloadTexture(const Rc<AssetData>& assetData, ColorSpace colorSpace, const Rc<DxvkContext>& context, bool forceLoad);
     void scheduleTextureUpload(TextureRef& texture, Rc<DxvkContext>& immediateContext, bool allowAsync);
     void unloadTexture(const Rc<ManagedTexture>& texture);
-    void releaseTexture(const Rc<ManagedTexture>& texture);
     void synchronize(bool dropRequests = false);
     void kickoff();
 
     void demoteTexturesFromVidmem();
     uint32_t updateMipMapSkipLevel(const Rc<DxvkContext>& context);
 
+    // Re-sorts the queued uploads by their current demand, once per frame
+    void updateStreamingPriorities();
+    // Bytes of video memory to free to get back under the texture streaming pressure threshold
+    uint64_t getVidMemOverBudget() const;
+
     static int calcPreloadMips(int mipLevels);
 
+    // Mod texture files sharing the GPU texture of another file with the same contents
+    uint32_t getDedupedTextureCount() const {
+      return m_dedupedTextureCount;
+    }
+
+    // Estimated memory those files would take up as separate textures
+    uint64_t getDedupedTextureBytes() const {
+      return m_dedupedTextureBytes;
+    }
+
+    // Usefulness of a texture's full mip chain: its screen coverage, fading with the frames since it was last used
+    static float streamingPriority(const ManagedTexture& texture, uint32_t currentFrame) {
+      const uint32_t age = currentFrame > texture.frameLastUsed ? currentFrame - texture.frameLastUsed : 0;
+      return texture.demand / (1.f + float(age));
+    }
+
     inline static XXH64_hash_t getUniqueKey() {
       static uint64_t ID;
       XXH64_hash_t key;
@@ -78,9 +101,40 @@ namespace dxvk {
     bool m_kickoff = false;
 
     uint32_t m_minimumMipLevel{ 0u };
+    // Keyed by content hash and color space, mod texture files with identical contents share an entry
     fast_unordered_cache<Rc<ManagedTexture>> m_textures;
+    // Bytes saved by each deduplicated file, keyed by its path hash
+    fast_unordered_cache<uint64_t> m_dedupedTextures;
+    std::atomic<uint32_t> m_dedupedTextureCount = 0;
+    std::atomic<uint64_t> m_dedupedTextureBytes = 0;
+
+    // Pending uploads by priority, the processor queue only counts them
+    dxvk::mutex m_uploadQueueMutex;
+    StreamingQueue<Rc<ManagedTexture>> m_uploadQueue;
+    // Only touched by the worker thread
+    StreamingBudget m_uploadBudget;
+
+    // Upload pipeline, only touched by the worker thread: upload workers read and pack the large mips of a batch
+    // of textures into the persistently mapped staging ring, the worker records their copies in one submission
+    static constexpr size_t kMaxUploadBatchSize = 32;
+    static constexpr uint32_t kMaxUploadWorkers = 16;
+    using UploadWorkers = WorkerThreadPool<kMaxUploadBatchSize, true, false>;
 
+    std::unique_ptr<UploadWorkers> m_uploadWorkers;
+    Rc<DxvkBuffer> m_stagingRingBuffer;
+    std::unique_ptr<StagingRing> m_stagingRing;
+    Rc<sync::Fence> m_uploadFence;
+    uint64_t m_uploadFenceValue = 0;
+
+    void queueUpload(Rc<ManagedTexture>&& texture);
+    Rc<ManagedTexture> popUpload(uint64_t& bytes);
+    Rc<ManagedTexture> popBatchUpload(StagingRing::Region& region);
     void uploadTexture(const Rc<ManagedTexture>& texture, Rc<DxvkContext>& ctx);
+    void uploadTextureBatch(Rc<ManagedTexture>&& texture, Rc<DxvkContext>& ctx);
+    void createStagingRing();
+
+    static uint64_t estimateLargeMipsSize(const ManagedTexture& texture);
+    static uint64_t estimateMipsSize(const ManagedTexture& texture, int numMips);
   };
 
 } // namespace dxvk
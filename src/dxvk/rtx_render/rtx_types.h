@@ -25,10 +25,10 @@
 #include "rtx_materials.h"
 #include "rtx_hashing.h"
 #include "vulkan/vulkan_core.h"
+#include "../util/util_future.h"
 
 #include <inttypes.h>
 #include <vector>
-#include <future>
 
 namespace dxvk 
 {
@@ -117,6 +117,11 @@ struct RaytraceGeometry {
 struct AxisAlignBoundingBox {
   Vector3 minPos = { FLT_MAX, FLT_MAX, FLT_MAX };
   Vector3 maxPos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+  // No position was accumulated, the bounds are unknown
+  bool isEmpty() const {
+    return minPos.x > maxPos.x;
+  }
 };
 
 // Stores a snapshot of the geometry state for a draw call.
@@ -124,7 +129,7 @@ struct AxisAlignBoundingBox {
 //          generated from has finished executing on the GPU
 struct RasterGeometry {
   GeometryHashes hashes;
-  std::shared_future<GeometryHashes> futureGeometryHashes;
+  Future<GeometryHashes> futureGeometryHashes;
 
   // Actual vertex/index count (when applicable) as calculated by geo-engine
   uint32_t vertexCount = 0;
@@ -147,30 +152,12 @@ struct RasterGeometry {
   RasterBuffer blendIndicesBuffer;
 
   AxisAlignBoundingBox boundingBox;
-  std::shared_future<AxisAlignBoundingBox> futureBoundingBox;
+  Future<AxisAlignBoundingBox> futureBoundingBox;
 
   const XXH64_hash_t getHashForRule(const HashRule& rule) const {
-    XXH64_hash_t hashResult = kEmptyHash;
-
-    // TODO: Can be optimized to not iterate over all component indices
-    for (uint32_t i = 0; i < (uint32_t)HashComponents::Count; i++) {
-      const HashComponents component = (HashComponents) i;
-
-      if (rule.test(component)) {
-        if (hashResult == kEmptyHash)
-          // For the first entry, we use the hash directly
-          hashResult = hashes[component];
-        else
-          // For all other entries, we combine the hash via seeding
-          hashResult = XXH64(&(hashes[component]), sizeof(XXH64_hash_t), hashResult);
-      }
-    }
-
-    assert(hashResult != kEmptyHash);
-    return hashResult;
+    return hashes.getHashForRule(rule);
   }
 
-
   const XXH64_hash_t getHashForRuleLegacy(const HashRule& rule) const {
     // Note: Only information relating to how the geometry is structured should be included here.
     XXH64_hash_t h = getHashForRule(rule);
@@ -627,7 +614,7 @@ enum class RtxGeometryStatus {
 struct DxvkRaytracingInstanceState {
   RasterGeometry geometry;
   RtxGeometryStatus geometryStatus;
-  std::shared_future<SkinningData> futureSkinningData;
+  Future<SkinningData> futureSkinningData;
   bool useProgrammableVS;
   bool useProgrammablePS;
   Matrix4 world;
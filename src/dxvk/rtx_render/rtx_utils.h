@@ -34,6 +34,7 @@
 #include "../util/util_matrix.h"
 #include "../util/util_quat.h"
 #include "../util/util_pack.h"
+#include "../util/util_flat_hash_map.h"
 #include "dxvk_bind_mask.h"
 #include <d3d9types.h>
 #include <type_traits>
@@ -184,15 +185,35 @@ struct XXH64_std_hash<std::string> {
 };
 
 // A fast caching structure for use ONLY with already hashed keys.
+// Elements are stored inline in an open addressing table: an insert that grows the table moves them,
+// invalidating all iterators, references and pointers to elements. Erasing only invalidates the erased
+// element, so erasing while iterating is fine. Use stable_unordered_cache when pointers to elements
+// are kept across inserts.
 template<class T>
-struct fast_unordered_cache : public std::unordered_map<XXH64_hash_t, T, XXH64_hash_passthrough> {
+struct fast_unordered_cache : public FlatHashMap<XXH64_hash_t, T, XXH64_hash_passthrough> {
   template<typename P>
   void erase_if(P&& p) {
-    for (auto it = begin(); it != end();) {
+    for (auto it = this->begin(); it != this->end();) {
       if (!p(it)) {
         ++it;
       } else {
-        it = erase(it);
+        it = this->erase(it);
+      }
+    }
+  }
+};
+
+// A node based caching structure for already hashed keys, references and pointers to elements
+// stay valid until the element is erased.
+template<class T>
+struct stable_unordered_cache : public std::unordered_map<XXH64_hash_t, T, XXH64_hash_passthrough> {
+  template<typename P>
+  void erase_if(P&& p) {
+    for (auto it = this->begin(); it != this->end();) {
+      if (!p(it)) {
+        ++it;
+      } else {
+        it = this->erase(it);
       }
     }
   }
@@ -57,11 +57,17 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 // Embedded MDLs
 #include <AperturePBR_Opacity.mdl.h>
@@ -103,23 +109,76 @@ void GameExporter::exportUsd(const Export& exportData) {
 
 void GameExporter::exportUsdInternal(const Export& exportData) {
   dxvk::Logger::info("[GameExporter][" + exportData.debugId + "] Export start");
+  const auto exportStart = std::chrono::steady_clock::now();
+  const auto timePhase = [&exportData](const char* phaseName, const auto& phase) {
+    const auto start = std::chrono::steady_clock::now();
+    phase();
+    const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    dxvk::Logger::info(dxvk::str::format("[GameExporter][", exportData.debugId, "][", phaseName, "] ", ms, " ms"));
+  };
   ExportContext ctx;
   lss::GameExporter::createApertureMdls(exportData.baseExportPath);
   ctx.instanceStage = (exportData.bExportInstanceStage) ? createInstanceStage(exportData) : pxr::UsdStageRefPtr();
-  exportMaterials(exportData, ctx);
-  exportMeshes(exportData, ctx);
+  timePhase("exportMaterials", [&] { exportMaterials(exportData, ctx); });
+  timePhase("exportMeshes", [&] { exportMeshes(exportData, ctx); });
   if(ctx.instanceStage) {
-    exportCamera(exportData, ctx);
-    exportSphereLights(exportData, ctx);
-    exportDistantLights(exportData, ctx);
-    exportInstances(exportData, ctx);
-    exportSky(exportData, ctx);
+    timePhase("exportCamera", [&] { exportCamera(exportData, ctx); });
+    timePhase("exportSphereLights", [&] { exportSphereLights(exportData, ctx); });
+    timePhase("exportDistantLights", [&] { exportDistantLights(exportData, ctx); });
+    timePhase("exportInstances", [&] { exportInstances(exportData, ctx); });
+    timePhase("exportSky", [&] { exportSky(exportData, ctx); });
     setCommonStageMetaData(ctx.instanceStage, exportData);
     ctx.instanceStage->SetStartTimeCode(exportData.meta.startTimeCode);
     ctx.instanceStage->SetEndTimeCode(exportData.meta.endTimeCode);
-    ctx.instanceStage->Save();
+    timePhase("saveInstanceStage", [&] { ctx.instanceStage->Save(); });
+  }
+  const auto exportMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - exportStart).count();
+  dxvk::Logger::info(dxvk::str::format("[GameExporter][", exportData.debugId, "] Export end, ", exportMs, " ms"));
+}
+
+size_t GameExporter::getNumExportThreads(const Export& exportData) {
+  if(exportData.meta.numExportThreads > 0) {
+    return exportData.meta.numExportThreads;
+  }
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+template<typename F>
+void GameExporter::parallelFor(const size_t count, const size_t numThreads, const F& func) {
+  const size_t numWorkers = std::min(count, numThreads);
+  if(numWorkers <= 1) {
+    for(size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+  // Workers pull the next index until all are taken, the calling thread works as well
+  std::atomic<size_t> nextIdx = 0;
+  std::exception_ptr exception;
+  std::mutex exceptionMutex;
+  const auto work = [&]() {
+    try {
+      for(size_t i = nextIdx++; i < count; i = nextIdx++) {
+        func(i);
+      }
+    } catch(...) {
+      std::scoped_lock lock(exceptionMutex);
+      exception = std::current_exception();
+      nextIdx = count;
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(numWorkers - 1);
+  for(size_t i = 1; i < numWorkers; ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for(auto& worker : workers) {
+    worker.join();
+  }
+  if(exception) {
+    std::rethrow_exception(exception);
   }
-  dxvk::Logger::info("[GameExporter][" + exportData.debugId + "] Export end");
 }
 
 pxr::UsdStageRefPtr GameExporter::createInstanceStage(const Export& exportData) {
@@ -197,110 +256,21 @@ void GameExporter::exportMaterials(const Export& exportData, ExportContext& ctx)
   const std::string matDirPath = exportData.baseExportPath + "/" + commonDirName::matDir;
   const std::string fullMaterialBasePath = arDefResolver.ComputeLocalPath(matDirPath);
   dxvk::env::createDirectory(matDirPath);
+  // Each material is authored to its own stage, so those are written concurrently
+  std::vector<std::pair<Id, const Material*>> materials;
+  materials.reserve(exportData.materials.size());
   for(const auto& [matId, matData] : exportData.materials) {
-    // Build material stage
-    const std::string matName = prefix::mat + matData.matName;
-    const std::string matStageName = matName + lss::ext::usd;
-    const std::string matStagePath = matDirPath + matStageName;
-    pxr::UsdStageRefPtr matStage = findOpenOrCreateStage(matStagePath, true);
-    assert(matStage);
-    setCommonStageMetaData(matStage, exportData);
-
-    // Add Looks + RootPrim prims
-    const auto looksSdfPath = gStageRootPath.AppendChild(gTokLooks);
-    const auto looksScopePrim = matStage->DefinePrim(looksSdfPath, gTokScope);
-    assert(looksScopePrim);
-    matStage->SetDefaultPrim(looksScopePrim);
-
-    // Create material prim
-    const auto matSdfPath = looksSdfPath.AppendElementString(matName);
-    const auto matSchema = pxr::UsdShadeMaterial::Define(matStage, matSdfPath);
-    assert(matSchema);
-    const auto matPrim = matSchema.GetPrim();
-    assert(matPrim);
-
-    // Create shader prim under material prim
-    static const pxr::TfToken kTokShader("Shader");
-    const auto shaderPath = matPrim.GetPath().AppendChild(kTokShader);
-    const auto shader = pxr::UsdShadeShader::Define(matStage, shaderPath);
-    const auto shaderPrim = shader.GetPrim();
-    assert(shaderPrim);
-
-    // Create shader prim outputs attr
-    static const pxr::TfToken kTokOutputsOutput("outputs:out");
-    const auto outputsOutAttr =
-      shaderPrim.CreateAttribute(kTokOutputsOutput, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
-
-    // Create and connect material outputs to shader outputs
-    static const pxr::TfToken kTokOutputsMdlSurface("outputs:mdl:surface");
-    const auto outputsMdlSurfaceAttr =
-      matPrim.CreateAttribute(kTokOutputsMdlSurface, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
-    outputsMdlSurfaceAttr.AddConnection(outputsOutAttr.GetPath(), pxr::UsdListPositionFrontOfAppendList);
-
-    // Set shader "Kind"
-    static const pxr::TfToken kTokMaterial("Material");
-    pxr::UsdModelAPI(shader).SetKind(kTokMaterial);
-
-    // Create and set textures asset paths on material
-    static const auto setTextureAttr =
-      [](const pxr::UsdPrim& shaderPrim, const pxr::TfToken attrName, const std::string& relTexPath, const std::string& fullMaterialBasePath)
-    {
-      const auto attr = shaderPrim.CreateAttribute(pxr::TfToken(attrName), pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityVarying);
-      assert(attr);
-      static pxr::ArDefaultResolver arDefResolver;
-      const auto fullTexturePath = arDefResolver.ComputeLocalPath(relTexPath);
-      const auto relToMaterialsTexPath = std::filesystem::relative(fullTexturePath,fullMaterialBasePath).string();
-      const bool bSetSuccessful = attr.Set(pxr::SdfAssetPath(relToMaterialsTexPath));
-      assert(bSetSuccessful);
-      static const pxr::TfToken kTokColorSpaceAuto("auto");
-      attr.SetColorSpace(kTokColorSpaceAuto);
-      return true;
-    };
-    static const pxr::TfToken kTokenInputsDiffuseTex("inputs:diffuse_texture");
-
-    // Try to use an updated texture, if that doesn't work, try to use an old one
-    setTextureAttr(shaderPrim, kTokenInputsDiffuseTex, matData.albedoTexPath, fullMaterialBasePath);
-
-    // Create and set OmniPBR MDL boilerplate attributes on shader
-    static const pxr::TfToken kTokInfoImplSource("info:implementationSource");
-    static const pxr::TfToken kTokSourceAsset("sourceAsset");
-    const auto infoImplSourceAttr =
-      shaderPrim.CreateAttribute(kTokInfoImplSource, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
-    assert(infoImplSourceAttr);
-    const bool bSetInfoImplSourceAttr = infoImplSourceAttr.Set(kTokSourceAsset);
-    assert(bSetInfoImplSourceAttr);
-
-    static const pxr::TfToken kTokInfoMdlSourceAsset("info:mdl:sourceAsset");
-
-    static const pxr::SdfAssetPath kSdfAssetPathOmniPBR("./AperturePBR_Opacity.mdl");
-    const auto infoMdlSourceAsset =
-      shaderPrim.CreateAttribute(kTokInfoMdlSourceAsset, pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityUniform);
-    assert(infoMdlSourceAsset);
-    const bool bSetInfoMdlSourceAsset = infoMdlSourceAsset.Set(kSdfAssetPathOmniPBR);
-    assert(bSetInfoMdlSourceAsset);
-
-    static const pxr::TfToken kTokInfoMdlSourceAssetSubId("info:mdl:sourceAsset:subIdentifier");
-    static const pxr::TfToken kTokOmniPBR("AperturePBR_Opacity");
-    const auto infoImplSourceSubIdAttr =
-      shaderPrim.CreateAttribute(kTokInfoMdlSourceAssetSubId, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
-    assert(infoImplSourceSubIdAttr);
-    const bool bSetInfoMdlSourceAssetSubId = infoImplSourceSubIdAttr.Set(kTokOmniPBR);
-    assert(bSetInfoMdlSourceAssetSubId);
-
-    // Mark whether to enable varying opacity
-    static const pxr::TfToken kTokEnableOpacity("enable_opacity");
-    const auto enableOpacityAttr =
-      shaderPrim.CreateAttribute(kTokEnableOpacity, pxr::SdfValueTypeNames->Bool, false, pxr::SdfVariabilityUniform);
-    assert(enableOpacityAttr);
-    const bool bSetEnableOpacityAttr = enableOpacityAttr.Set(matData.enableOpacity);
-    assert(bSetEnableOpacityAttr);
-
-    matStage->Save();
-    
-    // Cache material reference
-    Reference matLssReference;
-    matLssReference.stagePath = matStagePath;
-    matLssReference.ogSdfPath = matSdfPath;
+    materials.emplace_back(matId, &matData);
+  }
+  std::vector<Reference> matLssReferences(materials.size());
+  parallelFor(materials.size(), getNumExportThreads(exportData), [&](const size_t i) {
+    matLssReferences[i] = exportMaterialStage(exportData, *materials[i].second, matDirPath, fullMaterialBasePath);
+  });
+  // Stitch them into the instance stage, which can only be authored from one thread
+  for(size_t i = 0; i < materials.size(); ++i) {
+    const auto& [matId, pMatData] = materials[i];
+    const std::string matName = prefix::mat + pMatData->matName;
+    Reference& matLssReference = matLssReferences[i];
 
     // Build matSchema prim on instance stage
     if(ctx.instanceStage != nullptr) {
@@ -310,7 +280,7 @@ void GameExporter::exportMaterials(const Export& exportData, ExportContext& ctx)
       
       const std::string relMeshStagePath = commonDirName::matDir + matName + lss::ext::usd;
       auto matInstanceUsdReferences = matInstanceSchema.GetPrim().GetReferences();
-      matInstanceUsdReferences.AddReference(relMeshStagePath, matSdfPath);
+      matInstanceUsdReferences.AddReference(relMeshStagePath, matLssReference.ogSdfPath);
       
       matLssReference.instanceSdfPath = matInstanceSdfPath;
     }
@@ -320,6 +290,117 @@ void GameExporter::exportMaterials(const Export& exportData, ExportContext& ctx)
   dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMaterials] End");
 }
 
+GameExporter::Reference GameExporter::exportMaterialStage(const Export& exportData,
+                                                          const Material& matData,
+                                                          const std::string& matDirPath,
+                                                          const std::string& fullMaterialBasePath) {
+  // Build material stage
+  const std::string matName = prefix::mat + matData.matName;
+  const std::string matStageName = matName + lss::ext::usd;
+  const std::string matStagePath = matDirPath + matStageName;
+  pxr::UsdStageRefPtr matStage = findOpenOrCreateStage(matStagePath, true);
+  assert(matStage);
+  setCommonStageMetaData(matStage, exportData);
+
+  // Add Looks + RootPrim prims
+  const auto looksSdfPath = gStageRootPath.AppendChild(gTokLooks);
+  const auto looksScopePrim = matStage->DefinePrim(looksSdfPath, gTokScope);
+  assert(looksScopePrim);
+  matStage->SetDefaultPrim(looksScopePrim);
+
+  // Create material prim
+  const auto matSdfPath = looksSdfPath.AppendElementString(matName);
+  const auto matSchema = pxr::UsdShadeMaterial::Define(matStage, matSdfPath);
+  assert(matSchema);
+  const auto matPrim = matSchema.GetPrim();
+  assert(matPrim);
+
+  // Create shader prim under material prim
+  static const pxr::TfToken kTokShader("Shader");
+  const auto shaderPath = matPrim.GetPath().AppendChild(kTokShader);
+  const auto shader = pxr::UsdShadeShader::Define(matStage, shaderPath);
+  const auto shaderPrim = shader.GetPrim();
+  assert(shaderPrim);
+
+  // Create shader prim outputs attr
+  static const pxr::TfToken kTokOutputsOutput("outputs:out");
+  const auto outputsOutAttr =
+    shaderPrim.CreateAttribute(kTokOutputsOutput, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
+
+  // Create and connect material outputs to shader outputs
+  static const pxr::TfToken kTokOutputsMdlSurface("outputs:mdl:surface");
+  const auto outputsMdlSurfaceAttr =
+    matPrim.CreateAttribute(kTokOutputsMdlSurface, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
+  outputsMdlSurfaceAttr.AddConnection(outputsOutAttr.GetPath(), pxr::UsdListPositionFrontOfAppendList);
+
+  // Set shader "Kind"
+  static const pxr::TfToken kTokMaterial("Material");
+  pxr::UsdModelAPI(shader).SetKind(kTokMaterial);
+
+  // Create and set textures asset paths on material
+  static const auto setTextureAttr =
+    [](const pxr::UsdPrim& shaderPrim, const pxr::TfToken attrName, const std::string& relTexPath, const std::string& fullMaterialBasePath)
+  {
+    const auto attr = shaderPrim.CreateAttribute(pxr::TfToken(attrName), pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityVarying);
+    assert(attr);
+    static pxr::ArDefaultResolver arDefResolver;
+    const auto fullTexturePath = arDefResolver.ComputeLocalPath(relTexPath);
+    const auto relToMaterialsTexPath = std::filesystem::relative(fullTexturePath,fullMaterialBasePath).string();
+    const bool bSetSuccessful = attr.Set(pxr::SdfAssetPath(relToMaterialsTexPath));
+    assert(bSetSuccessful);
+    static const pxr::TfToken kTokColorSpaceAuto("auto");
+    attr.SetColorSpace(kTokColorSpaceAuto);
+    return true;
+  };
+  static const pxr::TfToken kTokenInputsDiffuseTex("inputs:diffuse_texture");
+
+  // Try to use an updated texture, if that doesn't work, try to use an old one
+  setTextureAttr(shaderPrim, kTokenInputsDiffuseTex, matData.albedoTexPath, fullMaterialBasePath);
+
+  // Create and set OmniPBR MDL boilerplate attributes on shader
+  static const pxr::TfToken kTokInfoImplSource("info:implementationSource");
+  static const pxr::TfToken kTokSourceAsset("sourceAsset");
+  const auto infoImplSourceAttr =
+    shaderPrim.CreateAttribute(kTokInfoImplSource, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
+  assert(infoImplSourceAttr);
+  const bool bSetInfoImplSourceAttr = infoImplSourceAttr.Set(kTokSourceAsset);
+  assert(bSetInfoImplSourceAttr);
+
+  static const pxr::TfToken kTokInfoMdlSourceAsset("info:mdl:sourceAsset");
+
+  static const pxr::SdfAssetPath kSdfAssetPathOmniPBR("./AperturePBR_Opacity.mdl");
+  const auto infoMdlSourceAsset =
+    shaderPrim.CreateAttribute(kTokInfoMdlSourceAsset, pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityUniform);
+  assert(infoMdlSourceAsset);
+  const bool bSetInfoMdlSourceAsset = infoMdlSourceAsset.Set(kSdfAssetPathOmniPBR);
+  assert(bSetInfoMdlSourceAsset);
+
+  static const pxr::TfToken kTokInfoMdlSourceAssetSubId("info:mdl:sourceAsset:subIdentifier");
+  static const pxr::TfToken kTokOmniPBR("AperturePBR_Opacity");
+  const auto infoImplSourceSubIdAttr =
+    shaderPrim.CreateAttribute(kTokInfoMdlSourceAssetSubId, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
+  assert(infoImplSourceSubIdAttr);
+  const bool bSetInfoMdlSourceAssetSubId = infoImplSourceSubIdAttr.Set(kTokOmniPBR);
+  assert(bSetInfoMdlSourceAssetSubId);
+
+  // Mark whether to enable varying opacity
+  static const pxr::TfToken kTokEnableOpacity("enable_opacity");
+  const auto enableOpacityAttr =
+    shaderPrim.CreateAttribute(kTokEnableOpacity, pxr::SdfValueTypeNames->Bool, false, pxr::SdfVariabilityUniform);
+  assert(enableOpacityAttr);
+  const bool bSetEnableOpacityAttr = enableOpacityAttr.Set(matData.enableOpacity);
+  assert(bSetEnableOpacityAttr);
+
+  matStage->Save();
+  
+  // Cache material reference
+  Reference matLssReference;
+  matLssReference.stagePath = matStagePath;
+  matLssReference.ogSdfPath = matSdfPath;
+
+  return matLssReference;
+}
+
 void GameExporter::exportMeshes(const Export& exportData, ExportContext& ctx) {
   dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMeshes] Begin");
   static pxr::ArDefaultResolver arDefResolver;
@@ -327,129 +408,28 @@ void GameExporter::exportMeshes(const Export& exportData, ExportContext& ctx) {
   const std::string meshDirPath = exportData.baseExportPath + "/" + relMeshDirPath;
   const std::string fullMeshStagePath = arDefResolver.ComputeLocalPath(meshDirPath);
   dxvk::env::createDirectory(meshDirPath);
-  for(const auto& [meshId,mesh] : exportData.meshes) {
-    assert(mesh.numVertices > 0);
-    assert(mesh.numIndices > 0);
-
-    // Build mesh stage
-    const std::string meshName = prefix::mesh + mesh.meshName;
-    const std::string meshStagePath = meshDirPath + meshName + lss::ext::usd;
-    pxr::UsdStageRefPtr meshStage = findOpenOrCreateStage(meshStagePath, true);
-    assert(meshStage);
-    setCommonStageMetaData(meshStage, exportData);
-
-    pxr::VtDictionary customLayerData = meshStage->GetRootLayer()->GetCustomLayerData();
-    for (auto& component : mesh.componentHashes) {
-      customLayerData.SetValueAtPath(component.first, pxr::VtValue(component.second));
-    }
-    meshStage->GetRootLayer()->SetCustomLayerData(customLayerData);
-
-    // Build mesh xform prim on mesh stage, make it visible
-    const auto meshXformSdfPath = gStageRootPath.AppendElementString(meshName);
-    auto meshXformSchema = pxr::UsdGeomXform::Define(meshStage, meshXformSdfPath);
-    assert(meshXformSchema);
-    meshStage->SetDefaultPrim(meshXformSchema.GetPrim());
-    auto meshXformVisibilityAttr = meshXformSchema.CreateVisibilityAttr();
-    assert(meshXformVisibilityAttr);
-    meshXformVisibilityAttr.Set(gVisibilityInherited);
-
-    // Build mesh geometry prim under above xform
-    const auto meshSchemaSdfPath = meshXformSdfPath.AppendChild(gTokMesh);
-    auto meshSchema = pxr::UsdGeomMesh::Define(meshStage, meshSchemaSdfPath);
-    assert(meshSchema);
-    auto meshVisibilityAttr = meshSchema.CreateVisibilityAttr();
-    assert(meshVisibilityAttr);
-    meshVisibilityAttr.Set(gVisibilityInherited);
-    
-    // Set double-sidedness attribute
-    auto doubleSidedAttr = meshSchema.CreateDoubleSidedAttr();
-    assert(doubleSidedAttr);
-    doubleSidedAttr.Set(mesh.isDoubleSided);
-
-    // Set orientation attribute
-    auto orientationAttr = meshSchema.CreateOrientationAttr();
-    assert(orientationAttr);
-    orientationAttr.Set(pxr::VtValue(pxr::UsdGeomTokens->leftHanded));
-
-    // Create corresponding attribute arrays using above populated VtArrays
-    pxr::VtArray<int> faceVertexCounts;
-    faceVertexCounts.assign(mesh.numIndices / 3, 3);
-    auto faceVertexCountsAttr = meshSchema.CreateFaceVertexCountsAttr();
-    assert(faceVertexCountsAttr);
-    faceVertexCountsAttr.Set(faceVertexCounts);
-
-    // Indices
-    ReducedIdxBufSet reducedIdxBufSet = (exportData.meta.bReduceMeshBuffers) ? reduceIdxBufferSet(mesh.buffers.idxBufs) : ReducedIdxBufSet();
-    const std::map<float,IndexBuffer>& idxBufSet =
-      (exportData.meta.bReduceMeshBuffers) ? reducedIdxBufSet.bufSet : mesh.buffers.idxBufs;
-    auto indexAttr = meshSchema.CreateFaceVertexIndicesAttr();
-    assert(indexAttr);
-    exportBufferSet(idxBufSet, indexAttr);
-    // Vertices
-    const std::map<float,PositionBuffer> reducedPosBufSet =
-      (exportData.meta.bReduceMeshBuffers) ? reduceBufferSet(mesh.buffers.positionBufs, reducedIdxBufSet) : std::map<float,PositionBuffer>();
-    const std::map<float,PositionBuffer>& posBufSet =
-      (exportData.meta.bReduceMeshBuffers) ? reducedPosBufSet : mesh.buffers.positionBufs;
-    auto pointsAttr = meshSchema.CreatePointsAttr();
-    assert(pointsAttr);
-    exportBufferSet(posBufSet, pointsAttr);
-    // Normals
-    auto normalsAttr = meshSchema.CreateNormalsAttr();
-    assert(normalsAttr);
-    exportBufferSet(mesh.buffers.normalBufs, normalsAttr);
-    // Set subdivision scheme to None (USD defaults to catmull clark)
-    auto subdivAttr = meshSchema.CreateSubdivisionSchemeAttr();
-    assert(subdivAttr);
-    subdivAttr.Set(pxr::UsdGeomTokens->none);
-    // Texture Coordinates
-    const std::map<float,TexcoordBuffer> reducedTexcoordBufSet =
-      (exportData.meta.bReduceMeshBuffers) ? reduceBufferSet(mesh.buffers.texcoordBufs, reducedIdxBufSet) : std::map<float,TexcoordBuffer>();
-    const std::map<float,TexcoordBuffer>& texcoordBufSet =
-      (exportData.meta.bReduceMeshBuffers) ? reducedTexcoordBufSet : mesh.buffers.texcoordBufs;
-    static const pxr::TfToken kTokSt("st");
-    auto stAttr = meshSchema.CreatePrimvar(kTokSt, pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->vertex);
-    assert(stAttr);
-    exportBufferSet(texcoordBufSet, stAttr);
-
-    // Vertex Colors
-    if (mesh.buffers.colorBufs.size() > 0) {
-      auto displayColorPrimvar = meshSchema.CreateDisplayColorPrimvar(pxr::UsdGeomTokens->vertex);
-      assert(displayColorPrimvar);
-      if (mesh.buffers.colorBufs.cbegin()->second.size() == 1) {
-        // Constant Color
-        displayColorPrimvar.SetInterpolation(pxr::UsdGeomTokens->constant);
-      }
-      exportBufferSet(mesh.buffers.colorBufs, displayColorPrimvar);
-    }
-
-    const bool bHasMat = mesh.matId != kInvalidId;
-    const Reference& matLssReference = (bHasMat) ? ctx.matReferences[mesh.matId] : Reference();
-    if(bHasMat) {
-      const auto shaderMatSchema = pxr::UsdShadeMaterial::Define(meshStage, matLssReference.ogSdfPath);
-      assert(shaderMatSchema);
-      auto shaderMatUsdReferences = shaderMatSchema.GetPrim().GetReferences();
-      const std::string fullMatStagePath = arDefResolver.ComputeLocalPath(matLssReference.stagePath);
-      const std::string relMatRefStagePath = std::filesystem::relative(fullMatStagePath,fullMeshStagePath).string();
-      shaderMatUsdReferences.AddReference(relMatRefStagePath, matLssReference.ogSdfPath);
-      pxr::UsdShadeMaterialBindingAPI(meshXformSchema.GetPrim()).Bind(shaderMatSchema);
-    }
-
-    // Kit metadata
-    if(exportData.meta.bUseLssUsdPlugins) {
-      meshXformSchema.GetPrim().SetMetadata(PXR_NS::SdfFieldKeys->Kind, PXR_NS::KindTokens->assembly);
-      static const pxr::TfToken kTokHideInStageWindow("hide_in_stage_window");
-      meshSchema.GetPrim().SetMetadata(kTokHideInStageWindow, true);
-      static const pxr::TfToken kTokNoDelete("no_delete");
-      meshSchema.GetPrim().SetMetadata(kTokNoDelete, true);
-    }
+  // Each mesh is authored to its own stage, so those are written concurrently
+  std::vector<std::pair<Id, const Mesh*>> meshes;
+  meshes.reserve(exportData.meshes.size());
+  for(const auto& [meshId, mesh] : exportData.meshes) {
+    meshes.emplace_back(meshId, &mesh);
+  }
+  std::vector<Reference> meshLssReferences(meshes.size());
+  TimeSampleStats timeSampleStats;
+  parallelFor(meshes.size(), getNumExportThreads(exportData), [&](const size_t i) {
+    meshLssReferences[i] = exportMeshStage(exportData, ctx, *meshes[i].second, meshDirPath, fullMeshStagePath, timeSampleStats);
+  });
+  if(exportData.meta.bDedupTimeSamples) {
+    dxvk::Logger::info(dxvk::str::format("[GameExporter][", exportData.debugId, "][exportMeshes] Dropped ",
+                                         timeSampleStats.numSamplesDropped.load(), " of ", timeSampleStats.numSamples.load(),
+                                         " redundant time samples, saving ", timeSampleStats.bytesSaved.load() / 1024, " KiB"));
+  }
+  // Stitch them into the instance stage, which can only be authored from one thread
+  for(size_t i = 0; i < meshes.size(); ++i) {
+    const auto& [meshId, pMesh] = meshes[i];
+    const std::string meshName = prefix::mesh + pMesh->meshName;
+    Reference& meshLssReference = meshLssReferences[i];
 
-    meshStage->Save();
-    
-    // Cache material reference
-    Reference meshLssReference;
-    meshLssReference.stagePath = meshStagePath;
-    meshLssReference.ogSdfPath = meshXformSdfPath;
-    
     // Build meshSchema prim on instance stage
     if(ctx.instanceStage != nullptr) {
       const auto meshInstanceXformSdfPath = gRootMeshesPath.AppendElementString(meshName);
@@ -464,8 +444,9 @@ void GameExporter::exportMeshes(const Export& exportData, ExportContext& ctx) {
       assert(meshInstanceXformVisibilityAttr);
       meshInstanceXformVisibilityAttr.Set(gVisibilityInvisible);
       
-      if(bHasMat) {
-        const auto shaderMatInstanceSchema = pxr::UsdShadeMaterial::Get(ctx.instanceStage, matLssReference.instanceSdfPath);
+      const auto matLssReferenceItr = ctx.matReferences.find(pMesh->matId);
+      if(matLssReferenceItr != ctx.matReferences.cend()) {
+        const auto shaderMatInstanceSchema = pxr::UsdShadeMaterial::Get(ctx.instanceStage, matLssReferenceItr->second.instanceSdfPath);
         assert(shaderMatInstanceSchema);
         pxr::UsdShadeMaterialBindingAPI(meshInstanceXformSchema.GetPrim()).Bind(shaderMatInstanceSchema);
       }
@@ -478,16 +459,176 @@ void GameExporter::exportMeshes(const Export& exportData, ExportContext& ctx) {
   dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMeshes] End");
 }
 
+GameExporter::Reference GameExporter::exportMeshStage(const Export& exportData,
+                                                      const ExportContext& ctx,
+                                                      const Mesh& mesh,
+                                                      const std::string& meshDirPath,
+                                                      const std::string& fullMeshStagePath,
+                                                      TimeSampleStats& timeSampleStats) {
+  static pxr::ArDefaultResolver arDefResolver;
+  const auto exportSamples = [&](const auto& bufSet, pxr::UsdAttribute attr) {
+    if(exportData.meta.bDedupTimeSamples) {
+      exportBufferSet(dedupBufferSet(bufSet, timeSampleStats), attr);
+    } else {
+      exportBufferSet(bufSet, attr);
+    }
+  };
+  assert(mesh.numVertices > 0);
+  assert(mesh.numIndices > 0);
+
+  // Build mesh stage
+  const std::string meshName = prefix::mesh + mesh.meshName;
+  const std::string meshStagePath = meshDirPath + meshName + lss::ext::usd;
+  pxr::UsdStageRefPtr meshStage = findOpenOrCreateStage(meshStagePath, true);
+  assert(meshStage);
+  setCommonStageMetaData(meshStage, exportData);
+
+  pxr::VtDictionary customLayerData = meshStage->GetRootLayer()->GetCustomLayerData();
+  for (auto& component : mesh.componentHashes) {
+    customLayerData.SetValueAtPath(component.first, pxr::VtValue(component.second));
+  }
+  meshStage->GetRootLayer()->SetCustomLayerData(customLayerData);
+
+  // Build mesh xform prim on mesh stage, make it visible
+  const auto meshXformSdfPath = gStageRootPath.AppendElementString(meshName);
+  auto meshXformSchema = pxr::UsdGeomXform::Define(meshStage, meshXformSdfPath);
+  assert(meshXformSchema);
+  meshStage->SetDefaultPrim(meshXformSchema.GetPrim());
+  auto meshXformVisibilityAttr = meshXformSchema.CreateVisibilityAttr();
+  assert(meshXformVisibilityAttr);
+  meshXformVisibilityAttr.Set(gVisibilityInherited);
+
+  // Build mesh geometry prim under above xform
+  const auto meshSchemaSdfPath = meshXformSdfPath.AppendChild(gTokMesh);
+  auto meshSchema = pxr::UsdGeomMesh::Define(meshStage, meshSchemaSdfPath);
+  assert(meshSchema);
+  auto meshVisibilityAttr = meshSchema.CreateVisibilityAttr();
+  assert(meshVisibilityAttr);
+  meshVisibilityAttr.Set(gVisibilityInherited);
+  
+  // Set double-sidedness attribute
+  auto doubleSidedAttr = meshSchema.CreateDoubleSidedAttr();
+  assert(doubleSidedAttr);
+  doubleSidedAttr.Set(mesh.isDoubleSided);
+
+  // Set orientation attribute
+  auto orientationAttr = meshSchema.CreateOrientationAttr();
+  assert(orientationAttr);
+  orientationAttr.Set(pxr::VtValue(pxr::UsdGeomTokens->leftHanded));
+
+  // Create corresponding attribute arrays using above populated VtArrays
+  pxr::VtArray<int> faceVertexCounts;
+  faceVertexCounts.assign(mesh.numIndices / 3, 3);
+  auto faceVertexCountsAttr = meshSchema.CreateFaceVertexCountsAttr();
+  assert(faceVertexCountsAttr);
+  faceVertexCountsAttr.Set(faceVertexCounts);
+
+  // Indices
+  ReducedIdxBufSet reducedIdxBufSet = (exportData.meta.bReduceMeshBuffers) ? reduceIdxBufferSet(mesh.buffers.idxBufs) : ReducedIdxBufSet();
+  const std::map<float,IndexBuffer>& idxBufSet =
+    (exportData.meta.bReduceMeshBuffers) ? reducedIdxBufSet.bufSet : mesh.buffers.idxBufs;
+  auto indexAttr = meshSchema.CreateFaceVertexIndicesAttr();
+  assert(indexAttr);
+  exportSamples(idxBufSet, indexAttr);
+  // Vertices
+  const std::map<float,PositionBuffer> reducedPosBufSet =
+    (exportData.meta.bReduceMeshBuffers) ? reduceBufferSet(mesh.buffers.positionBufs, reducedIdxBufSet) : std::map<float,PositionBuffer>();
+  const std::map<float,PositionBuffer>& posBufSet =
+    (exportData.meta.bReduceMeshBuffers) ? reducedPosBufSet : mesh.buffers.positionBufs;
+  auto pointsAttr = meshSchema.CreatePointsAttr();
+  assert(pointsAttr);
+  exportSamples(posBufSet, pointsAttr);
+  // Normals
+  auto normalsAttr = meshSchema.CreateNormalsAttr();
+  assert(normalsAttr);
+  exportSamples(mesh.buffers.normalBufs, normalsAttr);
+  // Set subdivision scheme to None (USD defaults to catmull clark)
+  auto subdivAttr = meshSchema.CreateSubdivisionSchemeAttr();
+  assert(subdivAttr);
+  subdivAttr.Set(pxr::UsdGeomTokens->none);
+  // Texture Coordinates
+  const std::map<float,TexcoordBuffer> reducedTexcoordBufSet =
+    (exportData.meta.bReduceMeshBuffers) ? reduceBufferSet(mesh.buffers.texcoordBufs, reducedIdxBufSet) : std::map<float,TexcoordBuffer>();
+  const std::map<float,TexcoordBuffer>& texcoordBufSet =
+    (exportData.meta.bReduceMeshBuffers) ? reducedTexcoordBufSet : mesh.buffers.texcoordBufs;
+  static const pxr::TfToken kTokSt("st");
+  auto stAttr = meshSchema.CreatePrimvar(kTokSt, pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->vertex);
+  assert(stAttr);
+  exportSamples(texcoordBufSet, stAttr);
+
+  // Vertex Colors
+  if (mesh.buffers.colorBufs.size() > 0) {
+    auto displayColorPrimvar = meshSchema.CreateDisplayColorPrimvar(pxr::UsdGeomTokens->vertex);
+    assert(displayColorPrimvar);
+    if (mesh.buffers.colorBufs.cbegin()->second.size() == 1) {
+      // Constant Color
+      displayColorPrimvar.SetInterpolation(pxr::UsdGeomTokens->constant);
+    }
+    exportSamples(mesh.buffers.colorBufs, displayColorPrimvar);
+  }
+
+  // Read-only lookup, the material references are shared by all mesh stages
+  const auto matLssReferenceItr = ctx.matReferences.find(mesh.matId);
+  const bool bHasMat = matLssReferenceItr != ctx.matReferences.cend();
+  if(bHasMat) {
+    const Reference& matLssReference = matLssReferenceItr->second;
+    const auto shaderMatSchema = pxr::UsdShadeMaterial::Define(meshStage, matLssReference.ogSdfPath);
+    assert(shaderMatSchema);
+    auto shaderMatUsdReferences = shaderMatSchema.GetPrim().GetReferences();
+    const std::string fullMatStagePath = arDefResolver.ComputeLocalPath(matLssReference.stagePath);
+    const std::string relMatRefStagePath = std::filesystem::relative(fullMatStagePath,fullMeshStagePath).string();
+    shaderMatUsdReferences.AddReference(relMatRefStagePath, matLssReference.ogSdfPath);
+    pxr::UsdShadeMaterialBindingAPI(meshXformSchema.GetPrim()).Bind(shaderMatSchema);
+  }
+
+  // Kit metadata
+  if(exportData.meta.bUseLssUsdPlugins) {
+    meshXformSchema.GetPrim().SetMetadata(PXR_NS::SdfFieldKeys->Kind, PXR_NS::KindTokens->assembly);
+    static const pxr::TfToken kTokHideInStageWindow("hide_in_stage_window");
+    meshSchema.GetPrim().SetMetadata(kTokHideInStageWindow, true);
+    static const pxr::TfToken kTokNoDelete("no_delete");
+    meshSchema.GetPrim().SetMetadata(kTokNoDelete, true);
+  }
+
+  meshStage->Save();
+  
+  // Cache mesh reference
+  Reference meshLssReference;
+  meshLssReference.stagePath = meshStagePath;
+  meshLssReference.ogSdfPath = meshXformSdfPath;
+  
+  return meshLssReference;
+}
+
+template<typename T>
+static bool buffersEqual(const pxr::VtArray<T>& a, const pxr::VtArray<T>& b) {
+  return a.size() == b.size() && (a.IsIdentical(b) || memcmp(a.cdata(), b.cdata(), sizeof(T) * a.size()) == 0);
+}
+
 GameExporter::ReducedIdxBufSet GameExporter::reduceIdxBufferSet(const std::map<float,IndexBuffer>& idxBufSet) {
   ReducedIdxBufSet reducedIdxBufSet;
+  const IndexBuffer* pPrevIdxBuf = nullptr;
+  const IndexBuffer* pPrevReducedIdxBuf = nullptr;
+  int prevMinIdx = 0;
   for(const auto& [timeCode, idxBuf] : idxBufSet) {
+    // Topology rarely changes between samples, share the previous reduced buffer instead of building a copy
+    if(pPrevIdxBuf != nullptr && buffersEqual(*pPrevIdxBuf, idxBuf)) {
+      pPrevReducedIdxBuf = &(reducedIdxBufSet.bufSet[timeCode] = *pPrevReducedIdxBuf);
+      reducedIdxBufSet.idxOffsets[timeCode] = prevMinIdx;
+      continue;
+    }
     int minIdx = std::numeric_limits<int>::max();
     for(const int idx : idxBuf) {
       minIdx = std::min(idx, minIdx);
     }
-    for(const int idx : idxBuf) {
-      reducedIdxBufSet.bufSet[timeCode].push_back(idx - minIdx);
+    IndexBuffer reducedIdxBuf(idxBuf.size());
+    int* const pReducedIdx = reducedIdxBuf.data();
+    for(size_t i = 0; i < idxBuf.size(); ++i) {
+      pReducedIdx[i] = idxBuf[i] - minIdx;
     }
+    pPrevIdxBuf = &idxBuf;
+    pPrevReducedIdxBuf = &(reducedIdxBufSet.bufSet[timeCode] = std::move(reducedIdxBuf));
+    prevMinIdx = minIdx;
     reducedIdxBufSet.idxOffsets[timeCode] = minIdx;
   }
   return reducedIdxBufSet;
@@ -502,34 +643,75 @@ std::map<float,pxr::VtArray<T>> GameExporter::reduceBufferSet(const std::map<flo
     if(reducedIdxBufSet.bufSet.size() > 1) {
       auto itr = reducedIdxBufSet.bufSet.lower_bound(bufTimeCode);
       assert(itr != reducedIdxBufSet.bufSet.cend());
-      const float idxTimeCode = itr->first;
       return itr->first;
     } else {
       return reducedIdxBufSet.bufSet.cbegin()->first;
     }
   };
   std::map<float,pxr::VtArray<T>> reducedBufSet;
+  // Sorted, unique indices of each distinct index buffer, samples sharing an index buffer share its storage
+  std::unordered_map<const int*, std::vector<int>> sortedIdxCache;
+  const pxr::VtArray<T>* pPrevBuf = nullptr;
+  const pxr::VtArray<T>* pPrevReducedBuf = nullptr;
+  const int* pPrevIdxData = nullptr;
   for(const auto& [timeCode, buf] : bufSet) {
     // There may not be a 1:1 mapping in timecodes b/w index buffers and other buffers
     const float idxBufTimeCode = getIdxBufTimeCode(reducedIdxBufSet, timeCode);
     const IndexBuffer& idxBuf = reducedIdxBufSet.bufSet.at(idxBufTimeCode);
     const int idxBufReductionOffset = reducedIdxBufSet.idxOffsets.at(idxBufTimeCode);
+    // Unchanged data reduced by the same indices, share the previous result
+    if(pPrevBuf != nullptr && idxBuf.cdata() == pPrevIdxData && buffersEqual(*pPrevBuf, buf)) {
+      pPrevReducedBuf = &(reducedBufSet[timeCode] = *pPrevReducedBuf);
+      continue;
+    }
     // Sort indices
-    std::set<int> sortedIdxSet(idxBuf.cbegin(), idxBuf.cend());
-    // Create a scratch space to assign values for new, reduce VtArray, in case there are holes in the indices
-    const int maxIdx = *(--sortedIdxSet.cend());
+    auto [sortedIdxItr, bNewIdxBuf] = sortedIdxCache.try_emplace(idxBuf.cdata());
+    std::vector<int>& sortedIdx = sortedIdxItr->second;
+    if(bNewIdxBuf) {
+      sortedIdx.assign(idxBuf.cbegin(), idxBuf.cend());
+      std::sort(sortedIdx.begin(), sortedIdx.end());
+      sortedIdx.erase(std::unique(sortedIdx.begin(), sortedIdx.end()), sortedIdx.end());
+    }
+    // Allocate the new, reduced VtArray, in case there are holes in the indices
+    const int maxIdx = sortedIdx.back();
     const size_t numElems = maxIdx + 1;
-    T* const reducedBufScratch = new T[numElems];
+    pxr::VtArray<T> reducedBuf(numElems);
+    T* const pReducedBuf = reducedBuf.data();
     // Init potential holes to 0
-    memset(reducedBufScratch, 0, sizeof(T) * numElems);
-    for(const int index : sortedIdxSet) {
-      reducedBufScratch[index] = buf[index + idxBufReductionOffset];
+    memset(pReducedBuf, 0, sizeof(T) * numElems);
+    for(const int index : sortedIdx) {
+      pReducedBuf[index] = buf[index + idxBufReductionOffset];
     }
-    reducedBufSet[timeCode] = pxr::VtArray<T>(reducedBufScratch, reducedBufScratch + numElems);
+    pPrevBuf = &buf;
+    pPrevIdxData = idxBuf.cdata();
+    pPrevReducedBuf = &(reducedBufSet[timeCode] = std::move(reducedBuf));
   }
   return reducedBufSet;
 }
 
+template<typename T>
+std::map<float,pxr::VtArray<T>> GameExporter::dedupBufferSet(const std::map<float,pxr::VtArray<T>>& bufSet,
+                                                             TimeSampleStats& stats) {
+  // A sample equal to both neighbours is what USD interpolates between them anyway. Only the first
+  // and last sample of a run of equal samples are kept, the last one too if it ends the set.
+  std::map<float,pxr::VtArray<T>> dedupedBufSet;
+  size_t bytesSaved = 0;
+  for(auto itr = bufSet.cbegin(); itr != bufSet.cend(); ++itr) {
+    const auto nextItr = std::next(itr);
+    const bool bRepeatsPrev = itr != bufSet.cbegin() && buffersEqual(std::prev(itr)->second, itr->second);
+    const bool bRepeatedByNext = nextItr == bufSet.cend() || buffersEqual(nextItr->second, itr->second);
+    if(bRepeatsPrev && bRepeatedByNext) {
+      bytesSaved += itr->second.size() * sizeof(T);
+      continue;
+    }
+    dedupedBufSet.emplace_hint(dedupedBufSet.cend(), itr->first, itr->second);
+  }
+  stats.numSamples += bufSet.size();
+  stats.numSamplesDropped += bufSet.size() - dedupedBufSet.size();
+  stats.bytesSaved += bytesSaved;
+  return dedupedBufSet;
+}
+
 template<typename T>
 void GameExporter::exportBufferSet(const std::map<float,pxr::VtArray<T>>& bufSet,
                                        pxr::UsdAttribute attr) {
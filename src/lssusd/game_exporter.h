@@ -29,6 +29,7 @@
 #include "game_exporter_common.h"
 #include "game_exporter_types.h"
 
+#include <atomic>
 #include <mutex>
 
 namespace lss {
@@ -47,18 +48,39 @@ private:
     pxr::SdfPath ogSdfPath;
     pxr::SdfPath instanceSdfPath;
   };
+  struct TimeSampleStats {
+    std::atomic<size_t> numSamples = 0;
+    std::atomic<size_t> numSamplesDropped = 0;
+    std::atomic<size_t> bytesSaved = 0;
+  };
   struct ExportContext {
     pxr::UsdStageRefPtr instanceStage;
     IdMap<Reference> matReferences;
     IdMap<Reference> meshReferences;
   };
   static void exportUsdInternal(const Export& exportData);
+  static size_t getNumExportThreads(const Export& exportData);
+  // Runs func(i) for every i in [0, count) on up to numThreads threads, including the calling one
+  template<typename F>
+  static void parallelFor(const size_t count, const size_t numThreads, const F& func);
   static pxr::UsdStageRefPtr createInstanceStage(const Export& exportData);
   static pxr::UsdStageRefPtr createStageAndRootPrim(const std::string& path);
   static void setCommonStageMetaData(pxr::UsdStageRefPtr stage, const Export& exportData);
   static void createApertureMdls(const std::string& baseExportPath);
   static void exportMaterials(const Export& exportData, ExportContext& ctx);
+  // Authors a material to its own stage, safe to call concurrently
+  static Reference exportMaterialStage(const Export& exportData,
+                                       const Material& matData,
+                                       const std::string& matDirPath,
+                                       const std::string& fullMaterialBasePath);
   static void exportMeshes(const Export& exportData, ExportContext& ctx);
+  // Authors a mesh to its own stage, safe to call concurrently once all materials are exported
+  static Reference exportMeshStage(const Export& exportData,
+                                   const ExportContext& ctx,
+                                   const Mesh& mesh,
+                                   const std::string& meshDirPath,
+                                   const std::string& fullMeshStagePath,
+                                   TimeSampleStats& timeSampleStats);
   struct ReducedIdxBufSet {
     // Per-timecode reduced bufset
     std::map<float,IndexBuffer> bufSet;
@@ -70,6 +92,10 @@ private:
   template<typename T>
   static std::map<float,pxr::VtArray<T>> reduceBufferSet(const std::map<float,pxr::VtArray<T>>& bufSet,
                                                          const ReducedIdxBufSet& reducedIdxBufSet);
+  // Drops time samples USD interpolates to the same value from their neighbours
+  template<typename T>
+  static std::map<float,pxr::VtArray<T>> dedupBufferSet(const std::map<float,pxr::VtArray<T>>& bufSet,
+                                                        TimeSampleStats& stats);
   template<typename T>
   static void exportBufferSet(const std::map<float,pxr::VtArray<T>>& bufSet,
                               pxr::UsdAttribute attr);
@@ -136,8 +136,11 @@ struct ExportMetaData {
   double startTimeCode;
   double endTimeCode;
   size_t numFramesCaptured;
+  // Threads authoring mesh and material stages, 0 to use all hardware threads
+  size_t numExportThreads;
   bool bUseLssUsdPlugins;
   bool bReduceMeshBuffers;
+  bool bDedupTimeSamples;
   bool isZUp;
   bool isLHS;
 };
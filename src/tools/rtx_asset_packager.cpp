@@ -0,0 +1,247 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../dxvk/rtx_render/rtx_asset_package.h"
+#include "../dxvk/rtx_render/rtx_asset_package_writer.h"
+#include "../util/rc/util_rc_ptr.h"
+
+using namespace dxvk;
+
+// Command line tool to build, convert and validate asset packages.
+//
+//   rtx_asset_packager pack <directory> <output.pkg> [--chunk-kb N] [--no-compression]
+//     Packages every file of a directory as a buffer asset named by its relative path.
+//   rtx_asset_packager repack <input.pkg> <output.pkg> [--chunk-kb N] [--no-compression]
+//     Converts a version 1 or 2 package to version 2, re-chunking and LZ4 compressing raw blobs.
+//     GDeflate blobs are carried over as single chunks for RTX IO.
+//   rtx_asset_packager validate <package.pkg>
+//     Checks the dictionary and the CRC of every chunk, and decodes every CPU decodable blob.
+namespace {
+  struct Options {
+    uint32_t chunkSize = AssetPackage::kDefaultChunkSize;
+    AssetPackage::Compression compression = AssetPackage::Compression::LZ4;
+  };
+
+  void printUsage() {
+    std::cout << "Usage:" << std::endl
+              << "  rtx_asset_packager pack <directory> <output.pkg> [--chunk-kb N] [--no-compression]" << std::endl
+              << "  rtx_asset_packager repack <input.pkg> <output.pkg> [--chunk-kb N] [--no-compression]" << std::endl
+              << "  rtx_asset_packager validate <package.pkg>" << std::endl;
+  }
+
+  bool parseOptions(int argc, char** argv, int first, Options& options) {
+    for (int i = first; i < argc; i++) {
+      const std::string arg = argv[i];
+
+      if (arg == "--no-compression") {
+        options.compression = AssetPackage::Compression::None;
+      } else if (arg == "--chunk-kb" && i + 1 < argc) {
+        options.chunkSize = static_cast<uint32_t>(std::stoul(argv[++i])) * 1024;
+        if (options.chunkSize == 0) {
+          std::cerr << "Chunk size must not be 0" << std::endl;
+          return false;
+        }
+      } else {
+        std::cerr << "Unknown option " << arg << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  int pack(const std::filesystem::path& directory, const std::string& output, const Options& options) {
+    AssetPackageWriter writer(options.chunkSize);
+    if (!writer.open(output)) {
+      return 1;
+    }
+
+    std::vector<uint8_t> data;
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+      if (!entry.is_regular_file()) {
+        continue;
+      }
+
+      if (entry.file_size() > UINT32_MAX) {
+        std::cerr << "Skipping " << entry.path().string() << ", buffer assets are limited to 4GB" << std::endl;
+        continue;
+      }
+
+      std::ifstream file(entry.path(), std::ios::binary);
+      data.resize(entry.file_size());
+      if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        std::cerr << "Failed to read " << entry.path().string() << std::endl;
+        return 1;
+      }
+
+      AssetPackage::AssetDesc assetDesc {};
+      assetDesc.type = AssetPackage::AssetDesc::Type::BUFFER;
+      assetDesc.size = static_cast<uint32_t>(data.size());
+      assetDesc.numMips = 1;
+      assetDesc.arraySize = 1;
+      assetDesc.baseBlobIdx = static_cast<uint16_t>(writer.addBlob(data.data(), data.size(), options.compression));
+      assetDesc.tailBlobIdx = assetDesc.baseBlobIdx;
+
+      // Names must match the lookups of AssetDataManager::findAsset
+      writer.addAsset(std::filesystem::relative(entry.path(), directory).make_preferred().string(), assetDesc);
+    }
+
+    if (!writer.finish()) {
+      std::cerr << "Failed to write " << output << std::endl;
+      return 1;
+    }
+
+    return 0;
+  }
+
+  int repack(const std::string& input, const std::string& output, const Options& options) {
+    Rc<AssetPackage> package = new AssetPackage(input);
+    if (!package->initialize()) {
+      return 1;
+    }
+
+    AssetPackageWriter writer(options.chunkSize);
+    if (!writer.open(output)) {
+      return 1;
+    }
+
+    // Blobs keep their indices, so the asset descriptors can be copied as they are
+    std::vector<uint8_t> decoded;
+    for (uint32_t n = 0; package->getDataBlobDesc(n) != nullptr; n++) {
+      if (package->getDataBlobCompression(n) == AssetPackage::Compression::GDeflate) {
+        const AssetPackage::BlobSpan blob = package->getDataBlob(n);
+        writer.addGDeflateBlob(blob.data, blob.size);
+        continue;
+      }
+
+      decoded.resize(package->getDataBlobSize(n));
+      if (!decoded.empty() && package->decodeDataBlob(n, decoded.data(), decoded.size()) == 0) {
+        std::cerr << "Failed to decode blob " << n << std::endl;
+        return 1;
+      }
+
+      writer.addBlob(decoded.data(), decoded.size(), options.compression);
+    }
+
+    for (uint32_t n = 0; n < package->getAssetCount(); n++) {
+      writer.addAsset(package->getAssetName(n), *package->getAssetDesc(n));
+    }
+
+    if (!writer.finish()) {
+      std::cerr << "Failed to write " << output << std::endl;
+      return 1;
+    }
+
+    return 0;
+  }
+
+  int validate(const std::string& filename) {
+    Rc<AssetPackage> package = new AssetPackage(filename);
+    if (!package->initialize()) {
+      return 1;
+    }
+
+    uint32_t numBlobs = 0;
+    uint32_t numChunks = 0;
+    uint32_t numGDeflateBlobs = 0;
+    uint32_t numFailures = 0;
+    uint64_t storedBytes = 0;
+    uint64_t decodedBytes = 0;
+
+    std::vector<uint8_t> decoded;
+    for (uint32_t n = 0; package->getDataBlobDesc(n) != nullptr; n++) {
+      numBlobs++;
+      numChunks += package->getDataBlobChunkCount(n);
+      storedBytes += package->getDataBlobDesc(n)->size;
+
+      // RTX IO decodes GDeflate blobs on the GPU, only their placement was validated
+      if (package->getDataBlobCompression(n) == AssetPackage::Compression::GDeflate) {
+        numGDeflateBlobs++;
+        continue;
+      }
+
+      decoded.resize(package->getDataBlobSize(n));
+      if (!decoded.empty() && package->decodeDataBlob(n, decoded.data(), decoded.size()) == 0) {
+        std::cerr << "Blob " << n << " failed to decode" << std::endl;
+        numFailures++;
+        continue;
+      }
+
+      decodedBytes += decoded.size();
+    }
+
+    for (uint32_t n = 0; n < package->getAssetCount(); n++) {
+      const AssetPackage::AssetDesc* assetDesc = package->getAssetDesc(n);
+      if (package->getDataBlobDesc(assetDesc->baseBlobIdx) == nullptr ||
+          package->getDataBlobDesc(assetDesc->tailBlobIdx) == nullptr) {
+        std::cerr << "Asset " << package->getAssetName(n) << " references a missing blob" << std::endl;
+        numFailures++;
+      }
+    }
+
+    std::cout << filename << ": version " << package->getVersion()
+              << ", " << package->getAssetCount() << " assets"
+              << ", " << numBlobs << " blobs (" << numGDeflateBlobs << " GDeflate)"
+              << ", " << numChunks << " chunks" << std::endl
+              << "  stored " << (storedBytes >> 10) << " KB, decoded " << (decodedBytes >> 10) << " KB"
+              << ", " << numFailures << " failure(s)" << std::endl;
+
+    return numFailures == 0 ? 0 : 1;
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+
+  const std::string command = argv[1];
+
+  try {
+    Options options;
+
+    if (command == "pack" && argc >= 4 && parseOptions(argc, argv, 4, options)) {
+      return pack(argv[2], argv[3], options);
+    }
+
+    if (command == "repack" && argc >= 4 && parseOptions(argc, argv, 4, options)) {
+      return repack(argv[2], argv[3], options);
+    }
+
+    if (command == "validate") {
+      return validate(argv[2]);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  printUsage();
+  return 1;
+}
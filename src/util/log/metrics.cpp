@@ -19,51 +19,461 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
-#include "METRICS.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "log.h"
 
 #include "../util_env.h"
-#include "util_math.h"
+#include "../util_likely.h"
+#include "../util_string.h"
 
 namespace dxvk {
-  
-  Metrics::Metrics() {
-    auto path = getFileName();
 
-    if (!path.empty())
-      m_fileStream = std::ofstream(str::tows(path.c_str()).c_str());
+  thread_local Metrics::ThreadRing Metrics::s_threadRing;
+
+  Metrics::ThreadRing::~ThreadRing() {
+    // The flusher frees the ring once it drained what is left in it
+    if (ring)
+      ring->retired.store(true, std::memory_order_release);
+  }
+
+  Metrics::Metrics()
+  : m_format(getFormat())
+  , m_path(getFileName(m_format))
+  , m_enabled(!m_path.empty()) { }
+
+  Metrics::~Metrics() {
+    // This runs during static destruction, i.e. under the loader lock on
+    // Windows, where joining would deadlock. shutdown() is expected to have
+    // stopped the flusher already, if it did not, the flusher still owns
+    // the rings and everything is left to the process teardown.
+    if (m_thread.joinable()) {
+      m_thread.detach();
+      return;
+    }
+
+    // Rings of threads that are still alive are leaked on purpose,
+    // their thread local destructors still reference them.
+    std::lock_guard<dxvk::mutex> lock(m_ringMutex);
+    for (Ring* ring : m_rings) {
+      if (ring->retired.load(std::memory_order_acquire))
+        delete ring;
+    }
+  }
+
+  MetricId Metrics::registerMetric(const char* name, MetricType type) {
+    if (!m_enabled)
+      return kInvalidMetricId;
+
+    std::lock_guard<dxvk::mutex> lock(m_registryMutex);
+
+    for (uint32_t i = 0; i < m_metrics.size(); i++) {
+      if (m_metrics[i].name == name) {
+        if (m_metrics[i].type != type)
+          Logger::warn(str::format("Metric ", name, " was registered with conflicting types"));
+
+        return i;
+      }
+    }
+
+    m_metrics.push_back({ name, type });
+    m_metricCount.store(uint32_t(m_metrics.size()), std::memory_order_release);
+    return MetricId(m_metrics.size() - 1);
+  }
+
+  void Metrics::push(MetricId id, double value) {
+    Ring* ring = s_threadRing.ring;
+
+    if (unlikely(ring == nullptr))
+      ring = s_threadRing.ring = createRing();
+
+    const uint32_t head = ring->head.load(std::memory_order_relaxed);
+    const uint32_t tail = ring->tail.load(std::memory_order_acquire);
+
+    if (unlikely(head - tail >= kRingSize)) {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    Event& event = ring->events[head % kRingSize];
+    event.id = id;
+    event.frame = m_frame.load(std::memory_order_relaxed);
+    event.value = value;
+
+    ring->head.store(head + 1, std::memory_order_release);
+  }
+
+  Metrics::Ring* Metrics::createRing() {
+    Ring* ring = new Ring();
+
+    std::lock_guard<dxvk::mutex> lock(m_ringMutex);
+    m_rings.push_back(ring);
+    return ring;
+  }
+
+  void Metrics::endFrame(uint64_t frameId) {
+    Metrics& self = s_instance;
+
+    if (!self.m_enabled)
+      return;
+
+    { std::unique_lock<dxvk::mutex> lock(self.m_frameMutex);
+
+      if (self.m_stopped)
+        return;
+
+      // The flusher thread is only spawned once the first frame ends, so that
+      // nothing happens while the DLL is being loaded.
+      if (!self.m_thread.joinable())
+        self.m_thread = dxvk::thread([&self] { self.runFlusher(); });
+
+      self.m_markers.push_back({ frameId, high_resolution_clock::now() });
+      self.m_frame.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    self.m_frameCond.notify_all();
+  }
+
+  void Metrics::flush() {
+    Metrics& self = s_instance;
+
+    if (!self.m_enabled)
+      return;
+
+    std::unique_lock<dxvk::mutex> lock(self.m_frameMutex);
+
+    self.m_frameCond.wait(lock, [&self] {
+      return self.m_stopped || !self.m_thread.joinable() ||
+             self.m_framesWritten == self.m_frame.load(std::memory_order_relaxed);
+    });
+  }
+
+  void Metrics::shutdown() {
+    Metrics& self = s_instance;
+
+    if (!self.m_enabled)
+      return;
+
+    dxvk::thread thread;
+
+    { std::unique_lock<dxvk::mutex> lock(self.m_frameMutex);
+      self.m_stopped = true;
+      thread = std::move(self.m_thread);
+    }
+
+    self.m_frameCond.notify_all();
+
+    // The flusher writes all closed frames before it exits
+    if (thread.joinable())
+      thread.join();
+
+    { std::unique_lock<dxvk::mutex> lock(self.m_frameMutex);
+      self.m_stopped = false;
+    }
+  }
+
+  void Metrics::runFlusher() {
+    // Restarted after a shutdown, keep appending to the same file
+    if (!m_fileStream.is_open()) {
+      m_fileStream = std::ofstream(str::tows(m_path.c_str()).c_str(),
+        m_format == Format::Binary ? std::ios::binary : std::ios::out);
+
+      if (!m_fileStream)
+        Logger::err(str::format("Metrics: Failed to open ", m_path));
+
+      writeHeader();
+    }
+
+    std::vector<FrameMarker> markers;
+    uint32_t framesDone;
+
+    { std::unique_lock<dxvk::mutex> lock(m_frameMutex);
+      framesDone = m_framesWritten;
+    }
+
+    while (true) {
+      { std::unique_lock<dxvk::mutex> lock(m_frameMutex);
+
+        m_frameCond.wait(lock, [this] {
+          return m_stopped || !m_markers.empty();
+        });
+
+        if (m_markers.empty())
+          break;
+
+        markers.clear();
+        std::swap(markers, m_markers);
+      }
+
+      if (framesDone == 0)
+        m_startTime = markers.front().time;
+
+      syncRegistry();
+
+      m_pending.resize(markers.size());
+
+      for (size_t i = 0; i < markers.size(); i++) {
+        m_pending[i].marker = markers[i];
+        m_pending[i].dropped = 0;
+        m_pending[i].accumulators.assign(m_flusherMetrics.size(), Accumulator());
+      }
+
+      drainRings(framesDone, framesDone + uint32_t(markers.size()));
+
+      for (PendingFrame& frame : m_pending)
+        writeFrame(frame);
+
+      m_fileStream.flush();
+      framesDone += uint32_t(markers.size());
+
+      { std::unique_lock<dxvk::mutex> lock(m_frameMutex);
+        m_framesWritten = framesDone;
+      }
+
+      m_frameCond.notify_all();
+    }
   }
-  
-  Metrics::~Metrics() { }
 
-  void Metrics::log(Metric metric, const float& value) {
-    std::lock_guard<dxvk::mutex> lock(s_instance.m_mutex);
-    const float& oldValue = s_instance.m_data[metric];
+  void Metrics::syncRegistry() {
+    // Keep the copy of the registry in sync, registering never
+    // blocks on the flusher that way.
+    if (m_flusherMetrics.size() == m_metricCount.load(std::memory_order_acquire))
+      return;
+
+    std::lock_guard<dxvk::mutex> lock(m_registryMutex);
 
-    const uint32_t kRollingAvgWindow = 100;
-    s_instance.m_data[metric] = lerp(oldValue, value, 1.f / kRollingAvgWindow);
+    for (size_t i = m_flusherMetrics.size(); i < m_metrics.size(); i++)
+      m_flusherMetrics.push_back(m_metrics[i]);
   }
-  
-  void Metrics::serialize() {
-    for(uint32_t i=0 ; i<Metric::kCount ; i++)
-      s_instance.emitMsg((Metric)i, s_instance.m_data[i]);
+
+  void Metrics::drainRings(uint32_t firstFrame, uint32_t endFrame) {
+    std::lock_guard<dxvk::mutex> lock(m_ringMutex);
+
+    for (auto it = m_rings.begin(); it != m_rings.end(); ) {
+      Ring* ring = *it;
+
+      // Check before draining, the owning thread may not record anything after retiring
+      const bool retired = ring->retired.load(std::memory_order_acquire);
+
+      const uint32_t head = ring->head.load(std::memory_order_acquire);
+      uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+
+      // Values of frames that are still open stay in the ring
+      while (tail != head) {
+        const Event& event = ring->events[tail % kRingSize];
+
+        if (event.frame >= endFrame)
+          break;
+
+        // Values recorded just before a frame ended may arrive after
+        // that frame was written, those go into the oldest open frame.
+        PendingFrame& frame = m_pending[std::max(event.frame, firstFrame) - firstFrame];
+        accumulate(frame, event);
+        tail++;
+      }
+
+      ring->tail.store(tail, std::memory_order_release);
+      m_pending.back().dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+      if (retired && tail == head) {
+        delete ring;
+        it = m_rings.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void Metrics::accumulate(PendingFrame& frame, const Event& event) {
+    if (unlikely(event.id >= frame.accumulators.size())) {
+      // Registered after this batch took its copy of the registry, the id
+      // was handed out before the value was recorded so it is known now.
+      if (event.id >= m_flusherMetrics.size())
+        syncRegistry();
+
+      if (event.id >= m_flusherMetrics.size()) {
+        Logger::warn(str::format("Metrics: Dropped value of unknown metric ", event.id));
+        return;
+      }
+
+      frame.accumulators.resize(m_flusherMetrics.size());
+    }
+
+    Accumulator& acc = frame.accumulators[event.id];
+
+    if (acc.count == 0) {
+      acc.min = event.value;
+      acc.max = event.value;
+      acc.buckets.fill(0);
+    } else {
+      acc.min = std::min(acc.min, event.value);
+      acc.max = std::max(acc.max, event.value);
+    }
+
+    acc.count++;
+
+    switch (m_flusherMetrics[event.id].type) {
+    case MetricType::Counter:
+      acc.value += event.value;
+      break;
+    case MetricType::Gauge:
+      acc.value = event.value;
+      break;
+    case MetricType::Histogram:
+      acc.value += event.value;
+      acc.buckets[histogramBucket(event.value)]++;
+      break;
+    }
   }
 
   template<typename T>
-  void Metrics::emitMsg(Metric metric, const T& value) {
-    if(m_fileStream)
-      m_fileStream << m_metricNames[(uint32_t)metric] << " " << value << std::endl;
+  static void writeBinary(std::ofstream& stream, const T& value) {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void Metrics::writeHeader() {
+    if (m_format == Format::Binary) {
+      // Binary layout, little endian:
+      //   "DXMT" u32 version
+      //   'M' u32 id, u8 type, u16 nameLength, char name[nameLength]  - before a metric first appears
+      //   'F' u64 frameId, f64 timeMs, u32 dropped, u32 numEntries, then per entry
+      //       u32 id, u32 count, f64 value, f64 min, f64 max
+      //       histograms only: u8 firstBucket, u8 numBuckets, u32 buckets[numBuckets]
+      m_fileStream.write("DXMT", 4);
+      writeBinary(m_fileStream, uint32_t(1));
+    } else {
+      m_fileStream << "frame,time_ms,metric,count,value,min,max,p50,p95" << std::endl;
+    }
+  }
+
+  void Metrics::writeFrame(PendingFrame& frame) {
+    const double timeMs = std::chrono::duration<double, std::milli>(frame.marker.time - m_startTime).count();
+
+    if (m_format == Format::Csv) {
+      for (uint32_t id = 0; id < frame.accumulators.size(); id++) {
+        const Accumulator& acc = frame.accumulators[id];
+
+        if (acc.count == 0)
+          continue;
+
+        m_fileStream << frame.marker.frameId << "," << timeMs << "," << m_flusherMetrics[id].name << "," << acc.count << ",";
+
+        if (m_flusherMetrics[id].type == MetricType::Histogram) {
+          m_fileStream << (acc.value / acc.count) << "," << acc.min << "," << acc.max << ","
+                       << histogramPercentile(acc, 0.5) << "," << histogramPercentile(acc, 0.95) << "\n";
+        } else {
+          m_fileStream << acc.value << "," << acc.min << "," << acc.max << ",,\n";
+        }
+      }
+
+      if (frame.dropped)
+        m_fileStream << frame.marker.frameId << "," << timeMs << ",metrics_dropped," << frame.dropped << "," << frame.dropped << ",,,,\n";
+
+      return;
+    }
+
+    uint32_t numEntries = 0;
+
+    for (uint32_t id = 0; id < frame.accumulators.size(); id++) {
+      if (frame.accumulators[id].count == 0)
+        continue;
+
+      numEntries++;
+
+      MetricInfo& info = m_flusherMetrics[id];
+
+      if (!info.described) {
+        m_fileStream.put('M');
+        writeBinary(m_fileStream, id);
+        writeBinary(m_fileStream, uint8_t(info.type));
+        writeBinary(m_fileStream, uint16_t(info.name.size()));
+        m_fileStream.write(info.name.data(), info.name.size());
+        info.described = true;
+      }
+    }
+
+    m_fileStream.put('F');
+    writeBinary(m_fileStream, frame.marker.frameId);
+    writeBinary(m_fileStream, timeMs);
+    writeBinary(m_fileStream, frame.dropped);
+    writeBinary(m_fileStream, numEntries);
+
+    for (uint32_t id = 0; id < frame.accumulators.size(); id++) {
+      const Accumulator& acc = frame.accumulators[id];
+
+      if (acc.count == 0)
+        continue;
+
+      writeBinary(m_fileStream, id);
+      writeBinary(m_fileStream, acc.count);
+      writeBinary(m_fileStream, acc.value);
+      writeBinary(m_fileStream, acc.min);
+      writeBinary(m_fileStream, acc.max);
+
+      if (m_flusherMetrics[id].type == MetricType::Histogram) {
+        uint32_t first = 0;
+        uint32_t last = kHistogramBuckets - 1;
+
+        while (acc.buckets[first] == 0)
+          first++;
+
+        while (acc.buckets[last] == 0)
+          last--;
+
+        writeBinary(m_fileStream, uint8_t(first));
+        writeBinary(m_fileStream, uint8_t(last - first + 1));
+        m_fileStream.write(reinterpret_cast<const char*>(&acc.buckets[first]), (last - first + 1) * sizeof(uint32_t));
+      }
+    }
+  }
+
+  uint32_t Metrics::histogramBucket(double value) {
+    if (!(value >= 1.0))
+      return 0;
+
+    // Values in [2^(n-1), 2^n) map to bucket n
+    int exponent = 0;
+    std::frexp(value, &exponent);
+    return std::min(uint32_t(exponent), kHistogramBuckets - 1);
+  }
+
+  double Metrics::histogramPercentile(const Accumulator& acc, double percentile) {
+    const double target = percentile * acc.count;
+    double count = 0.0;
+
+    for (uint32_t i = 0; i < kHistogramBuckets; i++) {
+      count += acc.buckets[i];
+
+      if (count >= target) {
+        // Upper bound of the bucket, clamped to the observed range
+        const double upper = std::ldexp(1.0, int(i));
+        return std::clamp(upper, acc.min, acc.max);
+      }
+    }
+
+    return acc.max;
   }
-  
-  std::string Metrics::getFileName() {
+
+  Metrics::Format Metrics::getFormat() {
+    return env::getEnvVar("DXVK_METRICS_FORMAT") == "binary"
+      ? Format::Binary
+      : Format::Csv;
+  }
+
+  std::string Metrics::getFileName(Format format) {
     std::string path = env::getEnvVar("DXVK_METRICS_PATH");
-    
-    if (path == "none")
+
+    // Metrics are opt-in, nothing is recorded unless a path is given
+    if (path.empty() || path == "none")
       return "";
 
-    if (!path.empty() && *path.rbegin() != '/')
+    if (*path.rbegin() != '/')
       path += '/';
 
-    path += "metrics.txt";
+    path += format == Format::Binary ? "metrics.bin" : "metrics.csv";
     return path;
   }
 }
@@ -22,56 +22,213 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
-#include <iostream>
-#include <mutex>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "../thread.h"
+#include "../util_time.h"
 
 namespace dxvk {
-  enum Metric {
-    average_frame_time = 0,  // In milliseconds
-    vid_memory_usage,        // In MB
-    sys_memory_usage,        // In MB
-    gpu_idle_ticks,          // In milliseconds
 
-    kCount
+  enum class MetricType : uint8_t {
+    Counter = 0,   // Sum of all values added during a frame
+    Gauge,         // Last value set during a frame
+    Histogram,     // Distribution of all values sampled during a frame
   };
 
+  /**
+   * \brief Metric handle
+   *
+   * Returned by the Metrics::register* functions, an invalid
+   * handle is returned when metrics are disabled.
+   */
+  using MetricId = uint32_t;
+
+  constexpr MetricId kInvalidMetricId = UINT32_MAX;
+
   /**
    * \brief Metrics
-   * 
-   * Metrics for one DLL. Creates a text file and
-   * writes all metrics messages to that file.
+   *
+   * Per frame time series of counters, gauges and histograms for one DLL.
+   * Enabled by setting DXVK_METRICS_PATH to a directory, DXVK_METRICS_FORMAT
+   * selects between "csv" (default, metrics.csv) and "binary" (metrics.bin).
+   *
+   * Recording a value only appends to a lock-free ring owned by the calling
+   * thread, a background thread aggregates the rings every frame and writes
+   * the file, so any thread may record without stalling the frame. Values
+   * recorded while a ring is full are dropped and reported as such.
+   *
+   * Subsystems register their metrics on first use, e.g.
+   *
+   *   static const MetricId s_blasBuilds = Metrics::registerCounter("blas_builds");
+   *   Metrics::add(s_blasBuilds, numBuilds);
+   *
+   * Registering is idempotent, the same name always maps to the same handle.
+   *
+   * The flusher thread must be stopped with shutdown() before the DLL is
+   * unloaded, the destructor runs under the loader lock and cannot join it.
    */
   class Metrics {
   public:
     Metrics();
     ~Metrics();
-    
-    static void log(Metric metric, const float& value);
-    static void serialize();
+
+    static MetricId registerCounter(const char* name) {
+      return s_instance.registerMetric(name, MetricType::Counter);
+    }
+
+    static MetricId registerGauge(const char* name) {
+      return s_instance.registerMetric(name, MetricType::Gauge);
+    }
+
+    // Histograms use power of two buckets: [0, 1), [1, 2), [2, 4) ...
+    static MetricId registerHistogram(const char* name) {
+      return s_instance.registerMetric(name, MetricType::Histogram);
+    }
+
+    // Record a value, aggregated according to the type the metric was registered with
+    static void add(MetricId id, double value = 1.0) {
+      if (id != kInvalidMetricId)
+        s_instance.push(id, value);
+    }
+
+    static void set(MetricId id, double value) {
+      add(id, value);
+    }
+
+    static void sample(MetricId id, double value) {
+      add(id, value);
+    }
+
+    static bool enabled() {
+      return s_instance.m_enabled;
+    }
+
+    // Closes the current frame, values recorded from now on belong to the next one
+    static void endFrame(uint64_t frameId);
+
+    // Blocks until all closed frames were written to the file
+    static void flush();
+
+    // Writes all closed frames and stops the flusher thread, the next
+    // endFrame starts it again and appends to the same file.
+    static void shutdown();
 
   private:
-    inline static const std::string m_metricNames[kCount] = {
-      "average_frame_time",
-      "vid_memory_usage",
-      "sys_memory_usage",
-      "gpu_idle_ticks",
+    static constexpr uint32_t kRingSize = 4096;
+    static constexpr uint32_t kHistogramBuckets = 64;
+
+    enum class Format {
+      Csv,
+      Binary,
+    };
+
+    struct Event {
+      MetricId id;
+      uint32_t frame;
+      double   value;
+    };
+
+    // Single producer (the owning thread), single consumer (the flusher)
+    struct Ring {
+      std::array<Event, kRingSize> events;
+      alignas(64) std::atomic<uint32_t> head = { 0u };
+      alignas(64) std::atomic<uint32_t> tail = { 0u };
+      std::atomic<uint32_t> dropped = { 0u };
+      std::atomic<bool> retired = { false };
+    };
+
+    struct ThreadRing {
+      Ring* ring = nullptr;
+      ~ThreadRing();
+    };
+
+    struct MetricInfo {
+      std::string name;
+      MetricType type;
+      bool described = false;
+    };
+
+    struct Accumulator {
+      uint32_t count = 0;
+      double value = 0.0;
+      double min = 0.0;
+      double max = 0.0;
+      std::array<uint32_t, kHistogramBuckets> buckets;
+    };
+
+    struct FrameMarker {
+      uint64_t frameId;
+      high_resolution_clock::time_point time;
     };
 
-    std::array<float, Metric::kCount> m_data = {};
+    struct PendingFrame {
+      FrameMarker marker;
+      uint32_t dropped = 0;
+      std::vector<Accumulator> accumulators;
+    };
 
     static Metrics s_instance;
-    
-    dxvk::mutex    m_mutex;
+
+    static thread_local ThreadRing s_threadRing;
+
+    const Format m_format;
+    const std::string m_path;
+    const bool m_enabled;
+
+    // Registry, append only
+    dxvk::mutex m_registryMutex;
+    std::vector<MetricInfo> m_metrics;
+    std::atomic<uint32_t> m_metricCount = { 0u };
+
+    // Rings of all threads that recorded a value
+    dxvk::mutex m_ringMutex;
+    std::vector<Ring*> m_rings;
+
+    // Frame index stamped into recorded values, incremented by endFrame
+    std::atomic<uint32_t> m_frame = { 0u };
+
+    dxvk::mutex m_frameMutex;
+    dxvk::condition_variable m_frameCond;
+    std::vector<FrameMarker> m_markers;
+    uint32_t m_framesWritten = 0;
+    bool m_stopped = false;
+    dxvk::thread m_thread;
+
+    // Owned by the flusher thread
     std::ofstream m_fileStream;
-    
-    template<typename T>
-    void emitMsg(Metric metric, const T& value);
-    
-    static std::string getFileName();
+    high_resolution_clock::time_point m_startTime;
+    std::vector<PendingFrame> m_pending;
+    std::vector<MetricInfo> m_flusherMetrics;
+
+    MetricId registerMetric(const char* name, MetricType type);
+
+    void push(MetricId id, double value);
+
+    Ring* createRing();
+
+    void runFlusher();
+
+    void syncRegistry();
+
+    void drainRings(uint32_t firstFrame, uint32_t endFrame);
+
+    void accumulate(PendingFrame& frame, const Event& event);
+
+    void writeHeader();
+
+    void writeFrame(PendingFrame& frame);
+
+    static uint32_t histogramBucket(double value);
+
+    static double histogramPercentile(const Accumulator& acc, double percentile);
+
+    static Format getFormat();
+
+    static std::string getFileName(Format format);
   };
 }
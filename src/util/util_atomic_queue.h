@@ -19,7 +19,9 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <utility>
 
@@ -69,4 +71,81 @@ namespace dxvk {
     std::atomic<uint32_t> m_head;
     std::atomic<uint32_t> m_tail;
   };
+
+  /**
+    * \brief Implements a bounded (MPMC) queue with similar functionality to STL.
+    *        Any number of threads may "push" and "pop" simultaneously.
+    *        Each slot carries a sequence number which tells producers and
+    *        consumers whether it is free for the current lap around the ring,
+    *        so neither side needs a lock (D. Vyukov's bounded MPMC queue).
+    *  T: Type of the object
+    *  Capacity: Number of elements in the ring buffer.
+    */
+  template <typename T, uint32_t Capacity>
+  class AtomicMpmcQueue {
+  public:
+    AtomicMpmcQueue() {
+      for (uint32_t i = 0; i < Capacity; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      m_enqueuePos.store(0, std::memory_order_relaxed);
+      m_dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    // Item is only moved from when the push succeeds
+    bool push(T&& item) {
+      Cell* cell;
+      size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+      while (true) {
+        cell = &m_cells[pos % Capacity];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+          if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;  // queue is full
+        } else {
+          pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+      }
+      cell->data = std::move(item);
+      cell->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(T& item) {
+      Cell* cell;
+      size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+      while (true) {
+        cell = &m_cells[pos % Capacity];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+        if (diff == 0) {
+          if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;  // queue is empty
+        } else {
+          pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+      }
+      item = std::move(cell->data);
+      cell->sequence.store(pos + Capacity, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      T data;
+    };
+
+    std::array<Cell, Capacity> m_cells;
+    // Keep producers and consumers off each others cache lines
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) std::atomic<size_t> m_dequeuePos;
+  };
 } //dxvk
@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <fstream>
+
+#include "util_content_hash_cache.h"
+#include "util_mapped_file.h"
+#include "util_string.h"
+#include "log/log.h"
+
+namespace dxvk {
+  // Cache file layout, little endian:
+  //   header:  magic, version, entry count (uint32 each)
+  //   entries: path length (uint32), path (not terminated), size (uint64), modification time (int64), hash (uint64)
+  constexpr uint32_t kCacheMagic = 0x43485852; // "RXHC"
+  constexpr uint32_t kCacheVersion = 1;
+  // Guards against reading garbage lengths from a corrupted file
+  constexpr uint32_t kMaxPathLength = 4096;
+
+  template<typename T>
+  static bool readValue(std::ifstream& file, T& value) {
+    return bool(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+  }
+
+  template<typename T>
+  static void writeValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  bool ContentHashCache::load(const std::filesystem::path& cacheFilename) {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    m_cacheFilename = cacheFilename;
+    m_directory = cacheFilename.parent_path().lexically_normal();
+    m_entries.clear();
+    m_dirty = false;
+
+    std::ifstream file(cacheFilename, std::ios::binary);
+    if (!file) {
+      return false;
+    }
+
+    uint32_t magic, version, count;
+    if (!readValue(file, magic) || !readValue(file, version) || !readValue(file, count) ||
+        magic != kCacheMagic || version != kCacheVersion) {
+      Logger::warn(str::format("Ignoring content hash cache ", cacheFilename.string(), " of an unknown format."));
+      return false;
+    }
+
+    std::string path;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t length;
+      Entry entry;
+      if (!readValue(file, length) || length > kMaxPathLength) {
+        break;
+      }
+
+      path.resize(length);
+      if (!file.read(path.data(), length) ||
+          !readValue(file, entry.size) || !readValue(file, entry.modificationTime) || !readValue(file, entry.hash)) {
+        break;
+      }
+
+      m_entries.emplace(path, entry);
+    }
+
+    if (m_entries.size() != count) {
+      // Keep what could be read, the rest is hashed again
+      Logger::warn(str::format("Content hash cache ", cacheFilename.string(), " is truncated."));
+      m_dirty = true;
+    }
+
+    return !m_entries.empty();
+  }
+
+  bool ContentHashCache::save() {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    if (!m_dirty || m_cacheFilename.empty()) {
+      return true;
+    }
+
+    std::ofstream file(m_cacheFilename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      Logger::warn(str::format("Unable to write content hash cache ", m_cacheFilename.string()));
+      return false;
+    }
+
+    writeValue(file, kCacheMagic);
+    writeValue(file, kCacheVersion);
+    writeValue(file, uint32_t(m_entries.size()));
+
+    for (const auto& [path, entry] : m_entries) {
+      writeValue(file, uint32_t(path.size()));
+      file.write(path.data(), path.size());
+      writeValue(file, entry.size);
+      writeValue(file, entry.modificationTime);
+      writeValue(file, entry.hash);
+    }
+
+    m_dirty = !file.good();
+    return !m_dirty;
+  }
+
+  XXH64_hash_t ContentHashCache::getHash(const std::filesystem::path& filename) {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(filename, ec);
+    if (ec) {
+      return 0;
+    }
+
+    const int64_t modificationTime = std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+    if (ec) {
+      return 0;
+    }
+
+    const std::string key = getKey(filename);
+
+    {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      auto it = m_entries.find(key);
+      if (it != m_entries.end() && it->second.size == size && it->second.modificationTime == modificationTime) {
+        return it->second.hash;
+      }
+    }
+
+    // Hash outside of the lock, files can be large
+    MappedFile file;
+    if (!file.open(filename.string())) {
+      return 0;
+    }
+
+    const XXH64_hash_t hash = XXH3_64bits(file.data(), file.size());
+
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+    m_entries[key] = Entry { size, modificationTime, hash };
+    m_numFilesHashed++;
+    m_dirty = true;
+    return hash;
+  }
+
+  bool ContentHashCache::covers(const std::filesystem::path& filename) const {
+    if (m_directory.empty()) {
+      return false;
+    }
+
+    const std::filesystem::path relative = filename.lexically_normal().lexically_relative(m_directory);
+    return !relative.empty() && *relative.begin() != "..";
+  }
+
+  std::string ContentHashCache::getKey(const std::filesystem::path& filename) const {
+    const std::filesystem::path normalized = filename.lexically_normal();
+
+    if (covers(normalized)) {
+      return normalized.lexically_relative(m_directory).generic_string();
+    }
+
+    return normalized.generic_string();
+  }
+}
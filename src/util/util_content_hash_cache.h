@@ -0,0 +1,98 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+#include "thread.h"
+#include "xxHash/xxhash.h"
+
+namespace dxvk {
+  /**
+    * \brief Content hashes of files, persisted in a cache file.
+    *
+    *  A file is hashed in full the first time it is looked up, and again
+    *  only once its size or modification time change.  Paths inside the
+    *  cache file's directory are stored relative to it, so the cache stays
+    *  valid when the directory is moved.  Without a cache file the hashes
+    *  are only kept in memory.  Thread safe.
+    */
+  class ContentHashCache {
+  public:
+    /**
+      * \brief Loads a cache file
+      *
+      *  A missing or unreadable cache file starts an empty cache, which
+      *  save() writes to the same path.
+      *   cacheFilename [in]: path of the cache file
+      *   returns: true if cached hashes were loaded
+      */
+    bool load(const std::filesystem::path& cacheFilename);
+
+    /**
+      * \brief Writes the cache file if hashes were added or changed
+      *
+      *   returns: false if the cache file could not be written
+      */
+    bool save();
+
+    /**
+      * \brief Content hash of a file
+      *
+      *   filename [in]: path of the file
+      *   returns: hash of the file contents, 0 if the file cannot be read
+      */
+    XXH64_hash_t getHash(const std::filesystem::path& filename);
+
+    // True if the file lies in the directory of the cache file
+    bool covers(const std::filesystem::path& filename) const;
+
+    size_t size() const {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      return m_entries.size();
+    }
+
+    // Number of files whose contents were read since the cache was loaded
+    uint32_t numFilesHashed() const {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      return m_numFilesHashed;
+    }
+
+  private:
+    struct Entry {
+      uint64_t size;
+      int64_t modificationTime;
+      XXH64_hash_t hash;
+    };
+
+    mutable dxvk::mutex m_mutex;
+    std::filesystem::path m_cacheFilename;
+    std::filesystem::path m_directory;
+    std::unordered_map<std::string, Entry> m_entries;
+    uint32_t m_numFilesHashed = 0;
+    bool m_dirty = false;
+
+    std::string getKey(const std::filesystem::path& filename) const;
+  };
+}
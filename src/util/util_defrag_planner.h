@@ -0,0 +1,265 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "util_flat_hash_map.h"
+
+namespace dxvk {
+  /**
+    * \brief Plans the evacuation of sparsely used memory chunks, a few bytes each frame.
+    *
+    *  Chunks filled below a maximum occupancy with nothing but movable allocations are
+    *  marked for evacuation when the other chunks of their memory type have room for
+    *  their contents.  Each frame the allocations in evacuating chunks are handed out
+    *  for relocation up to a byte budget, emptiest chunks first, so the chunks can be
+    *  released as soon as possible.  A chunk which stops shrinking is given back, and
+    *  not retried until its contents change.
+    *  The planner only sees chunk and allocation descriptions: the caller stops
+    *  allocating from evacuating chunks, moves the allocations and releases empty
+    *  chunks, which then disappear from the chunks passed in and count as reclaimed.
+    */
+  class DefragPlanner {
+  public:
+    struct Settings {
+      // Chunks filled up to this fraction are evacuated
+      float maxOccupancy = 0.25f;
+      uint64_t budgetBytesPerFrame = 16ull << 20;
+      uint32_t maxEvacuatingChunks = 2;
+      // Frames without an evacuating chunk shrinking before it is given back
+      uint32_t maxStalledFrames = 60;
+    };
+
+    struct Chunk {
+      uint64_t id;
+      uint32_t memoryType;
+      uint64_t size;
+      uint64_t usedBytes;
+    };
+
+    struct Allocation {
+      uint64_t chunkId;
+      uint64_t size;
+    };
+
+    struct Report {
+      uint64_t movedBytes = 0;
+      uint64_t reclaimedBytes = 0;
+      uint32_t evacuatedChunks = 0;
+      uint32_t abandonedChunks = 0;
+      uint32_t evacuatingChunks = 0;
+    };
+
+    /**
+      * \brief Advances the plan by a frame
+      *
+      *   chunks [in]: every sub-allocated chunk, released chunks are left out
+      *   allocations [in]: every movable allocation
+      *   evacuate [out]: chunks to stop allocating from
+      *   restore [out]: evacuating chunks which stalled, to allocate from again
+      *   moves [out]: indices of the allocations to relocate this frame
+      */
+    void update(const Settings& settings, const std::vector<Chunk>& chunks, const std::vector<Allocation>& allocations,
+                std::vector<uint64_t>& evacuate, std::vector<uint64_t>& restore, std::vector<uint32_t>& moves) {
+      evacuate.clear();
+      restore.clear();
+      moves.clear();
+
+      FlatHashMap<uint64_t, uint32_t> chunkIndices;
+      chunkIndices.reserve(chunks.size());
+      for (uint32_t i = 0; i < chunks.size(); i++) {
+        chunkIndices.emplace(chunks[i].id, i);
+      }
+
+      FlatHashMap<uint64_t, uint64_t> movableBytes;
+      for (const Allocation& allocation : allocations) {
+        movableBytes[allocation.chunkId] += allocation.size;
+      }
+
+      trackEvacuations(settings, chunks, chunkIndices, restore);
+      selectChunks(settings, chunks, movableBytes, evacuate);
+      selectMoves(settings, chunks, chunkIndices, allocations, moves);
+
+      m_report.evacuatingChunks = uint32_t(m_evacuating.size());
+    }
+
+    bool isEvacuating(uint64_t chunkId) const {
+      return m_evacuating.contains(chunkId);
+    }
+
+    const Report& getReport() const {
+      return m_report;
+    }
+
+  private:
+    // Room required in the remaining chunks, relative to the bytes to move, for alignment and fragmentation
+    static constexpr uint64_t kHeadroomNumerator = 5;
+    static constexpr uint64_t kHeadroomDenominator = 4;
+
+    struct Evacuation {
+      uint32_t memoryType;
+      uint64_t size;
+      uint64_t lastUsedBytes;
+      uint32_t stalledFrames;
+    };
+
+    FlatHashMap<uint64_t, Evacuation> m_evacuating;
+    // Used bytes of given back chunks when they were given back
+    FlatHashMap<uint64_t, uint64_t> m_abandoned;
+    Report m_report;
+
+    // Released chunks are reclaimed, stalled ones given back
+    void trackEvacuations(const Settings& settings, const std::vector<Chunk>& chunks,
+                          const FlatHashMap<uint64_t, uint32_t>& chunkIndices, std::vector<uint64_t>& restore) {
+      for (auto it = m_evacuating.begin(); it != m_evacuating.end();) {
+        auto chunkIt = chunkIndices.find(it->first);
+
+        if (chunkIt == chunkIndices.end()) {
+          m_report.reclaimedBytes += it->second.size;
+          m_report.evacuatedChunks++;
+          it = m_evacuating.erase(it);
+          continue;
+        }
+
+        const uint64_t usedBytes = chunks[chunkIt->second].usedBytes;
+
+        if (usedBytes < it->second.lastUsedBytes) {
+          it->second.lastUsedBytes = usedBytes;
+          it->second.stalledFrames = 0;
+        } else if (++it->second.stalledFrames > settings.maxStalledFrames) {
+          restore.push_back(it->first);
+          m_abandoned.insert_or_assign(it->first, usedBytes);
+          m_report.abandonedChunks++;
+          it = m_evacuating.erase(it);
+          continue;
+        }
+
+        ++it;
+      }
+
+      for (auto it = m_abandoned.begin(); it != m_abandoned.end();) {
+        auto chunkIt = chunkIndices.find(it->first);
+
+        if (chunkIt == chunkIndices.end() || chunks[chunkIt->second].usedBytes != it->second) {
+          it = m_abandoned.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    void selectChunks(const Settings& settings, const std::vector<Chunk>& chunks,
+                      const FlatHashMap<uint64_t, uint64_t>& movableBytes, std::vector<uint64_t>& evacuate) {
+      if (m_evacuating.size() >= settings.maxEvacuatingChunks) {
+        return;
+      }
+
+      // Free space to move into, and bytes still to be moved, per memory type
+      FlatHashMap<uint32_t, uint64_t> freeBytes;
+      FlatHashMap<uint32_t, uint64_t> pendingBytes;
+      std::vector<uint32_t> candidates;
+
+      for (uint32_t i = 0; i < chunks.size(); i++) {
+        const Chunk& chunk = chunks[i];
+
+        if (m_evacuating.contains(chunk.id)) {
+          pendingBytes[chunk.memoryType] += chunk.usedBytes;
+          continue;
+        }
+
+        freeBytes[chunk.memoryType] += chunk.size - chunk.usedBytes;
+
+        auto movable = movableBytes.find(chunk.id);
+        const bool isMovable = chunk.usedBytes == 0 || (movable != movableBytes.end() && movable->second >= chunk.usedBytes);
+
+        if (isMovable && !m_abandoned.contains(chunk.id) && double(chunk.usedBytes) <= double(settings.maxOccupancy) * double(chunk.size)) {
+          candidates.push_back(i);
+        }
+      }
+
+      std::sort(candidates.begin(), candidates.end(), [&chunks](uint32_t a, uint32_t b) {
+        return chunks[a].usedBytes != chunks[b].usedBytes ? chunks[a].usedBytes < chunks[b].usedBytes : chunks[a].id < chunks[b].id;
+      });
+
+      for (const uint32_t index : candidates) {
+        if (m_evacuating.size() >= settings.maxEvacuatingChunks) {
+          break;
+        }
+
+        const Chunk& chunk = chunks[index];
+        uint64_t& free = freeBytes[chunk.memoryType];
+        uint64_t& pending = pendingBytes[chunk.memoryType];
+
+        // The chunk's own free space is not available to its contents
+        const uint64_t freeElsewhere = free - (chunk.size - chunk.usedBytes);
+        const uint64_t required = (pending + chunk.usedBytes) * kHeadroomNumerator / kHeadroomDenominator;
+
+        // Keep the last chunk with free space, releasing it would only allocate a new one
+        if (freeElsewhere == 0 || freeElsewhere < required) {
+          continue;
+        }
+
+        free = freeElsewhere;
+        pending += chunk.usedBytes;
+        m_evacuating.emplace(chunk.id, Evacuation { chunk.memoryType, chunk.size, chunk.usedBytes, 0 });
+        evacuate.push_back(chunk.id);
+      }
+    }
+
+    // Emptiest evacuating chunks first, at least one allocation per frame even if over budget
+    void selectMoves(const Settings& settings, const std::vector<Chunk>& chunks, const FlatHashMap<uint64_t, uint32_t>& chunkIndices,
+                     const std::vector<Allocation>& allocations, std::vector<uint32_t>& moves) {
+      for (uint32_t i = 0; i < allocations.size(); i++) {
+        if (m_evacuating.contains(allocations[i].chunkId)) {
+          moves.push_back(i);
+        }
+      }
+
+      auto usedBytes = [&](uint32_t allocation) {
+        return chunks[chunkIndices.at(allocations[allocation].chunkId)].usedBytes;
+      };
+
+      std::stable_sort(moves.begin(), moves.end(), [&](uint32_t a, uint32_t b) {
+        return usedBytes(a) != usedBytes(b) ? usedBytes(a) < usedBytes(b) : allocations[a].chunkId < allocations[b].chunkId;
+      });
+
+      uint64_t budget = settings.budgetBytesPerFrame;
+      size_t numMoves = 0;
+
+      for (; numMoves < moves.size(); numMoves++) {
+        const uint64_t size = allocations[moves[numMoves]].size;
+
+        if (numMoves > 0 && size > budget) {
+          break;
+        }
+
+        budget -= std::min(budget, size);
+        m_report.movedBytes += size;
+      }
+
+      moves.resize(numMoves);
+    }
+  };
+}
@@ -26,6 +26,9 @@
 #include "util_fastops.h"
 #include "vulkan/vk_platform.h"
 #include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <float.h>
 #include <ppl.h>
 #include "util_fastops.h"
 
@@ -953,6 +956,533 @@ namespace fast {
   }
 
 
+  template<typename T>
+  __forceinline size_t gatherOffset(const T* indices, const uint32_t i, const size_t stride) {
+    return (indices ? (size_t) indices[i] : (size_t) i) * stride;
+  }
+
+  template<typename T>
+  __forceinline void gatherStrided_slow(uint8_t* dstData, const uint8_t* srcData, const size_t elementSize, const size_t stride, const T* indices, const uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+      std::memcpy(dstData + i * elementSize, srcData + gatherOffset(indices, i, stride), elementSize);
+    }
+  }
+
+  template<typename T>
+  __forceinline void gatherStrided_SSE(uint8_t* dstData, const uint8_t* srcData, const size_t elementSize, const size_t stride, const T* indices, const uint32_t count) {
+    // Each element is moved with a single unaligned 16 byte load/store.  The store spills into the
+    // next element (or the padding at the end of dstData), which is then overwritten in order.
+    // The load may read past the element, but never past the start of the next vertex since
+    // stride >= 16, so only the final (highest addressed) element needs the exact copy.
+    constexpr uint32_t kPrefetchDistance = 8;
+    const uint32_t simdCount = count - 1;
+
+    for (uint32_t i = 0; i < simdCount; i++) {
+      if (i + kPrefetchDistance < count) {
+        _mm_prefetch((const char*) (srcData + gatherOffset(indices, i + kPrefetchDistance, stride)), _MM_HINT_T0);
+      }
+
+      const __m128i element = _mm_loadu_si128((const __m128i*) (srcData + gatherOffset(indices, i, stride)));
+      _mm_storeu_si128((__m128i*) (dstData + i * elementSize), element);
+    }
+
+    std::memcpy(dstData + simdCount * elementSize, srcData + gatherOffset(indices, simdCount, stride), elementSize);
+  }
+
+  template<typename T>
+  void gatherStrided(void* dstData, const void* srcData, const size_t elementSize, const size_t stride, const T* indices, const uint32_t count) {
+    if (count == 0) {
+      return;
+    }
+
+    uint8_t* dst = static_cast<uint8_t*>(dstData);
+    const uint8_t* src = static_cast<const uint8_t*>(srcData);
+
+    // Tightly packed input without indices is just a copy
+    if (indices == nullptr && stride == elementSize) {
+      std::memcpy(dst, src, elementSize * count);
+      return;
+    }
+
+    const bool useSSE = SSE_ENABLE && elementSize <= kGatherStridedPadding && stride >= kGatherStridedPadding;
+
+    if (useSSE) {
+      gatherStrided_SSE<T>(dst, src, elementSize, stride, indices, count);
+    } else {
+      gatherStrided_slow<T>(dst, src, elementSize, stride, indices, count);
+    }
+  }
+
+  template void gatherStrided<uint16_t>(void* dstData, const void* srcData, const size_t elementSize, const size_t stride, const uint16_t* indices, const uint32_t count);
+  template void gatherStrided<uint32_t>(void* dstData, const void* srcData, const size_t elementSize, const size_t stride, const uint32_t* indices, const uint32_t count);
+
+  static bool initF16cSupport() {
+    int result[4];
+    __cpuid(result, 0x1);
+    return (result[2] & (1 << 29));
+  }
+
+  static const bool g_supportsF16C = initF16cSupport();
+
+  __forceinline float halfToFloat_slow(const uint16_t half) {
+    // Rebias the exponent by scaling, this also normalizes denormals
+    const uint32_t exponentMantissa = half & 0x7fff;
+    uint32_t bits = exponentMantissa << 13;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    result *= 5.192296858534828e+33f; // 2^112
+    std::memcpy(&bits, &result, sizeof(bits));
+    // Infinities and NaNs keep an all ones exponent
+    if (exponentMantissa >= 0x7c00) {
+      bits |= 0x7f800000;
+    }
+    bits |= (uint32_t) (half & 0x8000) << 16;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+  }
+
+  // Same as halfToFloat_slow, on the 4 halves in the low 64 bits
+  __forceinline __m128 halfToFloat_SSE41(const __m128i& halves) {
+    const __m128i h = _mm_cvtepu16_epi32(halves);
+    const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    const __m128i exponentMantissa = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+    __m128 result = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+    const __m128i isInfNan = _mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7bff));
+    result = _mm_or_ps(result, _mm_castsi128_ps(_mm_and_si128(isInfNan, _mm_set1_epi32(0x7f800000))));
+    return _mm_or_ps(result, _mm_castsi128_ps(sign));
+  }
+
+  __forceinline void decodePosition_slow(const uint8_t* data, const PositionFormat format, float out[3]) {
+    switch (format) {
+    case PositionFormat::Float32x3:
+      std::memcpy(out, data, sizeof(float) * 3);
+      break;
+    case PositionFormat::Float16x4: {
+      uint16_t halves[3];
+      std::memcpy(halves, data, sizeof(halves));
+      for (uint32_t c = 0; c < 3; c++)
+        out[c] = halfToFloat_slow(halves[c]);
+      break;
+    }
+    case PositionFormat::Sint16x4:
+    case PositionFormat::Snorm16x4: {
+      int16_t values[3];
+      std::memcpy(values, data, sizeof(values));
+      for (uint32_t c = 0; c < 3; c++)
+        out[c] = format == PositionFormat::Snorm16x4 ? std::max(values[c] / 32767.f, -1.f) : (float) values[c];
+      break;
+    }
+    case PositionFormat::Uint8x4:
+    case PositionFormat::Unorm8x4:
+      for (uint32_t c = 0; c < 3; c++)
+        out[c] = format == PositionFormat::Unorm8x4 ? data[c] / 255.f : (float) data[c];
+      break;
+    case PositionFormat::Snorm10x3: {
+      uint32_t packed;
+      std::memcpy(&packed, data, sizeof(packed));
+      for (uint32_t c = 0; c < 3; c++) {
+        // Sign extend the 10 bit component
+        const int32_t value = (int32_t) (packed << (22 - c * 10)) >> 22;
+        out[c] = std::max(value / 511.f, -1.f);
+      }
+      break;
+    }
+    default:
+      assert(false);
+      break;
+    }
+  }
+
+  __forceinline void accumulatePositionBounds_slow(const uint8_t* data, const size_t stride, const uint32_t count, const PositionFormat format, float minInOut[3], float maxInOut[3]) {
+    for (uint32_t i = 0; i < count; i++) {
+      float position[3];
+      decodePosition_slow(data + i * stride, format, position);
+      for (uint32_t c = 0; c < 3; c++) {
+        minInOut[c] = std::min(minInOut[c], position[c]);
+        maxInOut[c] = std::max(maxInOut[c], position[c]);
+      }
+    }
+  }
+
+  __forceinline void storeBounds_SSE(const __m128 min, const __m128 max, float minInOut[3], float maxInOut[3]) {
+    alignas(16) float minPos[4];
+    alignas(16) float maxPos[4];
+    _mm_store_ps(minPos, min);
+    _mm_store_ps(maxPos, max);
+    for (uint32_t c = 0; c < 3; c++) {
+      minInOut[c] = std::min(minInOut[c], minPos[c]);
+      maxInOut[c] = std::max(maxInOut[c], maxPos[c]);
+    }
+  }
+
+  __forceinline void accumulateFloat32x3Bounds_SSE(const uint8_t* data, const size_t stride, const uint32_t count, float minInOut[3], float maxInOut[3]) {
+    __m128 min = _mm_set_ps1(FLT_MAX);
+    __m128 max = _mm_set_ps1(-FLT_MAX);
+
+    // The 16 byte load reads 4 bytes past the position, which stays inside the buffer for all but the last vertex
+    const uint32_t simdCount = count - 1;
+    for (uint32_t i = 0; i < simdCount; i++) {
+      const __m128 position = _mm_loadu_ps((const float*) (data + i * stride));
+      min = _mm_min_ps(min, position);
+      max = _mm_max_ps(max, position);
+    }
+
+    const float* last = (const float*) (data + simdCount * stride);
+    const __m128 position = _mm_set_ps(0.f, last[2], last[1], last[0]);
+    min = _mm_min_ps(min, position);
+    max = _mm_max_ps(max, position);
+
+    storeBounds_SSE(min, max, minInOut, maxInOut);
+  }
+
+  __forceinline void accumulateFloat16x4Bounds_SSE41(const uint8_t* data, const size_t stride, const uint32_t count, float minInOut[3], float maxInOut[3]) {
+    __m128 min = _mm_set_ps1(FLT_MAX);
+    __m128 max = _mm_set_ps1(-FLT_MAX);
+
+    for (uint32_t i = 0; i < count; i++) {
+      const __m128 position = halfToFloat_SSE41(_mm_loadl_epi64((const __m128i*) (data + i * stride)));
+      min = _mm_min_ps(min, position);
+      max = _mm_max_ps(max, position);
+    }
+
+    storeBounds_SSE(min, max, minInOut, maxInOut);
+  }
+
+  // Integer formats are bounded in their native type, the conversion to float is monotonic so it happens once at the end
+  __forceinline void accumulateInt16x4Bounds_SSE(const uint8_t* data, const size_t stride, const uint32_t count, const PositionFormat format, float minInOut[3], float maxInOut[3]) {
+    __m128i min = _mm_set1_epi16(INT16_MAX);
+    __m128i max = _mm_set1_epi16(INT16_MIN);
+
+    for (uint32_t i = 0; i < count; i++) {
+      const __m128i position = _mm_loadl_epi64((const __m128i*) (data + i * stride));
+      min = _mm_min_epi16(min, position);
+      max = _mm_max_epi16(max, position);
+    }
+
+    alignas(16) int16_t minPos[8];
+    alignas(16) int16_t maxPos[8];
+    _mm_store_si128((__m128i*) minPos, min);
+    _mm_store_si128((__m128i*) maxPos, max);
+    float minOut[3], maxOut[3];
+    decodePosition_slow((const uint8_t*) minPos, format, minOut);
+    decodePosition_slow((const uint8_t*) maxPos, format, maxOut);
+    for (uint32_t c = 0; c < 3; c++) {
+      minInOut[c] = std::min(minInOut[c], minOut[c]);
+      maxInOut[c] = std::max(maxInOut[c], maxOut[c]);
+    }
+  }
+
+  __forceinline void accumulateUint8x4Bounds_SSE(const uint8_t* data, const size_t stride, const uint32_t count, const PositionFormat format, float minInOut[3], float maxInOut[3]) {
+    __m128i min = _mm_set1_epi8((char) UINT8_MAX);
+    __m128i max = _mm_setzero_si128();
+
+    for (uint32_t i = 0; i < count; i++) {
+      int32_t packed;
+      std::memcpy(&packed, data + i * stride, sizeof(packed));
+      const __m128i position = _mm_cvtsi32_si128(packed);
+      min = _mm_min_epu8(min, position);
+      max = _mm_max_epu8(max, position);
+    }
+
+    const uint32_t minPacked = (uint32_t) _mm_cvtsi128_si32(min);
+    const uint32_t maxPacked = (uint32_t) _mm_cvtsi128_si32(max);
+    float minOut[3], maxOut[3];
+    decodePosition_slow((const uint8_t*) &minPacked, format, minOut);
+    decodePosition_slow((const uint8_t*) &maxPacked, format, maxOut);
+    for (uint32_t c = 0; c < 3; c++) {
+      minInOut[c] = std::min(minInOut[c], minOut[c]);
+      maxInOut[c] = std::max(maxInOut[c], maxOut[c]);
+    }
+  }
+
+  __forceinline void accumulateFloat32x3Bounds_AVX2(const uint8_t* data, const size_t stride, const uint32_t count, float minInOut[3], float maxInOut[3]) {
+    __m256 min = _mm256_set1_ps(FLT_MAX);
+    __m256 max = _mm256_set1_ps(-FLT_MAX);
+
+    // Two positions per iteration, the last vertex is left to the SSE variant as its load can't over-read
+    uint32_t i = 0;
+    for (; i + 2 < count; i += 2) {
+      const __m128 a = _mm_loadu_ps((const float*) (data + i * stride));
+      const __m128 b = _mm_loadu_ps((const float*) (data + (i + 1) * stride));
+      const __m256 positions = _mm256_insertf128_ps(_mm256_castps128_ps256(a), b, 1);
+      min = _mm256_min_ps(min, positions);
+      max = _mm256_max_ps(max, positions);
+    }
+
+    storeBounds_SSE(_mm_min_ps(_mm256_castps256_ps128(min), _mm256_extractf128_ps(min, 1)),
+                    _mm_max_ps(_mm256_castps256_ps128(max), _mm256_extractf128_ps(max, 1)),
+                    minInOut, maxInOut);
+
+    accumulateFloat32x3Bounds_SSE(data + i * stride, stride, count - i, minInOut, maxInOut);
+  }
+
+  __forceinline void accumulateFloat16x4Bounds_F16C(const uint8_t* data, const size_t stride, const uint32_t count, float minInOut[3], float maxInOut[3]) {
+    __m256 min = _mm256_set1_ps(FLT_MAX);
+    __m256 max = _mm256_set1_ps(-FLT_MAX);
+
+    uint32_t i = 0;
+    for (; i + 1 < count; i += 2) {
+      const __m128i a = _mm_loadl_epi64((const __m128i*) (data + i * stride));
+      const __m128i b = _mm_loadl_epi64((const __m128i*) (data + (i + 1) * stride));
+      const __m256 positions = _mm256_cvtph_ps(_mm_unpacklo_epi64(a, b));
+      min = _mm256_min_ps(min, positions);
+      max = _mm256_max_ps(max, positions);
+    }
+
+    if (i < count) {
+      const __m256 position = _mm256_castps128_ps256(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i*) (data + i * stride))));
+      min = _mm256_min_ps(min, _mm256_insertf128_ps(position, _mm256_castps256_ps128(position), 1));
+      max = _mm256_max_ps(max, _mm256_insertf128_ps(position, _mm256_castps256_ps128(position), 1));
+    }
+
+    storeBounds_SSE(_mm_min_ps(_mm256_castps256_ps128(min), _mm256_extractf128_ps(min, 1)),
+                    _mm_max_ps(_mm256_castps256_ps128(max), _mm256_extractf128_ps(max, 1)),
+                    minInOut, maxInOut);
+  }
+
+  void accumulatePositionBounds(const void* data, const size_t stride, const uint32_t count, const PositionFormat format, float minInOut[3], float maxInOut[3]) {
+    if (count == 0 || format == PositionFormat::Unsupported) {
+      return;
+    }
+
+    // Every vertex aliases the first, and the vector loads below rely on the next vertex following the current one
+    const uint32_t boundedCount = stride == 0 ? 1 : count;
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+
+    if (g_simdSupportLevel < SIMD::SSE4_1) {
+      accumulatePositionBounds_slow(src, stride, boundedCount, format, minInOut, maxInOut);
+      return;
+    }
+
+    const bool useAVX2 = g_simdSupportLevel >= SIMD::AVX2;
+
+    switch (format) {
+    case PositionFormat::Float32x3:
+      if (useAVX2) {
+        accumulateFloat32x3Bounds_AVX2(src, stride, boundedCount, minInOut, maxInOut);
+      } else {
+        accumulateFloat32x3Bounds_SSE(src, stride, boundedCount, minInOut, maxInOut);
+      }
+      break;
+    case PositionFormat::Float16x4:
+      if (useAVX2 && g_supportsF16C) {
+        accumulateFloat16x4Bounds_F16C(src, stride, boundedCount, minInOut, maxInOut);
+      } else {
+        accumulateFloat16x4Bounds_SSE41(src, stride, boundedCount, minInOut, maxInOut);
+      }
+      break;
+    case PositionFormat::Sint16x4:
+    case PositionFormat::Snorm16x4:
+      accumulateInt16x4Bounds_SSE(src, stride, boundedCount, format, minInOut, maxInOut);
+      break;
+    case PositionFormat::Uint8x4:
+    case PositionFormat::Unorm8x4:
+      accumulateUint8x4Bounds_SSE(src, stride, boundedCount, format, minInOut, maxInOut);
+      break;
+    default:
+      // Packed 10 bit components aren't worth a vector path, they're rare as positions
+      accumulatePositionBounds_slow(src, stride, boundedCount, format, minInOut, maxInOut);
+      break;
+    }
+  }
+
+  static bool initSse42Support() {
+    int result[4];
+    __cpuid(result, 0x1);
+    return (result[2] & (1 << 20));
+  }
+
+  static const bool g_supportsSSE42 = initSse42Support();
+
+  struct Crc32cTable {
+    uint32_t entries[256];
+
+    Crc32cTable() {
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (uint32_t bit = 0; bit < 8; bit++) {
+          crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0u);
+        }
+        entries[i] = crc;
+      }
+    }
+  };
+
+  __forceinline uint32_t crc32c_slow(const uint8_t* data, const size_t size, uint32_t crc) {
+    static const Crc32cTable table;
+
+    for (size_t i = 0; i < size; i++) {
+      crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+  }
+
+  __forceinline uint32_t crc32c_SSE42(const uint8_t* data, size_t size, uint32_t crc) {
+    uint64_t crc64 = crc;
+
+    for (; size >= 8; size -= 8, data += 8) {
+      uint64_t value;
+      memcpy(&value, data, sizeof(value));
+      crc64 = _mm_crc32_u64(crc64, value);
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+
+    for (; size > 0; size--, data++) {
+      crc = _mm_crc32_u8(crc, *data);
+    }
+
+    return crc;
+  }
+
+  uint32_t crc32c(const void* data, const size_t size, const uint32_t crc) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    if (g_supportsSSE42) {
+      return ~crc32c_SSE42(bytes, size, ~crc);
+    }
+
+    return ~crc32c_slow(bytes, size, ~crc);
+  }
+
+  __forceinline void deinterleaveFloats_slow(float* dstData, const uint8_t* srcData, const size_t stride, const uint32_t components, const uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+      std::memcpy(dstData + i * components, srcData + i * stride, components * sizeof(float));
+    }
+  }
+
+  __forceinline void deinterleaveFloats_SSE(float* dstData, const uint8_t* srcData, const size_t stride, const uint32_t components, const uint32_t count) {
+    // Same as gatherStrided_SSE: one unaligned 16 byte load/store per vertex, spilling into the next vertex
+    // which is written afterwards.  Stores stop early enough to never spill past the end of dstData, and
+    // loads to never read past the last vertex, the remaining vertices are copied exactly.
+    const uint32_t spilledVertices = (16 + components * 4 - 1) / (components * 4);
+    const uint32_t simdCount = count >= spilledVertices ? count - spilledVertices + 1 : 0;
+
+    for (uint32_t i = 0; i < simdCount; i++) {
+      _mm_storeu_ps(dstData + i * components, _mm_loadu_ps((const float*) (srcData + i * stride)));
+    }
+
+    deinterleaveFloats_slow(dstData + simdCount * components, srcData + simdCount * stride, stride, components, count - simdCount);
+  }
+
+  void deinterleaveFloats(float* dstData, const void* srcData, const size_t stride, const uint32_t components, const uint32_t count) {
+    assert(components >= 1 && components <= 4 && stride >= components * sizeof(float));
+
+    if (count == 0) {
+      return;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(srcData);
+
+    // Tightly packed input is just a copy
+    if (stride == components * sizeof(float)) {
+      std::memcpy(dstData, src, stride * count);
+      return;
+    }
+
+    if (SSE_ENABLE && stride >= 16) {
+      deinterleaveFloats_SSE(dstData, src, stride, components, count);
+    } else {
+      deinterleaveFloats_slow(dstData, src, stride, components, count);
+    }
+  }
+
+  __forceinline void widenIndices16_SSE(uint32_t* dstData, const uint16_t* srcData, const uint32_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+      const __m128i indices = _mm_loadu_si128((const __m128i*) (srcData + i));
+      _mm_storeu_si128((__m128i*) (dstData + i), _mm_unpacklo_epi16(indices, zero));
+      _mm_storeu_si128((__m128i*) (dstData + i + 4), _mm_unpackhi_epi16(indices, zero));
+    }
+
+    for (; i < count; i++) {
+      dstData[i] = srcData[i];
+    }
+  }
+
+  template<typename T>
+  void widenIndices(uint32_t* dstData, const T* srcData, const uint32_t count) {
+    if (count == 0) {
+      return;
+    }
+
+    if constexpr (sizeof(T) == sizeof(uint32_t)) {
+      std::memcpy(dstData, srcData, count * sizeof(uint32_t));
+    } else if (SSE_ENABLE) {
+      widenIndices16_SSE(dstData, srcData, count);
+    } else {
+      for (uint32_t i = 0; i < count; i++) {
+        dstData[i] = srcData[i];
+      }
+    }
+  }
+
+  template void widenIndices<uint16_t>(uint32_t* dstData, const uint16_t* srcData, const uint32_t count);
+  template void widenIndices<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count);
+
+  __forceinline bool anyDeltaExceeds_slow(const float* a, const float* b, const uint32_t count, const uint32_t components, const float maxDeltaSq) {
+    for (uint32_t i = 0; i < count; i++) {
+      float lengthSq = 0.f;
+      for (uint32_t c = 0; c < components; c++) {
+        const float delta = a[i * components + c] - b[i * components + c];
+        lengthSq += delta * delta;
+      }
+
+      if (lengthSq > maxDeltaSq) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  __forceinline bool anyDeltaExceeds_SSE(const float* a, const float* b, const uint32_t count, const uint32_t components, const float maxDeltaSq) {
+    // Blocks of 12 floats hold a whole number of 1 to 4 component vectors.  The squared length of a vector is at
+    // least its largest squared component, and at most components times that: a block is resolved by its largest
+    // squared component alone, unless it falls in between and the block's vectors are measured exactly.
+    constexpr uint32_t kBlockFloats = 12;
+    const uint32_t vectorsPerBlock = kBlockFloats / components;
+    const uint32_t numBlocks = count / vectorsPerBlock;
+    const __m128 exceeds = _mm_set1_ps(maxDeltaSq);
+    const __m128 mayExceed = _mm_set1_ps(maxDeltaSq / float(components));
+
+    for (uint32_t block = 0; block < numBlocks; block++) {
+      const float* pA = a + block * kBlockFloats;
+      const float* pB = b + block * kBlockFloats;
+
+      const __m128 delta0 = _mm_sub_ps(_mm_loadu_ps(pA + 0), _mm_loadu_ps(pB + 0));
+      const __m128 delta1 = _mm_sub_ps(_mm_loadu_ps(pA + 4), _mm_loadu_ps(pB + 4));
+      const __m128 delta2 = _mm_sub_ps(_mm_loadu_ps(pA + 8), _mm_loadu_ps(pB + 8));
+      const __m128 maxSq = _mm_max_ps(_mm_max_ps(_mm_mul_ps(delta0, delta0), _mm_mul_ps(delta1, delta1)), _mm_mul_ps(delta2, delta2));
+
+      if (_mm_movemask_ps(_mm_cmpgt_ps(maxSq, mayExceed)) != 0) {
+        if (_mm_movemask_ps(_mm_cmpgt_ps(maxSq, exceeds)) != 0 ||
+            anyDeltaExceeds_slow(pA, pB, vectorsPerBlock, components, maxDeltaSq)) {
+          return true;
+        }
+      }
+    }
+
+    const uint32_t tail = numBlocks * vectorsPerBlock;
+    return anyDeltaExceeds_slow(a + tail * components, b + tail * components, count - tail, components, maxDeltaSq);
+  }
+
+  bool anyDeltaExceeds(const float* a, const float* b, const uint32_t count, const uint32_t components, const float maxDelta) {
+    assert(components >= 1 && components <= 4);
+
+    const float maxDeltaSq = maxDelta * maxDelta;
+
+    if (SSE_ENABLE) {
+      return anyDeltaExceeds_SSE(a, b, count, components, maxDeltaSq);
+    }
+
+    return anyDeltaExceeds_slow(a, b, count, components, maxDeltaSq);
+  }
+
   template<typename T>
   __forceinline T findNthBit_BMI2(const T num, const T n) {
     return _tzcnt_u32(_pdep_u32(1 << n, num));
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 namespace fast {
   enum SIMD {
@@ -80,6 +81,97 @@ namespace fast {
     */
   void parallel_memcpy(void* dest, const void* src, const size_t count, const size_t chunkSize = 4096);
 
+  // Bytes of slack required past the end of the destination array of gatherStrided
+  static constexpr size_t kGatherStridedPadding = 16;
+
+  /**
+    * \brief Gathers strided elements from a buffer into a tightly packed array
+    *
+    * dstData: memory to write packed elements to, must have kGatherStridedPadding bytes of slack past count * elementSize
+    * srcData: base of the strided buffer to read from
+    * elementSize: size of each element in bytes
+    * stride: byte distance between consecutive elements in srcData
+    * indices: element indices to gather, sorted ascending (nullptr gathers elements [0, count))
+    * count: number of elements to gather
+    *
+    * Supports unsigned 32-bit and 16-bit indices.  All other uses undefined.
+    */
+  template<typename T>
+  void gatherStrided(void* dstData, const void* srcData, const size_t elementSize, const size_t stride, const T* indices, const uint32_t count);
+
+  // Vertex position layouts understood by accumulatePositionBounds, only xyz is read
+  enum class PositionFormat {
+    Float32x3,  // R32G32B32_SFLOAT, R32G32B32A32_SFLOAT
+    Float16x4,  // R16G16B16A16_SFLOAT
+    Sint16x4,   // R16G16B16A16_SSCALED
+    Snorm16x4,  // R16G16B16A16_SNORM
+    Uint8x4,    // R8G8B8A8_USCALED
+    Unorm8x4,   // R8G8B8A8_UNORM
+    Snorm10x3,  // A2B10G10R10_SNORM_PACK32
+    Unsupported
+  };
+
+  /**
+    * \brief Grows an axis aligned bounding box to contain a set of strided vertex positions
+    *
+    * data: first position to read
+    * stride: byte distance between consecutive positions
+    * count: number of positions
+    * format: layout of each position
+    * minInOut: xyz minimum, merged with the bounds of the positions
+    * maxInOut: xyz maximum, merged with the bounds of the positions
+    *
+    * Can be called repeatedly over chunks of a buffer, initialize the bounds to FLT_MAX/-FLT_MAX.
+    * Unsupported formats leave the bounds untouched.
+    */
+  void accumulatePositionBounds(const void* data, const size_t stride, const uint32_t count, const PositionFormat format, float minInOut[3], float maxInOut[3]);
+
+  /**
+    * \brief Computes the CRC-32C (Castagnoli) checksum of a byte array
+    *
+    * data: bytes to checksum
+    * size: number of bytes
+    * crc: checksum of the preceding bytes when checksumming in pieces, 0 otherwise
+    *
+    * Uses the SSE4.2 crc32 instruction where available.
+    */
+  uint32_t crc32c(const void* data, const size_t size, const uint32_t crc = 0);
+
+  /**
+    * \brief Copies the leading floats of strided vertices into a tightly packed array
+    *
+    * dstData: array of count * components floats to write, no slack is required
+    * srcData: first vertex to read
+    * stride: byte distance between consecutive vertices, at least components * sizeof(float)
+    * components: number of floats to copy per vertex, 1 to 4
+    * count: number of vertices
+    */
+  void deinterleaveFloats(float* dstData, const void* srcData, const size_t stride, const uint32_t components, const uint32_t count);
+
+  /**
+    * \brief Widens an index buffer to 32-bit indices
+    *
+    * dstData: array of count indices to write
+    * srcData: indices to read
+    * count: number of indices
+    *
+    * Supports unsigned 32-bit and 16-bit integers.  All other uses undefined.
+    */
+  template<typename T>
+  void widenIndices(uint32_t* dstData, const T* srcData, const uint32_t count);
+
+  /**
+    * \brief Checks whether any vector of one array is further than a distance from its counterpart in another
+    *
+    * a, b: arrays of count * components floats
+    * count: number of vectors
+    * components: floats per vector, 1 to 4
+    * maxDelta: largest euclidean distance between two vectors still considered equal
+    *
+    * Returns as soon as a vector further than maxDelta is found.
+    */
+  bool anyDeltaExceeds(const float* a, const float* b, const uint32_t count, const uint32_t components, const float maxDelta);
+
   /**
     * \brief Returns the index of the nth set bit
     *
@@ -0,0 +1,461 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "util_bit.h"
+
+namespace dxvk {
+  /**
+    * \brief Open addressing hash map, probing 16 slots at a time (Swiss table layout).
+    *
+    *  Every slot has a control byte that is either empty, deleted, or 7 bits of the hash of
+    *  its key. A lookup compares a group of 16 control bytes against those bits with SSE2 and
+    *  only reads the keys of the matching slots, so misses rarely touch a key at all. Keys and
+    *  values are stored inline in one array: growing the table moves them, which invalidates
+    *  iterators and references. Erasing keeps every other element in place.
+    *  K: Key type
+    *  V: Value type
+    *  Hash: Hash of K, its result goes through a finalizer so identity hashes of keys
+    *        that only differ in their high bits (aligned offsets, pointers) work as well
+    */
+  template<typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+  class FlatHashMap {
+    static constexpr size_t kGroupWidth = 16;
+    static constexpr int8_t kEmpty = -128;
+    static constexpr int8_t kDeleted = -2;
+
+    template<bool IsConst>
+    class Iterator;
+
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = size_t;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+
+    FlatHashMap(const FlatHashMap& other) {
+      reserve(other.m_size);
+      for (const value_type& value : other) {
+        emplace(value.first, value.second);
+      }
+    }
+
+    FlatHashMap(FlatHashMap&& other) noexcept {
+      swap(other);
+    }
+
+    FlatHashMap& operator = (FlatHashMap other) {
+      swap(other);
+      return *this;
+    }
+
+    ~FlatHashMap() {
+      destroy();
+    }
+
+    void swap(FlatHashMap& other) noexcept {
+      std::swap(m_ctrl, other.m_ctrl);
+      std::swap(m_slots, other.m_slots);
+      std::swap(m_capacity, other.m_capacity);
+      std::swap(m_size, other.m_size);
+      std::swap(m_growthLeft, other.m_growthLeft);
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_capacity; }
+
+    iterator begin() { return iterator(this, nextFull(0)); }
+    iterator end() { return iterator(this, m_capacity); }
+    const_iterator begin() const { return const_iterator(this, nextFull(0)); }
+    const_iterator end() const { return const_iterator(this, m_capacity); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    /**
+      * \brief Grows the table so it holds count elements without rehashing
+      */
+    void reserve(size_t count) {
+      size_t capacity = kGroupWidth;
+      while (maxLoad(capacity) < count) {
+        capacity *= 2;
+      }
+
+      if (capacity > m_capacity) {
+        rehash(capacity);
+      }
+    }
+
+    void clear() {
+      for (size_t i = 0; i < m_capacity; i++) {
+        if (isFull(m_ctrl[i])) {
+          m_slots[i].~value_type();
+        }
+      }
+
+      if (m_capacity > 0) {
+        std::memset(m_ctrl, kEmpty, m_capacity + kGroupWidth);
+      }
+
+      m_size = 0;
+      m_growthLeft = maxLoad(m_capacity);
+    }
+
+    iterator find(const K& key) {
+      return iterator(this, findIndex(key));
+    }
+
+    const_iterator find(const K& key) const {
+      return const_iterator(this, findIndex(key));
+    }
+
+    size_t count(const K& key) const {
+      return findIndex(key) != m_capacity ? 1 : 0;
+    }
+
+    bool contains(const K& key) const {
+      return findIndex(key) != m_capacity;
+    }
+
+    V& at(const K& key) {
+      const size_t index = findIndex(key);
+      assert(index != m_capacity);
+      return m_slots[index].second;
+    }
+
+    const V& at(const K& key) const {
+      const size_t index = findIndex(key);
+      assert(index != m_capacity);
+      return m_slots[index].second;
+    }
+
+    V& operator [] (const K& key) {
+      return try_emplace(key).first->second;
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+      const uint64_t hash = hashOf(key);
+      size_t index = findIndex(key, hash);
+
+      if (index != m_capacity) {
+        return { iterator(this, index), false };
+      }
+
+      index = prepareInsert(hash);
+      new (&m_slots[index]) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+      return { iterator(this, index), true };
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(const K& key, Args&&... args) {
+      return try_emplace(key, std::forward<Args>(args)...);
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+      return try_emplace(value.first, value.second);
+    }
+
+    template<typename T>
+    std::pair<iterator, bool> insert_or_assign(const K& key, T&& value) {
+      auto result = try_emplace(key, std::forward<T>(value));
+      if (!result.second) {
+        result.first->second = std::forward<T>(value);
+      }
+      return result;
+    }
+
+    size_t erase(const K& key) {
+      const size_t index = findIndex(key);
+      if (index == m_capacity) {
+        return 0;
+      }
+
+      eraseIndex(index);
+      return 1;
+    }
+
+    /**
+      * \brief Erases an element, the other elements and iterators to them stay valid
+      *
+      *   returns: iterator to the next element
+      */
+    iterator erase(const_iterator it) {
+      eraseIndex(it.m_index);
+      return iterator(this, nextFull(it.m_index + 1));
+    }
+
+    iterator erase(iterator it) {
+      return erase(const_iterator(it));
+    }
+
+  private:
+    int8_t* m_ctrl = nullptr;
+    value_type* m_slots = nullptr;
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    size_t m_growthLeft = 0;
+
+    template<bool IsConst>
+    class Iterator {
+      friend class FlatHashMap;
+      using Map = std::conditional_t<IsConst, const FlatHashMap, FlatHashMap>;
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = typename FlatHashMap::value_type;
+      using difference_type = std::ptrdiff_t;
+      using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+      using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+
+      Iterator() = default;
+      Iterator(Map* map, size_t index) : m_map(map), m_index(index) { }
+
+      // Mutable iterators convert to const ones
+      template<bool WasConst, typename = std::enable_if_t<IsConst && !WasConst>>
+      Iterator(const Iterator<WasConst>& other) : m_map(other.m_map), m_index(other.m_index) { }
+
+      reference operator * () const { return m_map->m_slots[m_index]; }
+      pointer operator -> () const { return &m_map->m_slots[m_index]; }
+
+      Iterator& operator ++ () {
+        m_index = m_map->nextFull(m_index + 1);
+        return *this;
+      }
+
+      Iterator operator ++ (int) {
+        Iterator result = *this;
+        ++(*this);
+        return result;
+      }
+
+      bool operator == (const Iterator& other) const { return m_index == other.m_index; }
+      bool operator != (const Iterator& other) const { return m_index != other.m_index; }
+
+    private:
+      template<bool> friend class Iterator;
+
+      Map* m_map = nullptr;
+      size_t m_index = 0;
+    };
+
+    static bool isFull(int8_t ctrl) {
+      return ctrl >= 0;
+    }
+
+    // Up to 7/8 of the slots are used before the table grows
+    static size_t maxLoad(size_t capacity) {
+      return capacity - capacity / 8;
+    }
+
+    // Murmur3 fmix64, every bit of the result depends on every bit of the hash. A multiply alone
+    // leaves the low bits, which pick the slot, depending only on the low bits of the key.
+    static uint64_t hashOf(const K& key) {
+      uint64_t hash = static_cast<uint64_t>(Hash()(key));
+      hash ^= hash >> 33;
+      hash *= 0xFF51AFD7ED558CCDull;
+      hash ^= hash >> 33;
+      hash *= 0xC4CEB9FE1A85EC53ull;
+      hash ^= hash >> 33;
+      return hash;
+    }
+
+    // Position from the low bits, control byte from the high bits of the hash
+    static int8_t h2(uint64_t hash) {
+      return static_cast<int8_t>(hash >> 57);
+    }
+
+    static uint32_t matchByte(const int8_t* group, int8_t value) {
+      const __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+    }
+
+    // Empty and deleted control bytes are the negative ones
+    static uint32_t matchEmptyOrDeleted(const int8_t* group) {
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+    }
+
+    void setCtrl(size_t index, int8_t value) {
+      m_ctrl[index] = value;
+      // The first group is mirrored past the end, so groups can be loaded at any position
+      if (index < kGroupWidth) {
+        m_ctrl[m_capacity + index] = value;
+      }
+    }
+
+    size_t nextFull(size_t index) const {
+      while (index < m_capacity && !isFull(m_ctrl[index])) {
+        index++;
+      }
+      return index;
+    }
+
+    size_t findIndex(const K& key) const {
+      return findIndex(key, hashOf(key));
+    }
+
+    // Returns m_capacity if the key isn't in the table
+    size_t findIndex(const K& key, uint64_t hash) const {
+      if (m_capacity == 0) {
+        return m_capacity;
+      }
+
+      const size_t mask = m_capacity - 1;
+      const int8_t tag = h2(hash);
+      size_t pos = hash & mask;
+
+      // Triangular steps of whole groups visit every group of a power of two sized table
+      for (size_t step = kGroupWidth; ; step += kGroupWidth) {
+        const int8_t* group = m_ctrl + pos;
+
+        for (uint32_t match = matchByte(group, tag); match != 0; match &= match - 1) {
+          const size_t index = (pos + bit::tzcnt(match)) & mask;
+          if (KeyEqual()(m_slots[index].first, key)) {
+            return index;
+          }
+        }
+
+        if (matchByte(group, kEmpty) != 0) {
+          return m_capacity;
+        }
+
+        pos = (pos + step) & mask;
+      }
+    }
+
+    size_t findFirstNonFull(uint64_t hash) const {
+      const size_t mask = m_capacity - 1;
+      size_t pos = hash & mask;
+
+      for (size_t step = kGroupWidth; ; step += kGroupWidth) {
+        const uint32_t match = matchEmptyOrDeleted(m_ctrl + pos);
+        if (match != 0) {
+          return (pos + bit::tzcnt(match)) & mask;
+        }
+
+        pos = (pos + step) & mask;
+      }
+    }
+
+    // Finds a slot for a new key and marks it as used, the caller constructs the element
+    size_t prepareInsert(uint64_t hash) {
+      size_t index = m_capacity > 0 ? findFirstNonFull(hash) : 0;
+
+      // Reusing a deleted slot doesn't use up growth
+      if (m_capacity == 0 || (m_growthLeft == 0 && m_ctrl[index] != kDeleted)) {
+        // Mostly deleted slots are reclaimed in place, otherwise the table doubles
+        rehash(m_capacity == 0 ? kGroupWidth : (m_size * 2 < maxLoad(m_capacity) ? m_capacity : m_capacity * 2));
+        index = findFirstNonFull(hash);
+      }
+
+      if (m_ctrl[index] == kEmpty) {
+        m_growthLeft--;
+      }
+
+      setCtrl(index, h2(hash));
+      m_size++;
+      return index;
+    }
+
+    void eraseIndex(size_t index) {
+      m_slots[index].~value_type();
+      m_size--;
+
+      // If every group containing this slot also has an empty slot, no probe ever continued past it
+      // and the slot can be empty again. Otherwise it stays deleted to keep those probes going.
+      const size_t mask = m_capacity - 1;
+      const uint32_t emptyAfter = matchByte(m_ctrl + index, kEmpty);
+      const uint32_t emptyBefore = matchByte(m_ctrl + ((index - kGroupWidth) & mask), kEmpty);
+      const uint32_t fullAfter = emptyAfter != 0 ? bit::tzcnt(emptyAfter) : kGroupWidth;
+      const uint32_t fullBefore = emptyBefore != 0 ? bit::lzcnt(emptyBefore) - 16 : kGroupWidth;
+
+      if (fullBefore + fullAfter < kGroupWidth) {
+        setCtrl(index, kEmpty);
+        m_growthLeft++;
+      } else {
+        setCtrl(index, kDeleted);
+      }
+    }
+
+    void rehash(size_t capacity) {
+      int8_t* oldCtrl = m_ctrl;
+      value_type* oldSlots = m_slots;
+      const size_t oldCapacity = m_capacity;
+
+      m_ctrl = new int8_t[capacity + kGroupWidth];
+      m_slots = std::allocator<value_type>().allocate(capacity);
+      m_capacity = capacity;
+      m_growthLeft = maxLoad(capacity) - m_size;
+      std::memset(m_ctrl, kEmpty, capacity + kGroupWidth);
+
+      for (size_t i = 0; i < oldCapacity; i++) {
+        if (isFull(oldCtrl[i])) {
+          const uint64_t hash = hashOf(oldSlots[i].first);
+          const size_t index = findFirstNonFull(hash);
+          setCtrl(index, h2(hash));
+          new (&m_slots[index]) value_type(std::move(oldSlots[i]));
+          oldSlots[i].~value_type();
+        }
+      }
+
+      if (oldCapacity > 0) {
+        delete[] oldCtrl;
+        std::allocator<value_type>().deallocate(oldSlots, oldCapacity);
+      }
+    }
+
+    void destroy() {
+      if (m_capacity == 0) {
+        return;
+      }
+
+      for (size_t i = 0; i < m_capacity; i++) {
+        if (isFull(m_ctrl[i])) {
+          m_slots[i].~value_type();
+        }
+      }
+
+      delete[] m_ctrl;
+      std::allocator<value_type>().deallocate(m_slots, m_capacity);
+      m_ctrl = nullptr;
+      m_slots = nullptr;
+      m_capacity = 0;
+      m_size = 0;
+      m_growthLeft = 0;
+    }
+  };
+}
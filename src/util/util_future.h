@@ -0,0 +1,316 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <assert.h>
+#include "thread.h"
+#include "util_error.h"
+#include "sync/sync_spinlock.h"
+
+namespace dxvk {
+  template<typename T> class Future;
+  template<typename T> class Promise;
+
+  /**
+    * \brief Shared state of a Promise/Future pair.  States are
+    *        intrusively ref counted and never freed, once the last
+    *        reference is dropped they go back to a per-type free list.
+    *        After the first few frames every task scheduled finds a
+    *        recycled state, so no allocation is made in steady state.
+    */
+  template<typename T>
+  class FutureState {
+    struct Empty { };
+    using Value = std::conditional_t<std::is_void_v<T>, Empty, T>;
+
+    enum Status : uint32_t {
+      Pending,
+      Ready,
+      Broken
+    };
+
+    class Pool {
+      // States are handed out in blocks to amortize the allocation
+      static constexpr size_t kBlockSize = 256;
+
+    public:
+      FutureState* acquire() {
+        std::lock_guard<sync::Spinlock> lock(m_lock);
+        if (m_freeList == nullptr) {
+          grow();
+        }
+        FutureState* state = m_freeList;
+        m_freeList = state->m_nextFree;
+        return state;
+      }
+
+      void release(FutureState* state) {
+        std::lock_guard<sync::Spinlock> lock(m_lock);
+        state->m_nextFree = m_freeList;
+        m_freeList = state;
+      }
+
+    private:
+      void grow() {
+        FutureState* block = m_blocks.emplace_back(std::make_unique<FutureState[]>(kBlockSize)).get();
+        for (size_t i = 0; i < kBlockSize; i++) {
+          block[i].m_nextFree = m_freeList;
+          m_freeList = &block[i];
+        }
+      }
+
+      sync::Spinlock m_lock;
+      FutureState* m_freeList = nullptr;
+      std::vector<std::unique_ptr<FutureState[]>> m_blocks;
+    };
+
+    static Pool& pool() {
+      // Deliberately leaked, futures held by other statics may be released after this would be destroyed
+      static Pool* s_pool = new Pool();
+      return *s_pool;
+    }
+
+  public:
+    static FutureState* acquire() {
+      FutureState* state = pool().acquire();
+      state->m_refCount.store(1, std::memory_order_relaxed);
+      state->m_status.store(Pending, std::memory_order_relaxed);
+      return state;
+    }
+
+    void incRef() {
+      m_refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void decRef() {
+      if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (m_status.load(std::memory_order_relaxed) == Ready) {
+          std::launder(reinterpret_cast<Value*>(m_storage))->~Value();
+        }
+        pool().release(this);
+      }
+    }
+
+    template<typename... Args>
+    void setValue(Args&&... args) {
+      assert(m_status.load(std::memory_order_relaxed) == Pending);
+      new (m_storage) Value(std::forward<Args>(args)...);
+      complete(Ready);
+    }
+
+    void setBroken() {
+      complete(Broken);
+    }
+
+    bool isReady() const {
+      return m_status.load(std::memory_order_acquire) != Pending;
+    }
+
+    bool isBroken() const {
+      return m_status.load(std::memory_order_acquire) == Broken;
+    }
+
+    void wait() const {
+      // Most results are a short task away, so spin a little before parking the thread.
+      // Tasks doing I/O (e.g. reading textures from disk) can take far longer than that.
+      for (uint32_t i = 0; i < kSpinCount; i++) {
+        if (isReady()) {
+          return;
+        }
+        _mm_pause();
+      }
+
+      std::unique_lock<dxvk::mutex> lock(m_mutex);
+      // Sequentially consistent with complete(), so either the waiter sees the result or the producer sees the waiter
+      m_waiters.fetch_add(1, std::memory_order_seq_cst);
+      m_cond.wait(lock, [this] { return m_status.load(std::memory_order_seq_cst) != Pending; });
+      m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const Value& value() const {
+      return *std::launder(reinterpret_cast<const Value*>(m_storage));
+    }
+
+  private:
+    static constexpr uint32_t kSpinCount = 1024;
+
+    void complete(Status status) {
+      m_status.store(status, std::memory_order_seq_cst);
+
+      // Only take the lock if a thread is parked, or about to park, on this state
+      if (m_waiters.load(std::memory_order_seq_cst) != 0) {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+        m_cond.notify_all();
+      }
+    }
+
+    std::atomic<uint32_t> m_refCount = 0;
+    std::atomic<uint32_t> m_status = Pending;
+    mutable std::atomic<uint32_t> m_waiters = 0;
+    mutable dxvk::mutex m_mutex;
+    mutable dxvk::condition_variable m_cond;
+    FutureState* m_nextFree = nullptr;
+    alignas(Value) uint8_t m_storage[sizeof(Value)];
+  };
+
+  /**
+    * \brief Shared handle to the result of an asynchronous task, a drop-in
+    *        replacement for std::shared_future backed by pooled states.
+    *        Copies share the same state and may be waited on from any thread.
+    */
+  template<typename T>
+  class Future {
+    friend class Promise<T>;
+
+  public:
+    Future() = default;
+
+    Future(const Future& other) : m_state(other.m_state) {
+      if (m_state) {
+        m_state->incRef();
+      }
+    }
+
+    Future(Future&& other) noexcept : m_state(other.m_state) {
+      other.m_state = nullptr;
+    }
+
+    Future& operator=(const Future& other) {
+      if (other.m_state) {
+        other.m_state->incRef();
+      }
+      reset();
+      m_state = other.m_state;
+      return *this;
+    }
+
+    Future& operator=(Future&& other) noexcept {
+      if (this != &other) {
+        reset();
+        m_state = other.m_state;
+        other.m_state = nullptr;
+      }
+      return *this;
+    }
+
+    ~Future() {
+      reset();
+    }
+
+    bool valid() const {
+      return m_state != nullptr;
+    }
+
+    bool isReady() const {
+      return m_state->isReady();
+    }
+
+    void wait() const {
+      m_state->wait();
+    }
+
+    // Blocks until the result is available, throws if the promise was abandoned
+    decltype(auto) get() const {
+      m_state->wait();
+      if (m_state->isBroken()) {
+        throw DxvkError("Future: broken promise");
+      }
+      if constexpr (!std::is_void_v<T>) {
+        return m_state->value();
+      }
+    }
+
+  private:
+    explicit Future(FutureState<T>* state) : m_state(state) {
+      m_state->incRef();
+    }
+
+    void reset() {
+      if (m_state) {
+        m_state->decRef();
+        m_state = nullptr;
+      }
+    }
+
+    FutureState<T>* m_state = nullptr;
+  };
+
+  /**
+    * \brief Producer side of a Future, a drop-in replacement for std::promise.
+    *        Destroying a promise without setting a value breaks it, waking up
+    *        any waiters with an exception.
+    */
+  template<typename T>
+  class Promise {
+  public:
+    Promise() : m_state(FutureState<T>::acquire()) { }
+
+    Promise(Promise&& other) noexcept : m_state(other.m_state) {
+      other.m_state = nullptr;
+    }
+
+    Promise& operator=(Promise&& other) noexcept {
+      if (this != &other) {
+        reset();
+        m_state = other.m_state;
+        other.m_state = nullptr;
+      }
+      return *this;
+    }
+
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+
+    ~Promise() {
+      reset();
+    }
+
+    Future<T> get_future() {
+      return Future<T>(m_state);
+    }
+
+    template<typename... Args>
+    void set_value(Args&&... args) {
+      m_state->setValue(std::forward<Args>(args)...);
+    }
+
+  private:
+    void reset() {
+      if (m_state) {
+        if (!m_state->isReady()) {
+          m_state->setBroken();
+        }
+        m_state->decRef();
+        m_state = nullptr;
+      }
+    }
+
+    FutureState<T>* m_state;
+  };
+} //dxvk
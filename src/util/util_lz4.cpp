@@ -0,0 +1,61 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "util_lz4.h"
+
+#include <algorithm>
+#include <limits.h>
+
+#include "lz4/lz4.h"
+
+namespace dxvk::lz4 {
+  size_t compressBound(size_t size) {
+    if (size > LZ4_MAX_INPUT_SIZE) {
+      return 0;
+    }
+
+    return static_cast<size_t>(LZ4_compressBound(static_cast<int>(size)));
+  }
+
+  size_t compress(const void* src, size_t srcSize, void* dst, size_t dstCapacity) {
+    if (srcSize > LZ4_MAX_INPUT_SIZE) {
+      return 0;
+    }
+
+    const int result = LZ4_compress_default(
+      static_cast<const char*>(src), static_cast<char*>(dst),
+      static_cast<int>(srcSize), static_cast<int>(std::min<size_t>(dstCapacity, INT_MAX)));
+
+    return result > 0 ? static_cast<size_t>(result) : 0;
+  }
+
+  size_t decompress(const void* src, size_t srcSize, void* dst, size_t dstCapacity) {
+    if (srcSize > INT_MAX) {
+      return 0;
+    }
+
+    const int result = LZ4_decompress_safe(
+      static_cast<const char*>(src), static_cast<char*>(dst),
+      static_cast<int>(srcSize), static_cast<int>(std::min<size_t>(dstCapacity, INT_MAX)));
+
+    return result > 0 ? static_cast<size_t>(result) : 0;
+  }
+}
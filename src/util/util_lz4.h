@@ -0,0 +1,56 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+
+namespace dxvk::lz4 {
+  /**
+    * \brief Worst case size of a compressed block
+    *
+    *   size [in]: size of the uncompressed data
+    *   returns: capacity compress() needs to always succeed, 0 if size is too large
+    */
+  size_t compressBound(size_t size);
+
+  /**
+    * \brief Compresses a block of data
+    *
+    *   src [in]: uncompressed data
+    *   srcSize [in]: size of the uncompressed data
+    *   dst [out]: compressed data
+    *   dstCapacity [in]: size of the dst buffer
+    *   returns: size of the compressed data, 0 if it did not fit in dstCapacity
+    */
+  size_t compress(const void* src, size_t srcSize, void* dst, size_t dstCapacity);
+
+  /**
+    * \brief Decompresses a block of data, safe against malformed input
+    *
+    *   src [in]: compressed data
+    *   srcSize [in]: size of the compressed data
+    *   dst [out]: uncompressed data
+    *   dstCapacity [in]: size of the dst buffer
+    *   returns: size of the uncompressed data, 0 if the input is malformed or dst is too small
+    */
+  size_t decompress(const void* src, size_t srcSize, void* dst, size_t dstCapacity);
+}
@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "util_mapped_file.h"
+#include "util_string.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dxvk {
+  MappedFile::~MappedFile() {
+    close();
+  }
+
+  void MappedFile::prefetch(size_t offset, size_t size) const {
+    if (m_data == nullptr || offset >= m_size || size == 0) {
+      return;
+    }
+
+    if (size > m_size - offset) {
+      size = m_size - offset;
+    }
+
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8_t*>(m_data + offset);
+    range.NumberOfBytes = size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    // madvise requires a page aligned start address
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t alignedOffset = offset & ~(pageSize - 1);
+    madvise(const_cast<uint8_t*>(m_data + alignedOffset), size + (offset - alignedOffset), MADV_WILLNEED);
+#endif
+  }
+
+#ifdef _WIN32
+  bool MappedFile::open(const std::string& filename) {
+    close();
+
+    HANDLE file = CreateFileW(str::tows(filename.c_str()).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+      CloseHandle(file);
+      return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+      CloseHandle(file);
+      return false;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+  }
+
+  void MappedFile::close() {
+    if (m_data) {
+      UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+      CloseHandle(m_mapping);
+    }
+    if (m_file) {
+      CloseHandle(m_file);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+  }
+#else
+  bool MappedFile::open(const std::string& filename) {
+    close();
+
+    const int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+      return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+      ::close(file);
+      return false;
+    }
+
+    void* view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+      ::close(file);
+      return false;
+    }
+
+    m_file = file;
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(fileStat.st_size);
+    return true;
+  }
+
+  void MappedFile::close() {
+    if (m_data) {
+      munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    if (m_file >= 0) {
+      ::close(m_file);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+    m_file = -1;
+  }
+#endif
+}
@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace dxvk {
+  /**
+    * \brief Read-only memory mapping of a whole file.
+    *
+    *  Pages are faulted in by the OS on first access, so consumers
+    *  can address the file contents directly without staging copies.
+    *  The mapping is immutable and may be read from any thread.
+    */
+  class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+      * \brief Maps the file, closing any previously mapped file first
+      *
+      *   filename [in]: path of the file to map
+      *   returns: true if the file was mapped, empty files fail to map
+      */
+    bool open(const std::string& filename);
+
+    /**
+      * \brief Unmaps the file, invalidating all pointers into it
+      */
+    void close();
+
+    /**
+      * \brief Hints the OS to start reading a range of the file
+      *
+      *  Asynchronous, returns before the pages are resident. Ranges
+      *  outside of the file are clamped.
+      *   offset [in]: byte offset of the range
+      *   size [in]: byte size of the range
+      */
+    void prefetch(size_t offset, size_t size) const;
+
+    bool isOpen() const {
+      return m_data != nullptr;
+    }
+
+    const uint8_t* data() const {
+      return m_data;
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+  private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_file = -1;
+#endif
+  };
+}
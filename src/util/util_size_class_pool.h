@@ -0,0 +1,299 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "util_bit.h"
+
+namespace dxvk {
+  /**
+    * \brief Pool of reusable, sized resources (e.g. acceleration structure buffers),
+    *        bucketed into power of two size classes.
+    *
+    *  Items handed out by acquire() are in flight until kFramesInFlight frames have
+    *  passed, then they return to the free list of their size class.  acquire() returns
+    *  the smallest free item of sufficient size: the free lists are kept sorted, and a
+    *  mask of non-empty classes finds the next larger class without scanning, so
+    *  acquiring is O(log n) plus moving the tail of one free list.
+    *  T: Handle to the pooled resource
+    */
+  template<typename T>
+  class SizeClassPool {
+  public:
+    // Items stay in flight for one extra frame, so the previous frame can still access them
+    static constexpr uint32_t kFramesInFlight = 2;
+    static constexpr uint32_t kNumClasses = 32;
+
+    struct Stats {
+      size_t numItems = 0;
+      size_t numFreeItems = 0;
+      size_t totalBytes = 0;
+      size_t freeBytes = 0;
+      // Bytes requested by the items in flight, the rest of their capacity is wasted
+      size_t requestedBytes = 0;
+      size_t inFlightBytes = 0;
+    };
+
+    /**
+      * \brief Takes the smallest free item of at least the requested size
+      *
+      *   size [in]: minimum capacity in bytes
+      *   frame [in]: current frame, items in flight for long enough are recycled first
+      *   out [out]: the item, now in flight
+      *   returns: false if no free item is large enough
+      */
+    bool acquire(size_t size, uint32_t frame, T& out) {
+      recycle(frame);
+
+      const uint32_t sizeClass = classOf(size);
+
+      // Free lists are sorted by decreasing capacity, the last sufficient entry is the best fit
+      std::vector<Entry>& list = m_free[sizeClass];
+      auto fit = std::partition_point(list.begin(), list.end(), [size](const Entry& e) { return e.capacity >= size; });
+
+      if (fit != list.begin()) {
+        return take(sizeClass, fit - list.begin() - 1, size, frame, out);
+      }
+
+      // Any item of a larger class is large enough, take the smallest of the next one
+      const uint32_t largerClasses = sizeClass + 1 < kNumClasses ? m_nonEmpty & ~((1u << (sizeClass + 1)) - 1) : 0;
+
+      if (largerClasses == 0) {
+        return false;
+      }
+
+      const uint32_t nextClass = bit::tzcnt(largerClasses);
+      return take(nextClass, m_free[nextClass].size() - 1, size, frame, out);
+    }
+
+    /**
+      * \brief Adds a new item to the pool, in flight for the current frame
+      */
+    void insert(const T& item, size_t capacity, size_t size, uint32_t frame) {
+      m_inFlight.push_back({ item, capacity, size, frame });
+      m_totalBytes += capacity;
+      m_inFlightBytes += capacity;
+      m_requestedBytes += size;
+    }
+
+    /**
+      * \brief Hands an item that was used outside of the pool over to it
+      *
+      *   lastUsed [in]: frame the item was last used in, or UINT32_MAX if never
+      *   frame [in]: current frame
+      */
+    void release(const T& item, size_t capacity, uint32_t lastUsed, uint32_t frame) {
+      m_totalBytes += capacity;
+
+      if (lastUsed != UINT32_MAX && lastUsed + kFramesInFlight > frame) {
+        // The frame of an in flight item must not be older than the ones queued before it
+        const uint32_t inFlightFrame = m_inFlight.empty() ? lastUsed : std::max(lastUsed, m_inFlight.back().frame);
+        m_inFlight.push_back({ item, capacity, 0, inFlightFrame });
+        m_inFlightBytes += capacity;
+      } else {
+        addFree({ item, capacity, 0, lastUsed == UINT32_MAX ? 0 : lastUsed });
+      }
+    }
+
+    /**
+      * \brief Evicts free items unused for a number of frames, then the least recently
+      *        used free items until the pool fits its budget. Items in flight are kept.
+      *
+      *   frame [in]: current frame
+      *   numFramesToKeep [in]: frames a free item survives without being used
+      *   budgetBytes [in]: capacity of all items the pool may keep, 0 for unlimited
+      *   returns: number of evicted items
+      */
+    size_t garbageCollect(uint32_t frame, uint32_t numFramesToKeep, size_t budgetBytes) {
+      recycle(frame);
+
+      size_t numEvicted = 0;
+
+      for (uint32_t sizeClass = 0; sizeClass < kNumClasses; sizeClass++) {
+        std::vector<Entry>& list = m_free[sizeClass];
+
+        // Keeps the order of the survivors, the evicted items end up behind them
+        auto end = std::stable_partition(list.begin(), list.end(), [&](const Entry& e) {
+          return e.frame + numFramesToKeep >= frame;
+        });
+
+        numEvicted += evict(sizeClass, end, list.end());
+      }
+
+      if (budgetBytes == 0 || m_totalBytes <= budgetBytes) {
+        return numEvicted;
+      }
+
+      // Over budget: evict the least recently used free items first
+      std::vector<std::pair<uint32_t, uint32_t>> candidates;
+      for (uint32_t sizeClass = 0; sizeClass < kNumClasses; sizeClass++) {
+        for (const Entry& e : m_free[sizeClass]) {
+          candidates.emplace_back(e.frame, sizeClass);
+        }
+      }
+
+      std::sort(candidates.begin(), candidates.end());
+
+      for (const auto& candidate : candidates) {
+        if (m_totalBytes <= budgetBytes) {
+          break;
+        }
+
+        std::vector<Entry>& list = m_free[candidate.second];
+        auto it = std::find_if(list.begin(), list.end(), [&](const Entry& e) { return e.frame == candidate.first; });
+
+        numEvicted += evict(candidate.second, it, it + 1);
+      }
+
+      return numEvicted;
+    }
+
+    /**
+      * \brief Visits every item of the pool, free or in flight
+      */
+    template<typename Fn>
+    void forEach(const Fn& fn) const {
+      for (const Entry& e : m_inFlight) {
+        fn(e.item);
+      }
+
+      for (const std::vector<Entry>& list : m_free) {
+        for (const Entry& e : list) {
+          fn(e.item);
+        }
+      }
+    }
+
+    void clear() {
+      for (std::vector<Entry>& list : m_free) {
+        list.clear();
+      }
+
+      m_inFlight.clear();
+      m_nonEmpty = 0;
+      m_numFree = 0;
+      m_totalBytes = 0;
+      m_freeBytes = 0;
+      m_inFlightBytes = 0;
+      m_requestedBytes = 0;
+    }
+
+    Stats getStats() const {
+      Stats stats;
+      stats.numItems = m_numFree + m_inFlight.size();
+      stats.numFreeItems = m_numFree;
+      stats.totalBytes = m_totalBytes;
+      stats.freeBytes = m_freeBytes;
+      stats.requestedBytes = m_requestedBytes;
+      stats.inFlightBytes = m_inFlightBytes;
+      return stats;
+    }
+
+  private:
+    struct Entry {
+      T item;
+      size_t capacity;
+      size_t size;
+      uint32_t frame;
+    };
+
+    std::vector<Entry> m_free[kNumClasses];
+    std::deque<Entry> m_inFlight;
+    uint32_t m_nonEmpty = 0;
+    size_t m_numFree = 0;
+    size_t m_totalBytes = 0;
+    size_t m_freeBytes = 0;
+    size_t m_inFlightBytes = 0;
+    size_t m_requestedBytes = 0;
+
+    // Class n holds capacities in [2^(n-1), 2^n), the last class everything larger
+    static uint32_t classOf(size_t size) {
+      return size >= (size_t(1) << (kNumClasses - 1)) ? kNumClasses - 1 : 32 - bit::lzcnt(uint32_t(size));
+    }
+
+    void recycle(uint32_t frame) {
+      while (!m_inFlight.empty() && m_inFlight.front().frame + kFramesInFlight <= frame) {
+        Entry& e = m_inFlight.front();
+        m_inFlightBytes -= e.capacity;
+        m_requestedBytes -= e.size;
+        e.size = 0;
+        addFree(std::move(e));
+        m_inFlight.pop_front();
+      }
+    }
+
+    void addFree(Entry&& e) {
+      const uint32_t sizeClass = classOf(e.capacity);
+      std::vector<Entry>& list = m_free[sizeClass];
+
+      auto pos = std::partition_point(list.begin(), list.end(), [&e](const Entry& other) { return other.capacity >= e.capacity; });
+
+      m_freeBytes += e.capacity;
+      m_numFree++;
+      list.insert(pos, std::move(e));
+      m_nonEmpty |= 1u << sizeClass;
+    }
+
+    bool take(uint32_t sizeClass, size_t index, size_t size, uint32_t frame, T& out) {
+      std::vector<Entry>& list = m_free[sizeClass];
+      Entry e = std::move(list[index]);
+      list.erase(list.begin() + index);
+
+      if (list.empty()) {
+        m_nonEmpty &= ~(1u << sizeClass);
+      }
+
+      m_numFree--;
+      m_freeBytes -= e.capacity;
+      m_totalBytes -= e.capacity;
+
+      out = e.item;
+      insert(e.item, e.capacity, size, frame);
+      return true;
+    }
+
+    // Drops a range of free items of a class
+    size_t evict(uint32_t sizeClass, typename std::vector<Entry>::iterator first, typename std::vector<Entry>::iterator last) {
+      std::vector<Entry>& list = m_free[sizeClass];
+      const size_t count = last - first;
+
+      for (auto it = first; it != last; ++it) {
+        m_freeBytes -= it->capacity;
+        m_totalBytes -= it->capacity;
+      }
+
+      m_numFree -= count;
+      list.erase(first, last);
+
+      if (list.empty()) {
+        m_nonEmpty &= ~(1u << sizeClass);
+      }
+
+      return count;
+    }
+  };
+}
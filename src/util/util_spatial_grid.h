@@ -0,0 +1,142 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "util_vector.h"
+
+namespace dxvk {
+  /**
+    * \brief Uniform hash grid over points, for finding everything within a
+    *        fixed radius of a position without testing every point.  Meant
+    *        to be rebuilt every frame, clearing keeps the memory around.
+    *
+    *  Usage: clear(radius), insert() all points, build(), then forEachNear().
+    *  forEachNear() visits a superset of the points within the radius (the
+    *  27 cells around the position), callers must still test the distance.
+    *  T: Payload stored with each point
+    */
+  template<typename T>
+  class SpatialHashGrid {
+  public:
+    void clear(const float radius) {
+      // Cells a little larger than the radius, so rounding can't push a point within the radius two cells away
+      m_invCellSize = 1.f / (radius * 1.01f);
+      m_entries.clear();
+      m_cells.clear();
+    }
+
+    // Returns false (and drops the point) if the position isn't finite
+    bool insert(const Vector3& position, const T& value) {
+      Cell cell;
+      if (!toCell(position, cell)) {
+        return false;
+      }
+      m_entries.push_back({ cellKey(cell.x, cell.y, cell.z), value });
+      return true;
+    }
+
+    // Must be called after the last insert, before the first query
+    void build() {
+      // Stable, so points within a cell are visited in insertion order
+      std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+        return a.key < b.key;
+      });
+
+      m_cells.reserve(m_entries.size());
+      for (uint32_t i = 0; i < m_entries.size(); ) {
+        const uint64_t key = m_entries[i].key;
+        uint32_t end = i + 1;
+        while (end < m_entries.size() && m_entries[end].key == key) {
+          end++;
+        }
+        m_cells[key] = std::make_pair(i, end);
+        i = end;
+      }
+    }
+
+    template<typename F>
+    void forEachNear(const Vector3& position, F&& visit) const {
+      Cell cell;
+      if (m_entries.empty() || !toCell(position, cell)) {
+        return;
+      }
+
+      for (int32_t z = -1; z <= 1; z++) {
+        for (int32_t y = -1; y <= 1; y++) {
+          for (int32_t x = -1; x <= 1; x++) {
+            auto it = m_cells.find(cellKey(cell.x + x, cell.y + y, cell.z + z));
+            if (it == m_cells.end()) {
+              continue;
+            }
+            for (uint32_t i = it->second.first; i < it->second.second; i++) {
+              visit(m_entries[i].value);
+            }
+          }
+        }
+      }
+    }
+
+    size_t size() const {
+      return m_entries.size();
+    }
+
+  private:
+    struct Cell {
+      int32_t x, y, z;
+    };
+
+    struct Entry {
+      uint64_t key;
+      T value;
+    };
+
+    bool toCell(const Vector3& position, Cell& cellOut) const {
+      // Far away cells alias onto each other through the key, which only costs extra distance tests
+      constexpr float kMaxCoord = (float) (1 << 30);
+      float coords[3] = { position.x * m_invCellSize, position.y * m_invCellSize, position.z * m_invCellSize };
+      for (float& coord : coords) {
+        if (!std::isfinite(coord)) {
+          return false;
+        }
+        coord = std::clamp(std::floor(coord), -kMaxCoord, kMaxCoord);
+      }
+      cellOut = { (int32_t) coords[0], (int32_t) coords[1], (int32_t) coords[2] };
+      return true;
+    }
+
+    static uint64_t cellKey(const int32_t x, const int32_t y, const int32_t z) {
+      constexpr uint64_t kMask = (1ull << 21) - 1;
+      return ((uint64_t) x & kMask) | (((uint64_t) y & kMask) << 21) | (((uint64_t) z & kMask) << 42);
+    }
+
+    float m_invCellSize = 1.f;
+    std::vector<Entry> m_entries;
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> m_cells;
+  };
+} //dxvk
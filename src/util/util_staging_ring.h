@@ -0,0 +1,145 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+
+namespace dxvk {
+  /**
+    * \brief Ring allocator for a persistently mapped staging buffer.
+    *
+    *  Hands out contiguous regions of a fixed size buffer in allocation
+    *  order.  Each region is tagged with the fence value of the submission
+    *  reading it, and is only recycled once that fence has been reached and
+    *  every region allocated before it has been recycled too, so regions may
+    *  be submitted in any order.  A region never wraps around the end of the
+    *  buffer.  Only does the bookkeeping, the buffer itself is owned by the
+    *  caller.  Not thread safe.
+    */
+  class StagingRing {
+  public:
+    static constexpr uint64_t kInvalidOffset = ~0ull;
+    static constexpr uint64_t kUnsubmitted = ~0ull;
+
+    struct Region {
+      uint64_t offset = kInvalidOffset; // Offset into the buffer
+      uint64_t handle = 0;              // Identifies the region to submit()
+    };
+
+    explicit StagingRing(uint64_t capacity)
+      : m_capacity(capacity) {
+    }
+
+    uint64_t capacity() const {
+      return m_capacity;
+    }
+
+    // Bytes held by regions not recycled yet, including padding
+    uint64_t usedBytes() const {
+      return m_head - m_tail;
+    }
+
+    // True if regions are waiting on a fence
+    bool hasPending() const {
+      return !m_regions.empty();
+    }
+
+    /**
+      * \brief Reserves a region
+      *
+      *   returns: region with an offset of kInvalidOffset if the ring has no room left
+      */
+    Region alloc(uint64_t size, uint64_t alignment) {
+      assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+      if (size == 0 || size > m_capacity)
+        return Region { };
+
+      // Skip to the start of the buffer if the region would wrap around
+      uint64_t begin = alignUp(m_head, alignment);
+      if (begin % m_capacity + size > m_capacity)
+        begin = alignUp(m_head, m_capacity);
+
+      const uint64_t end = begin + size;
+      if (end - m_tail > m_capacity)
+        return Region { };
+
+      m_head = end;
+      m_regions.push_back({ end, kUnsubmitted });
+      return Region { begin % m_capacity, end };
+    }
+
+    /**
+      * \brief Tags a region with the fence value of the submission reading it
+      */
+    void submit(const Region& region, uint64_t fenceValue) {
+      auto it = std::lower_bound(m_regions.begin(), m_regions.end(), region.handle,
+        [](const Entry& entry, uint64_t handle) { return entry.end < handle; });
+
+      assert(it != m_regions.end() && it->end == region.handle);
+      it->fenceValue = fenceValue;
+    }
+
+    /**
+      * \brief Recycles submitted regions the GPU is done with
+      *
+      *   completedFenceValue [in]: last fence value signaled
+      */
+    void retire(uint64_t completedFenceValue) {
+      while (!m_regions.empty() && m_regions.front().fenceValue <= completedFenceValue) {
+        m_tail = m_regions.front().end;
+        m_regions.pop_front();
+      }
+
+      // Restart at the beginning of the buffer once idle, keeps large regions from wrapping
+      if (m_regions.empty())
+        m_head = m_tail = 0;
+    }
+
+    /**
+      * \brief Fence value to wait on before the oldest region can be recycled
+      *
+      *   returns: 0 if nothing is pending, kUnsubmitted if the oldest region was not submitted yet
+      */
+    uint64_t oldestFenceValue() const {
+      return m_regions.empty() ? 0 : m_regions.front().fenceValue;
+    }
+
+  private:
+    struct Entry {
+      uint64_t end;
+      uint64_t fenceValue;
+    };
+
+    static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+      return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t m_capacity;
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+    std::deque<Entry> m_regions;
+  };
+}
@@ -0,0 +1,281 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "util_flat_hash_map.h"
+
+namespace dxvk {
+  /**
+    * \brief Priority queue of streaming requests with updatable priorities.
+    *
+    *  A binary max-heap of requests, indexed by key so a queued request can
+    *  have its priority raised or lowered as demand changes, or be dropped,
+    *  in logarithmic time.  Each request carries its size in bytes, which
+    *  pop() hands back for budgeting.  Not thread safe.
+    *
+    *  typename T: Type of the request payload.
+    */
+  template<typename T, typename Key = uint64_t>
+  class StreamingQueue {
+  public:
+    bool empty() const {
+      return m_heap.empty();
+    }
+
+    size_t size() const {
+      return m_heap.size();
+    }
+
+    bool contains(const Key& key) const {
+      return m_positions.contains(key);
+    }
+
+    float topPriority() const {
+      return m_heap.front().priority;
+    }
+
+    // Highest priority request, the queue must not be empty
+    const T& top() const {
+      return m_heap.front().item;
+    }
+
+    uint64_t topBytes() const {
+      return m_heap.front().bytes;
+    }
+
+    /**
+      * \brief Queues a request, or updates the priority of a queued one
+      *
+      *   returns: true if the request was not queued yet
+      */
+    bool push(const Key& key, T item, float priority, uint64_t bytes) {
+      auto it = m_positions.find(key);
+      if (it != m_positions.end()) {
+        update(it->second, priority);
+        return false;
+      }
+
+      m_positions.emplace(key, uint32_t(m_heap.size()));
+      m_heap.push_back({ key, std::move(item), priority, bytes });
+      siftUp(uint32_t(m_heap.size() - 1));
+      return true;
+    }
+
+    /**
+      * \brief Changes the priority of a queued request
+      *
+      *   returns: false if the request is not queued
+      */
+    bool updatePriority(const Key& key, float priority) {
+      auto it = m_positions.find(key);
+      if (it == m_positions.end())
+        return false;
+
+      update(it->second, priority);
+      return true;
+    }
+
+    /**
+      * \brief Drops a queued request
+      *
+      *   returns: false if the request is not queued
+      */
+    bool remove(const Key& key) {
+      auto it = m_positions.find(key);
+      if (it == m_positions.end())
+        return false;
+
+      const uint32_t position = it->second;
+      m_positions.erase(it);
+      removeAt(position);
+      return true;
+    }
+
+    /**
+      * \brief Takes the highest priority request off the queue
+      *
+      *  The queue must not be empty.
+      *   bytes [out]: size of the request
+      */
+    T pop(uint64_t& bytes) {
+      Entry& top = m_heap.front();
+      T item = std::move(top.item);
+      bytes = top.bytes;
+
+      m_positions.erase(top.key);
+      removeAt(0);
+      return item;
+    }
+
+    /**
+      * \brief Recomputes the priority of every queued request
+      *
+      *  Cheaper than updating each request when most priorities change at once.
+      *   fn [in]: float(const T& item, float priority), returns the new priority
+      */
+    template<typename Fn>
+    void reprioritize(const Fn& fn) {
+      for (Entry& entry : m_heap) {
+        entry.priority = fn(entry.item, entry.priority);
+      }
+
+      for (uint32_t i = uint32_t(m_heap.size() / 2); i-- > 0; ) {
+        siftDown(i);
+      }
+    }
+
+    void clear() {
+      m_heap.clear();
+      m_positions.clear();
+    }
+
+  private:
+    struct Entry {
+      Key key;
+      T item;
+      float priority;
+      uint64_t bytes;
+    };
+
+    std::vector<Entry> m_heap;
+    FlatHashMap<Key, uint32_t> m_positions;
+
+    void update(uint32_t position, float priority) {
+      const float previous = m_heap[position].priority;
+      m_heap[position].priority = priority;
+
+      if (priority > previous)
+        siftUp(position);
+      else
+        siftDown(position);
+    }
+
+    void removeAt(uint32_t position) {
+      const uint32_t last = uint32_t(m_heap.size() - 1);
+
+      if (position != last) {
+        m_heap[position] = std::move(m_heap[last]);
+        m_heap.pop_back();
+
+        // The moved entry may belong above or below the hole
+        if (siftUp(position) == position)
+          siftDown(position);
+      } else {
+        m_heap.pop_back();
+      }
+    }
+
+    void place(uint32_t position) {
+      m_positions[m_heap[position].key] = position;
+    }
+
+    uint32_t siftUp(uint32_t position) {
+      while (position > 0) {
+        const uint32_t parent = (position - 1) / 2;
+        if (!(m_heap[parent].priority < m_heap[position].priority))
+          break;
+
+        std::swap(m_heap[parent], m_heap[position]);
+        place(position);
+        position = parent;
+      }
+      place(position);
+      return position;
+    }
+
+    void siftDown(uint32_t position) {
+      const uint32_t count = uint32_t(m_heap.size());
+
+      while (true) {
+        const uint32_t left = 2 * position + 1;
+        const uint32_t right = left + 1;
+        uint32_t largest = position;
+
+        if (left < count && m_heap[largest].priority < m_heap[left].priority)
+          largest = left;
+        if (right < count && m_heap[largest].priority < m_heap[right].priority)
+          largest = right;
+
+        if (largest == position)
+          break;
+
+        std::swap(m_heap[largest], m_heap[position]);
+        place(position);
+        position = largest;
+      }
+      place(position);
+    }
+  };
+
+  /**
+    * \brief Byte budget of streaming work done per frame
+    *
+    *  The first request of a frame is always granted, so requests larger
+    *  than the budget still make progress.
+    */
+  class StreamingBudget {
+  public:
+    /**
+      * \brief Checks if a request fits the given frame's remaining budget
+      */
+    bool canConsume(uint32_t frameId, uint64_t bytes, uint64_t budgetBytes) const {
+      if (frameId != m_frameId || budgetBytes == 0 || m_consumedBytes == 0)
+        return true;
+
+      return m_consumedBytes + bytes <= budgetBytes;
+    }
+
+    void consume(uint32_t frameId, uint64_t bytes) {
+      if (frameId != m_frameId) {
+        m_frameId = frameId;
+        m_consumedBytes = 0;
+      }
+
+      m_consumedBytes += bytes;
+    }
+
+    /**
+      * \brief Consumes budget of the given frame
+      *
+      *   returns: false if the frame's budget is spent
+      */
+    bool tryConsume(uint32_t frameId, uint64_t bytes, uint64_t budgetBytes) {
+      if (!canConsume(frameId, bytes, budgetBytes))
+        return false;
+
+      consume(frameId, bytes);
+      return true;
+    }
+
+    uint64_t consumedBytes() const {
+      return m_consumedBytes;
+    }
+
+  private:
+    uint32_t m_frameId = ~0u;
+    uint64_t m_consumedBytes = 0;
+  };
+}
@@ -0,0 +1,147 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dxvk {
+  /**
+    * \brief Move-only, type-erased void() callable with inline storage.
+    *        Callables up to StorageSize bytes are constructed in place,
+    *        so wrapping the lambdas typically handed to the thread pool
+    *        does not touch the heap.  Larger callables still work, but
+    *        fall back to a heap allocation.
+    *  StorageSize: Size of the inline buffer in bytes.
+    */
+  template<size_t StorageSize>
+  class InplaceTask {
+    struct Ops {
+      void (*invoke)(void* storage);
+      void (*move)(void* dst, void* src);
+      void (*destroy)(void* storage);
+    };
+
+    template<typename F>
+    static constexpr bool FitsInline = sizeof(F) <= StorageSize
+                                    && alignof(F) <= alignof(std::max_align_t)
+                                    && std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    struct InlineOps {
+      static void invoke(void* storage) {
+        (*std::launder(reinterpret_cast<F*>(storage)))();
+      }
+      static void move(void* dst, void* src) {
+        F* source = std::launder(reinterpret_cast<F*>(src));
+        new (dst) F(std::move(*source));
+        source->~F();
+      }
+      static void destroy(void* storage) {
+        std::launder(reinterpret_cast<F*>(storage))->~F();
+      }
+      static constexpr Ops ops = { &invoke, &move, &destroy };
+    };
+
+    template<typename F>
+    struct HeapOps {
+      static F*& ptr(void* storage) {
+        return *std::launder(reinterpret_cast<F**>(storage));
+      }
+      static void invoke(void* storage) {
+        (*ptr(storage))();
+      }
+      static void move(void* dst, void* src) {
+        new (dst) F*(ptr(src));
+      }
+      static void destroy(void* storage) {
+        delete ptr(storage);
+      }
+      static constexpr Ops ops = { &invoke, &move, &destroy };
+    };
+
+  public:
+    InplaceTask() = default;
+
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceTask>>>
+    InplaceTask(F&& f) {
+      using Func = std::decay_t<F>;
+      if constexpr (FitsInline<Func>) {
+        new (m_storage) Func(std::forward<F>(f));
+        m_ops = &InlineOps<Func>::ops;
+      } else {
+        new (m_storage) Func*(new Func(std::forward<F>(f)));
+        m_ops = &HeapOps<Func>::ops;
+      }
+    }
+
+    InplaceTask(InplaceTask&& other) noexcept {
+      moveFrom(other);
+    }
+
+    InplaceTask& operator=(InplaceTask&& other) noexcept {
+      if (this != &other) {
+        reset();
+        moveFrom(other);
+      }
+      return *this;
+    }
+
+    InplaceTask(const InplaceTask&) = delete;
+    InplaceTask& operator=(const InplaceTask&) = delete;
+
+    ~InplaceTask() {
+      reset();
+    }
+
+    void operator()() {
+      m_ops->invoke(m_storage);
+    }
+
+    explicit operator bool() const {
+      return m_ops != nullptr;
+    }
+
+    void reset() {
+      if (m_ops) {
+        m_ops->destroy(m_storage);
+        m_ops = nullptr;
+      }
+    }
+
+  private:
+    // Leaves the other task empty
+    void moveFrom(InplaceTask& other) {
+      if (other.m_ops) {
+        other.m_ops->move(m_storage, other.m_storage);
+        m_ops = other.m_ops;
+        other.m_ops = nullptr;
+      }
+    }
+
+    alignas(std::max_align_t) uint8_t m_storage[StorageSize];
+    const Ops* m_ops = nullptr;
+  };
+} //dxvk
@@ -27,10 +27,12 @@
 #include <thread>
 #include <vector>
 #include <type_traits>
-#include <future>
+#include <tuple>
 #include <assert.h>
 #include "util_atomic_queue.h"
 #include "util_env.h"
+#include "util_future.h"
+#include "util_task.h"
 #include "util_math.h"
 #include "util_fastops.h"
 #include "sync/sync_spinlock.h"
@@ -47,17 +49,31 @@ namespace dxvk {
     *  LowLatency: Enables the low-latency mode where workers will spin instead of
     *              waiting for tasks on a conditional variable
     *  (ctor)workerName: Name given to threads with the pattern: workerName(N)
+    *
+    *  Tasks may be scheduled from any number of threads concurrently.  Tasks
+    *  without a thread affinity go to a shared injection queue which every
+    *  worker pulls from, tasks with an affinity go to the queue of one of the
+    *  matching workers.  When the queues are full Schedule() waits for a worker
+    *  to make room rather than dropping the task, so the returned future is
+    *  always valid.
+    *
+    *  Scheduling does not allocate: tasks are stored inline in the queues
+    *  (callables larger than kTaskStorageSize fall back to the heap) and
+    *  the returned Future uses a pooled shared state.
     * 
     *  Example usage:
     *   // Creates 1 thread, and uses it to return PI via a future
     *   WorkerThreadPool threadPool(1, "thread-pool-name");
-    *   std::future<float> result = threadPool.Schedule([]{ return 3.14159265359f; });
+    *   Future<float> result = threadPool.Schedule([]{ return 3.14159265359f; });
     *   float pi = result.get();
     */
   template<size_t NumTasksPerThread, bool WorkStealing = true, bool LowLatency = true>
   class WorkerThreadPool {
-    using Task = std::function<void()>;
-    using Queue = AtomicQueue<Task, NumTasksPerThread>;
+    // Together with the type erasure this makes a task exactly one cache line
+    static constexpr size_t kTaskStorageSize = 56;
+
+    using Task = InplaceTask<kTaskStorageSize>;
+    using Queue = AtomicMpmcQueue<Task, NumTasksPerThread>;
     using QueuePtr = std::unique_ptr<Queue>;
 
     struct Nop { };
@@ -75,11 +91,13 @@ namespace dxvk {
       for (int i = 0; i < m_numThread; i++) {
         m_workerTasks[i] = std::make_unique<Queue>();
       }
+      m_injectionTasks = std::make_unique<Queue>();
 
       // Start the worker threads
       for (int i = 0; i < m_numThread; i++) {
         m_workerThreads[i] = std::thread([this, i, workerName] {
           env::setThreadName(str::format(workerName, "(", i, ")"));
+          s_workerPool = this;
           processWork(i);
         });
       }
@@ -90,6 +108,7 @@ namespace dxvk {
       m_stopWork = true;
 
       if constexpr (!LowLatency) {
+        { std::lock_guard<TaskMutex> lock(m_taskMutex); }
         m_condOnAdd.notify_all();
       }
 
@@ -98,40 +117,45 @@ namespace dxvk {
       }
     }
 
-    // Schedule a task to be executed by the thread pool
+    // Schedule a task to be executed by the thread pool, safe to call from any thread
     template <uint8_t Affinity = 0xFF, typename F, typename... Args, typename R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
-    std::shared_future<R> Schedule(F&& f, Args&&... args) {
-      std::function<R()> taskFunc = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-      std::shared_ptr<std::promise<R>> taskPromise = std::make_shared<std::promise<R>>();
+    Future<R> Schedule(F&& f, Args&&... args) {
+      Promise<R> taskPromise;
+      Future<R> future = taskPromise.get_future();
 
       // Package up the user task, and wrap it with promise
-      auto work = [taskFunc, taskPromise] {
+      Task work = [taskFunc = std::forward<F>(f),
+                   taskArgs = std::make_tuple(std::forward<Args>(args)...),
+                   taskPromise = std::move(taskPromise)]() mutable {
         if constexpr (std::is_void_v<R>) {
-          std::invoke(taskFunc);
-          taskPromise->set_value();
+          std::apply(taskFunc, taskArgs);
+          taskPromise.set_value();
         } else {
-          taskPromise->set_value(std::invoke(taskFunc));
+          taskPromise.set_value(std::apply(taskFunc, taskArgs));
         }
       };
 
-      // Add the task to the queue and notify a worker thread
-      //  just distribute evenly to all threads for some mask denoted by Affinity.
-      static size_t s_idx = 0;
-      
-      // Is the affinity mask valid?
-      const uint8_t affinityMask = std::min(popcnt_uint8(Affinity), m_numThread);
+      // Count the task before it becomes visible to the workers, so the count never underflows
+      ++m_numTasks;
 
-      // Schedule work on the appropriate thread
-      const uint32_t thread = fast::findNthBit(Affinity, (uint8_t) (s_idx++ % affinityMask));
-      assert(thread < m_numThread);
+      Queue& queue = selectQueue<Affinity>();
+      while (!queue.push(std::move(work))) {
+        // The queues are full.  A worker scheduling more work can't wait on itself
+        // to drain them, so run the task inline instead.
+        if (s_workerPool == this) {
+          --m_numTasks;
+          work();
+          return future;
+        }
 
-      // Atomic queue is SPSC, so we don't need to take a lock here
-      // since we know this will always be called from a single thread.
-      if (!m_workerTasks[thread]->push(work)) {
-        return std::shared_future<R>(); // the queue is full, return empty future
+        // Apply back-pressure to the producer until a worker makes room
+        std::this_thread::yield();
       }
 
       if constexpr (!LowLatency) {
+        // Taking the lock orders the notify after a waiting worker's predicate check
+        { std::lock_guard<TaskMutex> lock(m_taskMutex); }
+
         if constexpr (WorkStealing) {
           // Notify only one worker when workers can steal from the others
           m_condOnAdd.notify_one();
@@ -141,12 +165,31 @@ namespace dxvk {
         }
       }
 
-      ++m_numTasks;
-
-      return taskPromise->get_future();
+      return future;
     }
 
   private:
+    template<uint8_t Affinity>
+    Queue& selectQueue() {
+      const uint8_t allThreads = (uint8_t) ((1u << m_numThread) - 1);
+
+      // Any worker may run this task, share it with all of them
+      if ((Affinity & allThreads) == allThreads) {
+        return *m_injectionTasks;
+      }
+
+      // Is the affinity mask valid?
+      const uint8_t affinityMask = std::min(popcnt_uint8(Affinity), m_numThread);
+
+      // Distribute evenly to all threads denoted by Affinity, the counter is
+      // shared with other producers so use an atomic increment.
+      const uint32_t idx = m_nextAffinityIdx.fetch_add(1, std::memory_order_relaxed);
+      const uint32_t thread = fast::findNthBit(Affinity, (uint8_t) (idx % affinityMask));
+      assert(thread < m_numThread);
+
+      return *m_workerTasks[thread];
+    }
+
     void processWork(const uint32_t workerId) {
       while (true) {
         // Using a conditional wait in high-latency mode
@@ -162,8 +205,8 @@ namespace dxvk {
           return;
         }
 
-        // Try executing a task from our queue
-        if (executeTask(workerId))
+        // Try executing a task from our queue, then from the shared queue
+        if (executeTask(*m_workerTasks[workerId]) || executeTask(*m_injectionTasks))
           continue;
 
         if (WorkStealing) {
@@ -172,7 +215,7 @@ namespace dxvk {
           bool workStolen = false;
           for (uint32_t i = 1; i < m_numThread; i++) {
             const uint32_t victim = (workerId + i) % m_numThread;
-            if (executeTask(victim)) {
+            if (executeTask(*m_workerTasks[victim])) {
               workStolen = true;
               break;
             }
@@ -182,26 +225,21 @@ namespace dxvk {
           if (!workStolen && LowLatency) {
             std::this_thread::yield();
           }
+        } else if (LowLatency) {
+          std::this_thread::yield();
         }
       }
     }
 
-    // True if front pop, False if back pop
-    bool executeTask(const uint32_t workerId) {
+    bool executeTask(Queue& queue) {
+      // The queues are MPMC, so popping (or being stolen from) needs no lock
       Task task;
-      {
-        // Since we're using an SPSC queue, we must take a lock when
-        // popping, since we may be stealing (or be stolen from) by
-        // another thread.
-        std::unique_lock<sync::Spinlock> lock(m_threadMutex);
-
-        if (!m_workerTasks[workerId]->pop(task)) {
-          return false;
-        }
-
-        --m_numTasks;
+      if (!queue.pop(task)) {
+        return false;
       }
 
+      --m_numTasks;
+
       // Execute the task
       if (task) {
         task();
@@ -210,6 +248,9 @@ namespace dxvk {
       return false;
     }
 
+    // Identifies the pool (if any) whose worker is the current thread
+    inline static thread_local const WorkerThreadPool* s_workerPool = nullptr;
+
     uint8_t m_numThread;
 
     std::atomic<bool> m_stopWork = false;
@@ -218,9 +259,6 @@ namespace dxvk {
     TaskMutex m_taskMutex;
     OnAddCondition m_condOnAdd;
 
-    // Used to synchronize intra-thread stealing
-    sync::Spinlock m_threadMutex;
-
     std::vector<std::thread> m_workerThreads;
 
     // We expect high volume of potentially small tasks via "Schedule" per-
@@ -229,6 +267,8 @@ namespace dxvk {
     //  1. Non-circular queue incurs allocation overhead thats unacceptable
     //  2. Use of mutex, and CVs, incur overhead thats unacceptable
     std::vector<QueuePtr> m_workerTasks;
-    std::atomic_uint32_t m_numTasks;
+    QueuePtr m_injectionTasks;
+    std::atomic_uint32_t m_numTasks = 0;
+    std::atomic_uint32_t m_nextAffinityIdx = 0;
   };
-} //dxvk
\ No newline at end of file
+} //dxvk
@@ -0,0 +1,343 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "util_bit.h"
+#include "util_flat_hash_map.h"
+
+namespace dxvk {
+  /**
+    * \brief Two-level segregated fit (TLSF) allocator for offsets into a fixed size range.
+    *
+    *  Free blocks are kept in lists bucketed by a power of two first level and 32 linear
+    *  subdivisions of it, with bitmaps of the non-empty lists.  An allocation rounds its
+    *  size up to the next list boundary, so the head of any list found by a bit scan is
+    *  large enough, and freeing merges with the physical neighbours in constant time.
+    *  Neither operation depends on the number of free blocks.
+    *  Only offsets are managed, the backing memory is owned by the caller.
+    */
+  class TlsfAllocator {
+  public:
+    static constexpr uint64_t kInvalidOffset = ~0ull;
+
+    struct Stats {
+      uint64_t freeBytes = 0;
+      uint64_t largestFreeBlock = 0;
+      uint32_t numFreeBlocks = 0;
+      uint32_t numAllocations = 0;
+    };
+
+    explicit TlsfAllocator(uint64_t size) : m_size(size) {
+      for (auto& heads : m_heads) {
+        for (uint32_t& head : heads) {
+          head = kNull;
+        }
+      }
+
+      if (size > 0) {
+        insertFreeBlock(createBlock(0, size));
+      }
+    }
+
+    /**
+      * \brief Allocates a range
+      *
+      *   size [in]: number of bytes
+      *   align [in]: required alignment of the offset, must be a power of two
+      *   returns: offset of the range, or kInvalidOffset if no free block fits
+      */
+    uint64_t alloc(uint64_t size, uint64_t align) {
+      assert(align != 0 && (align & (align - 1)) == 0);
+      size = size != 0 ? size : 1;
+
+      if (size > m_size) {
+        return kInvalidOffset;
+      }
+
+      // Blocks in the list for the plain size are usually aligned already, only pad the search if not
+      uint32_t index = findFreeBlock(size);
+
+      if (index == kNull || alignUp(m_blocks[index].offset, align) + size > m_blocks[index].offset + m_blocks[index].size) {
+        index = align > 1 && size + align - 1 <= m_size ? findFreeBlock(size + align - 1) : kNull;
+      }
+
+      if (index == kNull) {
+        return kInvalidOffset;
+      }
+
+      removeFreeBlock(index);
+
+      // Return the alignment padding and the tail to the free lists
+      const uint64_t offset = alignUp(m_blocks[index].offset, align);
+
+      if (offset != m_blocks[index].offset) {
+        const uint32_t padding = createBlock(m_blocks[index].offset, offset - m_blocks[index].offset);
+        linkPhysical(m_blocks[index].prevPhys, padding);
+        linkPhysical(padding, index);
+        m_blocks[index].offset = offset;
+        m_blocks[index].size -= m_blocks[padding].size;
+        insertFreeBlock(padding);
+      }
+
+      if (m_blocks[index].size != size) {
+        const uint32_t tail = createBlock(offset + size, m_blocks[index].size - size);
+        linkPhysical(tail, m_blocks[index].nextPhys);
+        linkPhysical(index, tail);
+        m_blocks[index].size = size;
+        insertFreeBlock(tail);
+      }
+
+      m_allocations.emplace(offset, index);
+      return offset;
+    }
+
+    /**
+      * \brief Frees a range returned by alloc, merging it with adjacent free blocks
+      *
+      *   offset [in]: offset returned by alloc
+      */
+    void free(uint64_t offset) {
+      auto it = m_allocations.find(offset);
+      assert(it != m_allocations.end());
+
+      uint32_t index = it->second;
+      m_allocations.erase(it);
+
+      const uint32_t prev = m_blocks[index].prevPhys;
+
+      if (prev != kNull && m_blocks[prev].isFree) {
+        removeFreeBlock(prev);
+        m_blocks[prev].size += m_blocks[index].size;
+        linkPhysical(prev, m_blocks[index].nextPhys);
+        destroyBlock(index);
+        index = prev;
+      }
+
+      const uint32_t next = m_blocks[index].nextPhys;
+
+      if (next != kNull && m_blocks[next].isFree) {
+        removeFreeBlock(next);
+        m_blocks[index].size += m_blocks[next].size;
+        linkPhysical(index, m_blocks[next].nextPhys);
+        destroyBlock(next);
+      }
+
+      insertFreeBlock(index);
+    }
+
+    uint64_t size() const {
+      return m_size;
+    }
+
+    /**
+      * \brief Free space and fragmentation
+      *
+      *  The largest free block is found in the highest non-empty list,
+      *  only that list is scanned.
+      */
+    Stats getStats() const {
+      Stats stats;
+      stats.freeBytes = m_freeBytes;
+      stats.numFreeBlocks = m_numFreeBlocks;
+      stats.numAllocations = uint32_t(m_allocations.size());
+
+      if (m_flBitmap != 0) {
+        const uint32_t fl = 63 - lzcnt64(m_flBitmap);
+        const uint32_t sl = 31 - bit::lzcnt(m_slBitmaps[fl]);
+
+        for (uint32_t index = m_heads[fl][sl]; index != kNull; index = m_blocks[index].nextFree) {
+          stats.largestFreeBlock = std::max(stats.largestFreeBlock, m_blocks[index].size);
+        }
+      }
+
+      return stats;
+    }
+
+  private:
+    static constexpr uint32_t kNull = ~0u;
+    static constexpr uint32_t kSlLog2 = 5;
+    static constexpr uint32_t kSlCount = 1u << kSlLog2;
+    // Sizes below kSlCount map linearly into the first level, the rest by their top bit
+    static constexpr uint32_t kFlCount = 64 - kSlLog2 + 1;
+
+    struct Block {
+      uint64_t offset;
+      uint64_t size;
+      uint32_t prevPhys;
+      uint32_t nextPhys;
+      uint32_t prevFree;
+      uint32_t nextFree;
+      bool isFree;
+    };
+
+    uint64_t m_size;
+    uint64_t m_freeBytes = 0;
+    uint32_t m_numFreeBlocks = 0;
+
+    uint64_t m_flBitmap = 0;
+    uint32_t m_slBitmaps[kFlCount] = {};
+    uint32_t m_heads[kFlCount][kSlCount];
+
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unusedBlocks;
+
+    // Block index of each allocation by offset
+    FlatHashMap<uint64_t, uint32_t> m_allocations;
+
+    static uint64_t alignUp(uint64_t value, uint64_t align) {
+      return (value + align - 1) & ~(align - 1);
+    }
+
+    static uint32_t tzcnt64(uint64_t n) {
+      const uint32_t lo = uint32_t(n);
+      return lo != 0 ? bit::tzcnt(lo) : 32 + bit::tzcnt(uint32_t(n >> 32));
+    }
+
+    static uint32_t lzcnt64(uint64_t n) {
+      const uint32_t hi = uint32_t(n >> 32);
+      return hi != 0 ? bit::lzcnt(hi) : 32 + bit::lzcnt(uint32_t(n));
+    }
+
+    static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+      if (size < kSlCount) {
+        fl = 0;
+        sl = uint32_t(size);
+      } else {
+        const uint32_t msb = 63 - lzcnt64(size);
+        fl = msb - kSlLog2 + 1;
+        sl = uint32_t(size >> (msb - kSlLog2)) - kSlCount;
+      }
+    }
+
+    uint32_t findFreeBlock(uint64_t size) const {
+      // Round up to the next list so that every block in the list found is large enough
+      if (size >= kSlCount) {
+        size += (1ull << (63 - lzcnt64(size) - kSlLog2)) - 1;
+      }
+
+      uint32_t fl, sl;
+      mapping(size, fl, sl);
+
+      if (fl >= kFlCount) {
+        return kNull;
+      }
+
+      uint32_t slBitmap = m_slBitmaps[fl] & (~0u << sl);
+
+      if (slBitmap == 0) {
+        const uint64_t flBitmap = fl + 1 < 64 ? m_flBitmap & (~0ull << (fl + 1)) : 0;
+
+        if (flBitmap == 0) {
+          return kNull;
+        }
+
+        fl = tzcnt64(flBitmap);
+        slBitmap = m_slBitmaps[fl];
+      }
+
+      return m_heads[fl][bit::tzcnt(slBitmap)];
+    }
+
+    void insertFreeBlock(uint32_t index) {
+      uint32_t fl, sl;
+      mapping(m_blocks[index].size, fl, sl);
+
+      Block& block = m_blocks[index];
+      block.isFree = true;
+      block.prevFree = kNull;
+      block.nextFree = m_heads[fl][sl];
+
+      if (block.nextFree != kNull) {
+        m_blocks[block.nextFree].prevFree = index;
+      }
+
+      m_heads[fl][sl] = index;
+      m_slBitmaps[fl] |= 1u << sl;
+      m_flBitmap |= 1ull << fl;
+
+      m_freeBytes += block.size;
+      m_numFreeBlocks++;
+    }
+
+    void removeFreeBlock(uint32_t index) {
+      uint32_t fl, sl;
+      mapping(m_blocks[index].size, fl, sl);
+
+      Block& block = m_blocks[index];
+      block.isFree = false;
+
+      if (block.prevFree != kNull) {
+        m_blocks[block.prevFree].nextFree = block.nextFree;
+      } else {
+        m_heads[fl][sl] = block.nextFree;
+      }
+
+      if (block.nextFree != kNull) {
+        m_blocks[block.nextFree].prevFree = block.prevFree;
+      }
+
+      if (m_heads[fl][sl] == kNull) {
+        m_slBitmaps[fl] &= ~(1u << sl);
+
+        if (m_slBitmaps[fl] == 0) {
+          m_flBitmap &= ~(1ull << fl);
+        }
+      }
+
+      m_freeBytes -= block.size;
+      m_numFreeBlocks--;
+    }
+
+    void linkPhysical(uint32_t prev, uint32_t next) {
+      if (prev != kNull) {
+        m_blocks[prev].nextPhys = next;
+      }
+
+      if (next != kNull) {
+        m_blocks[next].prevPhys = prev;
+      }
+    }
+
+    uint32_t createBlock(uint64_t offset, uint64_t size) {
+      const Block block = { offset, size, kNull, kNull, kNull, kNull, false };
+
+      if (!m_unusedBlocks.empty()) {
+        const uint32_t index = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+        m_blocks[index] = block;
+        return index;
+      }
+
+      m_blocks.push_back(block);
+      return uint32_t(m_blocks.size() - 1);
+    }
+
+    void destroyBlock(uint32_t index) {
+      m_unusedBlocks.push_back(index);
+    }
+  };
+}
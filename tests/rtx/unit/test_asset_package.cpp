@@ -0,0 +1,493 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_asset_package.h"
+#include "../../../src/dxvk/rtx_render/rtx_asset_package_writer.h"
+#include "../../../src/util/rc/util_rc_ptr.h"
+#include "../../../src/util/util_env.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/util/xxHash/xxhash.h"
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+using namespace dxvk;
+
+class AssetPackageTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+
+    // Override with DXVK_ASSET_PACKAGE_BENCH_MB to benchmark other package sizes
+    const uint32_t packageSizeMB = env::getEnvVar<uint32_t>("DXVK_ASSET_PACKAGE_BENCH_MB", 2048);
+    const std::string filename = (std::filesystem::temp_directory_path() / "dxvk_asset_package_bench.pkg").string();
+
+    try {
+      writePackage(filename, packageSizeMB);
+      test_validation(filename);
+      test_throughput(filename);
+      test_malformed(filename);
+      test_chunked(filename);
+      test_chunked_throughput(filename, std::min(packageSizeMB, 512u));
+    } catch (...) {
+      std::filesystem::remove(filename);
+      throw;
+    }
+
+    std::filesystem::remove(filename);
+    std::cout << "Asset package successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr size_t kBlobSize = 256 * 1024;
+
+  static std::string assetName(uint32_t idx) {
+    return str::format("textures/asset_", idx, ".dds");
+  }
+
+  static void fillBlob(uint32_t idx, std::vector<uint64_t>& blob) {
+    for (size_t i = 0; i < blob.size(); i++) {
+      blob[i] = (uint64_t(idx) << 32) ^ (i * 0x9E3779B97F4A7C15ull);
+    }
+  }
+
+  // One buffer asset per 256kB blob, laid out the same way the packaging tool does:
+  // header, blob data, dictionary, name table.
+  static void writePackage(const std::string& filename, const uint32_t packageSizeMB) {
+    const uint32_t blobCount = static_cast<uint32_t>(std::min<size_t>(size_t(packageSizeMB) * 1024 * 1024 / kBlobSize, UINT16_MAX));
+
+    std::cout << "Writing " << (blobCount * kBlobSize >> 20) << " MB package: ";
+    Timer t;
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+      throw DxvkError("Unable to create the package file");
+    }
+
+    AssetPackage::Header header { AssetPackage::kMagic, AssetPackage::kVersion1, sizeof(header) + blobCount * kBlobSize };
+    fwrite(&header, sizeof(header), 1, file);
+
+    std::vector<uint64_t> blob(kBlobSize / sizeof(uint64_t));
+    for (uint32_t n = 0; n < blobCount; n++) {
+      fillBlob(n, blob);
+      if (fwrite(blob.data(), kBlobSize, 1, file) != 1) {
+        fclose(file);
+        throw DxvkError("Failed to write the package file");
+      }
+    }
+
+    const uint16_t counts[2] = { static_cast<uint16_t>(blobCount), static_cast<uint16_t>(blobCount) };
+    fwrite(counts, sizeof(counts), 1, file);
+
+    for (uint32_t n = 0; n < blobCount; n++) {
+      AssetPackage::AssetDesc asset {};
+      asset.nameIdx = static_cast<uint16_t>(n);
+      asset.type = AssetPackage::AssetDesc::Type::BUFFER;
+      asset.size = kBlobSize;
+      asset.numMips = 1;
+      asset.arraySize = 1;
+      asset.baseBlobIdx = static_cast<uint16_t>(n);
+      asset.tailBlobIdx = static_cast<uint16_t>(n);
+      fwrite(&asset, sizeof(asset), 1, file);
+    }
+
+    for (uint32_t n = 0; n < blobCount; n++) {
+      AssetPackage::BlobDesc blobDesc {};
+      blobDesc.offset = sizeof(header) + n * kBlobSize;
+      blobDesc.size = kBlobSize;
+      fwrite(&blobDesc, sizeof(blobDesc), 1, file);
+    }
+
+    for (uint32_t n = 0; n < blobCount; n++) {
+      const std::string name = assetName(n);
+      fwrite(name.c_str(), name.size() + 1, 1, file);
+    }
+
+    fclose(file);
+  }
+
+  static void test_validation(const std::string& filename) {
+    Rc<AssetPackage> package = new AssetPackage(filename);
+    if (!package->initialize()) {
+      throw DxvkError("Failed to initialize the asset package");
+    }
+
+    const uint32_t assetCount = package->getAssetCount();
+    std::vector<uint64_t> expected(kBlobSize / sizeof(uint64_t));
+    std::vector<uint8_t> copy(kBlobSize);
+
+    for (uint32_t n = 0; n < assetCount; n += std::max(1u, assetCount / 64)) {
+      const uint32_t assetIdx = package->findAsset(assetName(n));
+      if (assetIdx != n) {
+        throw DxvkError(str::format("Asset ", assetName(n), " was not found"));
+      }
+
+      const AssetPackage::BlobSpan blob = package->getDataBlob(package->getAssetDesc(assetIdx)->baseBlobIdx);
+      fillBlob(n, expected);
+
+      if (blob.size != kBlobSize || memcmp(blob.data, expected.data(), kBlobSize) != 0) {
+        throw DxvkError(str::format("Blob ", n, " content mismatch"));
+      }
+
+      if (package->readDataBlob(n, copy.data(), copy.size()) != kBlobSize || memcmp(copy.data(), expected.data(), kBlobSize) != 0) {
+        throw DxvkError(str::format("Blob ", n, " copy mismatch"));
+      }
+    }
+
+    if (package->findAsset("textures/missing.dds") != AssetPackage::kNoAssetIdx) {
+      throw DxvkError("Found an asset that is not in the package");
+    }
+
+    if (!package->getDataBlob(assetCount).empty()) {
+      throw DxvkError("Out of range blob returned data");
+    }
+  }
+
+  // Every thread consumes (hashes) a disjoint set of blobs, which is what the texture
+  // loaders do with the data once it is fetched.
+  template<typename ConsumeFn>
+  static double measureThroughput(const uint32_t numThreads, const uint32_t blobCount, const ConsumeFn& consume) {
+    std::atomic<uint32_t> nextBlob = 0;
+    std::atomic<uint64_t> checksum = 0;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < numThreads; t++) {
+      threads.emplace_back([&]() {
+        std::vector<uint8_t> scratch(kBlobSize);
+        uint64_t localChecksum = 0;
+        for (uint32_t n = nextBlob++; n < blobCount; n = nextBlob++) {
+          localChecksum ^= consume(n, scratch);
+        }
+        checksum ^= localChecksum;
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    const auto finish = std::chrono::high_resolution_clock::now();
+    const double seconds = std::chrono::duration<double>(finish - start).count();
+
+    if (checksum == 0) {
+      throw DxvkError("Blob data was not consumed");
+    }
+
+    return double(blobCount) * kBlobSize / (1024.0 * 1024.0) / seconds;
+  }
+
+  static void test_throughput(const std::string& filename) {
+    Rc<AssetPackage> package = new AssetPackage(filename);
+    if (!package->initialize()) {
+      throw DxvkError("Failed to initialize the asset package");
+    }
+
+    const uint32_t blobCount = package->getAssetCount();
+    const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Reference: the previous reader, a single FILE* handle shared by all threads
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+      throw DxvkError("Unable to open the package file");
+    }
+    std::mutex fileMutex;
+
+    for (uint32_t numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+      const double fileMBps = measureThroughput(numThreads, blobCount, [&](uint32_t n, std::vector<uint8_t>& scratch) {
+        const AssetPackage::BlobDesc* blobDesc = package->getDataBlobDesc(n);
+        {
+          std::lock_guard<std::mutex> lock(fileMutex);
+          fseek64(file, blobDesc->offset, SEEK_SET);
+          fread(scratch.data(), 1, blobDesc->size, file);
+        }
+        return XXH3_64bits(scratch.data(), blobDesc->size);
+      });
+
+      const double mappedMBps = measureThroughput(numThreads, blobCount, [&](uint32_t n, std::vector<uint8_t>&) {
+        const AssetPackage::BlobSpan blob = package->getDataBlob(n);
+        return XXH3_64bits(blob.data, blob.size);
+      });
+
+      std::cout << numThreads << " thread(s): FILE* " << uint32_t(fileMBps) << " MB/s, mapped " << uint32_t(mappedMBps) << " MB/s" << std::endl;
+    }
+
+    fclose(file);
+  }
+
+  static void test_malformed(const std::string& filename) {
+    // Cut a small package inside of the name table
+    const std::string truncatedFilename = filename + ".truncated";
+    writePackage(truncatedFilename, 1);
+    std::filesystem::resize_file(truncatedFilename, std::filesystem::file_size(truncatedFilename) - 16);
+
+    Rc<AssetPackage> package = new AssetPackage(truncatedFilename);
+    const bool initialized = package->initialize();
+    package = nullptr;
+    std::filesystem::remove(truncatedFilename);
+
+    if (initialized) {
+      throw DxvkError("Truncated asset package was accepted");
+    }
+  }
+
+  // Texture-like data: a repeating random pattern with sparse changes, so LZ4 finds matches
+  static void fillCompressible(std::mt19937& rng, std::vector<uint8_t>& data) {
+    std::vector<uint8_t> pattern(4096);
+    for (auto& byte : pattern) {
+      byte = static_cast<uint8_t>(rng());
+    }
+
+    for (size_t i = 0; i < data.size(); i++) {
+      data[i] = (i % 61 == 0) ? static_cast<uint8_t>(rng()) : pattern[i % pattern.size()];
+    }
+  }
+
+  static void fillRandom(std::mt19937& rng, std::vector<uint8_t>& data) {
+    for (auto& byte : data) {
+      byte = static_cast<uint8_t>(rng());
+    }
+  }
+
+  static AssetPackage::AssetDesc bufferAsset(uint32_t blobIdx, size_t size) {
+    AssetPackage::AssetDesc assetDesc {};
+    assetDesc.type = AssetPackage::AssetDesc::Type::BUFFER;
+    assetDesc.size = static_cast<uint32_t>(size);
+    assetDesc.numMips = 1;
+    assetDesc.arraySize = 1;
+    assetDesc.baseBlobIdx = static_cast<uint16_t>(blobIdx);
+    assetDesc.tailBlobIdx = static_cast<uint16_t>(blobIdx);
+    return assetDesc;
+  }
+
+  static void test_chunked(const std::string& filename) {
+    const std::string chunkedFilename = filename + ".v2";
+    const uint32_t chunkSize = AssetPackage::kDefaultChunkSize;
+
+    std::mt19937 rng(42);
+    std::vector<uint8_t> compressible(1024 * 1024 + 123), incompressible(300 * 1024), raw(200 * 1024), gdeflate(1000);
+    fillCompressible(rng, compressible);
+    fillRandom(rng, incompressible);
+    fillRandom(rng, raw);
+    fillRandom(rng, gdeflate);
+
+    {
+      AssetPackageWriter writer(chunkSize);
+      if (!writer.open(chunkedFilename)) {
+        throw DxvkError("Unable to create the chunked package");
+      }
+
+      writer.addAsset("compressible", bufferAsset(writer.addBlob(compressible.data(), compressible.size()), compressible.size()));
+      writer.addAsset("incompressible", bufferAsset(writer.addBlob(incompressible.data(), incompressible.size()), incompressible.size()));
+      writer.addAsset("raw", bufferAsset(writer.addBlob(raw.data(), raw.size(), AssetPackage::Compression::None), raw.size()));
+      writer.addAsset("gdeflate", bufferAsset(writer.addGDeflateBlob(gdeflate.data(), gdeflate.size()), gdeflate.size()));
+
+      if (!writer.finish()) {
+        throw DxvkError("Failed to write the chunked package");
+      }
+    }
+
+    auto cleanup = [&]() { std::filesystem::remove(chunkedFilename); };
+
+    try {
+      Rc<AssetPackage> package = new AssetPackage(chunkedFilename);
+      if (!package->initialize() || package->getVersion() != AssetPackage::kVersion2 || package->getAssetCount() != 4) {
+        throw DxvkError("Failed to initialize the chunked package");
+      }
+
+      const uint32_t compressibleIdx = package->getAssetDesc(package->findAsset("compressible"))->baseBlobIdx;
+      const uint32_t expectedChunks = static_cast<uint32_t>((compressible.size() + chunkSize - 1) / chunkSize);
+
+      if (package->getDataBlobChunkCount(compressibleIdx) != expectedChunks ||
+          package->getDataBlobCompression(compressibleIdx) != AssetPackage::Compression::LZ4 ||
+          package->getDataBlob(compressibleIdx).size >= compressible.size()) {
+        throw DxvkError("Compressible blob was not chunked and compressed");
+      }
+
+      // Whole blobs, decoded in parallel
+      for (const char* name : { "compressible", "incompressible", "raw" }) {
+        const std::vector<uint8_t>& expected = std::string(name) == "compressible" ? compressible :
+          std::string(name) == "incompressible" ? incompressible : raw;
+        const uint32_t blobIdx = package->getAssetDesc(package->findAsset(name))->baseBlobIdx;
+
+        std::vector<uint8_t> decoded(package->getDataBlobSize(blobIdx));
+        if (decoded.size() != expected.size() ||
+            package->decodeDataBlob(blobIdx, decoded.data(), decoded.size()) != expected.size() ||
+            decoded != expected) {
+          throw DxvkError(str::format("Blob ", name, " did not round trip"));
+        }
+      }
+
+      // Raw blobs are still addressable in place
+      const uint32_t rawIdx = package->getAssetDesc(package->findAsset("raw"))->baseBlobIdx;
+      const AssetPackage::BlobSpan rawSpan = package->getDataBlob(rawIdx);
+      if (rawSpan.size != raw.size() || memcmp(rawSpan.data, raw.data(), raw.size()) != 0) {
+        throw DxvkError("Raw blob is not contiguous in the package");
+      }
+
+      // A sub range of chunks, e.g. a single mip of a packed level range
+      std::vector<uint8_t> range(2 * chunkSize);
+      if (package->decodeDataBlobChunks(compressibleIdx, 3, 2, range.data(), range.size()) != range.size() ||
+          memcmp(range.data(), compressible.data() + 3 * chunkSize, range.size()) != 0) {
+        throw DxvkError("Chunk range did not round trip");
+      }
+
+      // GDeflate blobs are left to RTX IO
+      const uint32_t gdeflateIdx = package->getAssetDesc(package->findAsset("gdeflate"))->baseBlobIdx;
+      if (package->getDataBlobCompression(gdeflateIdx) != AssetPackage::Compression::GDeflate ||
+          package->getDataBlobSize(gdeflateIdx) != 0 ||
+          memcmp(package->getDataBlob(gdeflateIdx).data, gdeflate.data(), gdeflate.size()) != 0) {
+        throw DxvkError("GDeflate blob was not stored as is");
+      }
+    } catch (...) {
+      cleanup();
+      throw;
+    }
+
+    // Flip one stored byte of the compressible blob, which starts right after the header
+    {
+      std::fstream file(chunkedFilename, std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(sizeof(AssetPackage::Header) + 1024 + 17);
+      file.put('\xff' ^ static_cast<char>(file.peek()));
+    }
+
+    Rc<AssetPackage> package = new AssetPackage(chunkedFilename);
+    const bool initialized = package->initialize();
+    const uint32_t blobIdx = initialized ? package->getAssetDesc(package->findAsset("compressible"))->baseBlobIdx : 0;
+
+    std::vector<uint8_t> decoded(compressible.size());
+    const bool wholeBlobDecoded = initialized && package->decodeDataBlob(blobIdx, decoded.data(), decoded.size()) != 0;
+    package = nullptr;
+    cleanup();
+
+    if (!initialized) {
+      throw DxvkError("Corrupted chunk data broke the dictionary");
+    }
+
+    if (wholeBlobDecoded) {
+      throw DxvkError("Corrupted chunk passed the CRC check");
+    }
+  }
+
+  static void test_chunked_throughput(const std::string& filename, const uint32_t packageSizeMB) {
+    const std::string chunkedFilename = filename + ".v2";
+    const size_t mipSize = 1024 * 1024;
+    const uint32_t blobCount = std::max(1u, packageSizeMB);
+
+    std::mt19937 rng(7);
+    std::vector<uint8_t> mip(mipSize);
+
+    {
+      std::cout << "Writing " << blobCount << " MB chunked package: ";
+      Timer t;
+
+      AssetPackageWriter writer;
+      if (!writer.open(chunkedFilename)) {
+        throw DxvkError("Unable to create the chunked package");
+      }
+
+      for (uint32_t n = 0; n < blobCount; n++) {
+        fillCompressible(rng, mip);
+        writer.addAsset(assetName(n), bufferAsset(writer.addBlob(mip.data(), mip.size()), mip.size()));
+      }
+
+      if (!writer.finish()) {
+        std::filesystem::remove(chunkedFilename);
+        throw DxvkError("Failed to write the chunked package");
+      }
+    }
+
+    Rc<AssetPackage> package = new AssetPackage(chunkedFilename);
+    if (!package->initialize()) {
+      std::filesystem::remove(chunkedFilename);
+      throw DxvkError("Failed to initialize the chunked package");
+    }
+
+    uint64_t storedSize = 0;
+    for (uint32_t n = 0; n < blobCount; n++) {
+      storedSize += package->getDataBlob(n).size;
+    }
+
+    std::vector<uint8_t> decoded(size_t(blobCount) * mipSize);
+
+    // One blob at a time on one thread, the way a single FILE* reader would go
+    const auto serialStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t n = 0; n < blobCount; n++) {
+      package->decodeDataBlobChunks(n, 0, package->getDataBlobChunkCount(n), decoded.data() + n * mipSize, mipSize);
+    }
+    const double serialSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - serialStart).count();
+
+    // Mip ranges of 16 blobs, all of their chunks decoded in parallel
+    const auto parallelStart = std::chrono::high_resolution_clock::now();
+    bool success = true;
+    for (uint32_t first = 0; first < blobCount; first += 16) {
+      const uint32_t count = std::min(16u, blobCount - first);
+      uint32_t indices[16];
+      void* outs[16];
+      size_t outSizes[16];
+      for (uint32_t i = 0; i < count; i++) {
+        indices[i] = first + i;
+        outs[i] = decoded.data() + size_t(first + i) * mipSize;
+        outSizes[i] = mipSize;
+      }
+      success &= package->decodeDataBlobs(indices, outs, outSizes, count) == count * mipSize;
+    }
+    const double parallelSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - parallelStart).count();
+
+    package = nullptr;
+    std::filesystem::remove(chunkedFilename);
+
+    if (!success) {
+      throw DxvkError("Chunked package failed to decode");
+    }
+
+    const double decodedMB = double(decoded.size()) / (1024.0 * 1024.0);
+    std::cout << "LZ4 chunks (ratio " << double(storedSize) / decoded.size() << "): serial " << uint32_t(decodedMB / serialSeconds)
+              << " MB/s, parallel " << uint32_t(decodedMB / parallelSeconds) << " MB/s" << std::endl;
+  }
+};
+
+int main() {
+  try {
+    AssetPackageTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,532 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_drawcall_stream.h"
+#include "../../../src/dxvk/rtx_render/rtx_drawcall_matching.h"
+#include "../../../src/util/util_flat_hash_map.h"
+#include "../../../src/util/util_env.h"
+
+using namespace dxvk;
+
+// Replays a draw call stream (recorded with rtx.drawCallRecorder.numFrames, or synthesized when
+// DXVK_DRAWCALL_STREAM isn't set) through the CPU side of scene management and reports per stage
+// timings. The scene manager itself is bound to a DxvkDevice, so the stages below replicate the
+// CPU work of SceneManager::submitDrawState with every GPU resource stubbed out, calling the same
+// matching heuristics (rtx_drawcall_matching.h) as the scene manager:
+//   hashRules      - rule hashes and replacement lookups (SceneManager::submitDrawState)
+//   drawCallCache  - bucket and candidate matching (DrawCallCache::get)
+//   instances      - instance matching (InstanceManager::findSimilarInstance)
+//   gc             - garbage collection of stale instances and BLAS entries (SceneManager::garbageCollection)
+class DrawCallReplayTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_roundtrip();
+    test_malformed();
+    test_replay();
+    std::cout << "Draw call replay successfully tested" << std::endl;
+  }
+
+private:
+  using DrawRecord = DrawCallStream::DrawRecord;
+
+  // Defaults of the corresponding RtxOptions
+  static constexpr float kUniqueObjectDistance = 300.f;
+  static constexpr uint32_t kNumFramesToKeepInstances = 1;
+  static constexpr uint32_t kNumFramesToKeepBLAS = 4;
+
+  enum Stage {
+    HashRules,
+    DrawCallCache,
+    Instances,
+    GarbageCollection,
+    StageCount
+  };
+
+  static constexpr const char* kStageNames[StageCount] = { "hashRules", "drawCallCache", "instances", "gc" };
+
+  // The members of RtInstance the matching heuristics read
+  struct StubInstance {
+    Matrix4 transform;
+    XXH64_hash_t materialHash;
+    uint32_t frameLastUpdated;
+
+    uint32_t getFrameLastUpdated() const { return frameLastUpdated; }
+    const XXH64_hash_t& getMaterialHash() const { return materialHash; }
+    const Matrix4& getTransform() const { return transform; }
+    Vector3 getWorldPosition() const { return Vector3(transform[3][0], transform[3][1], transform[3][2]); }
+  };
+
+  struct StubBlasEntry {
+    DrawRecord input;
+    uint32_t frameCreated;
+    uint32_t frameLastTouched;
+    std::vector<StubInstance> instances;
+  };
+
+  struct PassthroughHash {
+    size_t operator()(const XXH64_hash_t key) const { return key; }
+  };
+
+  struct ReplayStats {
+    uint64_t draws = 0;
+    uint64_t replacements = 0;
+    uint64_t blasCreated = 0;
+    uint64_t blasReused = 0;
+    uint64_t instancesCreated = 0;
+    uint64_t instancesReused = 0;
+    uint64_t blasCollected = 0;
+
+    bool operator==(const ReplayStats& other) const {
+      return memcmp(this, &other, sizeof(ReplayStats)) == 0;
+    }
+  };
+
+  struct StageTimings {
+    double totalUs = 0.0;
+    double maxFrameUs = 0.0;
+  };
+
+  class StubScene {
+  public:
+    explicit StubScene(const std::unordered_set<XXH64_hash_t>& replacements)
+      : m_replacements(replacements) {
+      m_buckets.reserve(1024);
+    }
+
+    void submitDrawState(const DrawRecord& draw, uint32_t frame, std::chrono::nanoseconds* stageTimes) {
+      auto start = std::chrono::high_resolution_clock::now();
+
+      // Asset hash with the default rtx.geometryAssetHashRuleString, used for the replacement lookups
+      const HashRule assetHashRule = (1 << (uint32_t) HashComponents::VertexPosition)
+                                   | (1 << (uint32_t) HashComponents::Indices)
+                                   | (1 << (uint32_t) HashComponents::GeometryDescriptor);
+
+      const XXH64_hash_t assetHash = draw.hashes.getHashForRule(assetHashRule) ^ draw.materialHash;
+      if (m_replacements.find(assetHash) != m_replacements.end() ||
+          m_replacements.find(draw.materialHash) != m_replacements.end()) {
+        m_stats.replacements++;
+      }
+
+      auto end = std::chrono::high_resolution_clock::now();
+      stageTimes[HashRules] += end - start;
+      start = end;
+
+      StubBlasEntry* blas = getBlasEntry(draw, frame);
+
+      end = std::chrono::high_resolution_clock::now();
+      stageTimes[DrawCallCache] += end - start;
+      start = end;
+
+      processInstance(*blas, draw, frame);
+      blas->frameLastTouched = frame;
+
+      stageTimes[Instances] += std::chrono::high_resolution_clock::now() - start;
+      m_stats.draws++;
+    }
+
+    void garbageCollection(uint32_t frame) {
+      refreshReturnedCandidate();
+
+      for (auto it = m_buckets.begin(); it != m_buckets.end(); ) {
+        std::vector<DrawCallCandidate>& candidates = it->second;
+
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const DrawCallCandidate& candidate) {
+          StubBlasEntry& blas = *m_entries[candidate.handle];
+
+          blas.instances.erase(std::remove_if(blas.instances.begin(), blas.instances.end(), [frame](const StubInstance& instance) {
+            return instance.frameLastUpdated + kNumFramesToKeepInstances < frame;
+          }), blas.instances.end());
+
+          if (blas.frameLastTouched + kNumFramesToKeepBLAS < frame) {
+            m_entries[candidate.handle].reset();
+            m_freeHandles.push_back(candidate.handle);
+            m_stats.blasCollected++;
+            return true;
+          }
+          return false;
+        }), candidates.end());
+
+        if (candidates.empty()) {
+          it = m_buckets.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    const ReplayStats& getStats() const {
+      return m_stats;
+    }
+
+  private:
+    const std::unordered_set<XXH64_hash_t>& m_replacements;
+    FlatHashMap<XXH64_hash_t, std::vector<DrawCallCandidate>, PassthroughHash> m_buckets;
+    std::vector<std::unique_ptr<StubBlasEntry>> m_entries;
+    std::vector<uint32_t> m_freeHandles;
+    DrawCallCandidate* m_returnedCandidate = nullptr;
+    ReplayStats m_stats;
+
+    static DrawCallMatchInputs getMatchInputs(const DrawRecord& draw) {
+      DrawCallMatchInputs inputs;
+      inputs.fullGeometryHash = draw.hashes.getHashForRule(rules::FullGeometryHash);
+      inputs.vertexDataHash = draw.hashes.getHashForRule(rules::VertexDataHash);
+      inputs.positionHash = draw.hashes[HashComponents::VertexPosition];
+      inputs.texcoordHash = draw.hashes[HashComponents::VertexTexcoord];
+      inputs.materialHash = draw.materialHash;
+      inputs.boneHash = draw.boneHash;
+      inputs.worldPosition = Vector3(draw.objectToWorld[3][0], draw.objectToWorld[3][1], draw.objectToWorld[3][2]);
+      inputs.isSky = (draw.flags & DrawCallStream::Sky) != 0;
+      return inputs;
+    }
+
+    // The entry returned last was touched by the caller
+    void refreshReturnedCandidate() {
+      if (m_returnedCandidate == nullptr) {
+        return;
+      }
+
+      DrawCallCandidate& candidate = *m_returnedCandidate;
+      const StubBlasEntry& blas = *m_entries[candidate.handle];
+
+      candidate.inputs = getMatchInputs(blas.input);
+      candidate.frameLastTouched = blas.frameLastTouched;
+
+      m_returnedCandidate = nullptr;
+    }
+
+    StubBlasEntry* returnCandidate(DrawCallCandidate& candidate) {
+      m_returnedCandidate = &candidate;
+      return m_entries[candidate.handle].get();
+    }
+
+    StubBlasEntry* allocateEntry(XXH64_hash_t hash, const DrawRecord& draw, uint32_t frame) {
+      m_stats.blasCreated++;
+
+      uint32_t handle = static_cast<uint32_t>(m_entries.size());
+      if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+      } else {
+        m_entries.emplace_back();
+      }
+
+      m_entries[handle] = std::make_unique<StubBlasEntry>(StubBlasEntry { draw, frame, kInvalidFrame });
+
+      std::vector<DrawCallCandidate>& candidates = m_buckets[hash];
+      candidates.push_back(DrawCallCandidate {});
+      candidates.back().handle = handle;
+      return returnCandidate(candidates.back());
+    }
+
+    // As DrawCallCache::get
+    StubBlasEntry* getBlasEntry(const DrawRecord& draw, uint32_t frame) {
+      refreshReturnedCandidate();
+
+      const XXH64_hash_t hash = draw.hashes.getHashForRule(rules::TopologicalHash);
+      auto bucketIter = m_buckets.find(hash);
+
+      if (bucketIter == m_buckets.end()) {
+        return allocateEntry(hash, draw, frame);
+      }
+
+      DrawCallCandidate* candidate = matchDrawCallCandidate(bucketIter->second, getMatchInputs(draw), frame);
+      if (candidate == nullptr) {
+        return allocateEntry(hash, draw, frame);
+      }
+
+      m_stats.blasReused++;
+      return returnCandidate(*candidate);
+    }
+
+    // As InstanceManager::findSimilarInstance, without ray portals
+    void processInstance(StubBlasEntry& blas, const DrawRecord& draw, uint32_t frame) {
+      const Matrix4 transform(draw.objectToWorld[0], draw.objectToWorld[1], draw.objectToWorld[2], draw.objectToWorld[3]);
+      const float uniqueObjectDistanceSqr = kUniqueObjectDistance * kUniqueObjectDistance;
+
+      float nearestDistSqr;
+      StubInstance* similar = const_cast<StubInstance*>(matchSimilarInstance(blas.instances, transform, draw.materialHash, frame, uniqueObjectDistanceSqr, nearestDistSqr));
+
+      if (similar == nullptr) {
+        blas.instances.push_back({});
+        similar = &blas.instances.back();
+        m_stats.instancesCreated++;
+      } else {
+        m_stats.instancesReused++;
+      }
+
+      similar->transform = transform;
+      similar->materialHash = draw.materialHash;
+      similar->frameLastUpdated = frame;
+    }
+  };
+
+  static constexpr uint32_t kInvalidFrame = UINT32_MAX;
+
+  static DrawRecord makeDraw(uint64_t meshId, uint64_t materialId, const Vector3& position) {
+    DrawRecord draw {};
+
+    // Deterministic per mesh, so the same mesh hashes the same way every frame
+    std::mt19937_64 meshRng(meshId);
+    for (uint32_t i = 0; i < (uint32_t) HashComponents::Count; i++) {
+      draw.hashes[(HashComponents) i] = meshRng() | 1;
+    }
+
+    draw.materialHash = XXH3_64bits(&materialId, sizeof(materialId));
+    draw.colorTextureHash = draw.materialHash ^ 0x1234;
+    for (uint32_t i = 0; i < 4; i++) {
+      draw.objectToWorld[i][i] = 1.f;
+    }
+    draw.objectToWorld[3] = Vector4(position.x, position.y, position.z, 1.f);
+    memcpy(draw.objectToView, draw.objectToWorld, sizeof(draw.objectToView));
+    draw.vertexCount = 64 + uint32_t(meshRng() % 4096);
+    draw.indexCount = draw.vertexCount * 3;
+    draw.topology = 3; // VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
+    draw.positionStride = 32;
+    draw.flags = DrawCallStream::Indexed;
+    return draw;
+  }
+
+  // Scene of static meshes (some drawn several times), moving props, skinned characters and
+  // particles that change topology every frame.
+  static void synthesizeStream(const std::string& filename, uint32_t numFrames, uint32_t numMeshes) {
+    DrawCallStreamWriter writer;
+    if (!writer.open(filename)) {
+      throw DxvkError("Failed to create the draw call stream");
+    }
+
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<float> positionDist(-10000.f, 10000.f);
+
+    std::vector<Vector3> positions(numMeshes);
+    for (Vector3& position : positions) {
+      position = Vector3(positionDist(rng), positionDist(rng), positionDist(rng));
+    }
+
+    for (uint32_t frame = 0; frame < numFrames; frame++) {
+      for (uint32_t mesh = 0; mesh < numMeshes; mesh++) {
+        const uint32_t kind = mesh % 20;
+        Vector3 position = positions[mesh];
+
+        if (kind == 0) {
+          // Moving prop
+          position.x += frame * 2.f;
+        }
+
+        DrawRecord draw = makeDraw(mesh, mesh / 4, position);
+
+        if (kind == 1) {
+          // Skinned character, bones change every frame
+          draw.numBones = 32;
+          draw.boneHash = XXH3_64bits(&frame, sizeof(frame)) ^ mesh;
+        } else if (kind == 2) {
+          // Particles, new vertex and index data every frame
+          draw.hashes[HashComponents::VertexPosition] ^= uint64_t(frame) << 32;
+          draw.hashes[HashComponents::Indices] ^= uint64_t(frame) << 32;
+        }
+
+        writer.addDraw(draw);
+
+        if (kind == 3) {
+          // Instanced, the same mesh drawn 4 more times nearby
+          for (uint32_t i = 1; i <= 4; i++) {
+            writer.addDraw(makeDraw(mesh, mesh / 4, position + Vector3(i * 500.f, 0.f, 0.f)));
+          }
+        }
+      }
+
+      writer.endFrame(1000 + frame);
+    }
+
+    if (!writer.finish()) {
+      throw DxvkError("Failed to write the draw call stream");
+    }
+  }
+
+  static std::string tempFile(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+  }
+
+  static void test_roundtrip() {
+    const std::string filename = tempFile("dxvk_drawcall_roundtrip.dcs");
+
+    std::vector<DrawRecord> draws;
+
+    {
+      DrawCallStreamWriter writer;
+      if (!writer.open(filename)) {
+        throw DxvkError("Failed to create the draw call stream");
+      }
+
+      for (uint32_t frame = 0; frame < 3; frame++) {
+        for (uint32_t i = 0; i < frame * 10; i++) {
+          draws.push_back(makeDraw(i, i, Vector3(float(i), float(frame), 0.f)));
+          writer.addDraw(draws.back());
+        }
+        writer.endFrame(frame + 10);
+      }
+
+      // Draws of an unfinished frame are discarded
+      writer.addDraw(draws.back());
+
+      if (!writer.finish()) {
+        throw DxvkError("Failed to write the draw call stream");
+      }
+    }
+
+    DrawCallStreamReader reader;
+    if (!reader.open(filename) || reader.getFrameCount() != 3) {
+      throw DxvkError("Failed to read back the draw call stream");
+    }
+
+    size_t drawIdx = 0;
+    for (uint32_t frame = 0; frame < 3; frame++) {
+      const DrawCallStream::Frame& recorded = reader.getFrame(frame);
+
+      if (recorded.frameId != frame + 10 || recorded.drawCount != frame * 10) {
+        throw DxvkError("Frame mismatch in the draw call stream");
+      }
+
+      for (uint32_t i = 0; i < recorded.drawCount; i++) {
+        if (memcmp(&recorded.draws[i], &draws[drawIdx++], sizeof(DrawRecord)) != 0) {
+          throw DxvkError("Draw record mismatch in the draw call stream");
+        }
+      }
+    }
+  }
+
+  static void test_malformed() {
+    const std::string filename = tempFile("dxvk_drawcall_roundtrip.dcs");
+    const std::string truncated = tempFile("dxvk_drawcall_truncated.dcs");
+
+    std::filesystem::copy_file(filename, truncated, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(truncated, std::filesystem::file_size(filename) - sizeof(DrawRecord) / 2);
+
+    DrawCallStreamReader reader;
+    if (reader.open(truncated)) {
+      throw DxvkError("Truncated draw call stream was accepted");
+    }
+
+    std::filesystem::remove(truncated);
+    std::filesystem::remove(filename);
+  }
+
+  static ReplayStats replay(const DrawCallStreamReader& reader, const std::unordered_set<XXH64_hash_t>& replacements, StageTimings* timings) {
+    StubScene scene(replacements);
+
+    for (uint32_t frame = 0; frame < reader.getFrameCount(); frame++) {
+      const DrawCallStream::Frame& recorded = reader.getFrame(frame);
+      std::chrono::nanoseconds stageTimes[StageCount] = {};
+
+      for (uint32_t i = 0; i < recorded.drawCount; i++) {
+        scene.submitDrawState(recorded.draws[i], frame, stageTimes);
+      }
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      scene.garbageCollection(frame);
+      stageTimes[GarbageCollection] += std::chrono::high_resolution_clock::now() - start;
+
+      for (uint32_t stage = 0; stage < StageCount; stage++) {
+        const double us = std::chrono::duration<double, std::micro>(stageTimes[stage]).count();
+        timings[stage].totalUs += us;
+        timings[stage].maxFrameUs = std::max(timings[stage].maxFrameUs, us);
+      }
+    }
+
+    return scene.getStats();
+  }
+
+  static void test_replay() {
+    std::string filename = env::getEnvVar("DXVK_DRAWCALL_STREAM");
+    const bool synthesized = filename.empty();
+
+    if (synthesized) {
+      filename = tempFile("dxvk_drawcall_replay.dcs");
+      synthesizeStream(filename, 120, 4000);
+    }
+
+    DrawCallStreamReader reader;
+    if (!reader.open(filename) || reader.getFrameCount() == 0) {
+      throw DxvkError(str::format("Failed to open draw call stream ", filename));
+    }
+
+    // Replace one in ten materials
+    std::unordered_set<XXH64_hash_t> replacements;
+    const DrawCallStream::Frame& firstFrame = reader.getFrame(0);
+    for (uint32_t i = 0; i < firstFrame.drawCount; i += 10) {
+      replacements.insert(firstFrame.draws[i].materialHash);
+    }
+
+    StageTimings timings[StageCount] = {};
+    const ReplayStats stats = replay(reader, replacements, timings);
+
+    std::cout << "Replayed " << reader.getFrameCount() << " frames, " << stats.draws << " draws"
+              << (synthesized ? " (synthesized)" : "") << std::endl
+              << "  BLAS entries: " << stats.blasCreated << " created, " << stats.blasReused << " reused, " << stats.blasCollected << " collected" << std::endl
+              << "  instances: " << stats.instancesCreated << " created, " << stats.instancesReused << " reused, " << stats.replacements << " replaced draws" << std::endl;
+
+    for (uint32_t stage = 0; stage < StageCount; stage++) {
+      std::cout << "  " << kStageNames[stage] << ": "
+                << timings[stage].totalUs / reader.getFrameCount() << " us/frame avg, "
+                << timings[stage].maxFrameUs << " us/frame max, "
+                << timings[stage].totalUs * 1000.0 / std::max<uint64_t>(stats.draws, 1) << " ns/draw" << std::endl;
+    }
+
+    // The replay must be deterministic to be usable as a regression benchmark
+    StageTimings ignored[StageCount] = {};
+    if (!(replay(reader, replacements, ignored) == stats)) {
+      throw DxvkError("Replaying the same stream twice gave different results");
+    }
+
+    if (synthesized) {
+      // Static meshes must settle into reusing their BLAS entries and instances
+      if (stats.blasReused < stats.draws / 2 || stats.instancesReused < stats.draws / 2) {
+        throw DxvkError("Replayed scene doesn't reuse its BLAS entries and instances");
+      }
+
+      std::filesystem::remove(filename);
+    }
+  }
+};
+
+int main() {
+  try {
+    DrawCallReplayTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,265 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_fastops.h"
+
+using namespace dxvk;
+
+class MeshCaptureTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_deinterleave();
+    test_indices();
+    test_delta();
+    test_capture_throughput();
+    std::cout << "Mesh capture fastops successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr float kGuard = -12345.f;
+
+  static std::vector<uint8_t> makeVertices(std::mt19937& rng, uint32_t count, size_t stride) {
+    std::uniform_real_distribution<float> uni(-100.f, 100.f);
+    std::vector<uint8_t> vertices(count * stride);
+    for (size_t i = 0; i < vertices.size() / sizeof(float); i++) {
+      const float value = uni(rng);
+      memcpy(vertices.data() + i * sizeof(float), &value, sizeof(float));
+    }
+    return vertices;
+  }
+
+  // Every layout a capture sees, checked against a plain copy and for writes past the end
+  static void test_deinterleave() {
+    std::mt19937 rng(1);
+
+    for (uint32_t components = 1; components <= 4; components++) {
+      for (size_t stride = components * sizeof(float); stride <= 64; stride += 4) {
+        for (uint32_t count : { 0u, 1u, 2u, 3u, 5u, 17u, 1000u }) {
+          const std::vector<uint8_t> vertices = makeVertices(rng, count, stride);
+
+          std::vector<float> expected(count * components);
+          for (uint32_t i = 0; i < count; i++) {
+            memcpy(&expected[i * components], vertices.data() + i * stride, components * sizeof(float));
+          }
+
+          std::vector<float> packed(count * components + 4, kGuard);
+          fast::deinterleaveFloats(packed.data(), vertices.data(), stride, components, count);
+
+          if (!std::equal(expected.begin(), expected.end(), packed.begin())) {
+            throw DxvkError(str::format("deinterleaveFloats mismatch: ", components, " components, stride ", stride, ", ", count, " vertices"));
+          }
+
+          for (uint32_t i = 0; i < 4; i++) {
+            if (packed[count * components + i] != kGuard) {
+              throw DxvkError(str::format("deinterleaveFloats wrote past the end: ", components, " components, stride ", stride));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  static void test_indices() {
+    std::mt19937 rng(2);
+
+    for (uint32_t count : { 0u, 1u, 7u, 8u, 9u, 4099u }) {
+      std::vector<uint16_t> indices16(count);
+      std::vector<uint32_t> indices32(count);
+      for (uint32_t i = 0; i < count; i++) {
+        indices16[i] = uint16_t(rng());
+        indices32[i] = rng();
+      }
+
+      std::vector<uint32_t> widened(count + 1, 0xdeadbeef);
+      fast::widenIndices(widened.data(), indices16.data(), count);
+      for (uint32_t i = 0; i < count; i++) {
+        if (widened[i] != indices16[i]) {
+          throw DxvkError(str::format("widenIndices<uint16_t> mismatch at ", i, " of ", count));
+        }
+      }
+
+      fast::widenIndices(widened.data(), indices32.data(), count);
+      if (!std::equal(indices32.begin(), indices32.end(), widened.begin()) || widened[count] != 0xdeadbeef) {
+        throw DxvkError(str::format("widenIndices<uint32_t> mismatch for ", count, " indices"));
+      }
+    }
+  }
+
+  static bool referenceDeltaExceeds(const float* a, const float* b, uint32_t count, uint32_t components, float maxDelta) {
+    for (uint32_t i = 0; i < count; i++) {
+      float lengthSq = 0.f;
+      for (uint32_t c = 0; c < components; c++) {
+        const float delta = a[i * components + c] - b[i * components + c];
+        lengthSq += delta * delta;
+      }
+      if (lengthSq > maxDelta * maxDelta) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // One vector moved by about the threshold, at every position of a block and in the tail
+  static void test_delta() {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> uni(-1.f, 1.f);
+    constexpr float kMaxDelta = 0.3f;
+
+    for (uint32_t components = 1; components <= 4; components++) {
+      for (uint32_t count : { 1u, 5u, 13u, 64u }) {
+        std::vector<float> a(count * components);
+        for (float& value : a) {
+          value = uni(rng) * 10.f;
+        }
+
+        for (uint32_t moved = 0; moved < count; moved++) {
+          for (float scale : { 0.f, 0.5f, 0.95f, 1.05f, 2.f }) {
+            std::vector<float> b = a;
+            // Small noise everywhere, the moved vector gets a delta of scale * kMaxDelta
+            for (float& value : b) {
+              value += uni(rng) * 0.01f * kMaxDelta;
+            }
+            float lengthSq = 0.f;
+            std::vector<float> direction(components);
+            for (float& d : direction) {
+              d = uni(rng);
+              lengthSq += d * d;
+            }
+            for (uint32_t c = 0; c < components; c++) {
+              b[moved * components + c] = a[moved * components + c] + direction[c] / std::sqrt(lengthSq) * scale * kMaxDelta;
+            }
+
+            const bool expected = referenceDeltaExceeds(a.data(), b.data(), count, components, kMaxDelta);
+            if (fast::anyDeltaExceeds(a.data(), b.data(), count, components, kMaxDelta) != expected) {
+              throw DxvkError(str::format("anyDeltaExceeds mismatch: ", components, " components, ", count,
+                                          " vectors, vector ", moved, " moved by ", scale, "x the threshold"));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // A capture frame: positions and normals of interleaved 32 byte vertices, 16-bit indices, then compared
+  // against the previous time sample which is unchanged (the worst case, every vertex is compared).
+  // The per element path mirrors the capturer before: push_back per vertex and a compare lambda per element.
+  static void test_capture_throughput() {
+    constexpr uint32_t kNumVertices = 1 << 20;
+    constexpr uint32_t kNumIndices = kNumVertices * 3 / 2;
+    constexpr size_t kStride = 32;
+    constexpr float kMaxDelta = 0.3f;
+
+    struct Vec3 {
+      float v[3];
+    };
+
+    std::mt19937 rng(4);
+    const std::vector<uint8_t> vertices = makeVertices(rng, kNumVertices, kStride);
+    std::vector<uint16_t> indices(kNumIndices);
+    for (uint16_t& index : indices) {
+      index = uint16_t(rng());
+    }
+
+    double perElementSeconds;
+    bool perElementDifferent = false;
+    {
+      const auto start = std::chrono::high_resolution_clock::now();
+      std::vector<Vec3> previous;
+      for (uint32_t frame = 0; frame < 2; frame++) {
+        std::vector<Vec3> positions;
+        for (uint32_t i = 0; i < kNumVertices; i++) {
+          Vec3 position;
+          memcpy(position.v, vertices.data() + i * kStride, sizeof(position.v));
+          positions.push_back(position);
+        }
+
+        std::vector<int> widened;
+        for (uint32_t i = 0; i < kNumIndices; i++) {
+          widened.push_back(indices[i]);
+        }
+
+        auto differentEnough = [kMaxDelta](const Vec3& a, const Vec3& b) {
+          const float x = a.v[0] - b.v[0], y = a.v[1] - b.v[1], z = a.v[2] - b.v[2];
+          return x * x + y * y + z * z > kMaxDelta * kMaxDelta;
+        };
+        if (!previous.empty()) {
+          for (uint32_t i = 0; i < kNumVertices; i++) {
+            perElementDifferent = differentEnough(positions[i], previous[i]);
+            if (perElementDifferent) {
+              break;
+            }
+          }
+        }
+        previous = std::move(positions);
+      }
+      perElementSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    double fastSeconds;
+    bool fastDifferent = false;
+    {
+      const auto start = std::chrono::high_resolution_clock::now();
+      std::vector<Vec3> previous;
+      for (uint32_t frame = 0; frame < 2; frame++) {
+        std::vector<Vec3> positions(kNumVertices);
+        fast::deinterleaveFloats(positions.data()->v, vertices.data(), kStride, 3, kNumVertices);
+
+        std::vector<int> widened(kNumIndices);
+        fast::widenIndices(reinterpret_cast<uint32_t*>(widened.data()), indices.data(), kNumIndices);
+
+        if (!previous.empty()) {
+          fastDifferent = fast::anyDeltaExceeds(positions.data()->v, previous.data()->v, kNumVertices, 3, kMaxDelta);
+        }
+        previous = std::move(positions);
+      }
+      fastSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    if (perElementDifferent || fastDifferent) {
+      throw DxvkError("Identical time samples were considered different");
+    }
+
+    std::cout << "Capturing 2 frames of " << kNumVertices << " vertices: per element " << perElementSeconds * 1000.0
+              << " ms, vectorized " << fastSeconds * 1000.0 << " ms" << std::endl;
+  }
+};
+
+int main() {
+  try {
+    MeshCaptureTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
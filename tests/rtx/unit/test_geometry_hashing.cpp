@@ -0,0 +1,368 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <iostream>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_hashing.h"
+#include "../../../src/util/util_fastops.h"
+#include "../../../src/util/util_threadpool.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/util/xxHash/xxhash.h"
+
+using namespace dxvk;
+
+// Synthetic draw call, a strided vertex buffer and the sorted set of unique indices referencing it
+struct SyntheticDraw {
+  std::vector<uint8_t> vertexData;
+  std::vector<uint16_t> uniqueIndices;
+  size_t stride;
+  size_t elementSize;
+};
+
+class GeometryHashingTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_correctness();
+    test_degenerate();
+    test_kernel();
+    test_batching();
+    test_bounds();
+    std::cout << "Geometry hashing successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr uint32_t kNumDraws = 8 * 1024;
+  static constexpr uint32_t kBatchSize = 32;
+
+  static HashRegion toRegion(const SyntheticDraw& draw) {
+    HashRegion region;
+    region.pBase = const_cast<uint8_t*>(draw.vertexData.data());
+    region.size = draw.vertexData.size();
+    region.stride = draw.stride;
+    region.elementSize = draw.elementSize;
+    return region;
+  }
+
+  // One seeded hash per element read straight from the strided buffer
+  static XXH64_hash_t hashStrided(const SyntheticDraw& draw) {
+    return hashVertexRegionIndexed(toRegion(draw), draw.uniqueIndices);
+  }
+
+  // Gathered into the scratch arena then hashed linearly, as the geometry hash workers do
+  static XXH64_hash_t hashPacked(const SyntheticDraw& draw, std::vector<uint8_t>& scratch, HashBoundsQuery* pBounds = nullptr) {
+    return hashVertexRegionIndexed(toRegion(draw), draw.uniqueIndices, scratch, pBounds);
+  }
+
+  static std::vector<SyntheticDraw> createDraws(const uint32_t numDraws) {
+    std::mt19937 rng(numDraws);
+    std::uniform_int_distribution<uint32_t> vertexCountDist(3, 2048);
+    std::uniform_int_distribution<uint32_t> strideDist(0, 3);
+    std::uniform_int_distribution<uint32_t> byteDist(0, 255);
+    std::bernoulli_distribution useVertexDist(0.8);
+
+    const size_t strides[] = { 12, 20, 32, 48 };
+
+    std::vector<SyntheticDraw> draws(numDraws);
+    for (SyntheticDraw& draw : draws) {
+      const uint32_t vertexCount = vertexCountDist(rng);
+      draw.stride = strides[strideDist(rng)];
+      draw.elementSize = 12; // float3 position
+      draw.vertexData.resize(vertexCount * draw.stride);
+      for (uint8_t& byte : draw.vertexData) {
+        byte = (uint8_t) byteDist(rng);
+      }
+      for (uint32_t i = 0; i < vertexCount; i++) {
+        if (useVertexDist(rng)) {
+          draw.uniqueIndices.push_back((uint16_t) i);
+        }
+      }
+      if (draw.uniqueIndices.empty()) {
+        draw.uniqueIndices.push_back(0);
+      }
+    }
+    return draws;
+  }
+
+  static void test_correctness() {
+    std::vector<SyntheticDraw> draws = createDraws(256);
+    std::vector<uint8_t> scratch;
+
+    for (const SyntheticDraw& draw : draws) {
+      if (hashStrided(draw) != hashPacked(draw, scratch)) {
+        throw DxvkError("Packed hash doesn't match strided hash");
+      }
+
+      // Non-indexed gather must match a plain strided copy
+      const uint32_t vertexCount = (uint32_t) (draw.vertexData.size() / draw.stride);
+      std::vector<uint8_t> packed(vertexCount * draw.elementSize + fast::kGatherStridedPadding);
+      fast::gatherStrided<uint32_t>(packed.data(), draw.vertexData.data(), draw.elementSize, draw.stride, nullptr, vertexCount);
+      for (uint32_t i = 0; i < vertexCount; i++) {
+        if (memcmp(packed.data() + i * draw.elementSize, draw.vertexData.data() + i * draw.stride, draw.elementSize) != 0) {
+          throw DxvkError("Non-indexed gather produced wrong data");
+        }
+      }
+    }
+    std::cout << "Packed hash matches strided hash for " << draws.size() << " draws" << std::endl;
+  }
+
+  // Regions the packed variant can't gather must still hash as the strided variant does
+  static void test_degenerate() {
+    std::vector<uint8_t> scratch;
+
+    SyntheticDraw draw;
+    draw.vertexData.resize(64 * 12);
+    for (size_t i = 0; i < draw.vertexData.size(); i++) {
+      draw.vertexData[i] = (uint8_t) i;
+    }
+    draw.uniqueIndices = { 0, 3, 7, 42 };
+
+    // No bytes per element, the element count still feeds the hash
+    draw.stride = 12;
+    draw.elementSize = 0;
+    if (hashStrided(draw) != hashPacked(draw, scratch) || hashPacked(draw, scratch) == 0) {
+      throw DxvkError("Packed hash of empty elements doesn't match strided hash");
+    }
+
+    std::vector<uint16_t> indices;
+    std::swap(indices, draw.uniqueIndices);
+    if (hashStrided(draw) != hashPacked(draw, scratch)) {
+      throw DxvkError("Non-indexed packed hash of empty elements doesn't match strided hash");
+    }
+
+    // Zero stride, every index reads the first element
+    std::swap(indices, draw.uniqueIndices);
+    draw.stride = 0;
+    draw.elementSize = 12;
+    if (hashStrided(draw) != hashPacked(draw, scratch)) {
+      throw DxvkError("Packed hash of zero stride doesn't match strided hash");
+    }
+
+    // Zero stride without indices has no element count, only an empty region hashes (to 0) either way
+    draw.uniqueIndices.clear();
+    if (hashPacked(draw, scratch) != 0) {
+      throw DxvkError("Non-indexed packed hash of zero stride isn't empty");
+    }
+    draw.vertexData.clear();
+    if (hashStrided(draw) != 0) {
+      throw DxvkError("Strided hash of empty zero stride region isn't empty");
+    }
+  }
+
+  static void test_kernel() {
+    std::vector<SyntheticDraw> draws = createDraws(kNumDraws);
+    std::vector<uint8_t> scratch;
+
+    XXH64_hash_t stridedResult = 0;
+    {
+      std::cout << "Hashing " << kNumDraws << " draws, strided --> ";
+      Timer t;
+      for (const SyntheticDraw& draw : draws) {
+        stridedResult ^= hashStrided(draw);
+      }
+    }
+
+    XXH64_hash_t packedResult = 0;
+    {
+      std::cout << "Hashing " << kNumDraws << " draws, packed --> ";
+      Timer t;
+      for (const SyntheticDraw& draw : draws) {
+        packedResult ^= hashPacked(draw, scratch);
+      }
+    }
+
+    if (stridedResult != packedResult) {
+      throw DxvkError("Kernel results didnt match");
+    }
+  }
+
+  static void test_batching() {
+    std::vector<SyntheticDraw> draws = createDraws(kNumDraws);
+    std::vector<XXH64_hash_t> perDrawResults(kNumDraws, 0);
+    std::vector<XXH64_hash_t> batchedResults(kNumDraws, 0);
+
+    WorkerThreadPool<kNumDraws> threadPool(4, "hashing-test");
+
+    {
+      std::cout << "Scheduling one task per draw --> ";
+      Timer t;
+      std::vector<Future<void>> futures(kNumDraws);
+      for (uint32_t i = 0; i < kNumDraws; i++) {
+        futures[i] = threadPool.Schedule([&draws, &perDrawResults, i]() {
+          perDrawResults[i] = hashStrided(draws[i]);
+        });
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    }
+
+    {
+      std::cout << "Scheduling one task per " << kBatchSize << " draws --> ";
+      Timer t;
+      std::vector<Future<void>> futures;
+      for (uint32_t first = 0; first < kNumDraws; first += kBatchSize) {
+        futures.push_back(threadPool.Schedule([&draws, &batchedResults, first]() {
+          static thread_local std::vector<uint8_t> s_scratch;
+          const uint32_t last = std::min(first + kBatchSize, kNumDraws);
+          for (uint32_t i = first; i < last; i++) {
+            batchedResults[i] = hashPacked(draws[i], s_scratch);
+          }
+        }));
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    }
+
+    if (perDrawResults != batchedResults) {
+      throw DxvkError("Batched results didnt match");
+    }
+  }
+
+  // Scalar reference of the float32 bounds, as the original per vertex loop computed them
+  static void boundsReference(const SyntheticDraw& draw, float minPos[3], float maxPos[3]) {
+    for (const uint16_t idx : draw.uniqueIndices) {
+      float position[3];
+      memcpy(position, draw.vertexData.data() + idx * draw.stride, sizeof(position));
+      for (uint32_t c = 0; c < 3; c++) {
+        minPos[c] = std::min(minPos[c], position[c]);
+        maxPos[c] = std::max(maxPos[c], position[c]);
+      }
+    }
+  }
+
+  static void test_bounds() {
+    std::vector<SyntheticDraw> draws = createDraws(kNumDraws);
+    std::vector<uint8_t> scratch;
+
+    // Random bytes make for NaN positions, keep the data finite
+    std::mt19937 rng(kNumDraws);
+    std::uniform_real_distribution<float> positionDist(-1000.f, 1000.f);
+    for (SyntheticDraw& draw : draws) {
+      for (size_t offset = 0; offset + draw.elementSize <= draw.vertexData.size(); offset += draw.stride) {
+        float position[3] = { positionDist(rng), positionDist(rng), positionDist(rng) };
+        memcpy(draw.vertexData.data() + offset, position, sizeof(position));
+      }
+    }
+
+    for (const SyntheticDraw& draw : draws) {
+      float minRef[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+      float maxRef[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      boundsReference(draw, minRef, maxRef);
+
+      // Strided, straight from the vertex buffer
+      float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+      float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      for (const uint16_t idx : draw.uniqueIndices) {
+        fast::accumulatePositionBounds(draw.vertexData.data() + idx * draw.stride, draw.stride, 1, fast::PositionFormat::Float32x3, minPos, maxPos);
+      }
+      if (memcmp(minRef, minPos, sizeof(minPos)) != 0 || memcmp(maxRef, maxPos, sizeof(maxPos)) != 0) {
+        throw DxvkError("Strided bounds don't match the reference");
+      }
+
+      // Packed, as fused with the hash
+      const uint32_t count = (uint32_t) draw.uniqueIndices.size();
+      scratch.resize(count * draw.elementSize + fast::kGatherStridedPadding);
+      fast::gatherStrided<uint16_t>(scratch.data(), draw.vertexData.data(), draw.elementSize, draw.stride, draw.uniqueIndices.data(), count);
+      float minPacked[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+      float maxPacked[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      fast::accumulatePositionBounds(scratch.data(), draw.elementSize, count, fast::PositionFormat::Float32x3, minPacked, maxPacked);
+      if (memcmp(minRef, minPacked, sizeof(minPacked)) != 0 || memcmp(maxRef, maxPacked, sizeof(maxPacked)) != 0) {
+        throw DxvkError("Packed bounds don't match the reference");
+      }
+
+      // Fused with the hash
+      HashBoundsQuery bounds;
+      bounds.format = fast::PositionFormat::Float32x3;
+      hashPacked(draw, scratch, &bounds);
+      if (memcmp(minRef, bounds.minPos, sizeof(bounds.minPos)) != 0 || memcmp(maxRef, bounds.maxPos, sizeof(bounds.maxPos)) != 0) {
+        throw DxvkError("Fused bounds don't match the reference");
+      }
+    }
+
+    // A zero stride repeats the first vertex, the bounds must not read past it
+    {
+      const std::unique_ptr<float[]> position(new float[3] { 1.f, -2.f, 3.f });
+      float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+      float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      fast::accumulatePositionBounds(position.get(), 0, 64, fast::PositionFormat::Float32x3, minPos, maxPos);
+      if (memcmp(position.get(), minPos, sizeof(minPos)) != 0 || memcmp(position.get(), maxPos, sizeof(maxPos)) != 0) {
+        throw DxvkError("Zero stride bounds aren't the first vertex");
+      }
+
+      // Undecodable positions leave the bounds empty
+      float minUnsupported[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+      float maxUnsupported[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+      fast::accumulatePositionBounds(position.get(), 12, 1, fast::PositionFormat::Unsupported, minUnsupported, maxUnsupported);
+      if (minUnsupported[0] <= maxUnsupported[0]) {
+        throw DxvkError("Unsupported position format produced bounds");
+      }
+    }
+
+    XXH64_hash_t separateResult = 0;
+    {
+      std::cout << "Hashing then bounding " << kNumDraws << " draws in separate passes --> ";
+      Timer t;
+      for (const SyntheticDraw& draw : draws) {
+        separateResult ^= hashPacked(draw, scratch);
+        const uint32_t vertexCount = (uint32_t) (draw.vertexData.size() / draw.stride);
+        float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        fast::accumulatePositionBounds(draw.vertexData.data(), draw.stride, vertexCount, fast::PositionFormat::Float32x3, minPos, maxPos);
+      }
+    }
+
+    XXH64_hash_t fusedResult = 0;
+    {
+      std::cout << "Hashing and bounding " << kNumDraws << " draws in one pass --> ";
+      Timer t;
+      for (const SyntheticDraw& draw : draws) {
+        HashBoundsQuery bounds;
+        bounds.format = fast::PositionFormat::Float32x3;
+        fusedResult ^= hashPacked(draw, scratch, &bounds);
+      }
+    }
+
+    if (separateResult != fusedResult) {
+      throw DxvkError("Fused results didnt match");
+    }
+  }
+};
+
+int main() {
+  try {
+    GeometryHashingTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
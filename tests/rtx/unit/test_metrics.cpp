@@ -0,0 +1,275 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/log/metrics.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+namespace {
+  const std::string kMetricsDir = (std::filesystem::temp_directory_path() / "dxvk_metrics_test").string();
+
+  bool setupEnvironment() {
+    std::filesystem::create_directories(kMetricsDir);
+#ifdef _WIN32
+    _putenv_s("DXVK_METRICS_PATH", kMetricsDir.c_str());
+    _putenv_s("DXVK_METRICS_FORMAT", "csv");
+#else
+    setenv("DXVK_METRICS_PATH", kMetricsDir.c_str(), 1);
+    setenv("DXVK_METRICS_FORMAT", "csv", 1);
+#endif
+    return true;
+  }
+
+  // Must be initialized before the Metrics instance below reads the environment
+  const bool s_environmentReady = setupEnvironment();
+}
+
+namespace dxvk {
+  Metrics Metrics::s_instance;
+}
+
+class MetricsTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_registration();
+    test_aggregation();
+    test_shutdown();
+    test_overhead();
+    Metrics::shutdown();
+    std::cout << "Metrics successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr uint32_t kNumThreads = 8;
+  static constexpr uint32_t kNumFrames = 4;
+  static constexpr uint32_t kValuesPerThread = 1000;
+
+  struct Row {
+    uint64_t frame;
+    std::string metric;
+    double count;
+    double value;
+    double min;
+    double max;
+  };
+
+  static std::vector<Row> readRows() {
+    std::ifstream file(kMetricsDir + "/metrics.csv");
+    std::vector<Row> rows;
+    std::string line;
+
+    // Skip the header
+    std::getline(file, line);
+
+    while (std::getline(file, line)) {
+      std::vector<std::string> columns;
+      std::stringstream stream(line);
+      std::string column;
+
+      while (std::getline(stream, column, ','))
+        columns.push_back(column);
+
+      if (columns.size() < 7)
+        throw DxvkError(str::format("Malformed metrics row: ", line));
+
+      rows.push_back({ std::stoull(columns[0]), columns[2], std::stod(columns[3]), std::stod(columns[4]), std::stod(columns[5]), std::stod(columns[6]) });
+    }
+
+    return rows;
+  }
+
+  static const Row* findRow(const std::vector<Row>& rows, uint64_t frame, const std::string& metric) {
+    for (const Row& row : rows) {
+      if (row.frame == frame && row.metric == metric)
+        return &row;
+    }
+
+    return nullptr;
+  }
+
+  static void test_registration() {
+    if (!Metrics::enabled())
+      throw DxvkError("Metrics should be enabled by the test environment");
+
+    const MetricId a = Metrics::registerCounter("test_counter");
+    const MetricId b = Metrics::registerCounter("test_counter");
+    const MetricId c = Metrics::registerGauge("test_gauge");
+
+    if (a == kInvalidMetricId || a != b || a == c)
+      throw DxvkError("Registering a metric twice must return the same handle");
+  }
+
+  static void test_aggregation() {
+    const MetricId counter = Metrics::registerCounter("test_counter");
+    const MetricId gauge = Metrics::registerGauge("test_gauge");
+    const MetricId histogram = Metrics::registerHistogram("test_histogram");
+
+    for (uint32_t frame = 0; frame < kNumFrames; frame++) {
+      std::vector<std::thread> threads;
+
+      for (uint32_t t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([=] {
+          for (uint32_t i = 0; i < kValuesPerThread; i++) {
+            Metrics::add(counter, frame + 1);
+            Metrics::sample(histogram, i);
+          }
+        });
+      }
+
+      for (std::thread& thread : threads)
+        thread.join();
+
+      Metrics::set(gauge, frame * 10.0);
+      Metrics::endFrame(100 + frame);
+    }
+
+    Metrics::flush();
+
+    const std::vector<Row> rows = readRows();
+
+    for (uint32_t frame = 0; frame < kNumFrames; frame++) {
+      const Row* counterRow = findRow(rows, 100 + frame, "test_counter");
+      const Row* gaugeRow = findRow(rows, 100 + frame, "test_gauge");
+      const Row* histogramRow = findRow(rows, 100 + frame, "test_histogram");
+
+      if (!counterRow || !gaugeRow || !histogramRow)
+        throw DxvkError(str::format("Missing metrics for frame ", frame));
+
+      if (counterRow->value != double(kNumThreads * kValuesPerThread * (frame + 1)))
+        throw DxvkError(str::format("Counter mismatch in frame ", frame, ": ", counterRow->value));
+
+      if (gaugeRow->value != frame * 10.0)
+        throw DxvkError(str::format("Gauge mismatch in frame ", frame, ": ", gaugeRow->value));
+
+      if (histogramRow->count != double(kNumThreads * kValuesPerThread) ||
+          histogramRow->min != 0.0 || histogramRow->max != double(kValuesPerThread - 1))
+        throw DxvkError(str::format("Histogram mismatch in frame ", frame));
+    }
+
+    if (findRow(rows, 100, "metrics_dropped"))
+      throw DxvkError("No values should have been dropped");
+  }
+
+  static void test_shutdown() {
+    Metrics::shutdown();
+
+    // Registered after the flusher copied the registry, and recorded
+    // into a restarted flusher which has to append to the same file.
+    const MetricId late = Metrics::registerCounter("test_late_counter");
+    Metrics::add(late, 3.0);
+    Metrics::endFrame(200);
+    Metrics::flush();
+
+    const std::vector<Row> rows = readRows();
+
+    if (!findRow(rows, 100, "test_counter"))
+      throw DxvkError("Frames written before the shutdown were lost");
+
+    const Row* lateRow = findRow(rows, 200, "test_late_counter");
+
+    if (!lateRow || lateRow->value != 3.0)
+      throw DxvkError("Metric registered after the shutdown was not recorded");
+  }
+
+  // Compares the cost of recording a value against the mutex the previous implementation took per call
+  static void test_overhead() {
+    const MetricId counter = Metrics::registerCounter("test_overhead");
+    constexpr uint32_t kValuesPerFrame = 2000;
+    constexpr uint32_t kFrames = 200;
+
+    for (uint32_t numThreads : { 1u, kNumThreads }) {
+      std::cout << numThreads << " thread(s), " << kFrames * kValuesPerFrame << " values per thread" << std::endl;
+
+      {
+        dxvk::mutex mutex;
+        double value = 0.0;
+
+        std::cout << "  mutex per value: ";
+        Timer t;
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < numThreads; i++) {
+          threads.emplace_back([&] {
+            for (uint32_t n = 0; n < kFrames * kValuesPerFrame; n++) {
+              std::lock_guard<dxvk::mutex> lock(mutex);
+              value += 1.0;
+            }
+          });
+        }
+
+        for (std::thread& thread : threads)
+          thread.join();
+      }
+
+      {
+        std::cout << "  metrics rings: ";
+        Timer t;
+        std::atomic<uint32_t> framesDone = 0;
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < numThreads; i++) {
+          threads.emplace_back([&] {
+            for (uint32_t n = 0; n < kFrames * kValuesPerFrame; n++) {
+              Metrics::add(counter);
+            }
+          });
+        }
+
+        // Keep closing frames while the producers are running, like the render thread would
+        while (framesDone < kFrames) {
+          Metrics::endFrame(1000 + framesDone++);
+          std::this_thread::yield();
+        }
+
+        for (std::thread& thread : threads)
+          thread.join();
+      }
+
+      Metrics::endFrame(5000 + numThreads);
+      Metrics::flush();
+    }
+  }
+};
+
+int main() {
+  try {
+    MetricsTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
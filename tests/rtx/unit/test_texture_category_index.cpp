@@ -0,0 +1,171 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_texture_category_index.h"
+
+using namespace dxvk;
+
+class TextureCategoryIndexTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_lookup();
+    test_rebuild();
+    std::cout << "Texture category index successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr uint32_t kNumCategories = uint32_t(TextureCategory::Count);
+
+  // Category sets of a large mod: 16k listed hashes, some of them in several categories
+  static std::vector<std::unordered_set<XXH64_hash_t>> makeSets(std::mt19937_64& rng, std::vector<XXH64_hash_t>& listed) {
+    constexpr uint32_t kNumListed = 16384;
+
+    std::vector<std::unordered_set<XXH64_hash_t>> sets(kNumCategories);
+    for (uint32_t i = 0; i < kNumListed; i++) {
+      const XXH64_hash_t hash = rng();
+      listed.push_back(hash);
+      sets[rng() % kNumCategories].insert(hash);
+      if (rng() % 4 == 0) {
+        sets[rng() % kNumCategories].insert(hash);
+      }
+    }
+    return sets;
+  }
+
+  static TextureCategoryIndex::Mask referenceMask(const std::vector<std::unordered_set<XXH64_hash_t>>& sets, XXH64_hash_t hash) {
+    TextureCategoryIndex::Mask mask = 0;
+    for (uint32_t category = 0; category < kNumCategories; category++) {
+      if (sets[category].find(hash) != sets[category].end()) {
+        mask |= TextureCategoryIndex::bit(TextureCategory(category));
+      }
+    }
+    return mask;
+  }
+
+  static void build(TextureCategoryIndex& index, const std::vector<std::unordered_set<XXH64_hash_t>>& sets) {
+    index.clear();
+    for (uint32_t category = 0; category < kNumCategories; category++) {
+      index.add(TextureCategory(category), sets[category]);
+    }
+  }
+
+  // Index masks match probing each set, and per draw lookups are timed against the set probes they replace
+  static void test_lookup() {
+    std::mt19937_64 rng(9);
+    std::vector<XXH64_hash_t> listed;
+    const auto sets = makeSets(rng, listed);
+
+    TextureCategoryIndex index;
+    build(index, sets);
+
+    // A frame of draw calls, about a third of them using a listed texture
+    constexpr uint32_t kNumDraws = 1 << 20;
+    std::vector<XXH64_hash_t> draws(kNumDraws);
+    for (XXH64_hash_t& hash : draws) {
+      hash = rng() % 3 == 0 ? listed[rng() % listed.size()] : rng();
+    }
+
+    for (uint32_t i = 0; i < kNumDraws; i += 7) {
+      if (index.lookup(draws[i]) != referenceMask(sets, draws[i])) {
+        throw DxvkError(str::format("Categories of texture ", draws[i], " do not match the category sets"));
+      }
+    }
+
+    // The instance manager checks about a dozen categories per draw call
+    constexpr uint32_t kChecksPerDraw = 12;
+    uint32_t setMatches = 0;
+    const auto setStart = std::chrono::high_resolution_clock::now();
+    for (const XXH64_hash_t hash : draws) {
+      for (uint32_t category = 0; category < kChecksPerDraw; category++) {
+        setMatches += sets[category].find(hash) != sets[category].end();
+      }
+    }
+    const double setSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - setStart).count();
+
+    uint32_t indexMatches = 0;
+    const auto indexStart = std::chrono::high_resolution_clock::now();
+    for (const XXH64_hash_t hash : draws) {
+      const TextureCategoryIndex::Mask mask = index.lookup(hash);
+      for (uint32_t category = 0; category < kChecksPerDraw; category++) {
+        indexMatches += TextureCategoryIndex::has(mask, TextureCategory(category));
+      }
+    }
+    const double indexSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - indexStart).count();
+
+    if (setMatches != indexMatches) {
+      throw DxvkError(str::format("Index found ", indexMatches, " category matches, the sets ", setMatches));
+    }
+
+    std::cout << "Categories of " << kNumDraws << " draws against " << index.size() << " listed hashes: "
+              << kChecksPerDraw << " set probes " << setSeconds * 1e9 / kNumDraws << " ns/draw, one index lookup "
+              << indexSeconds * 1e9 / kNumDraws << " ns/draw" << std::endl;
+  }
+
+  // Toggling textures in and out of categories, as the texture selection UI does
+  static void test_rebuild() {
+    std::mt19937_64 rng(13);
+    std::vector<XXH64_hash_t> listed;
+    auto sets = makeSets(rng, listed);
+
+    TextureCategoryIndex index;
+    double buildSeconds = 0.0;
+    constexpr uint32_t kNumEdits = 64;
+
+    for (uint32_t edit = 0; edit < kNumEdits; edit++) {
+      const XXH64_hash_t hash = listed[rng() % listed.size()];
+      auto& set = sets[rng() % kNumCategories];
+      if (set.erase(hash) == 0) {
+        set.insert(hash);
+      }
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      build(index, sets);
+      buildSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+      if (index.lookup(hash) != referenceMask(sets, hash)) {
+        throw DxvkError(str::format("Categories of texture ", hash, " are stale after a rebuild"));
+      }
+    }
+
+    std::cout << "Rebuilding the index of " << listed.size() << " listed hashes: "
+              << buildSeconds * 1000.0 / kNumEdits << " ms" << std::endl;
+  }
+};
+
+int main() {
+  try {
+    TextureCategoryIndexTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_asset_data.h"
+#include "../../../src/util/util_streaming_queue.h"
+
+using namespace dxvk;
+
+// An image file held in memory, hashed the way AssetDataManager hashes mod textures
+class SyntheticImageAsset : public AssetData {
+public:
+  SyntheticImageAsset(const std::string& filename, const std::vector<uint8_t>& contents, bool hashContents)
+    : m_filename(filename), m_contents(contents) {
+    m_info.type = AssetType::Image2D;
+    m_info.format = VK_FORMAT_BC7_UNORM_BLOCK;
+    m_info.extent = { 4, 4, 1 };
+    m_info.mipLevels = 1;
+    m_info.numLayers = 1;
+    m_info.filename = m_filename.c_str();
+    m_hash = XXH3_64bits(filename.data(), filename.size());
+    if (hashContents) {
+      setContentHash(XXH3_64bits(contents.data(), contents.size()));
+    }
+  }
+
+  const void* data(int layer, int level) override {
+    return m_contents.data();
+  }
+
+  void placement(int layer, int face, int level, uint64_t& offset, size_t& size) const override {
+    offset = 0;
+    size = m_contents.size();
+  }
+
+  void evictCache() override { }
+
+private:
+  std::string m_filename;
+  std::vector<uint8_t> m_contents;
+};
+
+class TextureDedupTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_color_spaces(true);
+    test_color_spaces(false);
+    test_upload_queue();
+    std::cout << "Texture deduplication successfully tested" << std::endl;
+  }
+
+private:
+  // A flat placeholder, the kind of file a mod uses for both albedo and roughness
+  static std::vector<uint8_t> placeholder() {
+    return std::vector<uint8_t>(16, 0x80);
+  }
+
+  static void test_color_spaces(bool hashContents) {
+    const Rc<AssetData> file = new SyntheticImageAsset("textures/flat.dds", placeholder(), hashContents);
+    const Rc<AssetData> sameFile = new SyntheticImageAsset("textures/flat.dds", placeholder(), hashContents);
+
+    // One file loaded in both color spaces needs a texture per color space
+    if (file->textureKey(ColorSpace::FORCE_BC_SRGB) == file->textureKey(ColorSpace::AUTO)) {
+      throw DxvkError("One file loaded in both color spaces shares a texture");
+    }
+
+    // Loading it again in the same color space finds the existing texture
+    if (file->textureKey(ColorSpace::AUTO) != sameFile->textureKey(ColorSpace::AUTO) ||
+        file->textureKey(ColorSpace::FORCE_BC_SRGB) != sameFile->textureKey(ColorSpace::FORCE_BC_SRGB)) {
+      throw DxvkError("Reloading a file in the same color space creates another texture");
+    }
+
+    // Another file with the same contents is only deduplicated when its content was hashed
+    const Rc<AssetData> copy = new SyntheticImageAsset("textures/flat_copy.dds", placeholder(), hashContents);
+    if ((copy->textureKey(ColorSpace::AUTO) == file->textureKey(ColorSpace::AUTO)) != hashContents) {
+      throw DxvkError("Identical files are not deduplicated by content");
+    }
+    if (copy->textureKey(ColorSpace::FORCE_BC_SRGB) == file->textureKey(ColorSpace::AUTO)) {
+      throw DxvkError("Identical files in different color spaces share a texture");
+    }
+  }
+
+  // RtxTextureManager::queueUpload keys the queue by ManagedTexture::uniqueKey: both textures
+  // of one file must be queued, a second push is only a priority update of the same texture.
+  static void test_upload_queue() {
+    struct Texture {
+      size_t uniqueKey;
+      XXH64_hash_t textureKey;
+    };
+
+    const Rc<AssetData> file = new SyntheticImageAsset("textures/flat.dds", placeholder(), true);
+    const Texture srgb { 1, file->textureKey(ColorSpace::FORCE_BC_SRGB) };
+    const Texture linear { 2, file->textureKey(ColorSpace::AUTO) };
+
+    StreamingQueue<Texture> queue;
+    if (!queue.push(srgb.uniqueKey, srgb, 1.f, 64) || !queue.push(linear.uniqueKey, linear, 1.f, 64)) {
+      throw DxvkError("A texture of a file loaded in both color spaces was not queued for upload");
+    }
+    if (queue.push(srgb.uniqueKey, srgb, 2.f, 64) || queue.size() != 2) {
+      throw DxvkError("Requeueing a texture queued it twice");
+    }
+  }
+};
+
+int main() {
+  try {
+    TextureDedupTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,386 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_texture_file.h"
+#include "../../../src/util/util_mapped_file.h"
+
+using namespace dxvk;
+
+// Builds DDS and KTX2 files in memory, with every sub-resource filled with its own index,
+// and checks the layout parsed from the header addresses exactly those bytes.
+class TextureFileTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_dds_legacy();
+    test_dds_array();
+    test_dds_cubemap();
+    test_dds_volume();
+    test_ktx2();
+    test_rejected();
+    test_lazy_reads();
+    std::cout << "Texture file layout successfully tested" << std::endl;
+  }
+
+private:
+  struct FormatDesc {
+    uint32_t blockBytes;
+    uint32_t blockExtent;
+  };
+
+  struct Image {
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+    uint32_t levels;
+    uint32_t layers;
+    uint32_t faces;
+  };
+
+  static size_t levelSize(const Image& image, const FormatDesc& format, uint32_t level) {
+    const size_t widthBlocks = (std::max(image.width >> level, 1u) + format.blockExtent - 1) / format.blockExtent;
+    const size_t heightBlocks = (std::max(image.height >> level, 1u) + format.blockExtent - 1) / format.blockExtent;
+    return widthBlocks * heightBlocks * std::max(image.depth >> level, 1u) * format.blockBytes;
+  }
+
+  static uint8_t subresourceIndex(const Image& image, uint32_t layerFace, uint32_t level) {
+    return uint8_t(layerFace * image.levels + level + 1);
+  }
+
+  static void put32(std::vector<uint8_t>& file, size_t offset, uint32_t value) {
+    memcpy(file.data() + offset, &value, sizeof(value));
+  }
+
+  static void put64(std::vector<uint8_t>& file, size_t offset, uint64_t value) {
+    memcpy(file.data() + offset, &value, sizeof(value));
+  }
+
+  static constexpr uint32_t fourCC(const char* code) {
+    return uint32_t(uint8_t(code[0])) | (uint32_t(uint8_t(code[1])) << 8) | (uint32_t(uint8_t(code[2])) << 16) | (uint32_t(uint8_t(code[3])) << 24);
+  }
+
+  // Pixel format: either a FourCC (with dxgiFormat for DX10), or RGB masks
+  struct DdsFormat {
+    uint32_t fourCC = 0;
+    uint32_t dxgiFormat = 0;
+    uint32_t pixelFlags = 0;
+    uint32_t bitCount = 0;
+    uint32_t masks[4] = {};
+  };
+
+  static std::vector<uint8_t> makeDds(const Image& image, const FormatDesc& format, const DdsFormat& ddsFormat, bool volume = false) {
+    const bool dx10 = ddsFormat.fourCC == fourCC("DX10");
+    const size_t headerSize = 128 + (dx10 ? 20 : 0);
+
+    std::vector<uint8_t> file(headerSize, 0);
+    put32(file, 0, fourCC("DDS "));
+    put32(file, 4, 124);
+    put32(file, 8, 0x1007 | (image.levels > 1 ? 0x20000 : 0) | (volume ? 0x800000 : 0));
+    put32(file, 12, image.height);
+    put32(file, 16, image.width);
+    put32(file, 24, volume ? image.depth : 0);
+    put32(file, 28, image.levels);
+    put32(file, 76, 32);
+    put32(file, 80, ddsFormat.fourCC ? 0x4 : ddsFormat.pixelFlags);
+    put32(file, 84, ddsFormat.fourCC);
+    put32(file, 88, ddsFormat.bitCount);
+    for (uint32_t i = 0; i < 4; i++) {
+      put32(file, 92 + i * 4, ddsFormat.masks[i]);
+    }
+    put32(file, 108, 0x1000);
+    put32(file, 112, (image.faces == 6 && !dx10 ? 0x200 | 0xFC00 : 0) | (volume ? 0x200000 : 0));
+
+    if (dx10) {
+      put32(file, 128, ddsFormat.dxgiFormat);
+      put32(file, 132, volume ? 4 : 3);
+      put32(file, 136, image.faces == 6 ? 0x4 : 0);
+      put32(file, 140, image.layers);
+    }
+
+    for (uint32_t layerFace = 0; layerFace < image.layers * image.faces; layerFace++) {
+      for (uint32_t level = 0; level < image.levels; level++) {
+        file.resize(file.size() + levelSize(image, format, level), subresourceIndex(image, layerFace, level));
+      }
+    }
+
+    return file;
+  }
+
+  static std::vector<uint8_t> makeKtx2(const Image& image, const FormatDesc& format, VkFormat vkFormat) {
+    static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    std::vector<uint8_t> file(80 + image.levels * 24, 0);
+    memcpy(file.data(), identifier, sizeof(identifier));
+    put32(file, 12, vkFormat);
+    put32(file, 16, 1);
+    put32(file, 20, image.width);
+    put32(file, 24, image.height);
+    put32(file, 28, 0);
+    put32(file, 32, image.layers > 1 ? image.layers : 0);
+    put32(file, 36, image.faces);
+    put32(file, 40, image.levels);
+
+    // Smallest level first, each level aligned to 16 bytes
+    for (uint32_t level = image.levels; level-- > 0; ) {
+      file.resize((file.size() + 15) & ~size_t(15), 0);
+      put64(file, 80 + level * 24, file.size());
+      put64(file, 80 + level * 24 + 8, levelSize(image, format, level) * image.layers * image.faces);
+
+      for (uint32_t layerFace = 0; layerFace < image.layers * image.faces; layerFace++) {
+        file.resize(file.size() + levelSize(image, format, level), subresourceIndex(image, layerFace, level));
+      }
+    }
+
+    return file;
+  }
+
+  static TextureFileLayout parse(const std::vector<uint8_t>& file) {
+    TextureFileLayout layout;
+    if (!layout.parse(file.data(), std::min(file.size(), TextureFileLayout::kMaxHeaderSize), file.size())) {
+      throw DxvkError("Failed to parse a valid texture file");
+    }
+    return layout;
+  }
+
+  static void validate(const char* name, const std::vector<uint8_t>& file, const TextureFileLayout& layout,
+                       const Image& image, const FormatDesc& format, VkFormat vkFormat) {
+    if (layout.format != vkFormat || layout.width != image.width || layout.height != image.height || layout.depth != image.depth ||
+        layout.levels != image.levels || layout.layers != image.layers || layout.faces != image.faces) {
+      throw DxvkError(str::format(name, ": parsed ", layout.width, "x", layout.height, "x", layout.depth, ", ", layout.levels, " levels, ",
+                                  layout.layers, " layers, ", layout.faces, " faces, format ", layout.format));
+    }
+
+    for (uint32_t layer = 0; layer < image.layers; layer++) {
+      for (uint32_t face = 0; face < image.faces; face++) {
+        for (uint32_t level = 0; level < image.levels; level++) {
+          const TextureFileLayout::Subresource& subresource = layout.subresource(layer, face, level);
+          const uint8_t expected = subresourceIndex(image, layer * image.faces + face, level);
+
+          if (subresource.size != levelSize(image, format, level) || subresource.offset + subresource.size > file.size()) {
+            throw DxvkError(str::format(name, ": layer ", layer, " face ", face, " level ", level, " has size ", subresource.size,
+                                        " at offset ", subresource.offset));
+          }
+
+          for (size_t i = 0; i < subresource.size; i++) {
+            if (file[subresource.offset + i] != expected) {
+              throw DxvkError(str::format(name, ": layer ", layer, " face ", face, " level ", level, " addresses the wrong data"));
+            }
+          }
+        }
+      }
+    }
+
+    std::cout << name << " passed" << std::endl;
+  }
+
+  static void test_dds_legacy() {
+    const Image image { 256, 128, 1, 9, 1, 1 };
+    const FormatDesc format { 8, 4 };
+    DdsFormat ddsFormat;
+    ddsFormat.fourCC = fourCC("DXT1");
+
+    const std::vector<uint8_t> file = makeDds(image, format, ddsFormat);
+    // 16384 + 4096 + 1024 + 256 + 64 + 16 + 3 single block levels
+    if (file.size() != 128 + 21864) {
+      throw DxvkError(str::format("Unexpected BC1 file size ", file.size()));
+    }
+
+    validate("DXT1 2D", file, parse(file), image, format, VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+  }
+
+  static void test_dds_array() {
+    const Image image { 64, 64, 1, 7, 3, 1 };
+    const FormatDesc format { 16, 4 };
+    DdsFormat ddsFormat;
+    ddsFormat.fourCC = fourCC("DX10");
+    ddsFormat.dxgiFormat = 99; // DXGI_FORMAT_BC7_UNORM_SRGB
+
+    const std::vector<uint8_t> file = makeDds(image, format, ddsFormat);
+    validate("DX10 BC7 array", file, parse(file), image, format, VK_FORMAT_BC7_SRGB_BLOCK);
+  }
+
+  static void test_dds_cubemap() {
+    const Image image { 32, 32, 1, 6, 1, 6 };
+    const FormatDesc format { 4, 1 };
+    DdsFormat ddsFormat;
+    ddsFormat.pixelFlags = 0x40 | 0x1; // DDPF_RGB | DDPF_ALPHAPIXELS
+    ddsFormat.bitCount = 32;
+    ddsFormat.masks[0] = 0x00ff0000;
+    ddsFormat.masks[1] = 0x0000ff00;
+    ddsFormat.masks[2] = 0x000000ff;
+    ddsFormat.masks[3] = 0xff000000;
+
+    const std::vector<uint8_t> file = makeDds(image, format, ddsFormat);
+    validate("BGRA8 cubemap", file, parse(file), image, format, VK_FORMAT_B8G8R8A8_UNORM);
+  }
+
+  static void test_dds_volume() {
+    const Image image { 16, 16, 8, 5, 1, 1 };
+    const FormatDesc format { 8, 1 };
+    DdsFormat ddsFormat;
+    ddsFormat.fourCC = fourCC("DX10");
+    ddsFormat.dxgiFormat = 10; // DXGI_FORMAT_R16G16B16A16_FLOAT
+
+    const std::vector<uint8_t> file = makeDds(image, format, ddsFormat, true);
+    validate("RGBA16F volume", file, parse(file), image, format, VK_FORMAT_R16G16B16A16_SFLOAT);
+  }
+
+  static void test_ktx2() {
+    const Image image { 128, 128, 1, 8, 2, 1 };
+    const FormatDesc format { 16, 4 };
+
+    const std::vector<uint8_t> file = makeKtx2(image, format, VK_FORMAT_BC7_UNORM_BLOCK);
+    const TextureFileLayout layout = parse(file);
+    if (layout.container != TextureFileLayout::Container::KTX2) {
+      throw DxvkError("KTX2 file was not detected");
+    }
+    validate("KTX2 BC7 array", file, layout, image, format, VK_FORMAT_BC7_UNORM_BLOCK);
+  }
+
+  static void expectRejected(const char* name, const std::vector<uint8_t>& file, size_t headerSize = TextureFileLayout::kMaxHeaderSize) {
+    TextureFileLayout layout;
+    if (layout.parse(file.data(), std::min(file.size(), headerSize), file.size())) {
+      throw DxvkError(str::format(name, " was not rejected"));
+    }
+  }
+
+  static void test_rejected() {
+    const Image image { 64, 64, 1, 7, 1, 1 };
+    const FormatDesc format { 8, 4 };
+    DdsFormat ddsFormat;
+    ddsFormat.fourCC = fourCC("DXT1");
+    const std::vector<uint8_t> dds = makeDds(image, format, ddsFormat);
+
+    std::vector<uint8_t> file = dds;
+    file.pop_back();
+    expectRejected("Truncated DDS", file);
+
+    expectRejected("Truncated DDS header", dds, 100);
+
+    file = dds;
+    file[0] = 'X';
+    expectRejected("Bad DDS magic", file);
+
+    file = dds;
+    put32(file, 84, fourCC("YUY2"));
+    expectRejected("Unsupported FourCC", file);
+
+    file = dds;
+    put32(file, 28, 8);
+    expectRejected("Too many DDS levels", file);
+
+    DdsFormat dx10;
+    dx10.fourCC = fourCC("DX10");
+    dx10.dxgiFormat = 71;
+    file = makeDds(image, format, dx10);
+    put32(file, 128, 115); // DXGI_FORMAT_B4G4R4A4_UNORM
+    expectRejected("Unsupported DXGI format", file);
+
+    const std::vector<uint8_t> ktx2 = makeKtx2(image, { 16, 4 }, VK_FORMAT_BC7_UNORM_BLOCK);
+
+    file = ktx2;
+    put32(file, 44, 1); // Basis LZ
+    expectRejected("Supercompressed KTX2", file);
+
+    file = ktx2;
+    file.resize(file.size() - 16);
+    expectRejected("Truncated KTX2", file);
+
+    file = ktx2;
+    put32(file, 36, 3);
+    expectRejected("KTX2 face count", file);
+
+    std::cout << "Malformed files rejected" << std::endl;
+  }
+
+  // Preloading the mip tail of a large texture only reads the header and the tail pages
+  static void test_lazy_reads() {
+    const Image image { 2048, 2048, 1, 12, 1, 1 };
+    const FormatDesc format { 16, 4 };
+    const uint32_t preloadMips = 8;
+    DdsFormat ddsFormat;
+    ddsFormat.fourCC = fourCC("DX10");
+    ddsFormat.dxgiFormat = 98; // DXGI_FORMAT_BC7_UNORM
+
+    const std::string filename = (std::filesystem::temp_directory_path() / "dxvk_texture_file_test.dds").string();
+    {
+      const std::vector<uint8_t> file = makeDds(image, format, ddsFormat);
+      std::ofstream out(filename, std::ios::binary);
+      out.write(reinterpret_cast<const char*>(file.data()), file.size());
+    }
+
+    try {
+      std::vector<uint8_t> header(TextureFileLayout::kMaxHeaderSize);
+      std::ifstream in(filename, std::ios::binary | std::ios::ate);
+      const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+      in.seekg(0);
+      in.read(reinterpret_cast<char*>(header.data()), header.size());
+
+      TextureFileLayout layout;
+      if (!layout.parse(header.data(), size_t(in.gcount()), fileSize)) {
+        throw DxvkError("Failed to parse the texture file header");
+      }
+
+      MappedFile mapped;
+      if (!mapped.open(filename)) {
+        throw DxvkError(str::format("Failed to map ", filename));
+      }
+
+      size_t touchedBytes = header.size();
+      for (uint32_t level = image.levels - preloadMips; level < image.levels; level++) {
+        const TextureFileLayout::Subresource& subresource = layout.subresource(0, 0, level);
+        const uint8_t* data = mapped.data() + subresource.offset;
+        if (data[0] != subresourceIndex(image, 0, level) || data[subresource.size - 1] != subresourceIndex(image, 0, level)) {
+          throw DxvkError(str::format("Mapped level ", level, " has the wrong contents"));
+        }
+        touchedBytes += subresource.size;
+      }
+      mapped.close();
+
+      std::cout << "Preloading " << preloadMips << " of " << image.levels << " mips touches " << (touchedBytes >> 10)
+                << " KB of a " << (fileSize >> 10) << " KB file" << std::endl;
+    } catch (...) {
+      std::filesystem::remove(filename);
+      throw;
+    }
+
+    std::filesystem::remove(filename);
+  }
+};
+
+int main() {
+  try {
+    TextureFileTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
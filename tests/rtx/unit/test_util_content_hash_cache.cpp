@@ -0,0 +1,187 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_content_hash_cache.h"
+
+using namespace dxvk;
+
+class ContentHashCacheTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "dxvk_content_hash_cache_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "textures");
+
+    try {
+      test_hashes(directory);
+      test_relocation(directory);
+    }
+    catch (...) {
+      std::filesystem::remove_all(directory);
+      throw;
+    }
+
+    std::filesystem::remove_all(directory);
+    std::cout << "Content hash cache successfully tested" << std::endl;
+  }
+
+private:
+  static void writeFile(const std::filesystem::path& filename, const std::vector<uint8_t>& data) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!file) {
+      throw DxvkError(str::format("Failed to write ", filename.string()));
+    }
+  }
+
+  static std::vector<uint8_t> randomData(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (uint8_t& byte : data) {
+      byte = uint8_t(rng());
+    }
+    return data;
+  }
+
+  // A mod ships the same texture under many names, plus a few unique ones
+  static void test_hashes(const std::filesystem::path& directory) {
+    constexpr uint32_t kNumCopies = 64;
+    constexpr size_t kTextureSize = 4 << 20;
+
+    const std::vector<uint8_t> shared = randomData(kTextureSize, 1);
+    std::vector<std::filesystem::path> copies;
+    for (uint32_t i = 0; i < kNumCopies; i++) {
+      copies.push_back(directory / "textures" / str::format("copy_", i, ".dds"));
+      writeFile(copies.back(), shared);
+    }
+
+    // Same size, one byte apart
+    std::vector<uint8_t> modified = shared;
+    modified[kTextureSize / 2] ^= 1;
+    const std::filesystem::path unique = directory / "textures" / "unique.dds";
+    writeFile(unique, modified);
+
+    const std::filesystem::path cacheFilename = directory / "hashes.bin";
+    double coldSeconds;
+    {
+      ContentHashCache cache;
+      if (cache.load(cacheFilename)) {
+        throw DxvkError("A missing cache file was loaded");
+      }
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      const XXH64_hash_t hash = cache.getHash(copies[0]);
+      for (const auto& copy : copies) {
+        if (cache.getHash(copy) != hash) {
+          throw DxvkError(str::format("Copy ", copy.string(), " does not share the content hash"));
+        }
+      }
+      coldSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+      if (hash == 0 || cache.getHash(unique) == hash) {
+        throw DxvkError("Different contents share a content hash");
+      }
+
+      if (cache.getHash(directory / "missing.dds") != 0) {
+        throw DxvkError("A missing file was hashed");
+      }
+
+      if (!cache.save() || cache.numFilesHashed() != kNumCopies + 1) {
+        throw DxvkError(str::format("Hashed ", cache.numFilesHashed(), " files, expected ", kNumCopies + 1));
+      }
+    }
+
+    // Relaunch: nothing changed, nothing is read
+    double warmSeconds;
+    {
+      ContentHashCache cache;
+      if (!cache.load(cacheFilename) || cache.size() != kNumCopies + 1) {
+        throw DxvkError("Cache file was not loaded");
+      }
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      for (const auto& copy : copies) {
+        cache.getHash(copy);
+      }
+      warmSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+      if (cache.numFilesHashed() != 0) {
+        throw DxvkError(str::format("Hashed ", cache.numFilesHashed(), " unchanged files after a reload"));
+      }
+
+      // An edited file is hashed again
+      const XXH64_hash_t before = cache.getHash(unique);
+      writeFile(unique, randomData(kTextureSize + 1, 2));
+      if (cache.getHash(unique) == before || cache.numFilesHashed() != 1) {
+        throw DxvkError("Edited file kept its stale content hash");
+      }
+      cache.save();
+    }
+
+    std::cout << "Content hashes of " << kNumCopies << " files of " << (kTextureSize >> 20) << " MB: "
+              << coldSeconds * 1000.0 << " ms hashed, " << warmSeconds * 1000.0 << " ms cached" << std::endl;
+  }
+
+  // Moving the mod keeps its cache valid, paths are stored relative to the cache file
+  static void test_relocation(const std::filesystem::path& directory) {
+    const std::filesystem::path moved = directory.string() + "_moved";
+    std::filesystem::remove_all(moved);
+    std::filesystem::rename(directory, moved);
+
+    ContentHashCache cache;
+    const bool loaded = cache.load(moved / "hashes.bin");
+    const bool covered = cache.covers(moved / "textures" / "copy_0.dds") && !cache.covers(directory / "textures" / "copy_0.dds");
+    cache.getHash(moved / "textures" / "copy_0.dds");
+    const uint32_t numFilesHashed = cache.numFilesHashed();
+
+    std::filesystem::rename(moved, directory);
+
+    if (!loaded || !covered) {
+      throw DxvkError("Cache of a moved directory was not loaded or does not cover its files");
+    }
+
+    if (numFilesHashed != 0) {
+      throw DxvkError("Moving the directory invalidated the cached hashes");
+    }
+  }
+};
+
+int main() {
+  try {
+    ContentHashCacheTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
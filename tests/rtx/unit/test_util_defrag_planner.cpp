@@ -0,0 +1,355 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_defrag_planner.h"
+#include "../../../src/util/util_tlsf.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+// Drives the defragmentation planner with a simulated chunk allocator: chunks are TLSF allocators,
+// relocations allocate a copy and free the original a few frames later, as the GPU would.
+class DefragPlannerTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_single_chunk();
+    test_immovable();
+    test_stalled();
+    test_reclaim();
+    std::cout << "Defrag planner successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr uint64_t kChunkSize = 64ull << 20;
+  static constexpr uint32_t kFramesInFlight = 3;
+
+  struct Allocation {
+    uint64_t chunkId;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t memoryType;
+    bool movable;
+  };
+
+  class SimulatedAllocator {
+  public:
+    Allocation alloc(uint64_t size, uint32_t memoryType, bool movable) {
+      for (auto& chunk : m_chunks) {
+        if (chunk->memoryType != memoryType || chunk->evacuating) {
+          continue;
+        }
+
+        const uint64_t offset = chunk->allocator.alloc(size, 256);
+        if (offset != TlsfAllocator::kInvalidOffset) {
+          return { chunk->id, offset, size, memoryType, movable };
+        }
+      }
+
+      m_chunks.push_back(std::make_unique<Chunk>(m_nextChunkId++, memoryType));
+      m_numChunksCreated++;
+      return { m_chunks.back()->id, m_chunks.back()->allocator.alloc(size, 256), size, memoryType, movable };
+    }
+
+    void free(const Allocation& allocation) {
+      auto it = findChunk(allocation.chunkId);
+      (*it)->allocator.free(allocation.offset);
+      releaseIfEmpty(it);
+    }
+
+    void setEvacuating(uint64_t chunkId, bool evacuating) {
+      auto it = findChunk(chunkId);
+      (*it)->evacuating = evacuating;
+      releaseIfEmpty(it);
+    }
+
+    std::vector<DefragPlanner::Chunk> getChunks() const {
+      std::vector<DefragPlanner::Chunk> chunks;
+      for (const auto& chunk : m_chunks) {
+        chunks.push_back({ chunk->id, chunk->memoryType, kChunkSize, kChunkSize - chunk->allocator.getStats().freeBytes });
+      }
+      return chunks;
+    }
+
+    bool isEvacuating(uint64_t chunkId) {
+      return (*findChunk(chunkId))->evacuating;
+    }
+
+    size_t numChunks() const { return m_chunks.size(); }
+    uint32_t numChunksCreated() const { return m_numChunksCreated; }
+    uint64_t releasedBytes() const { return m_releasedBytes; }
+
+  private:
+    struct Chunk {
+      Chunk(uint64_t id, uint32_t memoryType) : id(id), memoryType(memoryType), allocator(kChunkSize) { }
+
+      uint64_t id;
+      uint32_t memoryType;
+      TlsfAllocator allocator;
+      bool evacuating = false;
+    };
+
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    uint64_t m_nextChunkId = 1;
+    uint32_t m_numChunksCreated = 0;
+    uint64_t m_releasedBytes = 0;
+
+    std::vector<std::unique_ptr<Chunk>>::iterator findChunk(uint64_t chunkId) {
+      auto it = std::find_if(m_chunks.begin(), m_chunks.end(), [chunkId](const auto& chunk) { return chunk->id == chunkId; });
+      if (it == m_chunks.end()) {
+        throw DxvkError(str::format("Chunk ", chunkId, " was released while still in use"));
+      }
+      return it;
+    }
+
+    void releaseIfEmpty(std::vector<std::unique_ptr<Chunk>>::iterator it) {
+      if ((*it)->evacuating && (*it)->allocator.getStats().numAllocations == 0) {
+        m_releasedBytes += kChunkSize;
+        m_chunks.erase(it);
+      }
+    }
+  };
+
+  // Simulated frames: plans, applies the plan and retires relocated originals once they are out of flight
+  struct Simulation {
+    SimulatedAllocator allocator;
+    DefragPlanner planner;
+    DefragPlanner::Settings settings;
+    std::vector<Allocation> live;
+    std::deque<std::vector<Allocation>> retired;
+    bool relocate = true;
+
+    void frame() {
+      std::vector<DefragPlanner::Allocation> movable;
+      std::vector<uint32_t> movableIndices;
+      for (uint32_t i = 0; i < live.size(); i++) {
+        if (live[i].movable) {
+          movable.push_back({ live[i].chunkId, live[i].size });
+          movableIndices.push_back(i);
+        }
+      }
+
+      std::vector<uint64_t> evacuate, restore;
+      std::vector<uint32_t> moves;
+      planner.update(settings, allocator.getChunks(), movable, evacuate, restore, moves);
+
+      for (const uint64_t chunkId : restore) {
+        allocator.setEvacuating(chunkId, false);
+      }
+
+      for (const uint64_t chunkId : evacuate) {
+        allocator.setEvacuating(chunkId, true);
+      }
+
+      uint64_t movedBytes = 0;
+      retired.emplace_back();
+
+      for (const uint32_t move : moves) {
+        Allocation& allocation = live[movableIndices[move]];
+
+        if (!allocator.isEvacuating(allocation.chunkId)) {
+          throw DxvkError("Planner moved an allocation out of a chunk which is not evacuating");
+        }
+
+        if (relocate) {
+          const uint32_t numChunksCreated = allocator.numChunksCreated();
+          const Allocation moved = allocator.alloc(allocation.size, allocation.memoryType, true);
+
+          if (allocator.numChunksCreated() != numChunksCreated) {
+            throw DxvkError("Relocation needed a new chunk, the planner evacuated without room");
+          }
+
+          retired.back().push_back(allocation);
+          allocation = moved;
+        }
+
+        movedBytes += allocation.size;
+      }
+
+      if (moves.size() > 1 && movedBytes > settings.budgetBytesPerFrame) {
+        throw DxvkError(str::format("Moved ", movedBytes, " bytes in a frame, over the budget"));
+      }
+
+      if (retired.size() > kFramesInFlight) {
+        for (const Allocation& allocation : retired.front()) {
+          allocator.free(allocation);
+        }
+        retired.pop_front();
+      }
+    }
+  };
+
+  static uint64_t randomSize(std::mt19937_64& rng) {
+    return rng() % 4 == 0 ? (1 + rng() % 32) << 16 : (1 + rng() % 64) << 10;
+  }
+
+  // A lone, sparse chunk has nowhere to move to
+  static void test_single_chunk() {
+    Simulation simulation;
+    simulation.live.push_back(simulation.allocator.alloc(1 << 20, 0, true));
+
+    for (uint32_t frame = 0; frame < 10; frame++) {
+      simulation.frame();
+    }
+
+    if (simulation.planner.getReport().evacuatedChunks != 0 || simulation.planner.getReport().movedBytes != 0) {
+      throw DxvkError("The only chunk of a memory type was evacuated");
+    }
+  }
+
+  // Chunks holding immovable allocations are left alone, however sparse
+  static void test_immovable() {
+    Simulation simulation;
+    std::mt19937_64 rng(3);
+
+    while (simulation.allocator.numChunks() < 4) {
+      simulation.live.push_back(simulation.allocator.alloc(randomSize(rng), 0, true));
+    }
+
+    // Leave one immovable allocation in each of the first three chunks, and free the rest
+    std::vector<Allocation> kept;
+    for (const Allocation& allocation : simulation.live) {
+      const bool isFirstInChunk = std::none_of(kept.begin(), kept.end(), [&](const Allocation& k) { return k.chunkId == allocation.chunkId; });
+      if (isFirstInChunk && allocation.chunkId <= 3) {
+        kept.push_back(allocation);
+        kept.back().movable = false;
+      } else {
+        simulation.allocator.free(allocation);
+      }
+    }
+    simulation.live = kept;
+
+    for (uint32_t frame = 0; frame < 100; frame++) {
+      simulation.frame();
+    }
+
+    if (simulation.planner.getReport().movedBytes != 0 || simulation.planner.getReport().evacuatedChunks != 1) {
+      throw DxvkError("Only the empty chunk should have been released");
+    }
+  }
+
+  // An evacuation which makes no progress is given back
+  static void test_stalled() {
+    Simulation simulation;
+    simulation.relocate = false;
+    simulation.settings.maxStalledFrames = 10;
+    std::mt19937_64 rng(5);
+
+    while (simulation.allocator.numChunks() < 3) {
+      simulation.live.push_back(simulation.allocator.alloc(randomSize(rng), 0, true));
+    }
+
+    // Only a few allocations survive in the last chunk
+    std::vector<Allocation> kept;
+    for (const Allocation& allocation : simulation.live) {
+      if (allocation.chunkId == 3) {
+        kept.push_back(allocation);
+      } else if (allocation.chunkId == 1 || rng() % 8 != 0) {
+        simulation.allocator.free(allocation);
+      } else {
+        kept.push_back(allocation);
+      }
+    }
+    simulation.live = kept;
+
+    for (uint32_t frame = 0; frame < 30; frame++) {
+      simulation.frame();
+    }
+
+    const DefragPlanner::Report& report = simulation.planner.getReport();
+    if (report.abandonedChunks == 0 || report.evacuatingChunks != 0) {
+      throw DxvkError(str::format("Stalled evacuation was not given back: ", report.abandonedChunks, " abandoned"));
+    }
+  }
+
+  // Two memory types fill up, most allocations are freed, the planner compacts what is left
+  static void test_reclaim() {
+    Simulation simulation;
+    std::mt19937_64 rng(7);
+
+    // Immovable resources created up front, then geometry caches streamed in
+    for (uint32_t i = 0; i < 4000; i++) {
+      simulation.live.push_back(simulation.allocator.alloc(randomSize(rng), rng() % 2, i >= 400));
+    }
+
+    std::vector<Allocation> kept;
+    for (const Allocation& allocation : simulation.live) {
+      if (rng() % 5 == 0) {
+        kept.push_back(allocation);
+      } else {
+        simulation.allocator.free(allocation);
+      }
+    }
+    simulation.live = kept;
+
+    uint64_t liveBytes = 0;
+    for (const Allocation& allocation : simulation.live) {
+      liveBytes += allocation.size;
+    }
+
+    const size_t numChunksBefore = simulation.allocator.numChunks();
+
+    {
+      std::cout << "Planning 600 frames over " << numChunksBefore << " chunks --> ";
+      Timer t;
+      for (uint32_t frame = 0; frame < 600; frame++) {
+        simulation.frame();
+      }
+    }
+
+    const DefragPlanner::Report& report = simulation.planner.getReport();
+    std::cout << "  " << numChunksBefore << " -> " << simulation.allocator.numChunks() << " chunks holding " << (liveBytes >> 20)
+              << " MB, moved " << (report.movedBytes >> 20) << " MB, reclaimed " << (report.reclaimedBytes >> 20) << " MB from "
+              << report.evacuatedChunks << " chunks, " << report.abandonedChunks << " abandoned" << std::endl;
+
+    if (report.reclaimedBytes != simulation.allocator.releasedBytes()) {
+      throw DxvkError("Reclaimed bytes do not match the released chunks");
+    }
+
+    if (report.reclaimedBytes == 0 || simulation.allocator.numChunks() >= numChunksBefore) {
+      throw DxvkError("Nothing was reclaimed from the sparse chunks");
+    }
+
+    if (report.evacuatingChunks != 0 || report.abandonedChunks != 0) {
+      throw DxvkError("Evacuations did not finish");
+    }
+  }
+};
+
+int main() {
+  try {
+    DefragPlannerTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,409 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_flat_hash_map.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/util/util_vector.h"
+
+using namespace dxvk;
+
+// Keys are already hashes, as in DrawCallCache and fast_unordered_cache
+struct PassthroughHash {
+  size_t operator()(const uint64_t key) const { return key; }
+};
+
+class FlatHashMapTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_operations<uint32_t, std::hash<uint32_t>>(1000);
+    test_operations<uint64_t, PassthroughHash>(100000);
+    test_erase_while_iterating();
+    test_copy_and_move();
+    test_aligned_keys();
+    test_bucket_lookups();
+    for (const uint32_t numEntries : { 1000u, 10000u, 100000u, 1000000u }) {
+      test_cache_operations(numEntries);
+    }
+    std::cout << "Flat hash map successfully tested" << std::endl;
+  }
+
+private:
+  // Random inserts, lookups and erases, checked against std::unordered_map. Small key ranges
+  // exercise reuse of erased slots, large ones growing the table.
+  template<typename K, typename Hash>
+  static void test_operations(const uint64_t keyRange) {
+    std::mt19937_64 rng(keyRange);
+    FlatHashMap<K, std::string, Hash> map;
+    std::unordered_map<K, std::string> reference;
+
+    for (uint32_t i = 0; i < 200000; i++) {
+      const K key = static_cast<K>(rng() % keyRange);
+
+      switch (rng() % 4) {
+      case 0:
+      case 1: {
+        const std::string value = std::to_string(i);
+        if (map.try_emplace(key, value).second != reference.try_emplace(key, value).second) {
+          throw DxvkError(str::format("Insert result differs for key ", key));
+        }
+        break;
+      }
+      case 2:
+        if (map.erase(key) != reference.erase(key)) {
+          throw DxvkError(str::format("Erase result differs for key ", key));
+        }
+        break;
+      case 3: {
+        auto it = map.find(key);
+        auto referenceIt = reference.find(key);
+        if ((it == map.end()) != (referenceIt == reference.end()) || (it != map.end() && it->second != referenceIt->second)) {
+          throw DxvkError(str::format("Lookup differs for key ", key));
+        }
+        break;
+      }
+      }
+
+      if (map.size() != reference.size()) {
+        throw DxvkError("Map size differs from the reference");
+      }
+    }
+
+    size_t numVisited = 0;
+    for (const auto& [key, value] : map) {
+      if (reference.at(key) != value) {
+        throw DxvkError("Iteration visited a wrong element");
+      }
+      numVisited++;
+    }
+
+    if (numVisited != reference.size()) {
+      throw DxvkError("Iteration missed elements");
+    }
+
+    map.clear();
+    if (!map.empty() || map.begin() != map.end() || map.contains(0)) {
+      throw DxvkError("Map is not empty after clearing");
+    }
+  }
+
+  static void test_erase_while_iterating() {
+    FlatHashMap<uint64_t, uint64_t, PassthroughHash> map;
+    for (uint64_t i = 0; i < 10000; i++) {
+      map[i * 0x9E3779B97F4A7C15ull] = i;
+    }
+
+    for (auto it = map.begin(); it != map.end();) {
+      if (it->second % 3 == 0) {
+        it = map.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    for (uint64_t i = 0; i < 10000; i++) {
+      if (map.contains(i * 0x9E3779B97F4A7C15ull) != (i % 3 != 0)) {
+        throw DxvkError(str::format("Erasing while iterating lost or kept the wrong element ", i));
+      }
+    }
+  }
+
+  static void test_copy_and_move() {
+    FlatHashMap<uint32_t, std::vector<uint32_t>> map;
+    for (uint32_t i = 0; i < 100; i++) {
+      map[i].push_back(i);
+    }
+
+    FlatHashMap<uint32_t, std::vector<uint32_t>> copy = map;
+    FlatHashMap<uint32_t, std::vector<uint32_t>> moved = std::move(map);
+
+    if (copy.size() != 100 || moved.size() != 100 || !map.empty() || copy.at(42) != moved.at(42)) {
+      throw DxvkError("Copied or moved map differs from the original");
+    }
+  }
+
+  // Counts key comparisons, which a lookup only makes for slots whose control byte matched
+  struct CountingKeyEqual {
+    static inline size_t s_count = 0;
+    bool operator()(const uint64_t a, const uint64_t b) const {
+      s_count++;
+      return a == b;
+    }
+  };
+
+  // Identity hashed keys with only high bits set, like the chunk offsets of an allocator. If the
+  // slot only depended on the low bits they would pile into a few groups and lookups would probe
+  // long runs of slots, comparing every key whose control byte matches by chance.
+  static void test_aligned_keys() {
+    constexpr uint64_t kNumKeys = 20000;
+    constexpr uint64_t kAlignment = 1ull << 16;
+
+    FlatHashMap<uint64_t, uint64_t, PassthroughHash, CountingKeyEqual> map;
+    for (uint64_t i = 0; i < kNumKeys; i++) {
+      map.emplace(i * kAlignment, i);
+    }
+
+    CountingKeyEqual::s_count = 0;
+    for (uint64_t i = 0; i < kNumKeys; i++) {
+      auto it = map.find(i * kAlignment);
+      if (it == map.end() || it->second != i) {
+        throw DxvkError(str::format("Aligned key ", i * kAlignment, " was not found"));
+      }
+    }
+
+    const double comparesPerLookup = double(CountingKeyEqual::s_count) / kNumKeys;
+    if (comparesPerLookup > 1.5) {
+      throw DxvkError(str::format("Aligned keys cluster in the table, ", comparesPerLookup, " key comparisons per lookup"));
+    }
+  }
+
+  // Stand-in for BlasEntry: scoring inputs spread over a large object, as in DrawCallState
+  struct Entry {
+    uint32_t id;
+    uint64_t fullGeometryHash;
+    uint8_t geometryState[512];
+    uint64_t positionHash;
+    uint64_t materialHash;
+    uint8_t materialState[512];
+    Vector4 objectToWorld[4];
+    uint32_t frameLastTouched;
+  };
+
+  // What DrawCallCache keeps per candidate in its flat buckets
+  struct Candidate {
+    uint64_t fullGeometryHash;
+    uint64_t positionHash;
+    uint64_t materialHash;
+    Vector3 worldPosition;
+    uint32_t frameLastTouched;
+    uint32_t id;
+  };
+
+  struct Draw {
+    uint64_t topologicalHash;
+    uint64_t fullGeometryHash;
+    uint64_t positionHash;
+    uint64_t materialHash;
+    Vector3 worldPosition;
+  };
+
+  // The multi-entry scoring of DrawCallCache::get
+  template<typename T>
+  static uint32_t score(const Draw& draw, const T& candidate, const Vector3& worldPosition, float& bestScore, uint32_t best) {
+    if (candidate.frameLastTouched == 1) {
+      return best;
+    }
+
+    float score = 0.f;
+    score += candidate.positionHash == draw.positionHash ? 1000.f : 0.f;
+    score += candidate.materialHash == draw.materialHash ? 1000.f : 0.f;
+    score -= lengthSqr(draw.worldPosition - worldPosition);
+
+    if (score > bestScore) {
+      bestScore = score;
+      return candidate.id;
+    }
+
+    return best;
+  }
+
+  static void test_bucket_lookups() {
+    constexpr uint32_t kNumBuckets = 5000;
+    constexpr uint32_t kNumDraws = 200000;
+
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<float> positionDist(-5000.f, 5000.f);
+
+    std::unordered_multimap<uint64_t, Entry, PassthroughHash> multimap;
+    FlatHashMap<uint64_t, std::vector<Candidate>, PassthroughHash> flat;
+    std::vector<uint64_t> topologicalHashes(kNumBuckets);
+
+    // Most buckets hold a single mesh, some are instanced many times
+    uint32_t numEntries = 0;
+    for (uint64_t& topologicalHash : topologicalHashes) {
+      topologicalHash = rng();
+      const uint32_t bucketSize = 1 + (rng() % 8 == 0 ? rng() % 16 : 0);
+
+      for (uint32_t i = 0; i < bucketSize; i++) {
+        Entry entry {};
+        entry.id = numEntries++;
+        entry.fullGeometryHash = rng();
+        entry.positionHash = rng() % 4;
+        entry.materialHash = rng() % 4;
+        entry.objectToWorld[3] = Vector4(positionDist(rng), positionDist(rng), positionDist(rng), 1.f);
+        entry.frameLastTouched = rng() % 4;
+        multimap.emplace(topologicalHash, entry);
+
+        flat[topologicalHash].push_back({ entry.fullGeometryHash, entry.positionHash, entry.materialHash,
+                                          Vector3(entry.objectToWorld[3].x, entry.objectToWorld[3].y, entry.objectToWorld[3].z),
+                                          entry.frameLastTouched, entry.id });
+      }
+    }
+
+    std::vector<Draw> draws(kNumDraws);
+    for (Draw& draw : draws) {
+      draw.topologicalHash = rng() % 10 == 0 ? rng() : topologicalHashes[rng() % kNumBuckets];
+      draw.fullGeometryHash = rng() % 2 == 0 ? multimap.find(draw.topologicalHash) != multimap.end() ? multimap.find(draw.topologicalHash)->second.fullGeometryHash : 0 : rng();
+      draw.positionHash = rng() % 4;
+      draw.materialHash = rng() % 4;
+      draw.worldPosition = Vector3(positionDist(rng), positionDist(rng), positionDist(rng));
+    }
+
+    constexpr uint32_t kMiss = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> multimapResults(kNumDraws);
+    {
+      std::cout << "Matching " << kNumDraws << " draws against " << numEntries << " entries, unordered_multimap --> ";
+      Timer t;
+      for (uint32_t i = 0; i < kNumDraws; i++) {
+        const Draw& draw = draws[i];
+        uint32_t best = kMiss;
+        float bestScore = std::numeric_limits<float>::lowest();
+
+        auto range = multimap.equal_range(draw.topologicalHash);
+        for (auto it = range.first; it != range.second; ++it) {
+          const Entry& entry = it->second;
+          if (entry.fullGeometryHash == draw.fullGeometryHash) {
+            best = entry.id;
+            break;
+          }
+          best = score(draw, entry, Vector3(entry.objectToWorld[3].x, entry.objectToWorld[3].y, entry.objectToWorld[3].z), bestScore, best);
+        }
+        multimapResults[i] = best;
+      }
+    }
+
+    std::vector<uint32_t> flatResults(kNumDraws);
+    {
+      std::cout << "Matching " << kNumDraws << " draws against " << numEntries << " entries, flat hash map --> ";
+      Timer t;
+      for (uint32_t i = 0; i < kNumDraws; i++) {
+        const Draw& draw = draws[i];
+        uint32_t best = kMiss;
+        float bestScore = std::numeric_limits<float>::lowest();
+
+        auto it = flat.find(draw.topologicalHash);
+        if (it != flat.end()) {
+          for (const Candidate& candidate : it->second) {
+            if (candidate.fullGeometryHash == draw.fullGeometryHash) {
+              best = candidate.id;
+              break;
+            }
+            best = score(draw, candidate, candidate.worldPosition, bestScore, best);
+          }
+        }
+        flatResults[i] = best;
+      }
+    }
+
+    if (multimapResults != flatResults) {
+      throw DxvkError("Flat hash map lookups selected different entries than the multimap");
+    }
+  }
+
+  // Times one pass of the operations a fast_unordered_cache sees, returning a checksum of the results
+  template<typename Map>
+  static uint64_t benchmark_cache(const char* name, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& misses) {
+    Map map;
+    uint64_t checksum = 0;
+
+    {
+      std::cout << "  " << name << " insert --> ";
+      Timer t;
+      for (const uint64_t key : keys) {
+        map.emplace(key, key ^ 0x5555);
+      }
+    }
+    {
+      std::cout << "  " << name << " lookup hit --> ";
+      Timer t;
+      for (const uint64_t key : keys) {
+        auto it = map.find(key);
+        checksum += it != map.end() ? it->second : 0;
+      }
+    }
+    {
+      std::cout << "  " << name << " lookup miss --> ";
+      Timer t;
+      for (const uint64_t key : misses) {
+        checksum += map.count(key);
+      }
+    }
+    {
+      std::cout << "  " << name << " iterate --> ";
+      Timer t;
+      for (const auto& it : map) {
+        checksum += it.second;
+      }
+    }
+    {
+      std::cout << "  " << name << " erase --> ";
+      Timer t;
+      for (size_t i = 0; i < keys.size(); i += 2) {
+        map.erase(keys[i]);
+      }
+    }
+
+    return checksum + map.size();
+  }
+
+  // Hashed keys at cache sizes seen in practice (textures, views) up to large geometry caches
+  static void test_cache_operations(const uint32_t numEntries) {
+    std::mt19937_64 rng(numEntries);
+    std::vector<uint64_t> keys(numEntries);
+    std::vector<uint64_t> misses(numEntries);
+    for (uint64_t& key : keys) {
+      key = rng();
+    }
+    for (uint64_t& key : misses) {
+      key = rng();
+    }
+
+    std::cout << numEntries << " entries:" << std::endl;
+    const uint64_t stdChecksum = benchmark_cache<std::unordered_map<uint64_t, uint64_t, PassthroughHash>>("unordered_map", keys, misses);
+    const uint64_t flatChecksum = benchmark_cache<FlatHashMap<uint64_t, uint64_t, PassthroughHash>>("flat hash map", keys, misses);
+
+    if (stdChecksum != flatChecksum) {
+      throw DxvkError(str::format("Flat hash map results differ from unordered_map at ", numEntries, " entries"));
+    }
+  }
+};
+
+int main() {
+  try {
+    FlatHashMapTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,298 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_size_class_pool.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+// Replays synthetic BLAS build size distributions through the size class pool and through
+// the linear best fit scan AccelManager used before, and compares the selections, the time
+// spent and the memory held by each.
+class SizeClassPoolTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_budget();
+    test_release();
+    for (const Distribution distribution : { Distribution::LogUniform, Distribution::Bimodal, Distribution::Steady }) {
+      test_distribution(distribution);
+    }
+    std::cout << "Size class pool successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr uint32_t kNumFrames = 100;
+  static constexpr uint32_t kBuildsPerFrame = 1000;
+  // Default of rtx.numFramesToKeepBLAS
+  static constexpr uint32_t kNumFramesToKeep = 4;
+  static constexpr uint32_t kNever = 1 << 20;
+
+  enum class Distribution {
+    LogUniform, // Sizes spread evenly over the orders of magnitude of typical BLAS'es
+    Bimodal,    // Mostly small dynamic meshes, a few large skinned characters
+    Steady,     // The same set of buckets rebuilt every frame, as in a static camera
+  };
+
+  static constexpr const char* kDistributionNames[] = { "log uniform", "bimodal", "steady" };
+
+  // Mirror of the pool AccelManager kept before, a vector scanned for the best fit. Ties between
+  // equally sized BLAS'es go to the most recently used one, as in the size class pool, so both
+  // pools keep the same BLAS'es alive.
+  struct LinearPool {
+    struct Entry {
+      size_t capacity;
+      uint32_t frameLastTouched;
+    };
+
+    std::vector<Entry> entries;
+
+    bool acquire(size_t size, uint32_t frame, size_t& out) {
+      Entry* selected = nullptr;
+      for (Entry& entry : entries) {
+        if (entry.capacity >= size &&
+            (!selected || entry.capacity < selected->capacity ||
+             (entry.capacity == selected->capacity && entry.frameLastTouched >= selected->frameLastTouched)) &&
+            entry.frameLastTouched + 2 <= frame) {
+          selected = &entry;
+        }
+      }
+
+      if (!selected) {
+        return false;
+      }
+
+      selected->frameLastTouched = frame;
+      out = selected->capacity;
+      return true;
+    }
+
+    void garbageCollect(uint32_t frame, uint32_t numFramesToKeep) {
+      for (uint32_t i = 0; i < entries.size();) {
+        if (entries[i].frameLastTouched + numFramesToKeep < frame) {
+          std::swap(entries[i], entries.back());
+          entries.pop_back();
+          continue;
+        }
+        ++i;
+      }
+    }
+
+    size_t totalBytes() const {
+      size_t bytes = 0;
+      for (const Entry& entry : entries) {
+        bytes += entry.capacity;
+      }
+      return bytes;
+    }
+  };
+
+  // Acceleration structure buffers are created with the requested size, aligned to 256 bytes
+  static size_t capacityOf(size_t size) {
+    return (size + 255) & ~size_t(255);
+  }
+
+  static std::vector<std::vector<size_t>> createFrames(const Distribution distribution) {
+    std::mt19937 rng(static_cast<uint32_t>(distribution));
+    std::uniform_real_distribution<double> logDist(std::log2(4096.0), std::log2(16.0 * 1024 * 1024));
+    std::uniform_real_distribution<double> smallDist(std::log2(4096.0), std::log2(256.0 * 1024));
+    std::uniform_real_distribution<double> largeDist(std::log2(4.0 * 1024 * 1024), std::log2(32.0 * 1024 * 1024));
+    std::uniform_real_distribution<double> unitDist(0.0, 1.0);
+
+    auto sample = [&]() -> size_t {
+      switch (distribution) {
+      case Distribution::Bimodal:
+        return static_cast<size_t>(std::exp2(unitDist(rng) < 0.95 ? smallDist(rng) : largeDist(rng)));
+      default:
+        return static_cast<size_t>(std::exp2(logDist(rng)));
+      }
+    };
+
+    std::vector<std::vector<size_t>> frames(kNumFrames);
+    for (std::vector<size_t>& frame : frames) {
+      if (distribution == Distribution::Steady && &frame != &frames[0]) {
+        frame = frames[0];
+        continue;
+      }
+
+      frame.resize(kBuildsPerFrame);
+      for (size_t& size : frame) {
+        size = sample();
+      }
+    }
+
+    return frames;
+  }
+
+  static void test_distribution(const Distribution distribution) {
+    const std::vector<std::vector<size_t>> frames = createFrames(distribution);
+    const char* name = kDistributionNames[static_cast<uint32_t>(distribution)];
+
+    for (const uint32_t numFramesToKeep : { kNever, kNumFramesToKeep }) {
+      const bool collect = numFramesToKeep != kNever;
+
+      LinearPool linear;
+      std::vector<size_t> linearSelections;
+      {
+        std::cout << "Replaying " << name << (collect ? " with GC" : "") << ", linear scan --> ";
+        Timer t;
+        uint32_t frameId = 1;
+        for (const std::vector<size_t>& frame : frames) {
+          for (const size_t size : frame) {
+            size_t capacity;
+            if (!linear.acquire(size, frameId, capacity)) {
+              capacity = capacityOf(size);
+              linear.entries.push_back({ capacity, frameId });
+            }
+            linearSelections.push_back(capacity);
+          }
+          linear.garbageCollect(frameId, numFramesToKeep);
+          frameId++;
+        }
+      }
+
+      SizeClassPool<size_t> pool;
+      std::vector<size_t> poolSelections;
+      double wasteRatio = 0.0;
+      {
+        std::cout << "Replaying " << name << (collect ? " with GC" : "") << ", size class pool --> ";
+        Timer t;
+        uint32_t frameId = 1;
+        for (const std::vector<size_t>& frame : frames) {
+          for (const size_t size : frame) {
+            size_t capacity;
+            if (!pool.acquire(size, frameId, capacity)) {
+              capacity = capacityOf(size);
+              pool.insert(capacity, capacity, size, frameId);
+            }
+            poolSelections.push_back(capacity);
+          }
+
+          const SizeClassPool<size_t>::Stats stats = pool.getStats();
+          wasteRatio += double(stats.inFlightBytes - stats.requestedBytes) / double(stats.inFlightBytes);
+
+          pool.garbageCollect(frameId, numFramesToKeep, 0);
+          frameId++;
+        }
+      }
+
+      for (size_t i = 0; i < poolSelections.size(); i++) {
+        if (poolSelections[i] < capacityOf(frames[i / kBuildsPerFrame][i % kBuildsPerFrame])) {
+          throw DxvkError(str::format("Size class pool selected a BLAS too small for build ", i));
+        }
+      }
+
+      if (poolSelections != linearSelections) {
+        throw DxvkError(str::format("Size class pool selections differ from the linear scan for the ", name, " distribution"));
+      }
+
+      const SizeClassPool<size_t>::Stats stats = pool.getStats();
+      std::cout << "  pool: " << stats.numItems << " BLAS, " << (stats.totalBytes >> 20) << " MB, "
+                << (stats.freeBytes >> 20) << " MB free, " << int(100.0 * wasteRatio / frames.size())
+                << "% of in flight bytes unused; linear: " << linear.entries.size() << " BLAS, "
+                << (linear.totalBytes() >> 20) << " MB" << std::endl;
+
+      size_t heldBytes = 0;
+      pool.forEach([&heldBytes](size_t capacity) { heldBytes += capacity; });
+
+      if (stats.numItems != linear.entries.size() || stats.totalBytes != linear.totalBytes() || heldBytes != stats.totalBytes) {
+        throw DxvkError(str::format("Size class pool holds different BLAS'es than the linear scan for the ", name, " distribution"));
+      }
+    }
+  }
+
+  static void test_budget() {
+    SizeClassPool<uint32_t> pool;
+
+    // Ten 1MB BLAS'es last used in frames 1 to 10
+    for (uint32_t i = 0; i < 10; i++) {
+      pool.insert(i, 1 << 20, 1 << 20, i + 1);
+    }
+
+    pool.garbageCollect(12, kNever, 4 << 20);
+
+    // All of them are free by frame 12, the budget keeps the four most recently used
+    const SizeClassPool<uint32_t>::Stats stats = pool.getStats();
+    if (stats.numItems != 4 || stats.totalBytes != (4 << 20) || stats.numFreeItems != 4) {
+      throw DxvkError(str::format("Unexpected pool after collecting over budget: ", stats.numItems, " items, ", stats.totalBytes, " bytes"));
+    }
+
+    std::vector<uint32_t> remaining;
+    pool.forEach([&remaining](uint32_t id) { remaining.push_back(id); });
+    std::sort(remaining.begin(), remaining.end());
+    if (remaining != std::vector<uint32_t> { 6, 7, 8, 9 }) {
+      throw DxvkError("Collecting over budget did not evict the least recently used BLAS'es");
+    }
+
+    // Items in flight are never evicted, even over budget
+    pool.clear();
+    pool.insert(0, 1 << 20, 1 << 20, 12);
+    pool.garbageCollect(12, kNumFramesToKeep, 1);
+    if (pool.getStats().numItems != 1) {
+      throw DxvkError("Collecting over budget evicted a BLAS in flight");
+    }
+  }
+
+  static void test_release() {
+    SizeClassPool<uint32_t> pool;
+    uint32_t id;
+
+    // A static BLAS used this frame must not be handed out before the frame after next
+    pool.release(1, 4096, 10, 10);
+    if (pool.acquire(4096, 11, id)) {
+      throw DxvkError("Released BLAS was handed out while in flight");
+    }
+
+    if (!pool.acquire(4096, 12, id) || id != 1) {
+      throw DxvkError("Released BLAS was not recycled");
+    }
+
+    // Never used and long unused BLAS'es are free immediately, the best fit is selected across classes
+    pool.release(2, 64 * 1024, UINT32_MAX, 12);
+    pool.release(3, 16 * 1024, 3, 12);
+    if (!pool.acquire(5000, 12, id) || id != 3) {
+      throw DxvkError("Pool did not select the smallest sufficient BLAS");
+    }
+
+    if (pool.acquire(128 * 1024, 12, id)) {
+      throw DxvkError("Pool handed out a BLAS too small for the request");
+    }
+  }
+};
+
+int main() {
+  try {
+    SizeClassPoolTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
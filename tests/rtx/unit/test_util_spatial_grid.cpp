@@ -0,0 +1,191 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_spatial_grid.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+// Stand-in for a light, as seen by LightManager::dynamicLightMatching
+struct SyntheticLight {
+  Vector3 position;
+};
+
+class SpatialGridTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    for (uint32_t numLights : { 100u, 1000u, 10000u }) {
+      test_matching(numLights);
+    }
+    test_sharedCandidate();
+    std::cout << "Spatial grid successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr float kUniqueObjectDistance = 300.f;
+
+  struct Candidate {
+    uint32_t index;
+  };
+
+  // Same metric LightManager::isSimilar uses for positional lights
+  static float similarity(const SyntheticLight& a, const SyntheticLight& b) {
+    const float distNormalized = length(a.position - b.position) / kUniqueObjectDistance;
+    return distNormalized <= 1.f ? (1.f - distNormalized) : -1.f;
+  }
+
+  // Lights scattered over a level sized volume, the previous frame's set moved a little (particles, muzzle flashes)
+  static void createLights(const uint32_t numLights, std::vector<SyntheticLight>& oldLights, std::vector<SyntheticLight>& newLights) {
+    std::mt19937 rng(numLights);
+    const float extent = 100.f * std::cbrt((float) numLights) * kUniqueObjectDistance / 10.f;
+    std::uniform_real_distribution<float> positionDist(-extent, extent);
+    std::uniform_real_distribution<float> jitterDist(-kUniqueObjectDistance * 0.5f, kUniqueObjectDistance * 0.5f);
+
+    oldLights.resize(numLights);
+    newLights.resize(numLights);
+    for (uint32_t i = 0; i < numLights; i++) {
+      oldLights[i].position = Vector3(positionDist(rng), positionDist(rng), positionDist(rng));
+      newLights[i].position = oldLights[i].position + Vector3(jitterDist(rng), jitterDist(rng), jitterDist(rng));
+    }
+  }
+
+  static void test_matching(const uint32_t numLights) {
+    std::vector<SyntheticLight> oldLights, newLights;
+    createLights(numLights, oldLights, newLights);
+
+    std::vector<int32_t> linearMatches;
+    {
+      std::cout << "Matching " << numLights << " lights, linear search --> ";
+      Timer t;
+      linearMatches = matchLinear(oldLights, newLights);
+    }
+
+    std::vector<int32_t> gridMatches;
+    {
+      std::cout << "Matching " << numLights << " lights, spatial grid --> ";
+      Timer t;
+      gridMatches = matchGrid(oldLights, newLights);
+    }
+
+    if (linearMatches != gridMatches) {
+      throw DxvkError("Spatial grid matches differ from the linear search");
+    }
+
+    // Non-finite positions are rejected rather than hashed
+    SpatialHashGrid<Candidate> grid;
+    grid.clear(kUniqueObjectDistance);
+    if (grid.insert(Vector3(NAN, 0.f, 0.f), Candidate { 0 })) {
+      throw DxvkError("Spatial grid accepted a non-finite position");
+    }
+  }
+
+  // Two old lights within range of one new light, only the first old light may take it
+  static void test_sharedCandidate() {
+    std::cout << "Matching two old lights against one new light" << std::endl;
+    const std::vector<SyntheticLight> oldLights = {
+      { Vector3(0.f, 0.f, 0.f) },
+      { Vector3(kUniqueObjectDistance * 0.25f, 0.f, 0.f) }
+    };
+    const std::vector<SyntheticLight> newLights = {
+      { Vector3(kUniqueObjectDistance * 0.2f, 0.f, 0.f) }
+    };
+
+    const std::vector<int32_t> expected = { 0, -1 };
+    if (matchLinear(oldLights, newLights) != expected) {
+      throw DxvkError("Linear search matched one new light to two old lights");
+    }
+    if (matchGrid(oldLights, newLights) != expected) {
+      throw DxvkError("Spatial grid matched one new light to two old lights");
+    }
+  }
+
+  // Matches each old light in order to its most similar new light, a new light leaves the candidates once matched
+  static std::vector<int32_t> matchLinear(const std::vector<SyntheticLight>& oldLights, const std::vector<SyntheticLight>& newLights) {
+    std::vector<int32_t> matches(oldLights.size(), -1);
+    std::vector<bool> matched(newLights.size(), false);
+    for (uint32_t i = 0; i < oldLights.size(); i++) {
+      float currentSimilarity = -1.f;
+      for (uint32_t j = 0; j < newLights.size(); j++) {
+        if (matched[j]) {
+          continue;
+        }
+        const float s = similarity(oldLights[i], newLights[j]);
+        if (s > currentSimilarity) {
+          matches[i] = j;
+          currentSimilarity = s;
+        }
+      }
+      if (matches[i] >= 0) {
+        matched[matches[i]] = true;
+      }
+    }
+    return matches;
+  }
+
+  static std::vector<int32_t> matchGrid(const std::vector<SyntheticLight>& oldLights, const std::vector<SyntheticLight>& newLights) {
+    std::vector<int32_t> matches(oldLights.size(), -1);
+    std::vector<bool> matched(newLights.size(), false);
+    SpatialHashGrid<Candidate> grid;
+    grid.clear(kUniqueObjectDistance);
+    for (uint32_t j = 0; j < newLights.size(); j++) {
+      grid.insert(newLights[j].position, Candidate { j });
+    }
+    grid.build();
+
+    for (uint32_t i = 0; i < oldLights.size(); i++) {
+      float currentSimilarity = -1.f;
+      grid.forEachNear(oldLights[i].position, [&](const Candidate& candidate) {
+        if (matched[candidate.index]) {
+          return;
+        }
+        const float s = similarity(oldLights[i], newLights[candidate.index]);
+        if (s > currentSimilarity || (matches[i] >= 0 && s == currentSimilarity && (int32_t) candidate.index < matches[i])) {
+          matches[i] = candidate.index;
+          currentSimilarity = s;
+        }
+      });
+      if (matches[i] >= 0) {
+        matched[matches[i]] = true;
+      }
+    }
+    return matches;
+  }
+};
+
+int main() {
+  try {
+    SpatialGridTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,263 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_lz4.h"
+#include "../../../src/util/util_staging_ring.h"
+#include "../../../src/util/util_threadpool.h"
+
+using namespace dxvk;
+
+class StagingRingTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_regions();
+    test_oversized();
+    test_upload_throughput();
+    std::cout << "Staging ring successfully tested" << std::endl;
+  }
+
+private:
+  // Random regions submitted out of order and retired a few fences later, no live region may overlap another
+  static void test_regions() {
+    constexpr uint64_t kCapacity = 1 << 16;
+    constexpr uint32_t kFencesInFlight = 3;
+
+    struct Live {
+      StagingRing::Region region;
+      uint64_t size;
+      uint64_t fenceValue;
+    };
+
+    StagingRing ring(kCapacity);
+    std::vector<uint32_t> owner(kCapacity, 0);
+    std::deque<Live> live;
+    std::vector<Live> unsubmitted;
+    std::mt19937 rng(3);
+    uint64_t fenceValue = 0;
+    uint32_t numAllocs = 0;
+
+    auto fill = [&](const Live& entry, uint32_t value) {
+      for (uint64_t i = 0; i < entry.size; i++) {
+        uint32_t& byteOwner = owner[entry.region.offset + i];
+        if (value != 0 && byteOwner != 0) {
+          throw DxvkError(str::format("Region at ", entry.region.offset, " overlaps a live region"));
+        }
+        byteOwner = value;
+      }
+    };
+
+    for (uint32_t batch = 0; batch < 20000; batch++) {
+      // Allocate a batch, like the texture manager does, until the ring is full
+      const uint32_t batchSize = 1 + rng() % 8;
+      for (uint32_t i = 0; i < batchSize; i++) {
+        const uint64_t size = 1 + rng() % (kCapacity / 8);
+        const uint64_t alignment = 1ull << (rng() % 7);
+        const StagingRing::Region region = ring.alloc(size, alignment);
+
+        if (region.offset == StagingRing::kInvalidOffset) {
+          break;
+        }
+
+        if (region.offset % alignment != 0 || region.offset + size > kCapacity) {
+          throw DxvkError(str::format("Region at ", region.offset, " of ", size, " bytes is misaligned or wraps around"));
+        }
+
+        unsubmitted.push_back({ region, size, 0 });
+        fill(unsubmitted.back(), ++numAllocs);
+      }
+
+      // Submit in a shuffled order
+      std::shuffle(unsubmitted.begin(), unsubmitted.end(), rng);
+      fenceValue++;
+      for (Live& entry : unsubmitted) {
+        entry.fenceValue = fenceValue;
+        ring.submit(entry.region, fenceValue);
+        live.push_back(entry);
+      }
+      unsubmitted.clear();
+
+      // The GPU lags behind by a few submissions
+      if (fenceValue > kFencesInFlight) {
+        const uint64_t completed = fenceValue - kFencesInFlight;
+        ring.retire(completed);
+
+        while (!live.empty() && live.front().fenceValue <= completed) {
+          fill(live.front(), 0);
+          live.pop_front();
+        }
+      }
+    }
+
+    ring.retire(fenceValue);
+    if (ring.hasPending() || ring.usedBytes() != 0) {
+      throw DxvkError("Regions were left over after the last fence");
+    }
+
+    std::cout << "Allocated " << numAllocs << " regions over " << fenceValue << " submissions" << std::endl;
+  }
+
+  static void test_oversized() {
+    StagingRing ring(1024);
+
+    if (ring.alloc(2048, 16).offset != StagingRing::kInvalidOffset) {
+      throw DxvkError("Region larger than the ring was allocated");
+    }
+
+    // Fill the ring, nothing fits until the oldest region is retired
+    const StagingRing::Region a = ring.alloc(512, 16);
+    const StagingRing::Region b = ring.alloc(512, 16);
+    if (ring.alloc(16, 16).offset != StagingRing::kInvalidOffset) {
+      throw DxvkError("Region was allocated in a full ring");
+    }
+
+    // Retiring waits on the oldest region even if a newer one completed
+    ring.submit(b, 1);
+    ring.submit(a, 2);
+    ring.retire(1);
+    if (ring.alloc(16, 16).offset != StagingRing::kInvalidOffset) {
+      throw DxvkError("Region was recycled before an older one");
+    }
+
+    ring.retire(2);
+    if (ring.alloc(1024, 16).offset != 0) {
+      throw DxvkError("Idle ring did not restart at the beginning");
+    }
+  }
+
+  // CPU side of uploading the streamed mips of a level's textures: LZ4 decode of each texture from a package.
+  // The serial path decodes into a temporary allocation then copies it to staging memory, the parallel path
+  // decodes straight into ring regions from several workers.
+  static void test_upload_throughput() {
+    constexpr uint32_t kNumTextures = 96;
+    constexpr uint64_t kTextureSize = (2048 * 2048) * 4 / 3; // BC7 2K with mips, one byte per texel
+    constexpr uint64_t kRingSize = 64ull << 20;
+    constexpr uint32_t kBatchSize = 8;
+    constexpr uint8_t kNumWorkers = 4;
+
+    // Compressible texture-like content
+    std::mt19937 rng(5);
+    std::vector<uint8_t> texture(kTextureSize);
+    for (uint64_t i = 0; i < kTextureSize; i += 16) {
+      const uint8_t value = uint8_t(rng() % 4);
+      std::fill_n(texture.begin() + i, std::min<uint64_t>(16, kTextureSize - i), uint8_t(value * 60 + (i / 4096) % 7));
+    }
+
+    std::vector<uint8_t> compressed(lz4::compressBound(kTextureSize));
+    compressed.resize(lz4::compress(texture.data(), texture.size(), compressed.data(), compressed.size()));
+    if (compressed.empty()) {
+      throw DxvkError("Failed to compress the test texture");
+    }
+
+    std::unique_ptr<uint8_t[]> staging(new uint8_t[kRingSize]);
+    const double totalMB = double(kNumTextures * kTextureSize) / (1 << 20);
+
+    auto verify = [&](const uint8_t* pData) {
+      if (memcmp(pData, texture.data(), kTextureSize) != 0) {
+        throw DxvkError("Staged texture data does not match the source");
+      }
+    };
+
+    double serialSeconds;
+    {
+      const auto start = std::chrono::high_resolution_clock::now();
+      uint64_t offset = 0;
+      for (uint32_t i = 0; i < kNumTextures; i++) {
+        std::unique_ptr<uint8_t[]> decoded(new uint8_t[kTextureSize]);
+        if (lz4::decompress(compressed.data(), compressed.size(), decoded.get(), kTextureSize) != kTextureSize) {
+          throw DxvkError("Failed to decode the test texture");
+        }
+
+        if (offset + kTextureSize > kRingSize) {
+          offset = 0;
+        }
+        memcpy(staging.get() + offset, decoded.get(), kTextureSize);
+        offset += kTextureSize;
+      }
+      serialSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+      verify(staging.get());
+    }
+
+    double parallelSeconds;
+    {
+      WorkerThreadPool<kBatchSize, true, false> workers(kNumWorkers, "staging-ring-test");
+      StagingRing ring(kRingSize);
+      uint64_t fenceValue = 0;
+
+      const auto start = std::chrono::high_resolution_clock::now();
+      for (uint32_t first = 0; first < kNumTextures; first += kBatchSize) {
+        std::vector<StagingRing::Region> regions;
+        std::vector<Future<bool>> decoded;
+
+        for (uint32_t i = first; i < std::min(first + kBatchSize, kNumTextures); i++) {
+          StagingRing::Region region = ring.alloc(kTextureSize, CACHE_LINE_SIZE);
+          while (region.offset == StagingRing::kInvalidOffset) {
+            // Stand-in for waiting on the copies of the oldest batch
+            ring.retire(ring.oldestFenceValue());
+            region = ring.alloc(kTextureSize, CACHE_LINE_SIZE);
+          }
+
+          uint8_t* pDst = staging.get() + region.offset;
+          regions.push_back(region);
+          decoded.push_back(workers.Schedule([&compressed, pDst]() {
+            return lz4::decompress(compressed.data(), compressed.size(), pDst, kTextureSize) == kTextureSize;
+          }));
+        }
+
+        fenceValue++;
+        for (size_t i = 0; i < regions.size(); i++) {
+          if (!decoded[i].get()) {
+            throw DxvkError("Failed to decode the test texture");
+          }
+          ring.submit(regions[i], fenceValue);
+        }
+      }
+      parallelSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+      verify(staging.get());
+    }
+
+    std::cout << "Staging " << kNumTextures << " textures (" << uint32_t(totalMB) << " MB): serial "
+              << uint32_t(totalMB / serialSeconds) << " MB/s, " << uint32_t(kNumWorkers) << " workers into the ring "
+              << uint32_t(totalMB / parallelSeconds) << " MB/s" << std::endl;
+  }
+};
+
+int main() {
+  try {
+    StagingRingTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
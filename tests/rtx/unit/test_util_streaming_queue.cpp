@@ -0,0 +1,231 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_streaming_queue.h"
+
+using namespace dxvk;
+
+class StreamingQueueTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_ordering();
+    test_reprioritize();
+    test_budget();
+    test_time_to_resident();
+    std::cout << "Streaming queue successfully tested" << std::endl;
+  }
+
+private:
+  // Random pushes, updates, removals and pops checked against a map of the expected priorities
+  static void test_ordering() {
+    StreamingQueue<uint32_t> queue;
+    std::map<uint64_t, float> reference;
+    std::mt19937 rng(7);
+
+    for (uint32_t i = 0; i < 100000; i++) {
+      const uint64_t key = rng() % 512;
+      const float priority = float(rng() % 1000);
+
+      switch (rng() % 4) {
+      case 0:
+      case 1: {
+        const bool added = queue.push(key, uint32_t(key), priority, key * 16);
+        if (added == (reference.count(key) != 0)) {
+          throw DxvkError(str::format("push() of key ", key, " reported the wrong queued state"));
+        }
+        reference[key] = priority;
+        break;
+      }
+      case 2:
+        if (queue.updatePriority(key, priority) != (reference.count(key) != 0)) {
+          throw DxvkError(str::format("updatePriority() of key ", key, " reported the wrong queued state"));
+        }
+        if (reference.count(key) != 0) {
+          reference[key] = priority;
+        }
+        break;
+      case 3:
+        if (queue.remove(key) != (reference.erase(key) != 0)) {
+          throw DxvkError(str::format("remove() of key ", key, " reported the wrong queued state"));
+        }
+        break;
+      }
+
+      if (!queue.empty() && rng() % 8 == 0) {
+        float highest = 0.f;
+        for (const auto& entry : reference) {
+          highest = std::max(highest, entry.second);
+        }
+
+        if (queue.topPriority() != highest) {
+          throw DxvkError(str::format("Top priority ", queue.topPriority(), " is not the highest queued priority ", highest));
+        }
+
+        uint64_t bytes;
+        const uint32_t item = queue.pop(bytes);
+        if (reference[item] != highest || bytes != item * 16) {
+          throw DxvkError(str::format("Popped item ", item, " with the wrong priority or size"));
+        }
+        reference.erase(item);
+      }
+
+      if (queue.size() != reference.size()) {
+        throw DxvkError(str::format("Queue holds ", queue.size(), " requests, expected ", reference.size()));
+      }
+    }
+
+    // Drain, priorities must come out in descending order
+    float previous = std::numeric_limits<float>::max();
+    while (!queue.empty()) {
+      const float priority = queue.topPriority();
+      uint64_t bytes;
+      const uint32_t item = queue.pop(bytes);
+
+      if (priority > previous || reference[item] != priority || queue.contains(item)) {
+        throw DxvkError("Draining the queue did not yield descending priorities");
+      }
+      previous = priority;
+    }
+  }
+
+  static void test_reprioritize() {
+    StreamingQueue<uint32_t> queue;
+    for (uint32_t i = 0; i < 100; i++) {
+      queue.push(i, i, float(i), 0);
+    }
+
+    // Invert the order
+    queue.reprioritize([](const uint32_t&, float priority) {
+      return 100.f - priority;
+    });
+
+    for (uint32_t i = 0; i < 100; i++) {
+      uint64_t bytes;
+      const uint32_t item = queue.pop(bytes);
+      if (item != i) {
+        throw DxvkError(str::format("Reprioritized queue popped ", item, ", expected ", i));
+      }
+    }
+  }
+
+  static void test_budget() {
+    StreamingBudget budget;
+
+    if (!budget.tryConsume(0, 100, 64)) {
+      throw DxvkError("First request of a frame must be granted");
+    }
+
+    if (budget.tryConsume(0, 1, 64)) {
+      throw DxvkError("Request over the frame budget was granted");
+    }
+
+    if (!budget.tryConsume(1, 32, 64) || !budget.tryConsume(1, 32, 64) || budget.tryConsume(1, 1, 64)) {
+      throw DxvkError("Frame budget was not reset or not enforced");
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+      if (!budget.tryConsume(2, 1ull << 30, 0)) {
+        throw DxvkError("Zero budget must not limit requests");
+      }
+    }
+  }
+
+  // A level loads 2000 textures in arbitrary order, 64 of which cover most of the screen.
+  // With a per-frame upload budget, count the frames until all of those are resident.
+  static void test_time_to_resident() {
+    struct Texture {
+      uint32_t id;
+      uint64_t bytes;
+      float coverage;
+    };
+
+    constexpr uint32_t kNumTextures = 2000;
+    constexpr uint32_t kNumHeroTextures = 64;
+    constexpr uint64_t kBudgetBytes = 64ull << 20;
+
+    std::mt19937 rng(11);
+    std::vector<Texture> textures;
+    for (uint32_t i = 0; i < kNumTextures; i++) {
+      const bool hero = i < kNumHeroTextures;
+      const uint64_t size = 1ull << (hero ? 11 : 9 + rng() % 3);
+      textures.push_back({ i, size * size * 4 * 4 / 3, hero ? 2.f : 0.01f * float(rng() % 10 + 1) });
+    }
+    std::shuffle(textures.begin(), textures.end(), rng);
+
+    auto heroesResidentAfter = [&](auto&& popNext, auto&& hasNext) {
+      StreamingBudget budget;
+      uint32_t numHeroes = 0;
+      uint32_t frame = 0;
+      while (hasNext()) {
+        const Texture texture = popNext();
+        while (!budget.tryConsume(frame, texture.bytes, kBudgetBytes)) {
+          frame++;
+        }
+        if (texture.id < kNumHeroTextures && ++numHeroes == kNumHeroTextures) {
+          return frame + 1;
+        }
+      }
+      return ~0u;
+    };
+
+    std::deque<Texture> fifo(textures.begin(), textures.end());
+    const uint32_t fifoFrames = heroesResidentAfter(
+      [&]() { Texture texture = fifo.front(); fifo.pop_front(); return texture; },
+      [&]() { return !fifo.empty(); });
+
+    StreamingQueue<Texture> queue;
+    for (const Texture& texture : textures) {
+      queue.push(texture.id, texture, texture.coverage, texture.bytes);
+    }
+    const uint32_t priorityFrames = heroesResidentAfter(
+      [&]() { uint64_t bytes; return queue.pop(bytes); },
+      [&]() { return !queue.empty(); });
+
+    std::cout << "Frames until " << kNumHeroTextures << " hero textures are resident at " << (kBudgetBytes >> 20)
+              << " MB/frame: FIFO " << fifoFrames << ", prioritized " << priorityFrames << std::endl;
+
+    if (priorityFrames >= fifoFrames) {
+      throw DxvkError("Prioritized streaming did not bring in the hero textures sooner");
+    }
+  }
+};
+
+int main() {
+  try {
+    StreamingQueueTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -19,8 +19,14 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <future>
+#include <new>
 #include <random>
+#include <thread>
 #include <chrono>
 #include <iostream>
 
@@ -33,12 +39,36 @@ using namespace dxvk;
 using namespace std;
 using namespace chrono;
 
+// Counts every heap allocation made by the process, used to check that scheduling is allocation free
+static atomic<uint64_t> g_numAllocations = 0;
+
+void* operator new(size_t size) {
+  ++g_numAllocations;
+  if (void* ptr = malloc(size))
+    return ptr;
+  throw bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
 class ThreadPoolTestApp {
 public:
   static void run() { 
     cout << "Begin test" << endl;
     test_smoke();
     cout << "WorkerThreadPool successfully smoke tested" << endl;
+    test_contention();
+    cout << "WorkerThreadPool successfully contention tested" << endl;
+    test_throughput();
+    cout << "WorkerThreadPool successfully throughput tested" << endl;
+    test_allocations();
+    cout << "WorkerThreadPool successfully allocation tested" << endl;
   }
   
 private:
@@ -52,7 +82,7 @@ private:
     WorkerThreadPool<numTasks> threadPool(numThreads);
     cout << "Created thread pool with " << numThreads << " threads" << endl;
 
-    vector<shared_future<uint32_t>> results;
+    vector<Future<uint32_t>> results;
     {
       Timer t;
       results.resize(numTasks);
@@ -81,7 +111,7 @@ private:
 
     // Count all the return values (1's) and make sure everyone made it home
     uint32_t resultCount = 0;
-    for (shared_future<uint32_t> result : results) {
+    for (Future<uint32_t> result : results) {
       resultCount += result.get();
     }
     FrameMark;
@@ -92,6 +122,146 @@ private:
     if (resultCount != numTasks)
       throw DxvkError("Results didnt match");
   }
+
+  // Many producers scheduling into deliberately undersized queues,
+  // every task must run exactly once (no drops under back-pressure).
+  static void test_contention() {
+    ZoneScoped;
+    const uint32_t numThreads = 4;
+    const uint32_t numProducers = 6;
+    const uint32_t numTasksPerProducer = 20000;
+
+    WorkerThreadPool<64> threadPool(numThreads);
+    atomic<uint32_t> executed = 0;
+
+    {
+      cout << "Scheduling " << numProducers * numTasksPerProducer << " tasks from " << numProducers << " producers --> ";
+      Timer t;
+      vector<thread> producers;
+      for (uint32_t p = 0; p < numProducers; p++) {
+        producers.emplace_back([&threadPool, &executed, p] {
+          vector<Future<void>> results;
+          results.reserve(numTasksPerProducer);
+          for (uint32_t i = 0; i < numTasksPerProducer; i++) {
+            // Mix shared and affinitized tasks
+            Future<void> future = (p & 1) ? threadPool.Schedule<0x3>([&executed] { ++executed; })
+                                                 : threadPool.Schedule([&executed] { ++executed; });
+            if (!future.valid())
+              throw DxvkError("Failed to schedule task");
+
+            results.push_back(future);
+          }
+          for (const Future<void>& result : results) {
+            result.get();
+          }
+        });
+      }
+      for (thread& producer : producers) {
+        producer.join();
+      }
+    }
+
+    cout << "Counted the result, expected:" << numProducers * numTasksPerProducer << ", got:" << executed << endl;
+
+    if (executed != numProducers * numTasksPerProducer)
+      throw DxvkError("Tasks were lost under contention");
+
+    // Tasks scheduling more tasks into full queues must not deadlock
+    atomic<uint32_t> nestedExecuted = 0;
+    {
+      vector<Future<void>> results;
+      for (uint32_t i = 0; i < 256; i++) {
+        results.push_back(threadPool.Schedule([&threadPool, &nestedExecuted] {
+          for (uint32_t j = 0; j < 64; j++) {
+            threadPool.Schedule([&nestedExecuted] { ++nestedExecuted; });
+          }
+        }));
+      }
+      for (const Future<void>& result : results) {
+        result.get();
+      }
+      while (nestedExecuted < 256 * 64) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Measures the cost of pushing small tasks through the pool with one or many producers
+  static void test_throughput() {
+    ZoneScoped;
+    const uint32_t numThreads = 4;
+    const uint32_t numTasks = 200000;
+
+    WorkerThreadPool<4 * 1024> threadPool(numThreads);
+
+    for (uint32_t numProducers : { 1u, 2u, 4u }) {
+      atomic<uint32_t> executed = 0;
+      const uint32_t tasksPerProducer = numTasks / numProducers;
+      {
+        cout << "Throughput with " << numProducers << " producer(s), " << tasksPerProducer * numProducers << " tasks --> ";
+        Timer t;
+        vector<thread> producers;
+        for (uint32_t p = 0; p < numProducers; p++) {
+          producers.emplace_back([&threadPool, &executed, tasksPerProducer] {
+            for (uint32_t i = 0; i < tasksPerProducer; i++) {
+              threadPool.Schedule([&executed] { ++executed; });
+            }
+          });
+        }
+        for (thread& producer : producers) {
+          producer.join();
+        }
+        while (executed < tasksPerProducer * numProducers) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+
+  // Once the future pool has warmed up, scheduling should not allocate at all
+  static void test_allocations() {
+    ZoneScoped;
+    const uint32_t numThreads = 4;
+    const uint32_t numTasks = 1000;
+    const uint32_t numFrames = 4;
+
+    WorkerThreadPool<4 * 1024> threadPool(numThreads);
+    vector<Future<uint32_t>> results;
+    results.reserve(numTasks);
+
+    uint64_t numAllocations = 0;
+    for (uint32_t frame = 0; frame < numFrames; frame++) {
+      const uint64_t allocationsBefore = g_numAllocations;
+      for (uint32_t i = 0; i < numTasks; i++) {
+        results.push_back(threadPool.Schedule([i, frame]() -> uint32_t { return i + frame; }));
+      }
+      for (const Future<uint32_t>& result : results) {
+        result.get();
+      }
+      results.clear();
+      numAllocations = g_numAllocations - allocationsBefore;
+
+      cout << "Frame " << frame << ": scheduled " << numTasks << " tasks with " << numAllocations << " allocations" << endl;
+    }
+
+    // For reference, what the same tasks cost when wrapped with the STL types
+    {
+      vector<shared_future<uint32_t>> stlResults;
+      stlResults.reserve(numTasks);
+      const uint64_t allocationsBefore = g_numAllocations;
+      for (uint32_t i = 0; i < numTasks; i++) {
+        function<uint32_t()> func = bind([i]() -> uint32_t { return i; });
+        shared_ptr<promise<uint32_t>> taskPromise = make_shared<promise<uint32_t>>();
+        stlResults.push_back(taskPromise->get_future());
+        function<void()> work = [func, taskPromise] { taskPromise->set_value(func()); };
+        work();
+      }
+      cout << "STL task wrappers: " << numTasks << " tasks with " << g_numAllocations - allocationsBefore << " allocations" << endl;
+    }
+
+    if (numAllocations != 0)
+      throw DxvkError("Scheduling allocated in steady state");
+  }
 };
 
 int main() {
@@ -0,0 +1,335 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_tlsf.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+// Checks the TLSF allocator against the invariants of a sub-allocator and replays level load
+// style workloads through it and through the linear free list DxvkMemoryChunk used before,
+// without a Vulkan device.
+class TlsfTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test" << std::endl;
+    test_alignment();
+    test_coalescing();
+    test_random_operations();
+    for (const uint32_t liveTarget : { 100u, 250u, 450u }) {
+      test_workload(liveTarget);
+    }
+    std::cout << "TLSF allocator successfully tested" << std::endl;
+  }
+
+private:
+  static constexpr uint64_t kChunkSize = 256ull << 20;
+
+  // The free list DxvkMemoryChunk used before: worst fit scan on alloc, merge scan on free
+  class LinearAllocator {
+  public:
+    explicit LinearAllocator(uint64_t size) {
+      m_freeList.push_back({ 0, size });
+    }
+
+    uint64_t alloc(uint64_t size, uint64_t align) {
+      if (m_freeList.empty()) {
+        return TlsfAllocator::kInvalidOffset;
+      }
+
+      auto bestSlice = m_freeList.begin();
+
+      for (auto slice = m_freeList.begin(); slice != m_freeList.end(); slice++) {
+        if (slice->length == size) {
+          bestSlice = slice;
+          break;
+        } else if (slice->length > bestSlice->length) {
+          bestSlice = slice;
+        }
+      }
+
+      const uint64_t sliceStart = bestSlice->offset;
+      const uint64_t sliceEnd = bestSlice->offset + bestSlice->length;
+      const uint64_t allocStart = alignUp(sliceStart, align);
+      const uint64_t allocEnd = allocStart + size;
+
+      if (allocEnd > sliceEnd) {
+        return TlsfAllocator::kInvalidOffset;
+      }
+
+      m_freeList.erase(bestSlice);
+
+      if (allocStart != sliceStart) {
+        m_freeList.push_back({ sliceStart, allocStart - sliceStart });
+      }
+
+      if (allocEnd != sliceEnd) {
+        m_freeList.push_back({ allocEnd, sliceEnd - allocEnd });
+      }
+
+      return allocStart;
+    }
+
+    void free(uint64_t offset, uint64_t length) {
+      auto curr = m_freeList.begin();
+
+      while (curr != m_freeList.end()) {
+        if (curr->offset == offset + length) {
+          length += curr->length;
+          curr = m_freeList.erase(curr);
+        } else if (curr->offset + curr->length == offset) {
+          offset -= curr->length;
+          length += curr->length;
+          curr = m_freeList.erase(curr);
+        } else {
+          curr++;
+        }
+      }
+
+      m_freeList.push_back({ offset, length });
+    }
+
+    TlsfAllocator::Stats getStats() const {
+      TlsfAllocator::Stats stats;
+      for (const FreeSlice& slice : m_freeList) {
+        stats.freeBytes += slice.length;
+        stats.largestFreeBlock = std::max(stats.largestFreeBlock, slice.length);
+      }
+      stats.numFreeBlocks = uint32_t(m_freeList.size());
+      return stats;
+    }
+
+  private:
+    struct FreeSlice {
+      uint64_t offset;
+      uint64_t length;
+    };
+
+    std::vector<FreeSlice> m_freeList;
+  };
+
+  struct Allocation {
+    uint64_t offset;
+    uint64_t length;
+  };
+
+  static uint64_t alignUp(uint64_t value, uint64_t align) {
+    return (value + align - 1) & ~(align - 1);
+  }
+
+  // Buffer, acceleration structure and texture sized requests, as seen during a level load
+  static void randomRequest(std::mt19937_64& rng, uint64_t& size, uint64_t& align) {
+    const uint32_t kind = rng() % 10;
+    if (kind < 6) {
+      size = 256 + rng() % (64 << 10);
+      align = 256;
+    } else if (kind < 9) {
+      size = (64 << 10) + rng() % (2 << 20);
+      align = 256;
+    } else {
+      size = (64 << 10) << (rng() % 7);
+      align = 64 << 10;
+    }
+    size = alignUp(size, align);
+  }
+
+  static void test_alignment() {
+    TlsfAllocator allocator(1 << 20);
+
+    const uint64_t first = allocator.alloc(3, 1);
+    const uint64_t second = allocator.alloc(100, 4096);
+    const uint64_t third = allocator.alloc(1, 1);
+
+    if (first != 0 || second != 4096) {
+      throw DxvkError(str::format("Unexpected offsets ", first, ", ", second));
+    }
+
+    // The alignment padding is free space again
+    if (third != 3) {
+      throw DxvkError(str::format("Alignment padding was not reused: ", third));
+    }
+
+    if (allocator.alloc(1 << 20, 1) != TlsfAllocator::kInvalidOffset) {
+      throw DxvkError("Allocation larger than the free space succeeded");
+    }
+  }
+
+  static void test_coalescing() {
+    TlsfAllocator allocator(1 << 20);
+    std::vector<uint64_t> offsets;
+    for (uint32_t i = 0; i < 16; i++) {
+      offsets.push_back(allocator.alloc(64 << 10, 1));
+    }
+
+    if (allocator.alloc(1, 1) != TlsfAllocator::kInvalidOffset) {
+      throw DxvkError("Full allocator handed out more memory");
+    }
+
+    // Free every other block, then the rest in reverse, each merge joins both neighbours
+    for (uint32_t i = 0; i < 16; i += 2) {
+      allocator.free(offsets[i]);
+    }
+
+    if (allocator.getStats().numFreeBlocks != 8 || allocator.getStats().largestFreeBlock != 64 << 10) {
+      throw DxvkError("Freed blocks were merged with allocated neighbours");
+    }
+
+    for (uint32_t i = 15; i < 16; i -= 2) {
+      allocator.free(offsets[i]);
+    }
+
+    const TlsfAllocator::Stats stats = allocator.getStats();
+    if (stats.numFreeBlocks != 1 || stats.largestFreeBlock != 1 << 20 || stats.numAllocations != 0) {
+      throw DxvkError(str::format("Free blocks were not coalesced: ", stats.numFreeBlocks, " blocks"));
+    }
+  }
+
+  // Random allocations and frees, every range must be aligned, in bounds and disjoint from the others
+  static void test_random_operations() {
+    std::mt19937_64 rng(1);
+    TlsfAllocator allocator(kChunkSize);
+    std::map<uint64_t, uint64_t> live;
+    uint64_t liveBytes = 0;
+
+    for (uint32_t i = 0; i < 100000; i++) {
+      if (live.empty() || rng() % 3 != 0) {
+        uint64_t size, align;
+        randomRequest(rng, size, align);
+        align = rng() % 8 == 0 ? 1ull << (rng() % 17) : align;
+
+        const uint64_t offset = allocator.alloc(size, align);
+        if (offset == TlsfAllocator::kInvalidOffset) {
+          // Requests round up to the next list boundary, within 1/32 of their size
+          const uint64_t padded = size + align - 1;
+          if (allocator.getStats().largestFreeBlock >= padded + padded / 32) {
+            throw DxvkError(str::format("Allocation of ", size, " bytes failed with a large enough free block"));
+          }
+          continue;
+        }
+
+        if (offset % align != 0 || offset + size > kChunkSize) {
+          throw DxvkError(str::format("Misaligned or out of bounds allocation at ", offset));
+        }
+
+        auto next = live.lower_bound(offset);
+        if ((next != live.end() && next->first < offset + size) ||
+            (next != live.begin() && std::prev(next)->first + std::prev(next)->second > offset)) {
+          throw DxvkError(str::format("Overlapping allocation at ", offset));
+        }
+
+        live.emplace(offset, size);
+        liveBytes += size;
+      } else {
+        auto it = std::next(live.begin(), rng() % live.size());
+        allocator.free(it->first);
+        liveBytes -= it->second;
+        live.erase(it);
+      }
+
+      if (allocator.getStats().freeBytes != kChunkSize - liveBytes) {
+        throw DxvkError(str::format("Free byte count is off after operation ", i));
+      }
+    }
+
+    for (const auto& allocation : live) {
+      allocator.free(allocation.first);
+    }
+
+    if (allocator.getStats().numFreeBlocks != 1) {
+      throw DxvkError("Freeing everything did not restore a single free block");
+    }
+  }
+
+  // Grows to the target number of live allocations, then keeps churning around it
+  template<typename Allocator>
+  static void replay(const char* name, const uint32_t liveTarget) {
+    constexpr uint32_t kNumOperations = 200000;
+
+    std::mt19937_64 rng(liveTarget);
+    Allocator allocator(kChunkSize);
+    std::vector<Allocation> live;
+    uint32_t failures = 0;
+
+    {
+      std::cout << "  " << name << " --> ";
+      Timer t;
+      for (uint32_t i = 0; i < kNumOperations; i++) {
+        if (live.size() < liveTarget || rng() % 2 == 0) {
+          uint64_t size, align;
+          randomRequest(rng, size, align);
+          const uint64_t offset = allocator.alloc(size, align);
+          if (offset != TlsfAllocator::kInvalidOffset) {
+            live.push_back({ offset, size });
+          } else {
+            failures++;
+          }
+        }
+
+        if (live.size() > liveTarget || (!live.empty() && rng() % 2 == 0)) {
+          const size_t index = rng() % live.size();
+          freeAllocation(allocator, live[index]);
+          live[index] = live.back();
+          live.pop_back();
+        }
+      }
+    }
+
+    const TlsfAllocator::Stats stats = allocator.getStats();
+    const double fragmentation = stats.freeBytes != 0 ? 1.0 - double(stats.largestFreeBlock) / double(stats.freeBytes) : 0.0;
+    std::cout << "    " << stats.numFreeBlocks << " free blocks, " << (stats.freeBytes >> 20) << " MB free, largest "
+              << (stats.largestFreeBlock >> 20) << " MB, fragmentation " << uint32_t(fragmentation * 100.0) << "%, "
+              << failures << " failed allocations" << std::endl;
+  }
+
+  static void freeAllocation(TlsfAllocator& allocator, const Allocation& allocation) {
+    allocator.free(allocation.offset);
+  }
+
+  static void freeAllocation(LinearAllocator& allocator, const Allocation& allocation) {
+    allocator.free(allocation.offset, allocation.length);
+  }
+
+  static void test_workload(const uint32_t liveTarget) {
+    std::cout << liveTarget << " live allocations in a " << (kChunkSize >> 20) << " MB chunk:" << std::endl;
+    replay<LinearAllocator>("linear free list", liveTarget);
+    replay<TlsfAllocator>("TLSF", liveTarget);
+  }
+};
+
+int main() {
+  try {
+    TlsfTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}